@@ -15,13 +15,16 @@
 #include <bluetooth/uuid.h>
 #include <bluetooth/gatt.h>
 
+#include <bluetooth/cx_link.h>
 #include <bluetooth/services/cx_endpoint.h>
+#include <bluetooth/services/cx_endpoint_rpc.h>
 
 #include <settings/settings.h>
 
 #include <dk_buttons_and_leds.h>
 
 #include <motor_controller.h>
+#include <motor_stream.h>
 
 #define DEVICE_NAME             CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN         (sizeof(DEVICE_NAME) - 1)
@@ -35,7 +38,45 @@
 
 #define USER_BUTTON             DK_BTN1_MSK
 
+/* RPC methods of the motor controller. */
+enum {
+	/* Arguments: int8_t speed of the first motor. Results: int8_t speed
+	 * applied.
+	 */
+	MOTOR_RPC_SET_SPEED,
+	/* No arguments. Results: int8_t current speed of the first motor,
+	 * ramping towards the last setpoint.
+	 */
+	MOTOR_RPC_GET_STATUS,
+	/* Arguments: int32_t kp, ki, kd in Q16.16, uint16_t control rate in
+	 * Hz, little endian. Results: none.
+	 */
+	MOTOR_RPC_SET_PID,
+	/* No arguments. Results: as the arguments of MOTOR_RPC_SET_PID. */
+	MOTOR_RPC_GET_PID,
+	/* No arguments. Results: uint32_t underruns, overruns, played,
+	 * uint8_t buffered, little endian.
+	 */
+	MOTOR_RPC_GET_STREAM_STATS,
+	/* Arguments: { uint8_t motor, int8_t speed } per motor, all applied
+	 * in the same control period. Results: none.
+	 */
+	MOTOR_RPC_SET_GROUP,
+	/* No arguments. Results: uint8_t number of motors, int8_t current
+	 * speed of each.
+	 */
+	MOTOR_RPC_GET_GROUP_STATUS,
+};
+
+#define MOTOR_RPC_PID_LEN	14
+
+/* Setpoints of a MOTOR_RPC_SET_GROUP request, on the stack of the
+ * Bluetooth receive thread.
+ */
+#define MOTOR_RPC_GROUP_MAX	16
+
 static bool app_button_state;
+static int8_t motor_speed;
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -64,8 +105,13 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	LOG_INF("Disconnected (reason %u)", reason);
 
-	int err = motor_controller_set(0);
-	LOG_INF("Motor Controller Speed set to %d - Result: %d",0,err);
+#if defined(CONFIG_APP_MOTOR_STREAM)
+	motor_stream_stop();
+#endif
+
+	int err = motor_controller_stop();
+	LOG_INF("Motor Controller stopped - Result: %d",err);
+	motor_speed = 0;
 
 	//dk_set_led_off(CON_STATUS_LED);
 }
@@ -77,19 +123,55 @@ static struct bt_conn_cb conn_callbacks = {
 
 static struct bt_conn_auth_cb conn_auth_callbacks;
 
-static void recv_data_cb(const uint8_t *data, uint16_t len)
+static void link_tuned(struct bt_conn *conn, const struct bt_cx_link_info *info,
+		       int err)
+{
+	LOG_INF("Link tuned: MTU %u, interval %u, data len %u (err %d)",
+		info->mtu, info->interval, info->tx_max_len, err);
+}
+
+static struct bt_cx_link_cb link_callbacks = {
+	.tuned = link_tuned,
+};
+
+/* The speed write is a single int8_t speed, echoed back with the speed
+ * applied. Streamed setpoints start with MOTOR_STREAM_ID. Built with
+ * overlay-rpc.conf, every message starts with a channel header, so the
+ * speed write becomes { 0x00, int8_t speed } on the default channel.
+ */
+static void recv_data_cb(struct bt_conn *conn, const uint8_t *data, uint16_t len)
 {
 	int err;
 	LOG_INF("received data - Len: %d",len);
 	LOG_HEXDUMP_INF(data,len,"recvd_data");
 
+	if (!len) {
+		LOG_INF("Empty message dropped");
+		return;
+	}
+
+#if defined(CONFIG_APP_MOTOR_STREAM)
+	if (data[0] == MOTOR_STREAM_ID) {
+		/* Played out later, without echo. */
+		err = motor_stream_recv(data, len);
+		if (err) {
+			LOG_INF("Stream packet dropped (err %d)", err);
+		}
+		return;
+	}
+
+	/* A single setpoint takes over from the stream. */
+	motor_stream_stop();
+#endif
+
 	int8_t speed = data[0];
-	err = motor_controller_set(speed);
+	err = motor_controller_set(0, speed);
 	LOG_INF("Motor Controller Speed set to %d - Result: %d",speed,err);
 	if(err)
 		speed = 0;
+	motor_speed = speed;
 
-	err = bt_cx_endpoint_send_data(&speed,1);
+	err = bt_cx_endpoint_send(conn,&speed,1);
 	LOG_INF("Sending back the speed set - Result: %d",err);
 
 	//dk_set_led(USER_LED, data[0]);
@@ -99,6 +181,188 @@ static struct bt_cx_endpoint_cb cx_endpoint_callbacs = {
 	.recv_cb    = recv_data_cb,
 };
 
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+static int rpc_set_speed(struct bt_conn *conn, const uint8_t *args,
+			 uint16_t len, struct net_buf *rsp)
+{
+	int8_t speed;
+	int err;
+
+	if (len != sizeof(speed)) {
+		return -EINVAL;
+	}
+
+	speed = args[0];
+
+#if defined(CONFIG_APP_MOTOR_STREAM)
+	/* A single setpoint takes over from the stream. */
+	motor_stream_stop();
+#endif
+
+	err = motor_controller_set(0, speed);
+	if (err) {
+		LOG_INF("Motor Controller Speed %d rejected (err %d)", speed,
+			err);
+		return err;
+	}
+
+	motor_speed = speed;
+	net_buf_add_u8(rsp, motor_speed);
+
+	return 0;
+}
+
+static int rpc_get_status(struct bt_conn *conn, const uint8_t *args,
+			  uint16_t len, struct net_buf *rsp)
+{
+	int8_t speed;
+	int err;
+
+	err = motor_controller_speed_get(0, &speed);
+	if (err) {
+		return err;
+	}
+
+	net_buf_add_u8(rsp, speed);
+
+	return 0;
+}
+
+static int rpc_set_group(struct bt_conn *conn, const uint8_t *args,
+			 uint16_t len, struct net_buf *rsp)
+{
+	struct motor_controller_setpoint setpoints[MOTOR_RPC_GROUP_MAX];
+	size_t count = len / 2;
+	int err;
+
+	if ((len % 2) || (count > ARRAY_SIZE(setpoints))) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		setpoints[i].motor = args[2 * i];
+		setpoints[i].speed = args[2 * i + 1];
+	}
+
+	err = motor_controller_set_group(setpoints, count);
+	if (err) {
+		LOG_INF("Motor Controller group rejected (err %d)", err);
+	}
+
+	return err;
+}
+
+static int rpc_get_group_status(struct bt_conn *conn, const uint8_t *args,
+				uint16_t len, struct net_buf *rsp)
+{
+	size_t count = motor_controller_count();
+	int8_t speed;
+	int err;
+
+	net_buf_add_u8(rsp, count);
+
+	for (uint8_t i = 0; i < count; i++) {
+		err = motor_controller_speed_get(i, &speed);
+		if (err) {
+			return err;
+		}
+
+		net_buf_add_u8(rsp, speed);
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_APP_MOTOR_PID)
+static int rpc_set_pid(struct bt_conn *conn, const uint8_t *args,
+		       uint16_t len, struct net_buf *rsp)
+{
+	struct motor_controller_pid pid;
+	uint16_t rate;
+	int err;
+
+	if (len != MOTOR_RPC_PID_LEN) {
+		return -EINVAL;
+	}
+
+	pid.kp = sys_get_le32(&args[0]);
+	pid.ki = sys_get_le32(&args[4]);
+	pid.kd = sys_get_le32(&args[8]);
+	rate = sys_get_le16(&args[12]);
+
+	/* Checked as by the motor controller, before applying anything, so
+	 * that a rejected call changes neither the gains nor the rate.
+	 */
+	if ((pid.kp < 0) || (pid.ki < 0) || (pid.kd < 0) || (rate == 0) ||
+	    (rate > CONFIG_SYS_CLOCK_TICKS_PER_SEC)) {
+		LOG_WRN("PID gains %d %d %d, rate %u Hz rejected", pid.kp,
+			pid.ki, pid.kd, rate);
+		return -EINVAL;
+	}
+
+	err = motor_controller_pid_set(&pid);
+	if (!err) {
+		err = motor_controller_rate_set(rate);
+	}
+
+	LOG_INF("PID gains %d %d %d, rate %u Hz (err %d)", pid.kp, pid.ki,
+		pid.kd, rate, err);
+
+	return err;
+}
+
+static int rpc_get_pid(struct bt_conn *conn, const uint8_t *args,
+		       uint16_t len, struct net_buf *rsp)
+{
+	struct motor_controller_pid pid;
+	int err;
+
+	err = motor_controller_pid_get(&pid);
+	if (err) {
+		return err;
+	}
+
+	net_buf_add_le32(rsp, pid.kp);
+	net_buf_add_le32(rsp, pid.ki);
+	net_buf_add_le32(rsp, pid.kd);
+	net_buf_add_le16(rsp, motor_controller_rate_get());
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_MOTOR_STREAM)
+static int rpc_get_stream_stats(struct bt_conn *conn, const uint8_t *args,
+				uint16_t len, struct net_buf *rsp)
+{
+	struct motor_stream_stats stats;
+
+	motor_stream_stats_get(&stats);
+
+	net_buf_add_le32(rsp, stats.underruns);
+	net_buf_add_le32(rsp, stats.overruns);
+	net_buf_add_le32(rsp, stats.played);
+	net_buf_add_u8(rsp, stats.buffered);
+
+	return 0;
+}
+#endif
+
+static const struct bt_cx_endpoint_rpc_method rpc_methods[] = {
+	{ MOTOR_RPC_SET_SPEED, rpc_set_speed },
+	{ MOTOR_RPC_GET_STATUS, rpc_get_status },
+	{ MOTOR_RPC_SET_GROUP, rpc_set_group },
+	{ MOTOR_RPC_GET_GROUP_STATUS, rpc_get_group_status },
+#if defined(CONFIG_APP_MOTOR_PID)
+	{ MOTOR_RPC_SET_PID, rpc_set_pid },
+	{ MOTOR_RPC_GET_PID, rpc_get_pid },
+#endif
+#if defined(CONFIG_APP_MOTOR_STREAM)
+	{ MOTOR_RPC_GET_STREAM_STATS, rpc_get_stream_stats },
+#endif
+};
+#endif
+
 static void button_changed(uint32_t button_state, uint32_t has_changed)
 {
 	if (has_changed & USER_BUTTON) {
@@ -138,6 +402,14 @@ void main(void)
 		return;
 	}
 
+#if defined(CONFIG_APP_MOTOR_STREAM)
+	err = motor_stream_init();
+	if (err) {
+		LOG_INF("Motor stream init failed (err %d)", err);
+		return;
+	}
+#endif
+
 	err = init_button();
 	if (err) {
 		LOG_INF("Button init failed (err %d)", err);
@@ -161,12 +433,26 @@ void main(void)
 		settings_load();
 	}
 
+	err = bt_cx_link_init(&link_callbacks);
+	if (err) {
+		LOG_INF("Failed to init link tuning (err %d)", err);
+		return;
+	}
+
 	err = bt_cx_endpoint_init(&cx_endpoint_callbacs);
 	if (err) {
 		LOG_INF("Failed to init CX_ENDPOINT (err:%d)", err);
 		return;
 	}
 
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+	err = bt_cx_endpoint_rpc_init(rpc_methods, ARRAY_SIZE(rpc_methods));
+	if (err) {
+		LOG_INF("Failed to init CX_ENDPOINT RPC (err:%d)", err);
+		return;
+	}
+#endif
+
 	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
 			      sd, ARRAY_SIZE(sd));
 	if (err) {
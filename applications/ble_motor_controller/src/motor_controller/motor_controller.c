@@ -1,54 +1,862 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#define DT_DRV_COMPAT croxel_motor
+
+#include <errno.h>
+#include <stdlib.h>
+#include <zephyr.h>
+#include <devicetree.h>
 #include <motor_controller.h>
 #include <drivers/pwm_dual.h>
+#include <drivers/sensor.h>
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(motor_controller, CONFIG_LOG_DEFAULT_LEVEL);
+
+#if !DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
+#error "No croxel,motor node in the devicetree"
+#endif
+
+/* Speeds are in percent of full speed, Q16.16 fixed point. */
+#define SPEED_SHIFT	16
+#define SPEED(percent)	((int32_t)(percent) << SPEED_SHIFT)
+#define SPEED_MAX	SPEED(100)
+
+/* Position along a ramp, Q16 from 0 to 1. */
+#define RAMP_ONE	BIT(16)
+
+/* Gain in thousandths to Q16.16. */
+#define GAIN(milli)	((int32_t)(((int64_t)(milli) << 16) / 1000))
+
+struct motor_config {
+	const char *label;
+	const char *pwm_label;
+	/* NULL without encoder. */
+	const char *encoder_label;
+	uint32_t period_usec;
+	/* Forward and backward, before inversion. */
+	uint8_t channels[2];
+	bool invert;
+};
+
+#define MOTOR_ENCODER_LABEL(inst)					\
+	COND_CODE_1(DT_INST_NODE_HAS_PROP(inst, encoder),		\
+		    (DT_LABEL(DT_INST_PHANDLE(inst, encoder))), (NULL))
+
+#define MOTOR_CONFIG(inst)						\
+	{								\
+		.label = DT_INST_LABEL(inst),				\
+		.pwm_label = DT_LABEL(DT_INST_PHANDLE(inst, pwm_dual)),	\
+		.encoder_label = MOTOR_ENCODER_LABEL(inst),		\
+		.period_usec = DT_INST_PROP(inst, period_us),		\
+		.channels = DT_INST_PROP(inst, channels),		\
+		.invert = DT_INST_PROP(inst, invert),			\
+	},
+
+#define MOTOR_CHECK(inst)						\
+	BUILD_ASSERT(DT_INST_PROP_LEN(inst, channels) == 2,		\
+		     DT_INST_LABEL(inst) " needs two channels");
+
+DT_INST_FOREACH_STATUS_OKAY(MOTOR_CHECK)
+
+/* Motors are numbered in instance order. */
+static const struct motor_config configs[] = {
+	DT_INST_FOREACH_STATUS_OKAY(MOTOR_CONFIG)
+};
+
+#define MOTOR_COUNT	ARRAY_SIZE(configs)
+
+/* Motors driven by the same PWM Dual group, updated with one reload. */
+struct group {
+	const struct device *dev;
+	uint32_t period_usec;
+
+	/* PWM period and pulse of each whole percent of speed, in cycles,
+	 * from the clock rate of the PWM controller.
+	 */
+	uint32_t period_cycles;
+	uint32_t pulse_table[101];
+
+	/* Pulse in cycles per percent of speed, Q16.16. */
+	uint64_t cycles_per_percent;
+
+	/* Staged by output(), applied by flush(). */
+	uint32_t pulses[CONFIG_PWM_DUAL_CHANNELS_MAX];
+	bool changed;
+
+	/* Channels taken by a motor. */
+	uint32_t taken;
+};
+
+struct motor {
+	const struct motor_config *config;
+	struct group *group;
+	uint8_t forward;
+	uint8_t backward;
+
+	/* Setpoint, or reference along the ramp towards it. */
+	int32_t speed;
+
+	/* Signed pulse applied last, in cycles. */
+	int64_t applied;
+
+#if defined(CONFIG_APP_MOTOR_RAMP)
+	/* Current ramp, from start to start + delta in steps control
+	 * periods.
+	 */
+	struct {
+		enum motor_controller_profile profile;
+		int32_t start;
+		int32_t delta;
+		uint32_t steps;
+		uint32_t step;
+	} plan;
+#endif
+
+#if defined(CONFIG_APP_MOTOR_PID)
+	/* NULL for an open-loop motor. */
+	const struct device *qdec;
+
+	/* Speed measured at the last control period. */
+	int32_t measured;
+
+	/* Updated by the control work only. */
+	struct {
+		int32_t integral;
+		int32_t measured;
+		bool measured_valid;
+	} loop;
+#endif
+};
+
+static struct k_spinlock lock;
+
+static struct motor motors[MOTOR_COUNT];
+
+static struct group groups[MOTOR_COUNT];
+static size_t group_count;
+
+/* Serializes the staging and reloads of the groups. */
+static K_MUTEX_DEFINE(output_lock);
+
+/* At least one motor has an encoder, the control loop then runs
+ * continuously.
+ */
+static bool closed_loop;
+
+#if defined(CONFIG_APP_MOTOR_CONTROL_RATE_HZ)
+static uint32_t rate_hz = CONFIG_APP_MOTOR_CONTROL_RATE_HZ;
+
+static struct k_timer control_timer;
+static struct k_work control_work;
+
+/* Set while the timer runs, updated with the lock held. */
+static bool control_running;
+#endif
+
+#if defined(CONFIG_APP_MOTOR_RAMP)
+static struct motor_controller_ramp ramp = {
+	.profile = IS_ENABLED(CONFIG_APP_MOTOR_RAMP_PROFILE_LINEAR) ?
+		   MOTOR_CONTROLLER_PROFILE_LINEAR :
+		   MOTOR_CONTROLLER_PROFILE_S_CURVE,
+	.accel = CONFIG_APP_MOTOR_RAMP_ACCEL,
+};
+#endif
+
+#if defined(CONFIG_APP_MOTOR_PID)
+static struct motor_controller_pid pid = {
+	.kp = GAIN(CONFIG_APP_MOTOR_PID_KP),
+	.ki = GAIN(CONFIG_APP_MOTOR_PID_KI),
+	.kd = GAIN(CONFIG_APP_MOTOR_PID_KD),
+};
+#endif
+
+/* Stage the pulse of a motor in its group, called with the output lock
+ * held.
+ */
+static void output(struct motor *motor, int32_t value)
+{
+	struct group *group = motor->group;
+	uint32_t magnitude = abs(value);
+	int64_t pulse;
+
+	/* Whole percents, from the setpoints without ramp or PID, are
+	 * looked up.
+	 */
+	if (!(magnitude & BIT_MASK(SPEED_SHIFT))) {
+		pulse = group->pulse_table[magnitude >> SPEED_SHIFT];
+	} else {
+		pulse = ((uint64_t)magnitude * group->cycles_per_percent) >> 32;
+	}
+
+	if (value < 0) {
+		pulse = -pulse;
+	}
+
+	if (pulse == motor->applied) {
+		return;
+	}
+
+	group->pulses[motor->forward] = (pulse > 0) ? pulse : 0;
+	group->pulses[motor->backward] = (pulse < 0) ? -pulse : 0;
+	group->changed = true;
+	motor->applied = pulse;
+}
+
+/* Reload the groups with staged pulses, called with the output lock held.
+ * The motors of a group change in the same PWM period.
+ */
+static int flush(void)
+{
+	int ret = 0;
+	int err;
+
+	for (size_t i = 0; i < group_count; i++) {
+		struct group *group = &groups[i];
+
+		if (!group->changed) {
+			continue;
+		}
+
+		err = pwm_dual_set_cycles(group->dev, group->period_cycles,
+					  group->pulses);
+		if (err) {
+			/* Retried with the next update. */
+			ret = err;
+			continue;
+		}
+
+		group->changed = false;
+	}
+
+	return ret;
+}
+
+static int group_init(struct group *group, const struct device *dev,
+		      uint32_t period_usec)
+{
+	uint64_t cycles_per_sec;
+	int err;
 
-#define PERIOD_USEC	20000U
-
-static const char * device_name = "PWM_0";
-static const struct device * pwm;
-
-int motor_controller_set(int8_t speed)
-{
-    int err = 0;
-
-    struct pwm_dual_duty_cycle duty_cycle = {
-        .period = PERIOD_USEC,
-        .ch0 = {
-            .pin = 24,
-            .pulse = 0U,
-        },
-        .ch1 = {
-            .pin = 44,
-            .pulse = 0U,
-        },
-    };
-    
-    uint32_t pulse_width = 0;
-    if(speed > 0 && speed <= 100){
-        pulse_width = PERIOD_USEC *speed/100;
-        duty_cycle.ch0.pulse = pulse_width;
-    }
-    else if(speed < 0 && speed >= -100){
-        pulse_width = PERIOD_USEC *(256 - ((uint8_t)speed) )/100;        
-        duty_cycle.ch1.pulse = pulse_width;
-    }
-    else{
-        err = -1;        
-    }
-
-    pwm_dual_set_usec(pwm,&duty_cycle);
-
-    return err;
+	err = pwm_dual_get_cycles_per_sec(dev, &cycles_per_sec);
+	if (err) {
+		return err;
+	}
+
+	if (((uint64_t)period_usec * cycles_per_sec) / USEC_PER_SEC >
+	    UINT32_MAX) {
+		return -ENOTSUP;
+	}
+
+	group->dev = dev;
+	group->period_usec = period_usec;
+	group->period_cycles = ((uint64_t)period_usec * cycles_per_sec) /
+			       USEC_PER_SEC;
+	group->cycles_per_percent = ((uint64_t)group->period_cycles << 16) /
+				    100;
+
+	for (int i = 0; i < ARRAY_SIZE(group->pulse_table); i++) {
+		group->pulse_table[i] = ((uint64_t)group->period_cycles * i) /
+					100;
+	}
+
+	return 0;
+}
+
+static int motor_init(struct motor *motor, const struct motor_config *config)
+{
+	const struct device *dev;
+	struct group *group = NULL;
+	uint32_t channels;
+	int err;
+
+	dev = device_get_binding(config->pwm_label);
+	if (!dev) {
+		return -ENODEV;
+	}
+
+	if ((config->channels[0] >= pwm_dual_channel_count(dev)) ||
+	    (config->channels[1] >= pwm_dual_channel_count(dev)) ||
+	    (config->channels[0] == config->channels[1])) {
+		LOG_ERR("%s: invalid channels", config->label);
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < group_count; i++) {
+		if (groups[i].dev == dev) {
+			group = &groups[i];
+		}
+	}
+
+	if (!group) {
+		group = &groups[group_count];
+		err = group_init(group, dev, config->period_usec);
+		if (err) {
+			return err;
+		}
+
+		group_count++;
+	} else if (group->period_usec != config->period_usec) {
+		/* The channels of a group share their period. */
+		LOG_ERR("%s: period differs from %s", config->label,
+			config->pwm_label);
+		return -EINVAL;
+	}
+
+	channels = BIT(config->channels[0]) | BIT(config->channels[1]);
+	if (group->taken & channels) {
+		LOG_ERR("%s: channels already taken", config->label);
+		return -EINVAL;
+	}
+
+	group->taken |= channels;
+
+	motor->config = config;
+	motor->group = group;
+	motor->forward = config->channels[config->invert];
+	motor->backward = config->channels[!config->invert];
+	motor->applied = INT64_MIN;
+
+#if defined(CONFIG_APP_MOTOR_PID)
+	if (config->encoder_label) {
+		motor->qdec = device_get_binding(config->encoder_label);
+		if (!motor->qdec) {
+			return -ENODEV;
+		}
+
+		closed_loop = true;
+	}
+#endif
+
+	return 0;
+}
+
+#if defined(CONFIG_APP_MOTOR_CONTROL_RATE_HZ)
+/* Start the control periods at the current rate, called with the lock
+ * held. Periods already running keep their phase.
+ */
+static void control_start(void)
+{
+	k_timeout_t period = K_USEC(USEC_PER_SEC / rate_hz);
+
+	if (control_running) {
+		return;
+	}
+
+	k_timer_start(&control_timer, period, period);
+	control_running = true;
+}
+
+/* Restart the control periods at a new rate, called with the lock held. */
+static void control_restart(void)
+{
+	control_running = false;
+	control_start();
+}
+#endif
+
+#if defined(CONFIG_APP_MOTOR_RAMP)
+/* Fraction of the ramp covered at position x, both Q16 from 0 to 1. */
+static uint32_t profile(enum motor_controller_profile shape, uint32_t x)
+{
+	switch (shape) {
+	case MOTOR_CONTROLLER_PROFILE_S_CURVE:
+		/* Smoothstep 3x^2 - 2x^3, with a peak slope of 1.5. */
+		return ((uint64_t)x * x * (3 * RAMP_ONE - 2 * x)) >> 32;
+	case MOTOR_CONTROLLER_PROFILE_LINEAR:
+	default:
+		return x;
+	}
+}
+
+/* Called with the lock held. */
+static void plan_start(struct motor *motor, int32_t target)
+{
+	uint64_t steps;
+
+	motor->plan.profile = ramp.profile;
+	motor->plan.start = motor->speed;
+	motor->plan.delta = target - motor->speed;
+	motor->plan.step = 0;
+
+	/* Duration at the peak acceleration, 1.5 times longer for the
+	 * S-curve.
+	 */
+	steps = ((uint64_t)abs(motor->plan.delta) * rate_hz) / ramp.accel;
+	if (motor->plan.profile == MOTOR_CONTROLLER_PROFILE_S_CURVE) {
+		steps = (3 * steps) / 2;
+	}
+
+	steps = DIV_ROUND_UP(steps, BIT(SPEED_SHIFT));
+	motor->plan.steps = CLAMP(steps, 1, UINT32_MAX);
+}
+
+/* Called with the lock held. Returns true at the end of the ramp. */
+static bool plan_advance(struct motor *motor, uint32_t elapsed)
+{
+	uint32_t x;
+
+	if (motor->plan.step == motor->plan.steps) {
+		return true;
+	}
+
+	motor->plan.step = MIN((uint64_t)motor->plan.step + elapsed,
+			       motor->plan.steps);
+	x = ((uint64_t)motor->plan.step * RAMP_ONE) / motor->plan.steps;
+	motor->speed = motor->plan.start +
+		       (((int64_t)motor->plan.delta *
+			 profile(motor->plan.profile, x)) >> 16);
+
+	return motor->plan.step == motor->plan.steps;
+}
+#endif
+
+#if defined(CONFIG_APP_MOTOR_PID)
+/* Speed over the last elapsed control periods, from the rotation since
+ * the previous sample.
+ */
+static int measure(struct motor *motor, uint32_t elapsed, uint32_t rate,
+		   int32_t *value)
+{
+	struct sensor_value rotation;
+	int64_t mdeg;
+	int err;
+
+	err = sensor_sample_fetch(motor->qdec);
+	if (!err) {
+		err = sensor_channel_get(motor->qdec, SENSOR_CHAN_ROTATION,
+					 &rotation);
+	}
+	if (err) {
+		return err;
+	}
+
+	/* RPM is mdeg * rate / (6000 * elapsed). */
+	mdeg = (rotation.val1 * 1000LL) + (rotation.val2 / 1000);
+	*value = (mdeg * rate * SPEED_MAX) /
+		 (6000LL * elapsed * CONFIG_APP_MOTOR_PID_MAX_RPM);
+
+	return 0;
+}
+
+static int32_t pid_update(struct motor *motor,
+			  const struct motor_controller_pid *gains,
+			  int32_t reference, int32_t value, uint32_t elapsed,
+			  uint32_t rate)
+{
+	int32_t error = reference - value;
+	int64_t integral;
+	int64_t out;
+
+	integral = motor->loop.integral +
+		   ((((int64_t)gains->ki * error) >> 16) * elapsed) / rate;
+	integral = CLAMP(integral, -SPEED_MAX, SPEED_MAX);
+
+	out = ((int64_t)gains->kp * error) >> 16;
+
+	/* On the measurement only, so that setpoint steps do not kick. */
+	if (motor->loop.measured_valid) {
+		out -= ((((int64_t)gains->kd *
+			  (value - motor->loop.measured)) >> 16) * rate) /
+		       elapsed;
+	}
+
+	/* Anti-windup: no integration further into saturation. */
+	if (((out + integral > SPEED_MAX) && (error > 0)) ||
+	    ((out + integral < -SPEED_MAX) && (error < 0))) {
+		integral = motor->loop.integral;
+	}
+
+	motor->loop.integral = integral;
+	motor->loop.measured = value;
+	motor->loop.measured_valid = true;
+
+	return CLAMP(out + integral, -SPEED_MAX, SPEED_MAX);
+}
+
+/* Duty cycle of a closed-loop motor following its reference. */
+static int32_t pid_control(struct motor *motor,
+			   const struct motor_controller_pid *gains,
+			   int32_t reference, uint32_t elapsed, uint32_t rate)
+{
+	k_spinlock_key_t key;
+	int32_t sample;
+	int err;
+
+	err = measure(motor, elapsed, rate, &sample);
+	if (err) {
+		/* Coast rather than act on a stale speed. */
+		LOG_ERR("%s: speed not measured (err %d)",
+			motor->config->label, err);
+		motor->loop.integral = 0;
+		motor->loop.measured_valid = false;
+		return 0;
+	}
+
+	key = k_spin_lock(&lock);
+	motor->measured = sample;
+	k_spin_unlock(&lock, key);
+
+	return pid_update(motor, gains, reference, sample, elapsed, rate);
+}
+#endif
+
+#if defined(CONFIG_APP_MOTOR_CONTROL_RATE_HZ)
+static void control_tick(struct k_work *work)
+{
+	uint32_t elapsed = k_timer_status_get(&control_timer);
+	int32_t values[MOTOR_COUNT];
+	k_spinlock_key_t key;
+	bool done = true;
+	int err;
+
+	/* Timer restarted since the submission. */
+	if (!elapsed) {
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+#if defined(CONFIG_APP_MOTOR_RAMP)
+		/* Control periods missed by the work queue are caught up,
+		 * so that the trajectories only depend on time.
+		 */
+		if (!plan_advance(&motors[i], elapsed)) {
+			done = false;
+		}
+#endif
+		values[i] = motors[i].speed;
+	}
+
+	if (done && !closed_loop) {
+		k_timer_stop(&control_timer);
+		control_running = false;
+	}
+
+#if defined(CONFIG_APP_MOTOR_PID)
+	struct motor_controller_pid gains = pid;
+	uint32_t rate = rate_hz;
+
+	k_spin_unlock(&lock, key);
+
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+		if (motors[i].qdec) {
+			values[i] = pid_control(&motors[i], &gains, values[i],
+						elapsed, rate);
+		}
+	}
+#else
+	k_spin_unlock(&lock, key);
+#endif
+
+	/* All the motors are updated in the same tick. */
+	k_mutex_lock(&output_lock, K_FOREVER);
+
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+		output(&motors[i], values[i]);
+	}
+
+	err = flush();
+
+	k_mutex_unlock(&output_lock);
+
+	if (err) {
+		LOG_ERR("Speeds not applied (err %d)", err);
+	}
+}
+
+static void control_expiry(struct k_timer *timer)
+{
+	k_work_submit(&control_work);
+}
+#endif
+
+/* Setpoints of the stream are already shaped by their sender and skip the
+ * ramp when ramped is false.
+ */
+static int setpoints_apply(const struct motor_controller_setpoint *setpoints,
+			   size_t count, bool ramped)
+{
+	bool deferred = closed_loop;
+	k_spinlock_key_t key;
+	int err;
+
+	for (size_t i = 0; i < count; i++) {
+		if ((setpoints[i].motor >= MOTOR_COUNT) ||
+		    (setpoints[i].speed < -100) || (setpoints[i].speed > 100)) {
+			return -EINVAL;
+		}
+	}
+
+	key = k_spin_lock(&lock);
+
+	for (size_t i = 0; i < count; i++) {
+		struct motor *motor = &motors[setpoints[i].motor];
+
+#if defined(CONFIG_APP_MOTOR_RAMP)
+		if (!ramped) {
+			/* Any ramp in progress ends at the new speed. */
+			motor->speed = SPEED(setpoints[i].speed);
+			motor->plan.start = motor->speed;
+			motor->plan.delta = 0;
+			motor->plan.step = motor->plan.steps;
+			continue;
+		}
+
+		/* A repeated setpoint keeps the ramp in progress towards
+		 * it.
+		 */
+		if ((motor->plan.step == motor->plan.steps) ||
+		    (motor->plan.start + motor->plan.delta !=
+		     SPEED(setpoints[i].speed))) {
+			plan_start(motor, SPEED(setpoints[i].speed));
+		}
+#else
+		motor->speed = SPEED(setpoints[i].speed);
+#endif
+	}
+
+#if defined(CONFIG_APP_MOTOR_RAMP)
+	/* The closed loop keeps running at its own pace. */
+	if (ramped && !closed_loop) {
+		control_start();
+		deferred = true;
+	}
+#endif
+
+	k_spin_unlock(&lock, key);
+
+	/* Applied by the next control period. */
+	if (deferred) {
+		return 0;
+	}
+
+	k_mutex_lock(&output_lock, K_FOREVER);
+
+	for (size_t i = 0; i < count; i++) {
+		output(&motors[setpoints[i].motor], SPEED(setpoints[i].speed));
+	}
+
+	err = flush();
+
+	k_mutex_unlock(&output_lock);
+
+	return err;
+}
+
+int motor_controller_set_group(
+	const struct motor_controller_setpoint *setpoints, size_t count)
+{
+	return setpoints_apply(setpoints, count, true);
+}
+
+int motor_controller_set(uint8_t motor, int8_t speed)
+{
+	struct motor_controller_setpoint setpoint = {
+		.motor = motor,
+		.speed = speed,
+	};
+
+	return setpoints_apply(&setpoint, 1, true);
+}
+
+int motor_controller_set_direct(uint8_t motor, int8_t speed)
+{
+	struct motor_controller_setpoint setpoint = {
+		.motor = motor,
+		.speed = speed,
+	};
+
+	return setpoints_apply(&setpoint, 1, false);
+}
+
+int motor_controller_stop(void)
+{
+	struct motor_controller_setpoint setpoints[MOTOR_COUNT];
+
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+		setpoints[i].motor = i;
+		setpoints[i].speed = 0;
+	}
+
+	return motor_controller_set_group(setpoints, MOTOR_COUNT);
+}
+
+size_t motor_controller_count(void)
+{
+	return MOTOR_COUNT;
+}
+
+int motor_controller_speed_get(uint8_t motor, int8_t *speed)
+{
+	k_spinlock_key_t key;
+	int32_t value;
+
+	if (motor >= MOTOR_COUNT) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&lock);
+	value = motors[motor].speed;
+#if defined(CONFIG_APP_MOTOR_PID)
+	if (motors[motor].qdec) {
+		value = motors[motor].measured;
+	}
+#endif
+	k_spin_unlock(&lock, key);
+
+	/* Rounded to the nearest percent. */
+	value = CLAMP(value, -SPEED_MAX, SPEED_MAX);
+	*speed = (value + SPEED(1) / 2) >> SPEED_SHIFT;
+
+	return 0;
+}
+
+int motor_controller_ramp_set(const struct motor_controller_ramp *new_ramp)
+{
+#if defined(CONFIG_APP_MOTOR_RAMP)
+	k_spinlock_key_t key;
+
+	if ((new_ramp->accel == 0) ||
+	    ((new_ramp->profile != MOTOR_CONTROLLER_PROFILE_LINEAR) &&
+	     (new_ramp->profile != MOTOR_CONTROLLER_PROFILE_S_CURVE))) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&lock);
+	ramp = *new_ramp;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int motor_controller_pid_set(const struct motor_controller_pid *new_pid)
+{
+#if defined(CONFIG_APP_MOTOR_PID)
+	k_spinlock_key_t key;
+
+	if ((new_pid->kp < 0) || (new_pid->ki < 0) || (new_pid->kd < 0)) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&lock);
+	pid = *new_pid;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int motor_controller_pid_get(struct motor_controller_pid *out)
+{
+#if defined(CONFIG_APP_MOTOR_PID)
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	*out = pid;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int motor_controller_rate_set(uint32_t new_rate)
+{
+#if defined(CONFIG_APP_MOTOR_CONTROL_RATE_HZ)
+	bool running = closed_loop;
+	k_spinlock_key_t key;
+
+	if ((new_rate == 0) || (new_rate > CONFIG_SYS_CLOCK_TICKS_PER_SEC)) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&lock);
+	rate_hz = new_rate;
+
+#if defined(CONFIG_APP_MOTOR_RAMP)
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+		struct motor *motor = &motors[i];
+
+		if (motor->plan.step != motor->plan.steps) {
+			plan_start(motor,
+				   motor->plan.start + motor->plan.delta);
+			running = true;
+		}
+	}
+#endif
+
+	if (running) {
+		control_restart();
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+uint32_t motor_controller_rate_get(void)
+{
+#if defined(CONFIG_APP_MOTOR_CONTROL_RATE_HZ)
+	return rate_hz;
+#else
+	return 0;
+#endif
 }
 
 int motor_controller_init(void)
 {
-    int err = -1;
+	int err;
+
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+		err = motor_init(&motors[i], &configs[i]);
+		if (err) {
+			LOG_ERR("%s: init failed (err %d)", configs[i].label,
+				err);
+			return err;
+		}
+	}
+
+#if defined(CONFIG_APP_MOTOR_CONTROL_RATE_HZ)
+	k_work_init(&control_work, control_tick);
+	k_timer_init(&control_timer, control_expiry, NULL);
+#endif
+
+#if defined(CONFIG_APP_MOTOR_PID)
+	if (closed_loop) {
+		/* Discard the rotation before the first control period. */
+		for (size_t i = 0; i < MOTOR_COUNT; i++) {
+			if (motors[i].qdec) {
+				(void)sensor_sample_fetch(motors[i].qdec);
+			}
+		}
+
+		control_start();
+	}
+#endif
+
+	k_mutex_lock(&output_lock, K_FOREVER);
+
+	for (size_t i = 0; i < MOTOR_COUNT; i++) {
+		output(&motors[i], 0);
+	}
 
-    pwm = device_get_binding(device_name);
-    if(!pwm)
-        return err;
+	err = flush();
 
-    err = motor_controller_set(0);
+	k_mutex_unlock(&output_lock);
 
-    return 0;
+	return err;
 }
@@ -3,7 +3,162 @@
 
 #include <device.h>
 
+/** Shape of the speed changes. */
+enum motor_controller_profile {
+	/** Constant acceleration. */
+	MOTOR_CONTROLLER_PROFILE_LINEAR,
+	/** Acceleration rising from and falling back to zero. */
+	MOTOR_CONTROLLER_PROFILE_S_CURVE,
+};
+
+/** Speed ramp from the current speed to a new setpoint. */
+struct motor_controller_ramp {
+	enum motor_controller_profile profile;
+	/** Peak acceleration, in percent of full speed per second. */
+	uint32_t accel;
+};
+
+/** Gains of the closed-loop speed control, Q16.16 fixed point. Speeds
+ *  and duty cycles are in percent.
+ */
+struct motor_controller_pid {
+	/** Duty cycle per unit of speed error. */
+	int32_t kp;
+	/** Duty cycle per unit of speed error and second. */
+	int32_t ki;
+	/** Duty cycle per unit of speed change per second. */
+	int32_t kd;
+};
+
+/** Speed setpoint of one motor. */
+struct motor_controller_setpoint {
+	/** Index of the motor, in devicetree instance order. */
+	uint8_t motor;
+	/** Range: -100 to 100. */
+	int8_t speed;
+};
+
+/**
+ * @brief Initialize the motors of the croxel,motor devicetree nodes.
+ *
+ * The motors are stopped.
+ *
+ * @retval 0 If successful.
+ * @retval -ENODEV If a PWM Dual group or an encoder is not ready.
+ * @retval -EINVAL If the channels of a motor are out of range or taken,
+ *                 or its period differs from the other motors of its
+ *                 group.
+ * @retval -errno Error of the PWM driver.
+ */
 int motor_controller_init(void);
-int motor_controller_set(int8_t speed); /**< Range: -100 to 100 */
+
+/** Number of motors. */
+size_t motor_controller_count(void);
+
+/**
+ * @brief Set the speed setpoints of several motors at once.
+ *
+ * The motors change speed in the same control period, or, without
+ * control loop, in the same PWM period for those of a PWM Dual group.
+ *
+ * With CONFIG_APP_MOTOR_RAMP, each speed moves to its setpoint along the
+ * ramp, without further calls. A new setpoint restarts the ramp of its
+ * motor from its current speed, a repeated one keeps the ramp going. The
+ * control periods keep their phase.
+ *
+ * @param setpoints Setpoints, the last one applies if a motor is listed
+ *                  more than once.
+ * @param count Number of setpoints.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If a motor or a speed is out of range, no setpoint is
+ *                 applied then.
+ * @retval -errno Error of the PWM driver.
+ */
+int motor_controller_set_group(
+	const struct motor_controller_setpoint *setpoints, size_t count);
+
+/**
+ * @brief Set the speed setpoint of one motor.
+ *
+ * @param motor Index of the motor.
+ * @param speed Range: -100 to 100.
+ *
+ * @return As motor_controller_set_group().
+ */
+int motor_controller_set(uint8_t motor, int8_t speed);
+
+/**
+ * @brief Set the speed of one motor at once, without ramp.
+ *
+ * For setpoints already following a trajectory, such as streamed ones,
+ * which a new ramp on each of them would only delay. A ramp in progress
+ * on the motor ends at the new speed. With the closed loop, the speed is
+ * the new reference of the next control period.
+ *
+ * @param motor Index of the motor.
+ * @param speed Range: -100 to 100.
+ *
+ * @return As motor_controller_set_group().
+ */
+int motor_controller_set_direct(uint8_t motor, int8_t speed);
+
+/** Set the setpoints of all the motors to 0 at once. */
+int motor_controller_stop(void);
+
+/**
+ * @brief Current speed of a motor.
+ *
+ * Between the previous setpoint and the last one while ramping. Measured
+ * with CONFIG_APP_MOTOR_PID for a motor with an encoder.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the motor is out of range.
+ */
+int motor_controller_speed_get(uint8_t motor, int8_t *speed);
+
+/**
+ * @brief Change the ramp of the next setpoints.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the acceleration is 0 or the profile unknown.
+ * @retval -ENOTSUP Without CONFIG_APP_MOTOR_RAMP.
+ */
+int motor_controller_ramp_set(const struct motor_controller_ramp *ramp);
+
+/**
+ * @brief Change the gains of the closed-loop speed control.
+ *
+ * Shared by the motors with an encoder. The integral terms are kept.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If a gain is negative.
+ * @retval -ENOTSUP Without CONFIG_APP_MOTOR_PID.
+ */
+int motor_controller_pid_set(const struct motor_controller_pid *pid);
+
+/**
+ * @brief Current gains of the closed-loop speed control.
+ *
+ * @retval 0 If successful.
+ * @retval -ENOTSUP Without CONFIG_APP_MOTOR_PID.
+ */
+int motor_controller_pid_get(struct motor_controller_pid *pid);
+
+/**
+ * @brief Change the rate of the ramp and PID updates.
+ *
+ * A ramp in progress is planned again at the new rate.
+ *
+ * @param rate_hz Updates per second.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the rate is 0 or above CONFIG_SYS_CLOCK_TICKS_PER_SEC.
+ * @retval -ENOTSUP Without control loop.
+ */
+int motor_controller_rate_set(uint32_t rate_hz);
+
+/** Rate of the ramp and PID updates, 0 without control loop. */
+uint32_t motor_controller_rate_get(void);
 
 #endif /* _MOTOR_CONTROLLER_H_ */
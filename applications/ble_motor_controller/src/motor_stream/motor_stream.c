@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <zephyr.h>
+#include <sys/byteorder.h>
+#include <motor_controller.h>
+#include <motor_stream.h>
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(motor_stream, CONFIG_LOG_DEFAULT_LEVEL);
+
+#define DEPTH		CONFIG_APP_MOTOR_STREAM_DEPTH
+#define PERIOD		K_USEC(USEC_PER_SEC / CONFIG_APP_MOTOR_STREAM_RATE_HZ)
+
+struct setpoint {
+	/* Local uptime in ms. */
+	int64_t due;
+	int8_t speed;
+};
+
+static struct k_spinlock lock;
+
+static struct setpoint ring[DEPTH];
+static uint8_t head;
+static uint8_t count;
+
+/* Mapping of the sender clock to the local uptime, lost when the buffer
+ * runs dry.
+ */
+static bool synced;
+static int64_t offset;
+static int64_t last_time;
+
+static bool playing;
+static struct motor_stream_stats stats;
+
+/* Incremented by motor_stream_stop(), so that a setpoint dequeued before
+ * it is not applied after it.
+ */
+static uint32_t stop_gen;
+
+/* Held while a dequeued setpoint is applied. */
+static K_MUTEX_DEFINE(apply_lock);
+
+static struct k_timer playout_timer;
+static struct k_work playout_work;
+
+/* Called with the lock held. */
+static void push(int64_t due, int8_t speed)
+{
+	if (count == DEPTH) {
+		head = (head + 1) % DEPTH;
+		count--;
+		stats.overruns++;
+	}
+
+	ring[(head + count) % DEPTH] = (struct setpoint) {
+		.due = due,
+		.speed = speed,
+	};
+	count++;
+}
+
+static void playout(struct k_work *work)
+{
+	int64_t now = k_uptime_get();
+	k_spinlock_key_t key;
+	bool apply = false;
+	int8_t speed = 0;
+	uint32_t gen;
+	int err;
+
+	key = k_spin_lock(&lock);
+	gen = stop_gen;
+
+	/* Setpoints due since the previous period are merged. */
+	while (count && (ring[head].due <= now)) {
+		speed = ring[head].speed;
+		head = (head + 1) % DEPTH;
+		count--;
+		stats.played++;
+		apply = true;
+	}
+
+	if (!count && playing) {
+		/* Hold the last speed until the next packet, played after a
+		 * new delay.
+		 */
+		k_timer_stop(&playout_timer);
+		playing = false;
+		synced = false;
+		stats.underruns++;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	if (!apply) {
+		return;
+	}
+
+	k_mutex_lock(&apply_lock, K_FOREVER);
+
+	/* Stopped since the setpoint was dequeued. */
+	key = k_spin_lock(&lock);
+	apply = (gen == stop_gen);
+	k_spin_unlock(&lock, key);
+
+	/* The setpoints are the trajectory, they skip the ramp. */
+	if (apply) {
+		err = motor_controller_set_direct(0, speed);
+		if (err) {
+			LOG_ERR("Setpoint %d not applied (err %d)", speed, err);
+		}
+	}
+
+	k_mutex_unlock(&apply_lock);
+}
+
+static void playout_expiry(struct k_timer *timer)
+{
+	k_work_submit(&playout_work);
+}
+
+int motor_stream_recv(const uint8_t *data, uint16_t len)
+{
+	int64_t now = k_uptime_get();
+	const uint8_t *setpoint;
+	k_spinlock_key_t key;
+	uint16_t time;
+	uint8_t n;
+
+	if ((len < MOTOR_STREAM_HDR_LEN) || (data[0] != MOTOR_STREAM_ID)) {
+		return -EINVAL;
+	}
+
+	n = data[1];
+	if (len != MOTOR_STREAM_HDR_LEN + (n * MOTOR_STREAM_SETPOINT_LEN)) {
+		return -EINVAL;
+	}
+
+	for (uint8_t i = 0; i < n; i++) {
+		int8_t speed = data[MOTOR_STREAM_HDR_LEN +
+				    (i * MOTOR_STREAM_SETPOINT_LEN) + 2];
+
+		if ((speed < -100) || (speed > 100)) {
+			return -EINVAL;
+		}
+	}
+
+	key = k_spin_lock(&lock);
+
+	for (uint8_t i = 0; i < n; i++) {
+		setpoint = &data[MOTOR_STREAM_HDR_LEN +
+				 (i * MOTOR_STREAM_SETPOINT_LEN)];
+		time = sys_get_le16(setpoint);
+
+		if (!synced) {
+			last_time = time;
+			offset = now + CONFIG_APP_MOTOR_STREAM_DELAY_MS - time;
+			synced = true;
+		} else {
+			/* Unwrapped, as the setpoints are less than 32 s
+			 * apart.
+			 */
+			last_time += (int16_t)(time - (uint16_t)last_time);
+		}
+
+		push(last_time + offset, (int8_t)setpoint[2]);
+	}
+
+	if (count && !playing) {
+		k_timer_start(&playout_timer, PERIOD, PERIOD);
+		playing = true;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+void motor_stream_stop(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	k_timer_stop(&playout_timer);
+	playing = false;
+	synced = false;
+	head = 0;
+	count = 0;
+	stop_gen++;
+
+	k_spin_unlock(&lock, key);
+
+	/* Wait for a setpoint being applied, so that the speed set by the
+	 * caller next is not overwritten.
+	 */
+	k_mutex_lock(&apply_lock, K_FOREVER);
+	k_mutex_unlock(&apply_lock);
+}
+
+void motor_stream_stats_get(struct motor_stream_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	*out = stats;
+	out->buffered = count;
+
+	k_spin_unlock(&lock, key);
+}
+
+int motor_stream_init(void)
+{
+	k_work_init(&playout_work, playout);
+	k_timer_init(&playout_timer, playout_expiry, NULL);
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _MOTOR_STREAM_H_
+#define _MOTOR_STREAM_H_
+
+/**
+ * @file
+ * @brief Timestamped setpoint streaming.
+ *
+ * A stream packet carries a batch of setpoints, each with the time at
+ * which the sender wants it applied:
+ *
+ *   uint8_t  id;           MOTOR_STREAM_ID
+ *   uint8_t  count;
+ *   struct {
+ *       uint16_t time;     sender clock in ms, wrapping, little endian
+ *       int8_t   speed;    -100 to 100
+ *   } setpoints[count];
+ *
+ * The first setpoint received, or the first one after the buffer ran
+ * dry, is played CONFIG_APP_MOTOR_STREAM_DELAY_MS after its reception;
+ * the following ones keep their time differences with it.
+ *
+ * The setpoints drive the first motor.
+ */
+
+#include <zephyr/types.h>
+
+/** First byte of a stream packet, an invalid speed for single setpoint
+ *  writes.
+ */
+#define MOTOR_STREAM_ID		0x80
+
+#define MOTOR_STREAM_HDR_LEN		2
+#define MOTOR_STREAM_SETPOINT_LEN	3
+
+/** Jitter buffer statistics since init. */
+struct motor_stream_stats {
+	/** Times the buffer ran dry, the end of a stream included. */
+	uint32_t underruns;
+	/** Setpoints dropped for lack of room. */
+	uint32_t overruns;
+	/** Setpoints applied. */
+	uint32_t played;
+	/** Setpoints currently buffered. */
+	uint8_t buffered;
+};
+
+int motor_stream_init(void);
+
+/**
+ * @brief Buffer the setpoints of a stream packet.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the packet is malformed or a speed out of range,
+ *                 nothing is buffered then.
+ */
+int motor_stream_recv(const uint8_t *data, uint16_t len);
+
+/** Drop the buffered setpoints, the speed applied last is kept. Returns
+ *  once no setpoint of the stream can be applied anymore, not to be called
+ *  from an ISR.
+ */
+void motor_stream_stop(void);
+
+void motor_stream_stats_get(struct motor_stream_stats *stats);
+
+#endif /* _MOTOR_STREAM_H_ */
@@ -1,19 +1,328 @@
-#include <drivers/pwm_dual.h>
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#define DT_DRV_COMPAT croxel_pwm_dual
+
+#include <errno.h>
+#include <string.h>
+#include <kernel.h>
 #include <drivers/pwm.h>
+#include <drivers/pwm_dual.h>
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(pwm_dual, CONFIG_PWM_LOG_LEVEL);
+
+#define CHANNELS_MAX	CONFIG_PWM_DUAL_CHANNELS_MAX
+
+struct pwm_dual_config {
+	const char *pwm_label;
+	const uint32_t *pins;
+	uint8_t channel_count;
+};
+
+struct pwm_dual_data {
+	const struct device *pwm;
+	struct k_mutex lock;
+
+	/* Read once at init, constant for the controllers supported. */
+	uint64_t cycles_per_sec;
+
+#if defined(CONFIG_PWM_DUAL_SYNC)
+	/* NULL if the controller is not registered as a backend. */
+	const struct pwm_dual_backend *backend;
+#endif
+
+	/* Last applied, in cycles. */
+	uint32_t period;
+	uint32_t *pulses;
+};
+
+#if defined(CONFIG_PWM_DUAL_SYNC)
+static sys_slist_t backends = SYS_SLIST_STATIC_INIT(&backends);
+
+int pwm_dual_backend_register(struct pwm_dual_backend *backend)
+{
+	if (!backend || !backend->dev || !backend->pin_set_multi) {
+		return -EINVAL;
+	}
+
+	sys_slist_append(&backends, &backend->node);
+
+	return 0;
+}
+
+static const struct pwm_dual_backend *backend_get(const struct device *pwm)
+{
+	struct pwm_dual_backend *backend;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&backends, backend, node) {
+		if (backend->dev == pwm) {
+			return backend;
+		}
+	}
+
+	return NULL;
+}
+#endif /* CONFIG_PWM_DUAL_SYNC */
+
+/* Set the channels one after the other by increasing pulse, so that a leg
+ * is released before another one is driven when the direction changes.
+ */
+static int set_sequential(const struct device *dev, uint32_t period,
+			  const uint32_t *pulses)
+{
+	const struct pwm_dual_config *config = dev->config;
+	struct pwm_dual_data *data = dev->data;
+	uint8_t order[CHANNELS_MAX];
+	uint8_t tmp;
+	int err;
+
+	for (uint8_t i = 0; i < config->channel_count; i++) {
+		order[i] = i;
+		for (uint8_t j = i; (j > 0) &&
+		     (pulses[order[j]] < pulses[order[j - 1]]); j--) {
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	}
+
+	for (uint8_t i = 0; i < config->channel_count; i++) {
+		err = pwm_pin_set_cycles(data->pwm, config->pins[order[i]],
+					 period, pulses[order[i]], 0);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+/* Called with the lock held. */
+static int apply(const struct device *dev, uint32_t period,
+		 const uint32_t *pulses)
+{
+	const struct pwm_dual_config *config = dev->config;
+	struct pwm_dual_data *data = dev->data;
+	int err = -ENOTSUP;
+
+	for (uint8_t i = 0; i < config->channel_count; i++) {
+		if (pulses[i] > period) {
+			return -EINVAL;
+		}
+	}
+
+#if defined(CONFIG_PWM_DUAL_SYNC)
+	if (data->backend) {
+		err = data->backend->pin_set_multi(data->pwm, period,
+						   config->pins, pulses,
+						   config->channel_count);
+	}
+#endif
+
+	if (err == -ENOTSUP) {
+		err = set_sequential(dev, period, pulses);
+	}
+
+	if (!err) {
+		data->period = period;
+		if (pulses != data->pulses) {
+			memcpy(data->pulses, pulses,
+			       config->channel_count * sizeof(*pulses));
+		}
+	}
+
+	return err;
+}
+
+static int pwm_dual_set_cycles_impl(const struct device *dev,
+				    uint32_t period, const uint32_t *pulses)
+{
+	struct pwm_dual_data *data = dev->data;
+	int err;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	err = apply(dev, period, pulses);
+	k_mutex_unlock(&data->lock);
+
+	return err;
+}
 
-int pwm_dual_set_usec(
-        const struct device *dev, 
-        struct pwm_dual_duty_cycle * setting)
+static int pwm_dual_set_channel_cycles_impl(const struct device *dev,
+					    uint32_t channel, uint32_t period,
+					    uint32_t pulse)
 {
-    int err = -1;
+	const struct pwm_dual_config *config = dev->config;
+	struct pwm_dual_data *data = dev->data;
+	uint32_t pulses[CHANNELS_MAX];
+	int err;
 
-    err = pwm_pin_set_usec(dev, setting->ch0.pin, setting->period,
-    		       setting->ch0.pulse, 0);
-    if(err)
-        return err;
+	if (channel >= config->channel_count) {
+		return -EINVAL;
+	}
 
-    err = pwm_pin_set_usec(dev, setting->ch1.pin, setting->period,
-    		       setting->ch1.pulse, 0);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	memcpy(pulses, data->pulses, config->channel_count * sizeof(*pulses));
+	pulses[channel] = pulse;
+	err = apply(dev, period, pulses);
+	k_mutex_unlock(&data->lock);
 
-    return err;
+	return err;
 }
+
+static int pwm_dual_get_cycles_per_sec_impl(const struct device *dev,
+					    uint64_t *cycles)
+{
+	struct pwm_dual_data *data = dev->data;
+
+	*cycles = data->cycles_per_sec;
+
+	return 0;
+}
+
+static uint8_t pwm_dual_channel_count_impl(const struct device *dev)
+{
+	const struct pwm_dual_config *config = dev->config;
+
+	return config->channel_count;
+}
+
+static const struct pwm_dual_driver_api pwm_dual_api = {
+	.set_cycles = pwm_dual_set_cycles_impl,
+	.set_channel_cycles = pwm_dual_set_channel_cycles_impl,
+	.get_cycles_per_sec = pwm_dual_get_cycles_per_sec_impl,
+	.channel_count = pwm_dual_channel_count_impl,
+};
+
+static int usec_to_cycles(uint32_t usec, uint64_t cycles_per_sec,
+			  uint32_t *cycles)
+{
+	uint64_t value = (usec * cycles_per_sec) / USEC_PER_SEC;
+
+	if (value > UINT32_MAX) {
+		return -ENOTSUP;
+	}
+
+	*cycles = value;
+
+	return 0;
+}
+
+int pwm_dual_set_usec(const struct device *dev, uint32_t period,
+		      const uint32_t *pulses)
+{
+	uint32_t pulse_cycles[CHANNELS_MAX];
+	uint32_t period_cycles;
+	uint64_t cycles_per_sec;
+	int err;
+
+	err = pwm_dual_get_cycles_per_sec(dev, &cycles_per_sec);
+	if (!err) {
+		err = usec_to_cycles(period, cycles_per_sec, &period_cycles);
+	}
+
+	for (uint8_t i = 0; !err && (i < pwm_dual_channel_count(dev)); i++) {
+		err = usec_to_cycles(pulses[i], cycles_per_sec,
+				     &pulse_cycles[i]);
+	}
+
+	if (err) {
+		return err;
+	}
+
+	return pwm_dual_set_cycles(dev, period_cycles, pulse_cycles);
+}
+
+int pwm_dual_set_channel_usec(const struct device *dev, uint32_t channel,
+			      uint32_t period, uint32_t pulse)
+{
+	uint32_t period_cycles;
+	uint32_t pulse_cycles;
+	uint64_t cycles_per_sec;
+	int err;
+
+	err = pwm_dual_get_cycles_per_sec(dev, &cycles_per_sec);
+	if (!err) {
+		err = usec_to_cycles(period, cycles_per_sec, &period_cycles);
+	}
+	if (!err) {
+		err = usec_to_cycles(pulse, cycles_per_sec, &pulse_cycles);
+	}
+	if (err) {
+		return err;
+	}
+
+	return pwm_dual_set_channel_cycles(dev, channel, period_cycles,
+					   pulse_cycles);
+}
+
+static int pwm_dual_init(const struct device *dev)
+{
+	const struct pwm_dual_config *config = dev->config;
+	struct pwm_dual_data *data = dev->data;
+	int err;
+
+	data->pwm = device_get_binding(config->pwm_label);
+	if (!data->pwm) {
+		LOG_ERR("PWM controller %s not found", config->pwm_label);
+		return -ENODEV;
+	}
+
+	err = pwm_get_cycles_per_sec(data->pwm, config->pins[0],
+				     &data->cycles_per_sec);
+	if (err) {
+		LOG_ERR("PWM controller %s clock unknown (err %d)",
+			config->pwm_label, err);
+		return err;
+	}
+
+#if defined(CONFIG_PWM_DUAL_SYNC)
+	data->backend = backend_get(data->pwm);
+	if (!data->backend) {
+		LOG_INF("PWM controller %s not synchronised, channels of %s "
+			"set one after the other", config->pwm_label,
+			dev->name);
+	}
+#endif
+
+	k_mutex_init(&data->lock);
+
+	return 0;
+}
+
+#define PWM_DUAL_PIN(idx, inst) DT_INST_PWMS_CHANNEL_BY_IDX(inst, idx),
+
+/* The group is driven through the controller of its first channel. */
+#define PWM_DUAL_SAME_CTLR(idx, inst)					\
+	BUILD_ASSERT(DT_DEP_ORD(DT_INST_PHANDLE_BY_IDX(inst, pwms, idx)) == \
+		     DT_DEP_ORD(DT_INST_PHANDLE_BY_IDX(inst, pwms, 0)),	\
+		     "All pwms of a group must share one controller");
+
+#define PWM_DUAL_DEVICE(inst)						\
+	BUILD_ASSERT(DT_INST_PROP_LEN(inst, pwms) <= CHANNELS_MAX,	\
+		     "Too many channels, see PWM_DUAL_CHANNELS_MAX");	\
+	UTIL_LISTIFY(DT_INST_PROP_LEN(inst, pwms),			\
+		     PWM_DUAL_SAME_CTLR, inst)				\
+	static const uint32_t pwm_dual_pins_##inst[] = {		\
+		UTIL_LISTIFY(DT_INST_PROP_LEN(inst, pwms),		\
+			     PWM_DUAL_PIN, inst)			\
+	};								\
+	static uint32_t							\
+		pwm_dual_pulses_##inst[DT_INST_PROP_LEN(inst, pwms)];	\
+	static struct pwm_dual_data pwm_dual_data_##inst = {		\
+		.pulses = pwm_dual_pulses_##inst,			\
+	};								\
+	static const struct pwm_dual_config pwm_dual_config_##inst = {	\
+		.pwm_label = DT_INST_PWMS_LABEL_BY_IDX(inst, 0),	\
+		.pins = pwm_dual_pins_##inst,				\
+		.channel_count = DT_INST_PROP_LEN(inst, pwms),		\
+	};								\
+	DEVICE_AND_API_INIT(pwm_dual_##inst, DT_INST_LABEL(inst),	\
+			    pwm_dual_init, &pwm_dual_data_##inst,	\
+			    &pwm_dual_config_##inst, POST_KERNEL,	\
+			    CONFIG_PWM_DUAL_INIT_PRIORITY, &pwm_dual_api);
+
+DT_INST_FOREACH_STATUS_OKAY(PWM_DUAL_DEVICE)
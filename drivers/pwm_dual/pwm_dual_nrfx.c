@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief nRF PWM driver with synchronised dual-channel updates
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/util.h>
+#include <drivers/pwm.h>
+#include <drivers/pwm_dual.h>
+#include <nrfx_pwm.h>
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(pwm_dual_nrfx, CONFIG_PWM_LOG_LEVEL);
+
+/* Bit 15 of a sequence value is the polarity, set for a pulse starting
+ * high.
+ */
+#define CH_POLARITY	BIT(15)
+#define CH_PULSE_MASK	BIT_MASK(15)
+
+#define COUNTERTOP_MAX	BIT_MASK(15)
+#define PRESCALER_MAX	NRF_PWM_CLK_125kHz
+
+#define CYCLES_PER_SEC	16000000
+
+struct pwm_dual_nrfx_config {
+	nrfx_pwm_t pwm;
+	nrfx_pwm_config_t initial_config;
+	nrf_pwm_sequence_t seq;
+};
+
+struct pwm_dual_nrfx_data {
+	/* Read by the PWM at the start of every period. Channels 0-1 and
+	 * 2-3 share a word, so that a pair is updated with a single store.
+	 */
+	uint16_t seq_values[NRF_PWM_CHANNEL_COUNT] __aligned(4);
+
+	uint32_t period_cycles;
+	uint16_t countertop;
+	uint8_t prescaler;
+
+	struct pwm_dual_backend backend;
+};
+
+static int channel_get(const struct pwm_dual_nrfx_config *config,
+		       uint32_t pin)
+{
+	uint8_t output;
+
+	for (int i = 0; i < NRF_PWM_CHANNEL_COUNT; i++) {
+		output = config->initial_config.output_pins[i];
+		if ((output != NRFX_PWM_PIN_NOT_USED) &&
+		    ((output & ~NRFX_PWM_PIN_INVERTED) == pin)) {
+			return i;
+		}
+	}
+
+	return -EINVAL;
+}
+
+/* Apply a new period, with the PWM stopped if running. Channels out of
+ * the channels mask must be inactive, their pulses being in ticks of the
+ * previous prescaler.
+ */
+static int period_set(const struct device *dev, uint32_t period_cycles,
+		      uint8_t channels, bool *restart)
+{
+	const struct pwm_dual_nrfx_config *config = dev->config;
+	struct pwm_dual_nrfx_data *data = dev->data;
+	uint8_t prescaler = 0;
+
+	*restart = nrfx_pwm_is_stopped(&config->pwm);
+
+	if (period_cycles == data->period_cycles) {
+		return 0;
+	}
+
+	while ((period_cycles >> prescaler) > COUNTERTOP_MAX) {
+		if (++prescaler > PRESCALER_MAX) {
+			LOG_ERR("Period of %u cycles too long", period_cycles);
+			return -EINVAL;
+		}
+	}
+
+	for (int i = 0; i < NRF_PWM_CHANNEL_COUNT; i++) {
+		if (!(channels & BIT(i)) &&
+		    (data->seq_values[i] & CH_PULSE_MASK)) {
+			LOG_ERR("Channel %d active, period kept", i);
+			return -EINVAL;
+		}
+	}
+
+	if (!*restart) {
+		(void)nrfx_pwm_stop(&config->pwm, true);
+		*restart = true;
+	}
+
+	data->period_cycles = period_cycles;
+	data->prescaler = prescaler;
+	data->countertop = period_cycles >> prescaler;
+
+	return 0;
+}
+
+static uint16_t seq_value(struct pwm_dual_nrfx_data *data, int channel,
+			  uint32_t pulse_cycles)
+{
+	return (data->seq_values[channel] & CH_POLARITY) |
+	       MIN(pulse_cycles >> data->prescaler, data->countertop);
+}
+
+/* Values written while running are loaded at the next period. */
+static void playback(const struct device *dev, bool restart)
+{
+	const struct pwm_dual_nrfx_config *config = dev->config;
+	struct pwm_dual_nrfx_data *data = dev->data;
+
+	if (!restart) {
+		return;
+	}
+
+	nrf_pwm_configure(config->pwm.p_registers, data->prescaler,
+			  NRF_PWM_MODE_UP, data->countertop);
+	(void)nrfx_pwm_simple_playback(&config->pwm, &config->seq, 1,
+				       NRFX_PWM_FLAG_LOOP);
+}
+
+static int pwm_dual_nrfx_pin_set(const struct device *dev, uint32_t pwm,
+				 uint32_t period_cycles, uint32_t pulse_cycles,
+				 pwm_flags_t flags)
+{
+	const struct pwm_dual_nrfx_config *config = dev->config;
+	struct pwm_dual_nrfx_data *data = dev->data;
+	int channel = channel_get(config, pwm);
+	bool restart;
+	int err;
+
+	if (channel < 0) {
+		return channel;
+	}
+
+	/* Polarity comes from the devicetree. */
+	if (flags) {
+		return -ENOTSUP;
+	}
+
+	if (pulse_cycles > period_cycles) {
+		return -EINVAL;
+	}
+
+	err = period_set(dev, period_cycles, BIT(channel), &restart);
+	if (err) {
+		return err;
+	}
+
+	data->seq_values[channel] = seq_value(data, channel, pulse_cycles);
+	playback(dev, restart);
+
+	return 0;
+}
+
+/* The channels of a pair, sharing a word of the sequence, are updated with
+ * a single store and change on the same period. Pairs may change one
+ * period apart.
+ */
+static int pwm_dual_nrfx_pin_set_multi(const struct device *dev,
+				       uint32_t period_cycles,
+				       const uint32_t *pins,
+				       const uint32_t *pulses, size_t count)
+{
+	const struct pwm_dual_nrfx_config *config = dev->config;
+	struct pwm_dual_nrfx_data *data = dev->data;
+	uint16_t values[NRF_PWM_CHANNEL_COUNT];
+	int channel[NRF_PWM_CHANNEL_COUNT];
+	uint8_t channels = 0;
+	bool restart;
+	int err;
+
+	if (count > NRF_PWM_CHANNEL_COUNT) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		channel[i] = channel_get(config, pins[i]);
+		if ((channel[i] < 0) || (channels & BIT(channel[i])) ||
+		    (pulses[i] > period_cycles)) {
+			return -EINVAL;
+		}
+		channels |= BIT(channel[i]);
+	}
+
+	err = period_set(dev, period_cycles, channels, &restart);
+	if (err) {
+		return err;
+	}
+
+	memcpy(values, data->seq_values, sizeof(values));
+	for (size_t i = 0; i < count; i++) {
+		values[channel[i]] = seq_value(data, channel[i], pulses[i]);
+	}
+
+	for (int i = 0; i < NRF_PWM_CHANNEL_COUNT; i += 2) {
+		if (channels & (BIT(i) | BIT(i + 1))) {
+			*(volatile uint32_t *)&data->seq_values[i] =
+				values[i] | ((uint32_t)values[i + 1] << 16);
+		}
+	}
+
+	playback(dev, restart);
+
+	return 0;
+}
+
+static int pwm_dual_nrfx_get_cycles_per_sec(const struct device *dev,
+					    uint32_t pwm, uint64_t *cycles)
+{
+	/* Prescaled periods are still given in cycles of the 16 MHz clock. */
+	*cycles = CYCLES_PER_SEC;
+
+	return 0;
+}
+
+static const struct pwm_driver_api pwm_dual_nrfx_api = {
+	.pin_set = pwm_dual_nrfx_pin_set,
+	.get_cycles_per_sec = pwm_dual_nrfx_get_cycles_per_sec,
+};
+
+static int pwm_dual_nrfx_init(const struct device *dev)
+{
+	const struct pwm_dual_nrfx_config *config = dev->config;
+	struct pwm_dual_nrfx_data *data = dev->data;
+	nrfx_err_t result;
+
+	for (int i = 0; i < NRF_PWM_CHANNEL_COUNT; i++) {
+		data->seq_values[i] = (config->initial_config.output_pins[i] &
+				       NRFX_PWM_PIN_INVERTED) ? 0 : CH_POLARITY;
+	}
+
+	data->countertop = COUNTERTOP_MAX;
+
+	result = nrfx_pwm_init(&config->pwm, &config->initial_config, NULL,
+			       NULL);
+	if (result != NRFX_SUCCESS) {
+		LOG_ERR("Failed to initialize device: %s", dev->name);
+		return -EBUSY;
+	}
+
+	data->backend.dev = dev;
+	data->backend.pin_set_multi = pwm_dual_nrfx_pin_set_multi;
+
+	return pwm_dual_backend_register(&data->backend);
+}
+
+#define PWM(dev_idx) DT_NODELABEL(pwm##dev_idx)
+
+#define PWM_DUAL_NRFX_OUTPUT_PIN(dev_idx, ch_idx)			\
+	COND_CODE_1(DT_NODE_HAS_PROP(PWM(dev_idx), ch##ch_idx##_pin),	\
+		(DT_PROP(PWM(dev_idx), ch##ch_idx##_pin) |		\
+		 (DT_PROP(PWM(dev_idx), ch##ch_idx##_inverted) ?	\
+		  NRFX_PWM_PIN_INVERTED : 0)),				\
+		(NRFX_PWM_PIN_NOT_USED))
+
+#define PWM_DUAL_NRFX_DEVICE(idx)					      \
+	static struct pwm_dual_nrfx_data pwm_dual_nrfx_##idx##_data;	      \
+	static const struct pwm_dual_nrfx_config			      \
+		pwm_dual_nrfx_##idx##_config = {			      \
+		.pwm = NRFX_PWM_INSTANCE(idx),				      \
+		.initial_config = {					      \
+			.output_pins = {				      \
+				PWM_DUAL_NRFX_OUTPUT_PIN(idx, 0),	      \
+				PWM_DUAL_NRFX_OUTPUT_PIN(idx, 1),	      \
+				PWM_DUAL_NRFX_OUTPUT_PIN(idx, 2),	      \
+				PWM_DUAL_NRFX_OUTPUT_PIN(idx, 3),	      \
+			},						      \
+			.base_clock = NRF_PWM_CLK_16MHz,		      \
+			.count_mode = NRF_PWM_MODE_UP,			      \
+			.top_value = COUNTERTOP_MAX,			      \
+			.load_mode = NRF_PWM_LOAD_INDIVIDUAL,		      \
+			.step_mode = NRF_PWM_STEP_AUTO,			      \
+		},							      \
+		.seq.values.p_raw = pwm_dual_nrfx_##idx##_data.seq_values,    \
+		.seq.length = NRF_PWM_CHANNEL_COUNT,			      \
+	};								      \
+	DEVICE_AND_API_INIT(pwm_dual_nrfx_##idx, DT_LABEL(PWM(idx)),	      \
+			    pwm_dual_nrfx_init, &pwm_dual_nrfx_##idx##_data,  \
+			    &pwm_dual_nrfx_##idx##_config, POST_KERNEL,	      \
+			    CONFIG_KERNEL_INIT_PRIORITY_DEVICE,		      \
+			    &pwm_dual_nrfx_api)
+
+#if DT_NODE_HAS_STATUS(DT_NODELABEL(pwm0), okay)
+PWM_DUAL_NRFX_DEVICE(0);
+#endif
+
+#if DT_NODE_HAS_STATUS(DT_NODELABEL(pwm1), okay)
+PWM_DUAL_NRFX_DEVICE(1);
+#endif
+
+#if DT_NODE_HAS_STATUS(DT_NODELABEL(pwm2), okay)
+PWM_DUAL_NRFX_DEVICE(2);
+#endif
+
+#if DT_NODE_HAS_STATUS(DT_NODELABEL(pwm3), okay)
+PWM_DUAL_NRFX_DEVICE(3);
+#endif
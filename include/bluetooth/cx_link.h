@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BT_CX_LINK_H_
+#define BT_CX_LINK_H_
+
+/**@file
+ * @defgroup bt_cx_link Link tuning API
+ * @{
+ * @brief Negotiation of PHY, data length, ATT MTU and connection
+ *        parameters for CX Endpoint links.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+/** @brief Connection parameter profiles. */
+enum bt_cx_link_profile {
+	/** Keep the parameters chosen by the central. */
+	BT_CX_LINK_PROFILE_NONE,
+	/** Shortest interval, for control traffic. */
+	BT_CX_LINK_PROFILE_LOW_LATENCY,
+	/** Long interval with long connection events, for bulk transfers. */
+	BT_CX_LINK_PROFILE_THROUGHPUT,
+	/** Long interval with peripheral latency. */
+	BT_CX_LINK_PROFILE_LOW_POWER,
+};
+
+/** @brief Link properties after tuning. */
+struct bt_cx_link_info {
+	/** TX PHY, BT_GAP_LE_PHY_*. 0 if unknown. */
+	uint8_t tx_phy;
+	/** RX PHY, BT_GAP_LE_PHY_*. 0 if unknown. */
+	uint8_t rx_phy;
+	/** Maximum LL payload sent, in octets. 0 if unknown. */
+	uint16_t tx_max_len;
+	/** Maximum LL payload received, in octets. 0 if unknown. */
+	uint16_t rx_max_len;
+	/** ATT MTU. */
+	uint16_t mtu;
+	/** Connection interval, in units of 1.25 ms. */
+	uint16_t interval;
+	/** Peripheral latency, in connection events. */
+	uint16_t latency;
+	/** Supervision timeout, in units of 10 ms. */
+	uint16_t timeout;
+	/** Profile the connection parameters were requested for. */
+	enum bt_cx_link_profile profile;
+};
+
+/** @brief Link tuning callback structure. */
+struct bt_cx_link_cb {
+	/** Link tuned callback.
+	 *
+	 * Called once all tuning steps of a connection have completed,
+	 * and again after every profile change.
+	 *
+	 * @param[in] conn Tuned connection.
+	 * @param[in] info Resulting link properties.
+	 * @param[in] err 0 if every request was accepted, otherwise the error
+	 *                of the last request that failed. The link is usable
+	 *                either way.
+	 */
+	void (*tuned)(struct bt_conn *conn, const struct bt_cx_link_info *info,
+		      int err);
+};
+
+/** @brief Start tuning new connections.
+ *
+ * @param[in] cb Callbacks, may be NULL.
+ *
+ * @retval 0 If the operation was successful.
+ *         Otherwise, a negative error code is returned.
+ */
+int bt_cx_link_init(const struct bt_cx_link_cb *cb);
+
+/** @brief Request the connection parameters of a profile.
+ *
+ * Applies to the given connection only. New connections keep using the
+ * profile selected in Kconfig.
+ *
+ * @param[in] conn Connection to update.
+ * @param[in] profile Profile to apply.
+ *
+ * @retval 0 If the request was queued.
+ * @retval -EINVAL If the connection is not tracked or the profile is
+ *                 unknown.
+ */
+int bt_cx_link_profile_set(struct bt_conn *conn,
+			   enum bt_cx_link_profile profile);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BT_CX_LINK_H_ */
@@ -18,6 +18,9 @@ extern "C" {
 #endif
 
 #include <zephyr/types.h>
+#include <bluetooth/conn.h>
+#include <net/buf.h>
+#include <bluetooth/services/cx_endpoint_chan.h>
 
 /** @brief CX_ENDPOINT Service UUID. */
 #define BT_UUID_CX_ENDPOINT_VAL \
@@ -31,20 +34,282 @@ extern "C" {
 #define BT_UUID_CX_ENDPOINT_RECV_VAL \
 	BT_UUID_128_ENCODE(0x0a000003, 0xcafe, 0xcafe, 0xcafe, 0xdeadbeefcafe)
 
+/** @brief Stats Characteristic UUID. */
+#define BT_UUID_CX_ENDPOINT_STATS_VAL \
+	BT_UUID_128_ENCODE(0x0a000004, 0xcafe, 0xcafe, 0xcafe, 0xdeadbeefcafe)
+
+/** @brief L2CAP PSM Characteristic UUID.
+ *
+ * Read-only, uint16_t little endian PSM of the L2CAP channel carrying
+ * messages when CONFIG_BT_CX_ENDPOINT_L2CAP is enabled.
+ */
+#define BT_UUID_CX_ENDPOINT_PSM_VAL \
+	BT_UUID_128_ENCODE(0x0a000005, 0xcafe, 0xcafe, 0xcafe, 0xdeadbeefcafe)
+
+/** @brief Compression Characteristic UUID.
+ *
+ * uint8_t bit mask of codecs, see @ref bt_cx_endpoint_comp. Read, the
+ * codecs the service decodes. Written by the client, the codecs it
+ * decodes. Present when CONFIG_BT_CX_ENDPOINT_COMPRESSION is enabled.
+ */
+#define BT_UUID_CX_ENDPOINT_COMP_VAL \
+	BT_UUID_128_ENCODE(0x0a000006, 0xcafe, 0xcafe, 0xcafe, 0xdeadbeefcafe)
+
+/** @brief Framing Characteristic UUID.
+ *
+ * Write-only. Written by the client with @ref BT_CX_ENDPOINT_FRAMING_ON to
+ * segment the messages of its link in both directions, see
+ * @ref bt_cx_endpoint_frame. Present when CONFIG_BT_CX_ENDPOINT_FRAMING is
+ * enabled, links whose client does not write it exchange unframed
+ * messages.
+ */
+#define BT_UUID_CX_ENDPOINT_FRAME_VAL \
+	BT_UUID_128_ENCODE(0x0a000007, 0xcafe, 0xcafe, 0xcafe, 0xdeadbeefcafe)
+
+/** @brief RX Credits Characteristic UUID.
+ *
+ * Read-only, see @ref bt_cx_endpoint_credits. Present when
+ * CONFIG_BT_CX_ENDPOINT_RX_DEFERRED is enabled. Writes of a link beyond
+ * its credits are dropped, so a client keeps the writes it has not seen
+ * consumed within them.
+ */
+#define BT_UUID_CX_ENDPOINT_CREDITS_VAL \
+	BT_UUID_128_ENCODE(0x0a000008, 0xcafe, 0xcafe, 0xcafe, 0xdeadbeefcafe)
 
 #define BT_UUID_CX_ENDPOINT           BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_VAL)
 #define BT_UUID_CX_ENDPOINT_SEND    BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_SEND_VAL)
 #define BT_UUID_CX_ENDPOINT_RECV       BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_RECV_VAL)
+#define BT_UUID_CX_ENDPOINT_STATS      BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_STATS_VAL)
+#define BT_UUID_CX_ENDPOINT_PSM        BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_PSM_VAL)
+#define BT_UUID_CX_ENDPOINT_COMP       BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_COMP_VAL)
+#define BT_UUID_CX_ENDPOINT_FRAME      BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_FRAME_VAL)
+#define BT_UUID_CX_ENDPOINT_CREDITS    BT_UUID_DECLARE_128(BT_UUID_CX_ENDPOINT_CREDITS_VAL)
+
+/** Value of the Framing Characteristic turning framing on. */
+#define BT_CX_ENDPOINT_FRAMING_ON 0x01
+
+/** Value of the RX Credits Characteristic, little endian. */
+struct bt_cx_endpoint_credits {
+	/** Writes the service buffers for the link. */
+	uint16_t credits;
+
+	/** Writes of the link still buffered when the value was read,
+	 *  including every write received before the read request.
+	 */
+	uint16_t pending;
+} __packed;
+
+/** Number of buckets of a latency histogram. Bucket 0 counts latencies
+ *  below 1 ms, bucket n those below 2^n ms and the last one everything
+ *  longer.
+ */
+#define BT_CX_ENDPOINT_STAT_LAT_BUCKETS 10
+
+/** @brief Counters of the Stats Characteristic.
+ *
+ * The characteristic value is an array of uint32_t little endian
+ * counters, indexed by this enumeration. Counters are shared by all
+ * connections and count since boot or the last reset from the shell.
+ */
+enum bt_cx_endpoint_stat {
+	/** Messages delivered to the application. */
+	BT_CX_ENDPOINT_STAT_RX_MSGS,
+	/** Bytes delivered to the application. */
+	BT_CX_ENDPOINT_STAT_RX_BYTES,
+	/** Writes rejected or dropped. */
+	BT_CX_ENDPOINT_STAT_RX_ERRORS,
+	/** Messages whose notifications completed. */
+	BT_CX_ENDPOINT_STAT_TX_MSGS,
+	/** Bytes of messages whose notifications completed. */
+	BT_CX_ENDPOINT_STAT_TX_BYTES,
+	/** Notifications handed over to the host. */
+	BT_CX_ENDPOINT_STAT_TX_PDUS,
+	/** Messages dropped after being queued. */
+	BT_CX_ENDPOINT_STAT_TX_ERRORS,
+	/** Sends rejected with -ENOMEM. */
+	BT_CX_ENDPOINT_STAT_ERR_NOMEM,
+	/** Sends rejected with -EACCES. */
+	BT_CX_ENDPOINT_STAT_ERR_EACCES,
+	/** Highest TX queue occupancy of any link. */
+	BT_CX_ENDPOINT_STAT_QUEUE_HWM,
+	/** Highest number of notifications in flight on any link. */
+	BT_CX_ENDPOINT_STAT_INFLIGHT_HWM,
+	/** First bucket of the histogram of the time from queuing a message
+	 *  to the completion of its last notification.
+	 */
+	BT_CX_ENDPOINT_STAT_TX_LAT,
+	/** Number of counters. */
+	BT_CX_ENDPOINT_STAT_COUNT =
+		BT_CX_ENDPOINT_STAT_TX_LAT + BT_CX_ENDPOINT_STAT_LAT_BUCKETS,
+};
 
 /** @brief Callback struct used by the CX_ENDPOINT Service. */
 struct bt_cx_endpoint_cb {
-	/** Received data callback. */
-	void (*recv_cb)(const uint8_t *data, uint16_t len);
+	/** Received data callback.
+	 *
+	 * @param[in] conn Connection the data was written on.
+	 * @param[in] data Received data.
+	 * @param[in] len Length of received data.
+	 */
+	void (*recv_cb)(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+	/** Message sent callback.
+	 *
+	 * Called once per message and connection when the notification
+	 * carrying it has been transmitted, or when it was dropped.
+	 *
+	 * @param[in] conn Connection the message was queued on.
+	 * @param[in] buf Buffer holding the message, valid during the call.
+	 * @param[in] err 0 on success, negative error code otherwise.
+	 */
+	void (*sent_cb)(struct bt_conn *conn, struct net_buf *buf, int err);
+};
+
+/** @brief Logical channel of the CX_ENDPOINT Service.
+ *
+ * See @ref bt_cx_endpoint_chan for the scheduling of channels.
+ */
+struct bt_cx_endpoint_chan {
+	/** Channel ID, below CONFIG_BT_CX_ENDPOINT_CHAN_COUNT. */
+	uint8_t id;
+
+	/** Priority, lower values are sent first. */
+	uint8_t prio;
+
+	/** Messages sent per round among the channels of the same priority,
+	 *  at least one.
+	 */
+	uint8_t weight;
+
+	/** Received data callback.
+	 *
+	 * @param[in] conn Connection the data was written on.
+	 * @param[in] data Received data, without the channel ID.
+	 * @param[in] len Length of received data.
+	 */
+	void (*recv_cb)(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+	/** Message sent callback.
+	 *
+	 * Called once per message and connection when the notification
+	 * carrying it has been transmitted, or when it was dropped.
+	 *
+	 * @param[in] conn Connection the message was queued on.
+	 * @param[in] data Message data, without the channel ID, valid during
+	 *                 the call.
+	 * @param[in] len Message length.
+	 * @param[in] err 0 on success, negative error code otherwise.
+	 */
+	void (*sent_cb)(struct bt_conn *conn, const uint8_t *data, uint16_t len,
+			int err);
 };
 
 int bt_cx_endpoint_init(struct bt_cx_endpoint_cb *callbacks);
+
+/** @brief Allocate a buffer from the service TX pool.
+ *
+ * The buffer can be filled in place and handed over with
+ * bt_cx_endpoint_send_buf() without an additional copy. With
+ * CONFIG_BT_CX_ENDPOINT_CHANNELS, headroom is reserved for the channel ID.
+ *
+ * @param[in] timeout Time to wait for a free buffer.
+ *
+ * @return Buffer, or NULL if none became available in time.
+ */
+struct net_buf *bt_cx_endpoint_buf_alloc(k_timeout_t timeout);
+
+/** @brief Queue a buffer for one or all subscribed peers.
+ *
+ * On success the service takes over the caller's reference. On fan-out
+ * every subscribed link holds its own reference, so the data is never
+ * copied per link. Completion is reported through
+ * @ref bt_cx_endpoint_cb.sent_cb. With CONFIG_BT_CX_ENDPOINT_CHANNELS, the
+ * message is sent on @ref BT_CX_ENDPOINT_CHAN_DEFAULT and the buffer seen by
+ * the callback starts with the channel ID.
+ *
+ * @param[in] conn Target connection, or NULL to fan out to every connection
+ *                 that has notifications enabled.
+ * @param[in] buf Buffer to send, typically from bt_cx_endpoint_buf_alloc().
+ *
+ * @retval 0 If the buffer was queued on the target (at least one, on
+ *           fan-out).
+ * @retval -EACCES If notifications are not enabled on the target (or on any
+ *                 connection, on fan-out).
+ * @retval -ENOTCONN If @p conn is not tracked by the service.
+ * @retval -ENOMEM If the TX queue of the target is full. The caller keeps
+ *                 ownership of the buffer on any error.
+ * @retval -EINVAL If the buffer has no headroom for the channel ID, with
+ *                 CONFIG_BT_CX_ENDPOINT_CHANNELS.
+ */
+int bt_cx_endpoint_send_buf(struct bt_conn *conn, struct net_buf *buf);
+
+/** @brief Send data to one or all subscribed peers.
+ *
+ * The data is copied into a buffer from the service TX pool and queued,
+ * see bt_cx_endpoint_send_buf().
+ *
+ * @param[in] conn Target connection, or NULL to fan out to every connection
+ *                 that has notifications enabled.
+ * @param[in] data Data to send.
+ * @param[in] len Length of data.
+ *
+ * @retval 0 If the data was queued on the target (at least one, on fan-out).
+ * @retval -EACCES If notifications are not enabled on the target (or on any
+ *                 connection, on fan-out).
+ * @retval -ENOTCONN If @p conn is not tracked by the service.
+ * @retval -EMSGSIZE If the data does not fit in a TX buffer.
+ * @retval -ENOMEM If no TX buffer is free or the TX queue is full.
+ */
+int bt_cx_endpoint_send(struct bt_conn *conn, const uint8_t *data,
+			uint16_t len);
+
+/** @brief Send data to all subscribed peers.
+ *
+ * Equivalent to bt_cx_endpoint_send() with a NULL connection.
+ */
 int bt_cx_endpoint_send_data(const uint8_t *data, uint16_t len);
 
+/** @brief Register a logical channel.
+ *
+ * Messages received on a channel without registration are dropped, except
+ * on @ref BT_CX_ENDPOINT_CHAN_DEFAULT whose messages go to the callbacks
+ * given to bt_cx_endpoint_init(). Unregistered channels are sent with the
+ * lowest priority. Channels are meant to be registered once, before
+ * traffic starts.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CHANNELS.
+ *
+ * @param[in] chan Channel, kept by the service.
+ *
+ * @retval 0 If the channel was registered.
+ * @retval -EINVAL If the ID is out of range or the weight is zero.
+ * @retval -EALREADY If a channel with the same ID is registered.
+ */
+int bt_cx_endpoint_chan_register(struct bt_cx_endpoint_chan *chan);
+
+/** @brief Queue a buffer on a channel.
+ *
+ * Same as bt_cx_endpoint_send_buf(), with the message sent on @p chan.
+ * The channel ID is pushed in the buffer headroom.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CHANNELS.
+ */
+int bt_cx_endpoint_chan_send_buf(const struct bt_cx_endpoint_chan *chan,
+				 struct bt_conn *conn, struct net_buf *buf);
+
+/** @brief Send data on a channel.
+ *
+ * Same as bt_cx_endpoint_send(), with the message sent on @p chan.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CHANNELS.
+ */
+int bt_cx_endpoint_chan_send(const struct bt_cx_endpoint_chan *chan,
+			     struct bt_conn *conn, const uint8_t *data,
+			     uint16_t len);
+
+/** @brief Get the number of connections with notifications enabled. */
+uint8_t bt_cx_endpoint_subscribed_count(void);
+
 #ifdef __cplusplus
 }
 #endif
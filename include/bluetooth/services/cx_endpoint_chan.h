@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BT_CX_ENDPOINT_CHAN_H_
+#define BT_CX_ENDPOINT_CHAN_H_
+
+/**
+ * @file
+ * @defgroup bt_cx_endpoint_chan CX_ENDPOINT logical channels
+ * @{
+ * @brief Multiplexing of logical channels over one CX_ENDPOINT link.
+ *
+ * Every message starts with a one-byte channel header, followed by the
+ * application data. The header is part of the message, so it is carried
+ * once per message whatever the segmentation or coalescing of the packets.
+ * Its low bits hold the channel ID, its top bit flags a compressed
+ * message, see @ref bt_cx_endpoint_comp.
+ *
+ * Queued messages are served by priority first: a message of a channel
+ * with a lower priority value is always sent before any message of a
+ * channel with a higher one. Channels of the same priority share the link
+ * by weighted round robin, each being served up to its weight in messages
+ * per round. A message already being segmented is always completed first.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHAN_COUNT)
+#define BT_CX_ENDPOINT_CHAN_COUNT	CONFIG_BT_CX_ENDPOINT_CHAN_COUNT
+#else
+#define BT_CX_ENDPOINT_CHAN_COUNT	1
+#endif
+
+/** Length of the channel header of a message. */
+#define BT_CX_ENDPOINT_CHAN_HDR_LEN	1
+
+/** Channel ID bits of the channel header. */
+#define BT_CX_ENDPOINT_CHAN_ID_MASK	0x7F
+
+/** Channel header flag of a compressed message. */
+#define BT_CX_ENDPOINT_CHAN_COMPRESSED	BIT(7)
+
+/** Channel of the messages sent and received without a channel. */
+#define BT_CX_ENDPOINT_CHAN_DEFAULT	0
+
+/** Priority of channels with no registration. */
+#define BT_CX_ENDPOINT_CHAN_PRIO_LOWEST	UINT8_MAX
+
+/** @brief Scheduling parameters of a channel. */
+struct bt_cx_endpoint_chan_param {
+	/** Priority, lower values are served first. */
+	uint8_t prio;
+
+	/** Messages served per round among the channels of the same
+	 *  priority, at least one.
+	 */
+	uint8_t weight;
+};
+
+/** @brief Scheduling state of one direction of a link. */
+struct bt_cx_endpoint_chan_sched {
+	/** Messages each channel may still send in the current round. */
+	uint8_t credit[BT_CX_ENDPOINT_CHAN_COUNT];
+};
+
+/** @brief Select the channel to serve next.
+ *
+ * @param[in] sched Scheduling state.
+ * @param[in] param Parameters of every channel, indexed by channel ID.
+ * @param[in] backlog Bit mask of the channels with messages waiting, not
+ *                    zero.
+ *
+ * @return ID of the channel to serve.
+ */
+uint8_t bt_cx_endpoint_chan_pick(const struct bt_cx_endpoint_chan_sched *sched,
+				 const struct bt_cx_endpoint_chan_param *param,
+				 uint32_t backlog);
+
+/** @brief Account for a message sent on the channel selected last.
+ *
+ * @param[in,out] sched Scheduling state.
+ * @param[in] param Parameters of every channel, indexed by channel ID.
+ * @param[in] id Channel returned by bt_cx_endpoint_chan_pick().
+ */
+void bt_cx_endpoint_chan_served(struct bt_cx_endpoint_chan_sched *sched,
+				const struct bt_cx_endpoint_chan_param *param,
+				uint8_t id);
+
+/** @brief Reset the parameters of all channels to those of an
+ *         unregistered channel.
+ *
+ * @param[out] param Parameters of every channel, indexed by channel ID.
+ */
+void bt_cx_endpoint_chan_param_init(struct bt_cx_endpoint_chan_param *param);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BT_CX_ENDPOINT_CHAN_H_ */
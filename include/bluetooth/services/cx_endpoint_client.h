@@ -21,6 +21,10 @@ extern "C" {
 #include <bluetooth/gatt.h>
 #include <bluetooth/conn.h>
 #include <bluetooth/gatt_dm.h>
+#include <bluetooth/l2cap.h>
+#include <bluetooth/services/cx_endpoint_frame.h>
+#include <bluetooth/services/cx_endpoint_chan.h>
+#include <bluetooth/services/cx_endpoint_rpc.h>
 
 /** @brief Handles on the connected peer device that are needed to interact with
  * the device.
@@ -41,8 +45,38 @@ struct bt_cx_endpoint_client_handles {
 	 *  as provided by a discovery.
          */
 	uint16_t tx_ccc;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+        /** Handle of the CX_ENDPOINT PSM characteristic, 0 if the peer
+	 *  does not offer an L2CAP channel.
+         */
+	uint16_t psm;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+        /** Handle of the CX_ENDPOINT Compression characteristic, 0 if the
+	 *  peer does not decompress messages.
+         */
+	uint16_t comp;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+        /** Handle of the CX_ENDPOINT Framing characteristic, 0 if the
+	 *  peer exchanges unframed messages only.
+         */
+	uint16_t frame;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+        /** Handle of the CX_ENDPOINT RX Credits characteristic, 0 if the
+	 *  peer does not limit the writes of a link.
+         */
+	uint16_t credits;
+#endif
 };
 
+struct bt_cx_endpoint_client;
+
 /** @brief CX_ENDPOINT Client callback structure. */
 struct bt_cx_endpoint_client_cb {
 	/** @brief Data received callback.
@@ -50,29 +84,118 @@ struct bt_cx_endpoint_client_cb {
 	 * The data has been received as a notification of the CX_ENDPOINT TX
 	 * Characteristic.
 	 *
+	 * @param[in] cx_endpoint Client instance.
 	 * @param[in] data Received data.
 	 * @param[in] len Length of received data.
 	 *
 	 * @retval BT_GATT_ITER_CONTINUE To keep notifications enabled.
 	 * @retval BT_GATT_ITER_STOP To disable notifications.
 	 */
-	uint8_t (*received)(const uint8_t *data, uint16_t len);
+	uint8_t (*received)(struct bt_cx_endpoint_client *cx_endpoint,
+			    const uint8_t *data, uint16_t len);
 
 	/** @brief Data sent callback.
 	 *
 	 * The data has been sent and written to the CX_ENDPOINT RX Characteristic.
 	 *
+	 * @param[in] cx_endpoint Client instance.
 	 * @param[in] err ATT error code.
 	 * @param[in] data Transmitted data.
 	 * @param[in] len Length of transmitted data.
 	 */
-	void (*sent)(uint8_t err, const uint8_t *data, uint16_t len);
+	void (*sent)(struct bt_cx_endpoint_client *cx_endpoint, uint8_t err,
+		     const uint8_t *data, uint16_t len);
 
 	/** @brief TX notifications disabled callback.
 	 *
 	 * TX notifications have been disabled.
+	 *
+	 * @param[in] cx_endpoint Client instance.
+	 */
+	void (*unsubscribed)(struct bt_cx_endpoint_client *cx_endpoint);
+
+	/** @brief Cached handles stale callback.
+	 *
+	 * The handles assigned with bt_cx_endpoint_client_cache_assign() do
+	 * not match the database of the peer anymore. The instance has been
+	 * released and the service must be discovered again.
+	 *
+	 * @param[in] cx_endpoint Client instance.
+	 */
+	void (*stale)(struct bt_cx_endpoint_client *cx_endpoint);
+};
+
+/** @brief Logical channel of a CX_ENDPOINT Client.
+ *
+ * See @ref bt_cx_endpoint_chan for the scheduling of channels.
+ */
+struct bt_cx_endpoint_client_chan {
+	/** Channel ID, below CONFIG_BT_CX_ENDPOINT_CHAN_COUNT. */
+	uint8_t id;
+
+	/** Priority, lower values are written first. */
+	uint8_t prio;
+
+	/** Messages written per round among the channels of the same
+	 *  priority, at least one.
+	 */
+	uint8_t weight;
+
+	/** Write the messages of the channel with acknowledged writes,
+	 *  after every message queued before them has completed.
+	 */
+	bool reliable;
+
+	/** @brief Data received callback.
+	 *
+	 * @param[in] cx_endpoint Client instance.
+	 * @param[in] data Received data, without the channel ID.
+	 * @param[in] len Length of received data.
+	 *
+	 * @retval BT_GATT_ITER_CONTINUE To keep notifications enabled.
+	 * @retval BT_GATT_ITER_STOP To disable notifications.
+	 */
+	uint8_t (*received)(struct bt_cx_endpoint_client *cx_endpoint,
+			    const uint8_t *data, uint16_t len);
+
+	/** @brief Data sent callback.
+	 *
+	 * @param[in] cx_endpoint Client instance.
+	 * @param[in] err ATT error code.
+	 * @param[in] data Transmitted data, without the channel ID.
+	 * @param[in] len Length of transmitted data.
 	 */
-	void (*unsubscribed)(void);
+	void (*sent)(struct bt_cx_endpoint_client *cx_endpoint, uint8_t err,
+		     const uint8_t *data, uint16_t len);
+};
+
+/** @brief RPC response callback.
+ *
+ * @param[in] cx_endpoint Client instance.
+ * @param[in] err 0 on success. The negative errno value returned by the
+ *                handler of the service, -ETIMEDOUT if no response came
+ *                in time, -EIO if the request could not be written or
+ *                -ECONNRESET if the instance was released.
+ * @param[in] data Results of the call, valid during the callback.
+ * @param[in] len Length of the results.
+ * @param[in] user_data User data given to bt_cx_endpoint_client_rpc_call().
+ */
+typedef void (*bt_cx_endpoint_client_rpc_cb_t)(struct bt_cx_endpoint_client *cx_endpoint,
+					       int err, const uint8_t *data,
+					       uint16_t len, void *user_data);
+
+/** @brief RPC call of a client waiting for its response. */
+struct bt_cx_endpoint_client_rpc_call {
+	/** Response callback, NULL if the entry is free. */
+	bt_cx_endpoint_client_rpc_cb_t cb;
+	void *user_data;
+
+	/** Uptime at which the call was made, and its timeout. */
+	uint32_t stamp;
+	uint32_t timeout_ms;
+
+	uint16_t id;
+	uint8_t method;
 };
 
 /** @brief CX_ENDPOINT Client structure. */
@@ -97,6 +220,152 @@ struct bt_cx_endpoint_client {
 
         /** Application callbacks. */
 	struct bt_cx_endpoint_client_cb cb;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING) || \
+	defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+        /** Message being written. */
+	const uint8_t *tx_data;
+	uint16_t tx_len;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+        /** Bytes of the message already segmented. */
+	uint16_t tx_offset;
+
+        /** Segment being written to the CX_ENDPOINT RX Characteristic. */
+	uint8_t tx_pdu[CONFIG_BT_L2CAP_TX_MTU - 3];
+
+        /** Segmentation state of written messages. */
+	struct bt_cx_endpoint_frame_tx frame_tx;
+
+        /** Reassembly state of received notifications. */
+	struct bt_cx_endpoint_frame_rx frame_rx;
+
+        /** GATT parameters for the CX_ENDPOINT Framing Characteristic,
+         *  written to frame the messages of the link.
+         */
+	struct bt_gatt_write_params frame_write_params;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+        /** GATT read parameters for the CX_ENDPOINT PSM Characteristic. */
+	struct bt_gatt_read_params psm_read_params;
+
+        /** Bulk channel, carrying every message once connected. */
+	struct bt_l2cap_le_chan l2cap;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+        /** GATT parameters for the CX_ENDPOINT Compression Characteristic,
+         *  read for the codecs of the peer and written with ours.
+         */
+	struct bt_gatt_read_params comp_read_params;
+	struct bt_gatt_write_params comp_write_params;
+	uint8_t comp_codecs;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+        /** GATT read parameters for the database hash of the peer. */
+	struct bt_gatt_read_params hash_read_params;
+
+        /** Database hash of the peer the handles belong to. */
+	uint8_t db_hash[16];
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+        /** Uptime at which the pending write was issued. */
+	uint32_t write_stamp;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+        /** Registered channels, indexed by channel ID. */
+	struct bt_cx_endpoint_client_chan *chan[BT_CX_ENDPOINT_CHAN_COUNT];
+	struct bt_cx_endpoint_chan_param chan_param[BT_CX_ENDPOINT_CHAN_COUNT];
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+        /** Messages waiting to be written, oldest first. */
+	struct net_buf *tx_queue[CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE_LEN];
+	uint8_t tx_head;
+	uint8_t tx_count;
+
+        /** Channel scheduling state of the queue. */
+	struct bt_cx_endpoint_chan_sched sched;
+
+        /** Bytes of the queue head already written without response. */
+	uint16_t tx_queue_offset;
+
+        /** Writes without response not yet completed, oldest first. */
+	struct {
+		struct net_buf *buf;
+		uint32_t stamp;
+		bool last;
+	} tx_inflight[CONFIG_BT_CX_ENDPOINT_CLIENT_TX_WINDOW];
+	uint8_t inflight_head;
+	uint8_t inflight_count;
+
+        /** Message written with acknowledged writes or over L2CAP. */
+	struct net_buf *tx_buf;
+
+        /** Writes the peer buffers for the link, 0 until read. */
+	uint16_t credits;
+
+        /** Writes issued on the link, the ones past credits_base are not
+         *  known to be consumed by the peer.
+         */
+	uint16_t credits_writes;
+	uint16_t credits_base;
+
+        /** Writes issued when the pending credits read was. */
+	uint16_t credits_mark;
+
+        /** GATT read parameters for the CX_ENDPOINT RX Credits
+         *  Characteristic.
+         */
+	struct bt_gatt_read_params credits_read_params;
+
+        /** Writes the queued messages. */
+	struct k_delayed_work tx_work;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+        /** Channel carrying the calls. */
+	struct bt_cx_endpoint_client_chan rpc_chan;
+
+        /** Calls waiting for their response. */
+	struct bt_cx_endpoint_client_rpc_call
+		rpc_calls[CONFIG_BT_CX_ENDPOINT_CLIENT_RPC_MAX_PENDING];
+
+        /** ID of the next request. */
+	uint16_t rpc_next_id;
+
+        /** Fails the calls that timed out. */
+	struct k_delayed_work rpc_work;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+        /** Received messages waiting for the application, can be polled
+         *  with K_POLL_TYPE_FIFO_DATA_AVAILABLE.
+         */
+	struct k_fifo rx_fifo;
+
+        /** Received messages not yet released by the application. */
+	atomic_t rx_count;
+
+        /** Received messages dropped for lack of RX buffers. */
+	uint32_t rx_drops;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+        /** GATT write parameters for the CCC of the CX_ENDPOINT TX
+         *  Characteristic when pausing or resuming notifications.
+         */
+	struct bt_gatt_write_params rx_flow_params;
+	uint16_t rx_flow_ccc;
+
+        /** Pauses and resumes notifications. */
+	struct k_work rx_flow_work;
+#endif
 };
 
 /** @brief CX_ENDPOINT Client initialization structure. */
@@ -108,12 +377,223 @@ struct bt_cx_endpoint_client_init_param {
 
 int bt_cx_endpoint_client_init(struct bt_cx_endpoint_client *cx_endpoint,
 		       const struct bt_cx_endpoint_client_init_param *init_param);
+
+/** @brief Send data to the peer.
+ *
+ * Without CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE, a single message is
+ * written at a time with acknowledged writes and @p data must stay valid
+ * until the sent callback. With it, the data is copied and queued, and
+ * written without response with several packets in flight. The sent
+ * callback is called once per message, in order. With channels, the
+ * message is sent on @ref BT_CX_ENDPOINT_CHAN_DEFAULT.
+ *
+ * @param[in] cx_endpoint Client instance.
+ * @param[in] data Data to send.
+ * @param[in] len Length of data.
+ *
+ * @retval 0 If the data was written or queued.
+ * @retval -ENOTCONN If the client is not assigned to a connection.
+ * @retval -EALREADY If a write is pending, without TX queue.
+ * @retval -ENOMEM If the TX queue is full or no buffer is free, with
+ *                 TX queue.
+ * @retval -EMSGSIZE If the data does not fit in a TX buffer, with TX
+ *                   queue.
+ * @retval -EAGAIN If cached handles are not verified yet or framing is
+ *                 being turned on, without TX queue.
+ */
 int bt_cx_endpoint_client_send(struct bt_cx_endpoint_client *cx_endpoint, const uint8_t *data,
 		       uint16_t len);
+
+/** @brief Queue data to be written with acknowledged writes.
+ *
+ * Same as bt_cx_endpoint_client_send() with TX queue, for control
+ * messages whose delivery must be confirmed by the peer. The message is
+ * written once every message queued before it has completed, and the
+ * sent callback reports the ATT error of the write.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE.
+ */
+int bt_cx_endpoint_client_send_reliable(struct bt_cx_endpoint_client *cx_endpoint,
+					const uint8_t *data, uint16_t len);
+
+/** @brief Take the next received message.
+ *
+ * With CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE, received messages are
+ * queued instead of being handed to the received callback of the
+ * instance. Channels registered with a received callback, such as the
+ * RPC channel, keep being called from the Bluetooth RX thread. The message must be released with
+ * bt_cx_endpoint_client_recv_done() once processed. Messages still queued
+ * when the instance is released are dropped.
+ *
+ * @param[in] cx_endpoint Client instance.
+ * @param[in] timeout Time to wait for a message.
+ *
+ * @return Buffer holding the message, without the channel ID, or NULL if
+ *         none arrived in time.
+ */
+struct net_buf *bt_cx_endpoint_client_recv(struct bt_cx_endpoint_client *cx_endpoint,
+					   k_timeout_t timeout);
+
+/** @brief Release a message taken with bt_cx_endpoint_client_recv().
+ *
+ * Resumes the notifications of a paused instance once enough messages
+ * are released.
+ *
+ * @param[in] cx_endpoint Client instance.
+ * @param[in] buf Message to release.
+ */
+void bt_cx_endpoint_client_recv_done(struct bt_cx_endpoint_client *cx_endpoint,
+				     struct net_buf *buf);
+
+/** @brief Channel of a message taken with bt_cx_endpoint_client_recv().
+ *
+ * @param[in] buf Received message.
+ *
+ * @return Channel ID, @ref BT_CX_ENDPOINT_CHAN_DEFAULT without channels.
+ */
+static inline uint8_t bt_cx_endpoint_client_recv_chan(struct net_buf *buf)
+{
+	return *(uint8_t *)net_buf_user_data(buf);
+}
+
+/** @brief Register a logical channel on a client instance.
+ *
+ * Messages received on a channel without registration are dropped, except
+ * on @ref BT_CX_ENDPOINT_CHAN_DEFAULT whose messages go to the callbacks
+ * of the instance. Unregistered channels are written with the lowest
+ * priority.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CHANNELS.
+ *
+ * @param[in] cx_endpoint Client instance, initialized.
+ * @param[in] chan Channel, kept by the instance.
+ *
+ * @retval 0 If the channel was registered.
+ * @retval -EINVAL If the ID is out of range or the weight is zero.
+ * @retval -EALREADY If a channel with the same ID is registered.
+ */
+int bt_cx_endpoint_client_chan_register(struct bt_cx_endpoint_client *cx_endpoint,
+					struct bt_cx_endpoint_client_chan *chan);
+
+/** @brief Queue data on a channel.
+ *
+ * Same as bt_cx_endpoint_client_send() with channels, with the message
+ * sent on @p chan, reliably if the channel is.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CHANNELS.
+ */
+int bt_cx_endpoint_client_chan_send(struct bt_cx_endpoint_client *cx_endpoint,
+				    const struct bt_cx_endpoint_client_chan *chan,
+				    const uint8_t *data, uint16_t len);
+
 int bt_cx_endpoint_handles_assign(struct bt_gatt_dm *dm,
 			  struct bt_cx_endpoint_client *cx_endpoint);
+
+/** @brief Detach a client instance from its connection.
+ *
+ * To be called once the connection is gone, before the instance is
+ * assigned to another one with bt_cx_endpoint_handles_assign(). Messages
+ * still queued are reported sent with an error.
+ *
+ * @param[in] cx_endpoint Client instance.
+ */
+void bt_cx_endpoint_client_release(struct bt_cx_endpoint_client *cx_endpoint);
+
+/** @brief Assign the cached handles of a bonded peer.
+ *
+ * Replaces the discovery and bt_cx_endpoint_handles_assign() for a peer
+ * known from a previous connection. If the instance was subscribed then,
+ * the subscription is resumed with bt_gatt_resubscribe() once the hash is
+ * verified, without writing the CCC the server kept for the bonded peer.
+ * Data can be sent right away, it is written once the database hash of the
+ * peer matches the cached one. On a mismatch, the stale callback is called.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE.
+ *
+ * @param[in] cx_endpoint Client instance, released or never assigned.
+ * @param[in] conn Connection to the peer.
+ *
+ * @retval 0 If the handles were assigned.
+ * @retval -ENOENT If the peer is not bonded or not cached.
+ * @return Other negative error code if the hash could not be read.
+ */
+int bt_cx_endpoint_client_cache_assign(struct bt_cx_endpoint_client *cx_endpoint,
+				       struct bt_conn *conn);
+
+/** @brief Store the handles of the assigned peer in the cache.
+ *
+ * Done when the handles are assigned after a discovery, to be called
+ * again once the peer is bonded if bonding completes later. The settings
+ * are written from the system work queue.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE.
+ *
+ * @param[in] cx_endpoint Client instance.
+ *
+ * @retval 0 If the handles were queued for storage or already stored.
+ * @retval -EAGAIN If the database hash of the peer is not known yet.
+ * @retval -EACCES If the peer is not bonded.
+ * @retval -ENOMEM If too many settings updates are pending, or if every
+ *         cache entry holds a subscription.
+ */
+int bt_cx_endpoint_client_cache_save(struct bt_cx_endpoint_client *cx_endpoint);
+
+/** @brief Drop the cached handles of a peer, e.g. when unpairing it.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE.
+ *
+ * @param[in] addr Address of the peer, NULL for every peer.
+ */
+void bt_cx_endpoint_client_cache_forget(const bt_addr_le_t *addr);
+
 int bt_cx_endpoint_subscribe_receive(struct bt_cx_endpoint_client *cx_endpoint);
 
+/** @brief Call a method of the service.
+ *
+ * The request is queued on the RPC channel and the call returns at once,
+ * several calls can be outstanding. The callback is called exactly once
+ * per successful call, with the results or the reason of the failure.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_RPC.
+ *
+ * @param[in] cx_endpoint Client instance.
+ * @param[in] method Method to call.
+ * @param[in] args Arguments of the call, copied.
+ * @param[in] len Length of the arguments.
+ * @param[in] timeout Time to wait for the response, K_FOREVER to wait
+ *                    until the instance is released.
+ * @param[in] cb Response callback.
+ * @param[in] user_data User data passed to the callback.
+ *
+ * @retval 0 If the request was queued.
+ * @retval -EINVAL If no callback is given.
+ * @retval -ENOTCONN If the client is not assigned to a connection.
+ * @retval -EMSGSIZE If the arguments are longer than
+ *                   @ref BT_CX_ENDPOINT_RPC_MAX_LEN.
+ * @retval -ENOMEM If too many calls are outstanding or the TX queue is
+ *                 full.
+ */
+int bt_cx_endpoint_client_rpc_call(struct bt_cx_endpoint_client *cx_endpoint,
+				   uint8_t method, const uint8_t *args,
+				   uint16_t len, k_timeout_t timeout,
+				   bt_cx_endpoint_client_rpc_cb_t cb,
+				   void *user_data);
+
+/** @brief Get the round-trip latency record of a method.
+ *
+ * Recorded over all client instances.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_RPC.
+ *
+ * @param[in] method Method ID.
+ * @param[out] lat Latency record.
+ *
+ * @retval 0 If the record was copied.
+ * @retval -EINVAL If the method is not recorded.
+ */
+int bt_cx_endpoint_client_rpc_lat_get(uint8_t method,
+				      struct bt_cx_endpoint_rpc_lat *lat);
+
 #ifdef __cplusplus
 }
 #endif
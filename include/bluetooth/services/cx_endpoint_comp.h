@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BT_CX_ENDPOINT_COMP_H_
+#define BT_CX_ENDPOINT_COMP_H_
+
+/**
+ * @file
+ * @defgroup bt_cx_endpoint_comp CX_ENDPOINT payload compression
+ * @{
+ * @brief Compression of single CX_ENDPOINT messages.
+ *
+ * Messages are compressed one by one, without state kept between them, so
+ * that a message queued for several links or dropped on one of them never
+ * affects the others. A compressed message is flagged with
+ * @ref BT_CX_ENDPOINT_CHAN_COMPRESSED in its channel header, and sent as is
+ * whenever compression would not make it shorter.
+ *
+ * The codec is a byte-aligned LZ77 variant in the LZF format. The payload
+ * is a sequence of tokens starting with a control byte:
+ *
+ * - 0x00 to 0x1F: literal run, the next (control + 1) bytes are copied.
+ * - 0x20 to 0xFF: back reference. Bits 5-7 hold the match length minus 2,
+ *   7 meaning that the next byte is added to it. The low 5 bits are the
+ *   high bits of the distance minus 1, whose low 8 bits follow.
+ *
+ * Each side announces the codecs it decodes in the Compression
+ * Characteristic: the server in its value, the client by writing it. A
+ * side compresses only what its peer announced.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** LZF codec, bit of the Compression Characteristic value. */
+#define BT_CX_ENDPOINT_COMP_LZF		BIT(0)
+
+/** Codecs supported by this build. */
+#define BT_CX_ENDPOINT_COMP_SUPPORTED	BT_CX_ENDPOINT_COMP_LZF
+
+/** @brief Compress a message.
+ *
+ * The encoder state is shared, a call made while another one is running,
+ * or from an interrupt, fails rather than waits.
+ *
+ * @param[in] data Message to compress.
+ * @param[in] len Message length.
+ * @param[out] out Buffer receiving the compressed message.
+ * @param[in] size Size of @p out. Giving @p len - 1 makes sure compression
+ *                 saves at least one byte.
+ *
+ * @return Length of the compressed message.
+ * @retval -ENOSPC If the compressed message does not fit in @p size.
+ * @retval -EBUSY If the encoder is in use.
+ */
+int bt_cx_endpoint_comp_encode(const uint8_t *data, uint16_t len,
+			       uint8_t *out, uint16_t size);
+
+/** @brief Decompress a message.
+ *
+ * @param[in] data Compressed message.
+ * @param[in] len Compressed message length.
+ * @param[out] out Buffer receiving the message.
+ * @param[in] size Size of @p out.
+ *
+ * @return Length of the message.
+ * @retval -EBADMSG If the compressed message is malformed.
+ * @retval -EMSGSIZE If the message does not fit in @p size.
+ */
+int bt_cx_endpoint_comp_decode(const uint8_t *data, uint16_t len,
+			       uint8_t *out, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BT_CX_ENDPOINT_COMP_H_ */
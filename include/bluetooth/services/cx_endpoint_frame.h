@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BT_CX_ENDPOINT_FRAME_H_
+#define BT_CX_ENDPOINT_FRAME_H_
+
+/**
+ * @file
+ * @defgroup bt_cx_endpoint_frame CX_ENDPOINT message framing
+ * @{
+ * @brief Segmentation and reassembly of CX_ENDPOINT messages.
+ *
+ * Messages larger than a single ATT payload are split into segments, each
+ * carried in one notification or write. Every segment starts with a
+ * one-byte header:
+ *
+ * - bit 0: FIRST, the segment starts a message. The header is followed by
+ *   the total message length (uint16_t, little endian).
+ * - bit 1: LAST, the segment ends a message.
+ * - bits 2-3: reserved, set to zero.
+ * - bits 4-7: segment sequence number, incremented by one per segment.
+ *
+ * Receivers complete a message once the announced length has arrived, so a
+ * segment may itself be split across the chunks of an ATT long write.
+ * A packet may also carry several whole messages back to back, each with
+ * its own first-segment header, when the sender coalesces small messages.
+ *
+ * A link is framed once the client writes the Framing Characteristic of the
+ * service, messages exchanged before that are carried unframed.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <net/buf.h>
+
+/** Segment starts a message. */
+#define BT_CX_ENDPOINT_FRAME_FIRST		BIT(0)
+/** Segment ends a message. */
+#define BT_CX_ENDPOINT_FRAME_LAST		BIT(1)
+
+#define BT_CX_ENDPOINT_FRAME_SEQ_POS		4
+#define BT_CX_ENDPOINT_FRAME_SEQ_MASK		0x0F
+
+/** Header length of a continuation segment. */
+#define BT_CX_ENDPOINT_FRAME_HDR_LEN		1
+/** Header length of a segment starting a message. */
+#define BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN	3
+
+/** @brief Segmentation state of one direction of a link. */
+struct bt_cx_endpoint_frame_tx {
+	/** Sequence number of the next segment. */
+	uint8_t seq;
+};
+
+/** @brief Reassembly state of one direction of a link. */
+struct bt_cx_endpoint_frame_rx {
+	/** Message being reassembled, NULL when idle. */
+	struct net_buf *buf;
+
+	/** Announced length of the message being reassembled. */
+	uint16_t total;
+
+	/** Expected sequence number of the next segment. */
+	uint8_t seq;
+};
+
+/** @brief Reassembled message callback.
+ *
+ * @param[in] data Message data, valid only during the call.
+ * @param[in] len Message length.
+ * @param[in] user_data User data passed to the feed functions.
+ */
+typedef void (*bt_cx_endpoint_frame_recv_t)(const uint8_t *data,
+					    uint16_t len, void *user_data);
+
+/** @brief Build the next segment of a message.
+ *
+ * @param[in,out] tx Segmentation state.
+ * @param[in] msg Message data.
+ * @param[in] msg_len Message length.
+ * @param[in,out] offset Offset of the first byte not yet segmented, zero for
+ *                       a new message. Advanced past the bytes consumed.
+ * @param[out] pdu Buffer receiving the segment.
+ * @param[in] pdu_size Size of @p pdu, at least
+ *                     @ref BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN + 1.
+ *
+ * @return Length of the segment written to @p pdu.
+ */
+uint16_t bt_cx_endpoint_frame_segment(struct bt_cx_endpoint_frame_tx *tx,
+				      const uint8_t *msg, uint16_t msg_len,
+				      uint16_t *offset, uint8_t *pdu,
+				      uint16_t pdu_size);
+
+/** @brief Feed a received packet, including its segment headers.
+ *
+ * @param[in,out] rx Reassembly state.
+ * @param[in] pdu Received packet.
+ * @param[in] len Packet length.
+ * @param[in] cb Called for every message completed by this packet.
+ * @param[in] user_data Passed to @p cb.
+ *
+ * @retval 0 If the segment was accepted.
+ * @retval -EBADMSG If the segment is malformed or out of sequence. Any
+ *                  message being reassembled is dropped.
+ * @retval -EMSGSIZE If the announced message is too large.
+ * @retval -ENOMEM If no reassembly buffer is available.
+ */
+int bt_cx_endpoint_frame_feed(struct bt_cx_endpoint_frame_rx *rx,
+			      const uint8_t *pdu, uint16_t len,
+			      bt_cx_endpoint_frame_recv_t cb, void *user_data);
+
+/** @brief Append raw data to the segment being received.
+ *
+ * Used for the chunks of an ATT long write following the first one, which
+ * carry no segment header.
+ *
+ * @param[in,out] rx Reassembly state.
+ * @param[in] data Chunk data.
+ * @param[in] len Chunk length.
+ * @param[in] cb Called if the chunk completes the message.
+ * @param[in] user_data Passed to @p cb.
+ *
+ * @retval 0 If the chunk was accepted.
+ * @retval -EBADMSG If no message is being reassembled or the chunk overruns
+ *                  the announced length.
+ */
+int bt_cx_endpoint_frame_append(struct bt_cx_endpoint_frame_rx *rx,
+				const uint8_t *data, uint16_t len,
+				bt_cx_endpoint_frame_recv_t cb,
+				void *user_data);
+
+/** @brief Drop any message being reassembled. */
+void bt_cx_endpoint_frame_rx_reset(struct bt_cx_endpoint_frame_rx *rx);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BT_CX_ENDPOINT_FRAME_H_ */
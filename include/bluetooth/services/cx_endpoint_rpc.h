@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BT_CX_ENDPOINT_RPC_H_
+#define BT_CX_ENDPOINT_RPC_H_
+
+/**
+ * @file
+ * @defgroup bt_cx_endpoint_rpc CX_ENDPOINT remote procedure calls
+ * @{
+ * @brief Request/response calls from the client to the service.
+ *
+ * Calls travel on their own logical channel. Every message starts with a
+ * @ref bt_cx_endpoint_rpc_hdr followed by the arguments or the results of
+ * the call. The client numbers its requests and may have several of them
+ * outstanding, the service answers each request with the same ID, so
+ * responses are matched whatever their order.
+ *
+ * The service dispatches requests to a table of handlers indexed by
+ * method. The client calls a method with bt_cx_endpoint_client_rpc_call().
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+#include <net/buf.h>
+#include <bluetooth/services/cx_endpoint.h>
+
+/** @brief Header of every RPC message. */
+struct bt_cx_endpoint_rpc_hdr {
+	/** Request ID chosen by the client, little endian, echoed in the
+	 *  response.
+	 */
+	uint16_t id;
+
+	/** Method called. */
+	uint8_t method;
+
+	/** Zero in requests. In responses, zero on success or the positive
+	 *  errno value returned by the handler, in which case no results
+	 *  follow.
+	 */
+	uint8_t status;
+} __packed;
+
+/** Largest arguments or results of a call. */
+#define BT_CX_ENDPOINT_RPC_MAX_LEN	CONFIG_BT_CX_ENDPOINT_RPC_MAX_LEN
+
+/** @brief Latency record of a method.
+ *
+ * The client records the time from queuing a request to the arrival of
+ * its response, the service the time spent in the handler.
+ */
+struct bt_cx_endpoint_rpc_lat {
+	/** Calls completed, successful or not. */
+	uint32_t count;
+
+	/** Calls that failed, timeouts included. */
+	uint32_t errors;
+
+	/** Calls that timed out, client only. */
+	uint32_t timeouts;
+
+	/** Sum and maximum of the latencies of completed calls, in
+	 *  milliseconds.
+	 */
+	uint32_t total_ms;
+	uint32_t max_ms;
+
+	/** Histogram of the latencies, bucket 0 counts latencies below
+	 *  1 ms, bucket n those below 2^n ms and the last one everything
+	 *  longer.
+	 */
+	uint32_t hist[BT_CX_ENDPOINT_STAT_LAT_BUCKETS];
+};
+
+/** @brief RPC method handler of the service.
+ *
+ * Called from the context the service delivers received data in.
+ *
+ * @param[in] conn Connection the request was received on.
+ * @param[in] args Arguments of the call.
+ * @param[in] len Length of the arguments.
+ * @param[out] rsp Buffer to append the results to, with room for
+ *                 @ref BT_CX_ENDPOINT_RPC_MAX_LEN bytes.
+ *
+ * @return 0 on success, negative errno value otherwise, reported to the
+ *         caller without results.
+ */
+typedef int (*bt_cx_endpoint_rpc_handler_t)(struct bt_conn *conn,
+					     const uint8_t *args, uint16_t len,
+					     struct net_buf *rsp);
+
+/** @brief Entry of the handler table of the service. */
+struct bt_cx_endpoint_rpc_method {
+	/** Method ID, below CONFIG_BT_CX_ENDPOINT_RPC_METHOD_COUNT to have
+	 *  its latency recorded.
+	 */
+	uint8_t method;
+
+	/** Handler of the method. */
+	bt_cx_endpoint_rpc_handler_t handler;
+};
+
+/** @brief Serve remote procedure calls on the service.
+ *
+ * Registers the RPC channel of the service. Requests for a method
+ * missing from the table are answered with ENOTSUP.
+ *
+ * Requires CONFIG_BT_CX_ENDPOINT_RPC.
+ *
+ * @param[in] methods Handler table, kept by the service.
+ * @param[in] count Number of entries of the table.
+ *
+ * @retval 0 If the calls are served.
+ * @retval -EINVAL If the table is empty.
+ * @retval -EALREADY If the RPC channel is already registered.
+ */
+int bt_cx_endpoint_rpc_init(const struct bt_cx_endpoint_rpc_method *methods,
+			    size_t count);
+
+/** @brief Get the handler latency record of a method of the service.
+ *
+ * @param[in] method Method ID.
+ * @param[out] lat Latency record.
+ *
+ * @retval 0 If the record was copied.
+ * @retval -EINVAL If the method is not recorded.
+ */
+int bt_cx_endpoint_rpc_lat_get(uint8_t method,
+			       struct bt_cx_endpoint_rpc_lat *lat);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BT_CX_ENDPOINT_RPC_H_ */
@@ -1,23 +1,197 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
 #ifndef _PWM_DUAL_H_
 #define _PWM_DUAL_H_
 
+/**
+ * @file
+ * @brief Groups of PWM channels updated together, such as the legs of one
+ * or more H-bridges.
+ *
+ * Each "croxel,pwm-dual" devicetree node is a device driving the channels
+ * listed in its pwms property, all sharing a period.
+ *
+ * With CONFIG_PWM_DUAL_SYNC, the channels of a group on a controller
+ * registered as a @ref pwm_dual_backend change on the same period
+ * boundary, see the backend for its exact guarantee. On other controllers,
+ * or when the backend cannot apply the update at once, the channels are
+ * set one after the other by increasing pulse, so that a leg is released
+ * before another one is driven.
+ */
+
 #include <stdint.h>
 #include <device.h>
+#include <drivers/pwm.h>
+#include <sys/slist.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief PWM controller with synchronised multi-channel updates.
+ *
+ * The controller keeps its standard drivers/pwm.h API, and is known to
+ * the groups through its registration only.
+ */
+struct pwm_dual_backend {
+	sys_snode_t node;
+
+	/** PWM controller. */
+	const struct device *dev;
 
-struct pwm_dual_duty_cycle {
-    uint32_t period;
-    struct {
-        uint32_t pin;
-        uint32_t pulse;
-    } ch0;
-    struct {
-        uint32_t pin;
-        uint32_t pulse;
-    } ch1;
+	/**
+	 * Apply the pulses of the channels on pins, in cycles, in a single
+	 * reload. Returns -ENOTSUP if the controller cannot for this update.
+	 */
+	int (*pin_set_multi)(const struct device *dev, uint32_t period_cycles,
+			     const uint32_t *pins, const uint32_t *pulses,
+			     size_t count);
 };
 
-int pwm_dual_set_usec(
-        const struct device *dev, 
-        struct pwm_dual_duty_cycle * setting);
+/**
+ * @brief Register a PWM controller as a backend of the groups.
+ *
+ * To be called by the controller driver at init, before the groups
+ * initialize. Groups on a controller without registration set their
+ * channels one after the other.
+ *
+ * Requires CONFIG_PWM_DUAL_SYNC.
+ *
+ * @param backend Backend, kept by the driver.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the controller or pin_set_multi is missing.
+ */
+int pwm_dual_backend_register(struct pwm_dual_backend *backend);
+
+/** @cond INTERNAL_HIDDEN */
+struct pwm_dual_driver_api {
+	int (*set_cycles)(const struct device *dev, uint32_t period,
+			  const uint32_t *pulses);
+	int (*set_channel_cycles)(const struct device *dev, uint32_t channel,
+				  uint32_t period, uint32_t pulse);
+	int (*get_cycles_per_sec)(const struct device *dev, uint64_t *cycles);
+	uint8_t (*channel_count)(const struct device *dev);
+};
+/** @endcond */
+
+/**
+ * @brief Number of channels of a group.
+ *
+ * @param dev PWM Dual device.
+ *
+ * @return Number of entries of the pwms property.
+ */
+static inline uint8_t pwm_dual_channel_count(const struct device *dev)
+{
+	const struct pwm_dual_driver_api *api = dev->api;
+
+	return api->channel_count(dev);
+}
+
+/**
+ * @brief Clock rate of the PWM controller of a group.
+ *
+ * Read from the controller once at init, so that callers can convert
+ * their periods and pulses to cycles once and use pwm_dual_set_cycles()
+ * on their hot path.
+ *
+ * @param dev PWM Dual device.
+ * @param cycles Cycles per second.
+ *
+ * @retval 0 If successful.
+ * @retval -errno Error of the PWM controller.
+ */
+static inline int pwm_dual_get_cycles_per_sec(const struct device *dev,
+					      uint64_t *cycles)
+{
+	const struct pwm_dual_driver_api *api = dev->api;
+
+	return api->get_cycles_per_sec(dev, cycles);
+}
+
+/**
+ * @brief Set every channel of a group, in clock cycles.
+ *
+ * Meant to be called once per control tick for all the channels of a
+ * board, rather than once per channel.
+ *
+ * @param dev PWM Dual device.
+ * @param period Period shared by the channels.
+ * @param pulses Pulse of each channel, pwm_dual_channel_count() entries.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If a pulse is longer than the period.
+ * @retval -errno Error of the PWM controller.
+ */
+static inline int pwm_dual_set_cycles(const struct device *dev,
+				      uint32_t period, const uint32_t *pulses)
+{
+	const struct pwm_dual_driver_api *api = dev->api;
+
+	return api->set_cycles(dev, period, pulses);
+}
+
+/**
+ * @brief Set one channel of a group, in clock cycles.
+ *
+ * The other channels keep their pulse.
+ *
+ * @param dev PWM Dual device.
+ * @param channel Index of the channel in the pwms property.
+ * @param period Period shared by the channels.
+ * @param pulse Pulse of the channel.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the channel does not exist or a pulse is longer than
+ *                 the period.
+ * @retval -errno Error of the PWM controller.
+ */
+static inline int pwm_dual_set_channel_cycles(const struct device *dev,
+					      uint32_t channel,
+					      uint32_t period, uint32_t pulse)
+{
+	const struct pwm_dual_driver_api *api = dev->api;
+
+	return api->set_channel_cycles(dev, channel, period, pulse);
+}
+
+/**
+ * @brief Set every channel of a group, in microseconds.
+ *
+ * @param dev PWM Dual device.
+ * @param period Period shared by the channels.
+ * @param pulses Pulse of each channel, pwm_dual_channel_count() entries.
+ *
+ * @retval 0 If successful.
+ * @retval -ENOTSUP If a value does not fit in clock cycles.
+ * @retval -errno See pwm_dual_set_cycles().
+ */
+int pwm_dual_set_usec(const struct device *dev, uint32_t period,
+		      const uint32_t *pulses);
+
+/**
+ * @brief Set one channel of a group, in microseconds.
+ *
+ * @param dev PWM Dual device.
+ * @param channel Index of the channel in the pwms property.
+ * @param period Period shared by the channels.
+ * @param pulse Pulse of the channel.
+ *
+ * @retval 0 If successful.
+ * @retval -ENOTSUP If a value does not fit in clock cycles.
+ * @retval -errno See pwm_dual_set_channel_cycles().
+ */
+int pwm_dual_set_channel_usec(const struct device *dev, uint32_t channel,
+			      uint32_t period, uint32_t pulse);
+
+#ifdef __cplusplus
+}
+#endif
 
-#endif /* _PWM_DUAL_H_ */
\ No newline at end of file
+#endif /* _PWM_DUAL_H_ */
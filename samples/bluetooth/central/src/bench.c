@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Benchmark driver of the central sample
+ *
+ * Runs, once per connection, a bulk transfer and a ping-pong test in each
+ * direction against the peripheral sample built with the same benchmark
+ * configuration, and prints one "BENCH" line per test.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/printk.h>
+#include <logging/log.h>
+
+#include <bluetooth/gatt.h>
+
+#include "cx_bench.h"
+#include "bench.h"
+#include "links.h"
+
+LOG_MODULE_REGISTER(bench, CONFIG_LOG_DEFAULT_LEVEL);
+
+#define BENCH_TIMEOUT	K_MSEC(CONFIG_APP_BENCH_TIMEOUT_MS)
+#define BENCH_RETRY	K_MSEC(CONFIG_APP_BENCH_RETRY_MS)
+
+struct bench_evt {
+	struct cx_bench_hdr hdr;
+	struct cx_bench_report report;
+};
+
+K_MSGQ_DEFINE(bench_evt_q, sizeof(struct bench_evt), 4, 4);
+static K_SEM_DEFINE(start_sem, 0, 1);
+static K_SEM_DEFINE(sent_sem, 0, CONFIG_APP_BENCH_BULK_COUNT + 1);
+static K_SEM_DEFINE(tuned_sem, 0, 1);
+
+/* Link under test, only its messages are handled. */
+static struct bt_conn *bench_conn;
+static atomic_t bench_busy;
+static uint8_t sent_err;
+static uint16_t sent_errors;
+
+/* Streamed messages whose sent callback is still to come. */
+static uint16_t outstanding;
+
+/* Copied by links_send(), reused for every message. */
+static uint8_t tx_msg[CX_BENCH_MSG_MAX];
+
+/* Receiver side of peripheral-to-central bulk transfers. */
+static struct {
+	struct cx_bench_report report;
+	uint32_t first;
+	uint32_t last;
+	uint16_t next_seq;
+} bulk_rx;
+
+static struct cx_bench_rtt rtt;
+static uint16_t ping_seq;
+
+/* Write the message prepared in tx_msg and wait for its completion. */
+static int write_msg(uint16_t len, struct cx_bench_report *stats)
+{
+	int err;
+
+	for (;;) {
+		err = links_send(bench_conn, tx_msg, len);
+		if (err != -ENOMEM) {
+			break;
+		}
+
+		stats->retries++;
+		k_sleep(BENCH_RETRY);
+	}
+
+	if (!err && k_sem_take(&sent_sem, BENCH_TIMEOUT)) {
+		err = -ETIMEDOUT;
+	} else if (!err && sent_err) {
+		err = -EIO;
+	}
+
+	if (err) {
+		LOG_WRN("Write of op %u failed (err %d)", tx_msg[0], err);
+		stats->errors++;
+	}
+
+	return err;
+}
+
+static int write_op(uint8_t op, uint16_t seq, uint16_t len,
+		    struct cx_bench_report *stats)
+{
+	return write_msg(cx_bench_msg_fill(tx_msg, len, op, seq), stats);
+}
+
+/* Queue a message without waiting for its completion, so the client keeps
+ * several writes in flight.
+ */
+static int stream_op(uint8_t op, uint16_t seq, uint16_t len,
+		     struct cx_bench_report *stats)
+{
+	int err;
+
+	len = cx_bench_msg_fill(tx_msg, len, op, seq);
+
+	for (;;) {
+		err = links_send(bench_conn, tx_msg, len);
+		if (err != -ENOMEM) {
+			break;
+		}
+
+		stats->retries++;
+		k_sleep(BENCH_RETRY);
+	}
+
+	if (err) {
+		LOG_WRN("Queueing of op %u failed (err %d)", op, err);
+		stats->errors++;
+		return err;
+	}
+
+	outstanding++;
+
+	return 0;
+}
+
+/* Wait for the completion of every streamed message. */
+static void stream_drain(struct cx_bench_report *stats)
+{
+	while (outstanding) {
+		if (k_sem_take(&sent_sem, BENCH_TIMEOUT)) {
+			LOG_WRN("%u writes not completed", outstanding);
+			stats->errors += outstanding;
+			break;
+		}
+
+		outstanding--;
+	}
+
+	outstanding = 0;
+	stats->errors += sent_errors;
+	sent_errors = 0;
+}
+
+static int write_start(uint8_t op, uint16_t count, uint16_t len,
+		       struct cx_bench_report *stats)
+{
+	struct cx_bench_start start = {
+		.count = count,
+		.len = len,
+	};
+	uint16_t msg_len = sizeof(struct cx_bench_hdr) + sizeof(start);
+
+	cx_bench_msg_fill(tx_msg, msg_len, op, 0);
+	memcpy(&tx_msg[sizeof(struct cx_bench_hdr)], &start, sizeof(start));
+
+	return write_msg(msg_len, stats);
+}
+
+static int wait_evt(uint8_t op, struct bench_evt *evt, k_timeout_t timeout)
+{
+	for (;;) {
+		if (k_msgq_get(&bench_evt_q, evt, timeout)) {
+			LOG_WRN("Timed out waiting for op %u", op);
+			return -ETIMEDOUT;
+		}
+
+		if (evt->hdr.op == op) {
+			return 0;
+		}
+	}
+}
+
+static void bench_uplink(struct bt_conn *conn, uint16_t mtu)
+{
+	struct cx_bench_report local = {0};
+	struct bench_evt evt;
+
+	for (uint16_t seq = 0; seq < CONFIG_APP_BENCH_BULK_COUNT; seq++) {
+		if (stream_op(CX_BENCH_OP_BULK, seq, CONFIG_APP_BENCH_BULK_LEN,
+			      &local) == -ENOTCONN) {
+			stream_drain(&local);
+			return;
+		}
+	}
+
+	stream_op(CX_BENCH_OP_BULK_END, CONFIG_APP_BENCH_BULK_COUNT,
+		  sizeof(struct cx_bench_hdr), &local);
+	stream_drain(&local);
+
+	if (wait_evt(CX_BENCH_OP_REPORT, &evt, BENCH_TIMEOUT)) {
+		printk("BENCH uplink: no report\n");
+		return;
+	}
+
+	/* Throughput as seen by the receiver, retries as seen by us. */
+	evt.report.errors += local.errors;
+	evt.report.retries = local.retries;
+	cx_bench_print_bulk("uplink", conn, &evt.report,
+			    cx_bench_pdus(CONFIG_APP_BENCH_BULK_LEN, mtu));
+}
+
+static void bench_downlink(struct bt_conn *conn, uint16_t mtu)
+{
+	struct cx_bench_report local = {0};
+	struct bench_evt evt;
+
+	memset(&bulk_rx, 0, sizeof(bulk_rx));
+
+	if (write_start(CX_BENCH_OP_START_BULK, CONFIG_APP_BENCH_BULK_COUNT,
+			CONFIG_APP_BENCH_BULK_LEN, &local)) {
+		return;
+	}
+
+	if (wait_evt(CX_BENCH_OP_REPORT, &evt,
+		     K_MSEC(CONFIG_APP_BENCH_TIMEOUT_MS *
+			    (1 + CONFIG_APP_BENCH_BULK_COUNT / 16)))) {
+		printk("BENCH downlink: no report\n");
+		return;
+	}
+
+	/* Throughput as seen by us, retries as seen by the sender. */
+	bulk_rx.report.errors = evt.report.errors + local.errors;
+	bulk_rx.report.retries = evt.report.retries;
+	cx_bench_print_bulk("downlink", conn, &bulk_rx.report,
+			    cx_bench_pdus(CONFIG_APP_BENCH_BULK_LEN, mtu));
+}
+
+static void bench_rtt_central(void)
+{
+	struct cx_bench_report report = {0};
+	struct bench_evt evt;
+
+	rtt.count = 0;
+
+	for (uint16_t seq = 0; seq < CONFIG_APP_BENCH_PING_COUNT; seq++) {
+		ping_seq = seq;
+
+		if (write_op(CX_BENCH_OP_PING, seq, CONFIG_APP_BENCH_PING_LEN,
+			     &report) == -ENOTCONN) {
+			return;
+		}
+
+		if (wait_evt(CX_BENCH_OP_PONG, &evt, BENCH_TIMEOUT)) {
+			report.errors++;
+		}
+	}
+
+	cx_bench_rtt_summarize(&rtt, &report);
+	cx_bench_print_rtt("rtt_central", &report);
+}
+
+static void bench_rtt_peripheral(void)
+{
+	struct cx_bench_report local = {0};
+	struct bench_evt evt;
+	struct cx_bench_hdr *pong;
+
+	if (write_start(CX_BENCH_OP_START_PING, CONFIG_APP_BENCH_PING_COUNT,
+			CONFIG_APP_BENCH_PING_LEN, &local)) {
+		return;
+	}
+
+	for (;;) {
+		if (k_msgq_get(&bench_evt_q, &evt, BENCH_TIMEOUT)) {
+			printk("BENCH rtt_peripheral: no report\n");
+			return;
+		}
+
+		if (evt.hdr.op == CX_BENCH_OP_REPORT) {
+			break;
+		}
+
+		if (evt.hdr.op != CX_BENCH_OP_PING) {
+			continue;
+		}
+
+		/* Echo the stamp back so the peripheral can time the trip. */
+		pong = (struct cx_bench_hdr *)tx_msg;
+		*pong = evt.hdr;
+		pong->op = CX_BENCH_OP_PONG;
+		write_msg(sizeof(*pong), &local);
+	}
+
+	evt.report.errors += local.errors;
+	evt.report.retries += local.retries;
+	cx_bench_print_rtt("rtt_peripheral", &evt.report);
+}
+
+static void bench_thread(void)
+{
+	struct bt_conn *conn;
+	uint16_t mtu;
+
+	for (;;) {
+		k_sem_take(&start_sem, K_FOREVER);
+
+		/* Measure the link as negotiated, not its defaults. */
+		if (k_sem_take(&tuned_sem, K_SECONDS(10))) {
+			LOG_WRN("Link not tuned, measuring anyway");
+		}
+
+		k_msgq_purge(&bench_evt_q);
+
+		conn = bench_conn;
+		mtu = bt_gatt_get_mtu(conn);
+
+		printk("BENCH start: mtu=%u bulk=%ux%u ping=%ux%u\n", mtu,
+		       CONFIG_APP_BENCH_BULK_COUNT, CONFIG_APP_BENCH_BULK_LEN,
+		       CONFIG_APP_BENCH_PING_COUNT, CONFIG_APP_BENCH_PING_LEN);
+
+		bench_uplink(conn, mtu);
+		bench_downlink(conn, mtu);
+		bench_rtt_central();
+		bench_rtt_peripheral();
+
+		printk("BENCH done\n");
+
+		bench_conn = NULL;
+		atomic_clear(&bench_busy);
+	}
+}
+
+K_THREAD_DEFINE(bench_tid, 1024, bench_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+void bench_start(struct bt_conn *conn)
+{
+	/* One link at a time, the others are left alone. */
+	if (atomic_set(&bench_busy, 1)) {
+		return;
+	}
+
+	bench_conn = conn;
+	k_sem_give(&start_sem);
+}
+
+void bench_link_tuned(struct bt_conn *conn)
+{
+	if (!bench_conn || (conn == bench_conn)) {
+		k_sem_give(&tuned_sem);
+	}
+}
+
+void bench_sent(struct bt_conn *conn, uint8_t err, const uint8_t *data,
+		uint16_t len)
+{
+	if (conn != bench_conn) {
+		return;
+	}
+
+	sent_err = err;
+	if (err) {
+		sent_errors++;
+	}
+	k_sem_give(&sent_sem);
+}
+
+static void bulk_recv(const struct cx_bench_hdr *hdr, uint16_t len)
+{
+	uint32_t now = k_cycle_get_32();
+
+	if (!bulk_rx.report.msgs) {
+		bulk_rx.first = now;
+	}
+
+	if (hdr->seq != bulk_rx.next_seq) {
+		bulk_rx.report.lost += (uint16_t)(hdr->seq - bulk_rx.next_seq);
+	}
+
+	bulk_rx.next_seq = hdr->seq + 1;
+	bulk_rx.last = now;
+	bulk_rx.report.msgs++;
+	bulk_rx.report.bytes += len;
+}
+
+uint8_t bench_recv(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+	const struct cx_bench_hdr *hdr = (const struct cx_bench_hdr *)data;
+	struct bench_evt evt = {0};
+
+	if (conn != bench_conn) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	if (len < sizeof(*hdr)) {
+		LOG_WRN("Runt benchmark message (%u bytes)", len);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	switch (hdr->op) {
+	case CX_BENCH_OP_BULK:
+		bulk_recv(hdr, len);
+		return BT_GATT_ITER_CONTINUE;
+	case CX_BENCH_OP_BULK_END:
+		bulk_rx.report.lost += (uint16_t)(hdr->seq - bulk_rx.next_seq);
+		bulk_rx.report.elapsed_us =
+			k_cyc_to_us_floor32(bulk_rx.last - bulk_rx.first);
+		return BT_GATT_ITER_CONTINUE;
+	case CX_BENCH_OP_PONG:
+		if (hdr->seq != ping_seq) {
+			return BT_GATT_ITER_CONTINUE;
+		}
+
+		/* Timed here rather than on the benchmark thread. */
+		cx_bench_rtt_add(&rtt, hdr);
+		break;
+	case CX_BENCH_OP_REPORT:
+		if (len < sizeof(*hdr) + sizeof(evt.report)) {
+			return BT_GATT_ITER_CONTINUE;
+		}
+
+		memcpy(&evt.report, &data[sizeof(*hdr)], sizeof(evt.report));
+		break;
+	case CX_BENCH_OP_PING:
+		break;
+	default:
+		LOG_WRN("Unknown benchmark op 0x%02x", hdr->op);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	evt.hdr = *hdr;
+	if (k_msgq_put(&bench_evt_q, &evt, K_NO_WAIT)) {
+		LOG_WRN("Benchmark event dropped");
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+/** @brief Run the benchmark against a subscribed peripheral, unless it is
+ *         already running against another one.
+ */
+void bench_start(struct bt_conn *conn);
+
+/** @brief Let the benchmark start once the link has been tuned. */
+void bench_link_tuned(struct bt_conn *conn);
+
+/** @brief Handle a message notified by a peripheral. */
+uint8_t bench_recv(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+/** @brief Handle the completion of a message write. */
+void bench_sent(struct bt_conn *conn, uint8_t err, const uint8_t *data,
+		uint16_t len);
+
+#endif /* BENCH_H_ */
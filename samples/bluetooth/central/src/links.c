@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Gateway links of the central sample
+ *
+ * Keeps one CX Endpoint client per connection, indexed by connection, and
+ * schedules the messages sent to the peripherals so that every link gets
+ * its share of the client TX buffers.
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/printk.h>
+#include <logging/log.h>
+
+#include <bluetooth/gatt.h>
+#include <bluetooth/gatt_dm.h>
+#include <bluetooth/services/cx_endpoint.h>
+#include <bluetooth/services/cx_endpoint_client.h>
+
+#include "links.h"
+
+LOG_MODULE_REGISTER(links, CONFIG_LOG_DEFAULT_LEVEL);
+
+#define LINK_COUNT	CONFIG_BT_MAX_CONN
+#define LINK_INFLIGHT	CONFIG_APP_LINK_TX_INFLIGHT
+#define STATS_INTERVAL	MAX(CONFIG_APP_LINK_STATS_INTERVAL_S, 1)
+
+enum link_state {
+	LINK_IDLE,
+	LINK_DISCOVERY_PENDING,
+	LINK_DISCOVERING,
+	LINK_READY,
+};
+
+struct link_counters {
+	uint32_t tx_msgs;
+	uint32_t tx_bytes;
+	uint32_t tx_errors;
+	uint32_t rx_msgs;
+	uint32_t rx_bytes;
+};
+
+struct link {
+	struct bt_conn *conn;
+	enum link_state state;
+	struct bt_cx_endpoint_client client;
+
+	/* Messages waiting for their turn, single buffers without
+	 * fragments. A queue rather than a FIFO, a message the client could
+	 * not take is put back first in line.
+	 */
+	struct k_queue tx_queue;
+
+	/* Messages handed over to the client and not yet sent. */
+	atomic_t inflight;
+
+	struct link_counters cnt;
+
+	/* Counters as of the previous report. */
+	struct link_counters last;
+};
+
+NET_BUF_POOL_DEFINE(link_tx_pool, CONFIG_APP_LINK_TX_BUF_COUNT,
+		    CONFIG_APP_LINK_TX_BUF_SIZE, 0, NULL);
+
+static struct link links[LINK_COUNT];
+static const struct links_cb *app_cb;
+
+/* Link served first in the next scheduling round. */
+static uint8_t rr_next;
+
+static struct k_work tx_work;
+static struct k_delayed_work stats_work;
+
+static struct link *link_get(struct bt_conn *conn)
+{
+	struct link *link = &links[bt_conn_index(conn)];
+
+	return (link->conn == conn) ? link : NULL;
+}
+
+static uint8_t link_id(const struct link *link)
+{
+	return link - links;
+}
+
+static struct link *client_link(struct bt_cx_endpoint_client *client)
+{
+	return CONTAINER_OF(client, struct link, client);
+}
+
+static void discovery_complete(struct bt_gatt_dm *dm, void *context);
+static void discovery_service_not_found(struct bt_conn *conn, void *context);
+static void discovery_error(struct bt_conn *conn, int err, void *context);
+
+static struct bt_gatt_dm_cb discovery_cb = {
+	.completed         = discovery_complete,
+	.service_not_found = discovery_service_not_found,
+	.error_found       = discovery_error,
+};
+
+/* The discovery manager runs one procedure at a time, links wait for
+ * their turn.
+ */
+static void discover_next(void)
+{
+	struct link *link;
+	int err;
+
+	for (uint8_t i = 0; i < LINK_COUNT; i++) {
+		if (links[i].state == LINK_DISCOVERING) {
+			return;
+		}
+	}
+
+	for (uint8_t i = 0; i < LINK_COUNT; i++) {
+		link = &links[i];
+		if (link->state != LINK_DISCOVERY_PENDING) {
+			continue;
+		}
+
+		err = bt_gatt_dm_start(link->conn, BT_UUID_CX_ENDPOINT,
+				       &discovery_cb, link);
+		if (!err) {
+			link->state = LINK_DISCOVERING;
+			return;
+		}
+
+		if (err == -EALREADY) {
+			/* Busy with a link that just went away. */
+			return;
+		}
+
+		LOG_ERR("could not start the discovery procedure on link %u, "
+			"error code: %d", i, err);
+		link->state = LINK_IDLE;
+	}
+}
+
+static void discovery_complete(struct bt_gatt_dm *dm, void *context)
+{
+	struct link *link = context;
+
+	LOG_INF("Service discovery completed on link %u", link_id(link));
+
+	bt_gatt_dm_data_print(dm);
+
+	bt_cx_endpoint_handles_assign(dm, &link->client);
+	bt_cx_endpoint_subscribe_receive(&link->client);
+
+	bt_gatt_dm_data_release(dm);
+
+	link->state = LINK_READY;
+	if (app_cb->ready) {
+		app_cb->ready(link->conn);
+	}
+
+	discover_next();
+}
+
+static void discovery_service_not_found(struct bt_conn *conn, void *context)
+{
+	struct link *link = context;
+
+	LOG_INF("Service not found on link %u", link_id(link));
+
+	link->state = LINK_IDLE;
+	discover_next();
+}
+
+static void discovery_error(struct bt_conn *conn, int err, void *context)
+{
+	struct link *link = context;
+
+	LOG_WRN("Error while discovering GATT database on link %u: (%d)",
+		link_id(link), err);
+
+	if (link->state == LINK_DISCOVERING) {
+		link->state = LINK_IDLE;
+	}
+	discover_next();
+}
+
+/* Hand queued messages over to the clients, one message per link and per
+ * round, each round starting with the next link, until every link is
+ * either idle or has its share in flight.
+ */
+static void tx_work_handler(struct k_work *work)
+{
+	struct net_buf *buf;
+	struct link *link;
+	bool served;
+	int err;
+
+	do {
+		served = false;
+
+		for (uint8_t i = 0; i < LINK_COUNT; i++) {
+			link = &links[(rr_next + i) % LINK_COUNT];
+
+			if ((link->state != LINK_READY) ||
+			    (atomic_get(&link->inflight) >= LINK_INFLIGHT)) {
+				continue;
+			}
+
+			/* Taken once, links_disconnected() may drain the
+			 * queue meanwhile.
+			 */
+			buf = k_queue_get(&link->tx_queue, K_NO_WAIT);
+			if (!buf) {
+				continue;
+			}
+
+			err = bt_cx_endpoint_client_send(&link->client,
+							 buf->data, buf->len);
+			if ((err == -ENOMEM) && (link->state == LINK_READY)) {
+				/* Client buffers all taken, put back first in
+				 * line and retried on the next completion of
+				 * any link.
+				 */
+				k_queue_prepend(&link->tx_queue, buf);
+				continue;
+			}
+
+			if (err) {
+				LOG_WRN("Send on link %u failed (err %d)",
+					link_id(link), err);
+				link->cnt.tx_errors++;
+				if (link->conn && app_cb->sent) {
+					app_cb->sent(link->conn,
+						     BT_ATT_ERR_UNLIKELY,
+						     buf->data, buf->len);
+				}
+			} else {
+				atomic_inc(&link->inflight);
+				served = true;
+			}
+
+			net_buf_unref(buf);
+		}
+
+		rr_next = (rr_next + 1) % LINK_COUNT;
+	} while (served);
+}
+
+static uint8_t client_received(struct bt_cx_endpoint_client *client,
+			       const uint8_t *data, uint16_t len)
+{
+	struct link *link = client_link(client);
+
+	link->cnt.rx_msgs++;
+	link->cnt.rx_bytes += len;
+
+	if (app_cb->received) {
+		return app_cb->received(link->conn, data, len);
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void client_sent(struct bt_cx_endpoint_client *client, uint8_t err,
+			const uint8_t *data, uint16_t len)
+{
+	struct link *link = client_link(client);
+
+	if (atomic_get(&link->inflight)) {
+		atomic_dec(&link->inflight);
+	}
+
+	if (err) {
+		link->cnt.tx_errors++;
+	} else {
+		link->cnt.tx_msgs++;
+		link->cnt.tx_bytes += len;
+	}
+
+	if (link->conn && app_cb->sent) {
+		app_cb->sent(link->conn, err, data, len);
+	}
+
+	k_work_submit(&tx_work);
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+static void client_stale(struct bt_cx_endpoint_client *client)
+{
+	struct link *link = client_link(client);
+
+	LOG_INF("Cached handles of link %u are stale", link_id(link));
+
+	link->state = LINK_DISCOVERY_PENDING;
+	discover_next();
+}
+#endif
+
+static void stats_work_handler(struct k_work *work)
+{
+	uint32_t tx_total = 0;
+	uint32_t rx_total = 0;
+	uint32_t tx;
+	uint32_t rx;
+	uint8_t count = 0;
+	struct link *link;
+
+	for (uint8_t i = 0; i < LINK_COUNT; i++) {
+		link = &links[i];
+		if (!link->conn) {
+			continue;
+		}
+
+		tx = link->cnt.tx_bytes - link->last.tx_bytes;
+		rx = link->cnt.rx_bytes - link->last.rx_bytes;
+		link->last = link->cnt;
+
+		printk("LINK %u: tx=%u B/s rx=%u B/s errors=%u\n", i,
+		       tx / STATS_INTERVAL, rx / STATS_INTERVAL,
+		       link->cnt.tx_errors);
+
+		tx_total += tx;
+		rx_total += rx;
+		count++;
+	}
+
+	if (count) {
+		printk("LINKS %u/%u: tx=%u B/s rx=%u B/s\n", count, LINK_COUNT,
+		       tx_total / STATS_INTERVAL, rx_total / STATS_INTERVAL);
+	}
+
+	k_delayed_work_submit(&stats_work, K_SECONDS(STATS_INTERVAL));
+}
+
+int links_init(const struct links_cb *cb)
+{
+	struct bt_cx_endpoint_client_init_param init = {
+		.cb = {
+			.received = client_received,
+			.sent = client_sent,
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+			.stale = client_stale,
+#endif
+		}
+	};
+	int err;
+
+	app_cb = cb;
+
+	for (uint8_t i = 0; i < LINK_COUNT; i++) {
+		k_queue_init(&links[i].tx_queue);
+
+		err = bt_cx_endpoint_client_init(&links[i].client, &init);
+		if (err) {
+			LOG_ERR("CX_ENDPOINT Client initialization failed "
+				"(err %d)", err);
+			return err;
+		}
+	}
+
+	k_work_init(&tx_work, tx_work_handler);
+	k_delayed_work_init(&stats_work, stats_work_handler);
+
+	if (CONFIG_APP_LINK_STATS_INTERVAL_S) {
+		k_delayed_work_submit(&stats_work, K_SECONDS(STATS_INTERVAL));
+	}
+
+	LOG_INF("CX_ENDPOINT Client pool of %u links initialized",
+		LINK_COUNT);
+
+	return 0;
+}
+
+void links_connected(struct bt_conn *conn)
+{
+	struct link *link = &links[bt_conn_index(conn)];
+
+	link->conn = bt_conn_ref(conn);
+	link->state = LINK_DISCOVERY_PENDING;
+	memset(&link->cnt, 0, sizeof(link->cnt));
+	memset(&link->last, 0, sizeof(link->last));
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+	/* Bonded peers seen before need no discovery, messages are held by
+	 * the client until it has checked the cached handles.
+	 */
+	if (!bt_cx_endpoint_client_cache_assign(&link->client, conn)) {
+		LOG_INF("Link %u ready from the cache", link_id(link));
+		link->state = LINK_READY;
+		if (app_cb->ready) {
+			app_cb->ready(conn);
+		}
+		return;
+	}
+#endif
+
+	discover_next();
+}
+
+void links_disconnected(struct bt_conn *conn)
+{
+	struct link *link = link_get(conn);
+	struct net_buf *buf;
+
+	if (!link) {
+		return;
+	}
+
+	link->state = LINK_IDLE;
+
+	/* Queued messages are reported as failed while the link is known. */
+	bt_cx_endpoint_client_release(&link->client);
+
+	while ((buf = k_queue_get(&link->tx_queue, K_NO_WAIT))) {
+		if (app_cb->sent) {
+			app_cb->sent(conn, BT_ATT_ERR_UNLIKELY, buf->data,
+				     buf->len);
+		}
+		net_buf_unref(buf);
+	}
+
+	atomic_clear(&link->inflight);
+
+	bt_conn_unref(link->conn);
+	link->conn = NULL;
+
+	discover_next();
+}
+
+void links_discover(struct bt_conn *conn)
+{
+	struct link *link = link_get(conn);
+
+	if (!link) {
+		return;
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+	/* Bonding may complete after the discovery. */
+	if (link->state == LINK_READY) {
+		(void)bt_cx_endpoint_client_cache_save(&link->client);
+		return;
+	}
+#endif
+
+	if (link->state != LINK_IDLE) {
+		return;
+	}
+
+	link->state = LINK_DISCOVERY_PENDING;
+	discover_next();
+}
+
+uint8_t links_free(void)
+{
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < LINK_COUNT; i++) {
+		if (!links[i].conn) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+int links_send(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+	struct link *link = link_get(conn);
+	struct net_buf *buf;
+
+	if (!link || (link->state != LINK_READY)) {
+		return -ENOTCONN;
+	}
+
+	if (len > CONFIG_APP_LINK_TX_BUF_SIZE) {
+		return -EMSGSIZE;
+	}
+
+	buf = net_buf_alloc(&link_tx_pool, K_NO_WAIT);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	net_buf_add_mem(buf, data, len);
+	k_queue_append(&link->tx_queue, buf);
+
+	k_work_submit(&tx_work);
+
+	return 0;
+}
+
+int links_broadcast(const uint8_t *data, uint16_t len)
+{
+	struct link *link;
+	int count = 0;
+
+	for (uint8_t i = 0; i < LINK_COUNT; i++) {
+		link = &links[(rr_next + i) % LINK_COUNT];
+		if (link->conn && !links_send(link->conn, data, len)) {
+			count++;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LINKS_H_
+#define LINKS_H_
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+/** @brief Callbacks of the gateway links. */
+struct links_cb {
+	/** @brief The CX Endpoint service of a link is discovered and
+	 *         subscribed.
+	 */
+	void (*ready)(struct bt_conn *conn);
+
+	/** @brief Message notified by the peripheral of a link. */
+	uint8_t (*received)(struct bt_conn *conn, const uint8_t *data,
+			    uint16_t len);
+
+	/** @brief Message queued with links_send() has been written. */
+	void (*sent)(struct bt_conn *conn, uint8_t err, const uint8_t *data,
+		     uint16_t len);
+};
+
+/** @brief Initialize one CX Endpoint client per possible connection. */
+int links_init(const struct links_cb *cb);
+
+/** @brief Take a new connection into the pool and discover its service,
+ *         or take its handles from the cache for a known bonded peer.
+ */
+void links_connected(struct bt_conn *conn);
+
+/** @brief Release the link of a connection that is gone. */
+void links_disconnected(struct bt_conn *conn);
+
+/** @brief Retry the discovery of a link that failed, e.g. for lack of
+ *         security, or cache the handles of a ready link once bonded.
+ */
+void links_discover(struct bt_conn *conn);
+
+/** @brief Number of connections that can still be taken. */
+uint8_t links_free(void);
+
+/** @brief Queue a message to the peripheral of a ready link.
+ *
+ * The data is copied. Messages of all links are handed over to their
+ * clients round robin.
+ *
+ * @retval 0 If the message was queued.
+ * @retval -ENOTCONN If the link is not ready.
+ * @retval -ENOMEM If no gateway buffer is free.
+ * @retval -EMSGSIZE If the message does not fit in a gateway buffer.
+ */
+int links_send(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+/** @brief Queue a message to every ready link.
+ *
+ * @return Number of links the message was queued for.
+ */
+int links_broadcast(const uint8_t *data, uint16_t len);
+
+#endif /* LINKS_H_ */
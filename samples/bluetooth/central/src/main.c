@@ -15,6 +15,7 @@
 #include <bluetooth/uuid.h>
 #include <bluetooth/gatt.h>
 
+#include <bluetooth/cx_link.h>
 #include <bluetooth/services/cx_endpoint.h>
 #include <bluetooth/services/cx_endpoint_client.h>
 #include <bluetooth/gatt_dm.h>
@@ -28,6 +29,10 @@
 
 #include <dk_buttons_and_leds.h>
 
+#include "bench.h"
+#include "links.h"
+#include "reconnect.h"
+
 LOG_MODULE_REGISTER(app, CONFIG_LOG_DEFAULT_LEVEL);
 
 #define RUN_STATUS_LED          DK_LED1
@@ -40,118 +45,107 @@ LOG_MODULE_REGISTER(app, CONFIG_LOG_DEFAULT_LEVEL);
 
 #define DEVICE_NAME_FILTER      "CX-Peripheral"
 
-static struct bt_conn *default_conn;
-static struct bt_cx_endpoint_client cx_endpoint_client;
+/* Scanning for new devices was requested, resumed whenever a link is
+ * free. Known devices are reconnected from the filter accept list the rest
+ * of the time.
+ */
+static bool scan_wanted;
 
-static uint8_t ble_data_received(const uint8_t *const data, uint16_t len)
+static uint8_t ble_data_received(struct bt_conn *conn, const uint8_t *data,
+				 uint16_t len)
 {
-	LOG_INF("Received data - len: %d",len);
+	if (IS_ENABLED(CONFIG_APP_BENCH)) {
+		return bench_recv(conn, data, len);
+	}
+
+	LOG_INF("Received data - link %u len: %d", bt_conn_index(conn), len);
 	LOG_HEXDUMP_INF(data,len,"received_data");
 
 	return BT_GATT_ITER_CONTINUE;
 }
 
-static void discovery_complete(struct bt_gatt_dm *dm,
-			       void *context)
-{
-	struct bt_cx_endpoint_client *cx_endpoint = context;
-	LOG_INF("Service discovery completed");
-
-	bt_gatt_dm_data_print(dm);
-
-	bt_cx_endpoint_handles_assign(dm, cx_endpoint);
-	bt_cx_endpoint_subscribe_receive(cx_endpoint);
-
-	bt_gatt_dm_data_release(dm);
-}
-
-static void discovery_service_not_found(struct bt_conn *conn,
-					void *context)
+static void ble_data_sent(struct bt_conn *conn, uint8_t err,
+			  const uint8_t *data, uint16_t len)
 {
-	LOG_INF("Service not found");
+	if (IS_ENABLED(CONFIG_APP_BENCH)) {
+		bench_sent(conn, err, data, len);
+	}
 }
 
-static void discovery_error(struct bt_conn *conn,
-			    int err,
-			    void *context)
+static void link_ready(struct bt_conn *conn)
 {
-	LOG_WRN("Error while discovering GATT database: (%d)", err);
+	if (IS_ENABLED(CONFIG_APP_BENCH)) {
+		bench_start(conn);
+	}
 }
 
-struct bt_gatt_dm_cb discovery_cb = {
-	.completed         = discovery_complete,
-	.service_not_found = discovery_service_not_found,
-	.error_found       = discovery_error,
+static const struct links_cb links_callbacks = {
+	.ready = link_ready,
+	.received = ble_data_received,
+	.sent = ble_data_sent,
 };
 
-static void gatt_discover(struct bt_conn *conn)
+static void scan_resume(void)
 {
 	int err;
 
-	if (conn != default_conn) {
+	if (!links_free()) {
 		return;
 	}
 
-	err = bt_gatt_dm_start(conn,
-			       BT_UUID_CX_ENDPOINT,
-			       &discovery_cb,
-			       &cx_endpoint_client);
-	if (err) {
-		LOG_ERR("could not start the discovery procedure, error "
-			"code: %d", err);
+	if (!scan_wanted) {
+		if (IS_ENABLED(CONFIG_APP_RECONNECT)) {
+			(void)reconnect_start();
+		}
+		return;
+	}
+
+	err = bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
+	if (err && (err != -EALREADY)) {
+		LOG_ERR("Scanning failed to start (err %d)", err);
 	}
 }
 
 static void connected(struct bt_conn *conn, uint8_t conn_err)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
-	int err;
 
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
+	if (IS_ENABLED(CONFIG_APP_RECONNECT)) {
+		reconnect_ended();
+	}
+
 	if (conn_err) {
 		LOG_INF("Failed to connect to %s (%d)", log_strdup(addr),
 			conn_err);
-
-		if (default_conn == conn) {
-			bt_conn_unref(default_conn);
-			default_conn = NULL;
-
-			err = bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
-			if (err) {
-				LOG_ERR("Scanning failed to start (err %d)",
-					err);
-			}
-		}
-
+		scan_resume();
 		return;
 	}
 
 	LOG_INF("Connected: %s", log_strdup(addr));
 
-	gatt_discover(conn);
-
-	err = bt_scan_stop();
-	if ((!err) && (err != -EALREADY)) {
-		LOG_ERR("Stop LE scan failed (err %d)", err);
+	if (IS_ENABLED(CONFIG_APP_RECONNECT)) {
+		reconnect_peer_seen(bt_conn_get_dst(conn));
 	}
+
+	links_connected(conn);
+
+	/* Keep looking for peripherals while links are free. */
+	scan_resume();
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
-	
+
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
 	LOG_INF("Disconnected: %s (reason %u)", log_strdup(addr),
 		reason);
 
-	if (default_conn != conn) {
-		return;
-	}
-
-	bt_conn_unref(default_conn);
-	default_conn = NULL;
+	links_disconnected(conn);
+	scan_resume();
 }
 
 static void security_changed(struct bt_conn *conn, bt_security_t level,
@@ -169,9 +163,24 @@ static void security_changed(struct bt_conn *conn, bt_security_t level,
 			level, err);
 	}
 
-	gatt_discover(conn);
+	links_discover(conn);
+}
+
+static void link_tuned(struct bt_conn *conn, const struct bt_cx_link_info *info,
+		       int err)
+{
+	LOG_INF("Link tuned: MTU %u, interval %u, data len %u (err %d)",
+		info->mtu, info->interval, info->tx_max_len, err);
+
+	if (IS_ENABLED(CONFIG_APP_BENCH)) {
+		bench_link_tuned(conn);
+	}
 }
 
+static struct bt_cx_link_cb link_callbacks = {
+	.tuned = link_tuned,
+};
+
 static struct bt_conn_cb conn_callbacks = {
 	.connected = connected,
 	.disconnected = disconnected,
@@ -193,35 +202,11 @@ static void scan_filter_match(struct bt_scan_device_info *device_info,
 static void scan_connecting_error(struct bt_scan_device_info *device_info)
 {
 	LOG_WRN("Connecting failed");
-}
-
-static void scan_connecting(struct bt_scan_device_info *device_info,
-			    struct bt_conn *conn)
-{
-	default_conn = bt_conn_ref(conn);
-}
-
-static int cx_endpoint_client_init(void)
-{
-	int err;
-	struct bt_cx_endpoint_client_init_param init = {
-		.cb = {
-			.received = ble_data_received,
-		}
-	};
-
-	err = bt_cx_endpoint_client_init(&cx_endpoint_client, &init);
-	if (err) {
-		LOG_ERR("CX_ENDPOINT Client initialization failed (err %d)", err);
-		return err;
-	}
-
-	LOG_INF("CX_ENDPOINT Client module initialized");
-	return err;
+	scan_resume();
 }
 
 BT_SCAN_CB_INIT(scan_cb, scan_filter_match, NULL,
-		scan_connecting_error, scan_connecting);
+		scan_connecting_error, NULL);
 
 static int scan_init(void)
 {
@@ -253,6 +238,19 @@ void app_start_scanning(void)
 {
 	int err;
 
+	scan_wanted = true;
+
+	/* The controller cannot connect on its own while the scan module
+	 * does.
+	 */
+	if (IS_ENABLED(CONFIG_APP_RECONNECT)) {
+		err = reconnect_stop();
+		if (err) {
+			LOG_WRN("Scanning not started (err %d)", err);
+			return;
+		}
+	}
+
 	err = bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
 	if (err) {
 		LOG_WRN("Scanning failed to start (err %d)", err);
@@ -265,6 +263,8 @@ void app_stop_scanning(void)
 {
 	int err;
 
+	scan_wanted = false;
+
 	err = bt_scan_stop();
 	if (err) {
 		LOG_WRN("Scanning failed to stop (err %d)", err);
@@ -272,6 +272,7 @@ void app_stop_scanning(void)
 	}
 	LOG_INF("Scanning successfully stopped");	
 
+	scan_resume();
 }
 
 static void button_changed(uint32_t button_state, uint32_t has_changed)
@@ -294,8 +295,8 @@ static void button_changed(uint32_t button_state, uint32_t has_changed)
 	}
 
 	if( (has_changed & BUTTON_SEND_DATA) ){
-		err = bt_cx_endpoint_client_send(&cx_endpoint_client,(const uint8_t *)&button_state,1);
-		LOG_INF("Send data result: %d",err);
+		err = links_broadcast((const uint8_t *)&button_state, 1);
+		LOG_INF("Data sent to %d links", err);
 		dk_set_led(BTN_STATUS_LED,button_state);
 	}
 
@@ -318,16 +319,21 @@ void main(void)
 	int err;
 	int blink_status = 0;
 
-	err = dk_leds_init();
-	if (err) {
-		LOG_INF("LEDs init failed (err %d)", err);
-		return;
-	}
+	/* Benchmark builds for simulated boards run without LEDs and
+	 * buttons.
+	 */
+	if (IS_ENABLED(CONFIG_DK_LIBRARY)) {
+		err = dk_leds_init();
+		if (err) {
+			LOG_INF("LEDs init failed (err %d)", err);
+			return;
+		}
 
-	err = init_button();
-	if (err) {
-		LOG_INF("Buttons init failed (err %d)", err);
-		return;
+		err = init_button();
+		if (err) {
+			LOG_INF("Buttons init failed (err %d)", err);
+			return;
+		}
 	}
 
 	err = bt_enable(NULL);
@@ -343,13 +349,19 @@ void main(void)
 
 	bt_conn_cb_register(&conn_callbacks);
 
+	err = bt_cx_link_init(&link_callbacks);
+	if (err) {
+		LOG_ERR("Link tuning init failed (err %d)", err);
+		return;
+	}
+
 	err = scan_init();
 	if(err){
 		LOG_ERR("Scan Init failed: %d",err);
 		return;
 	}
 
-	err = cx_endpoint_client_init();
+	err = links_init(&links_callbacks);
 	if(err){
 		LOG_ERR("CX_ENDPOINT Client init failed: %d",err);
 		return;
@@ -357,6 +369,21 @@ void main(void)
 
 	printk("Starting Bluetooth Central CX Endpoint Client example\n");
 
+	if (IS_ENABLED(CONFIG_APP_RECONNECT)) {
+		reconnect_init();
+	}
+
+	/* Benchmark runs headless, start looking for the peripheral now. */
+	if (IS_ENABLED(CONFIG_APP_BENCH)) {
+		app_start_scanning();
+	} else {
+		scan_resume();
+	}
+
+	if (!IS_ENABLED(CONFIG_DK_LIBRARY)) {
+		return;
+	}
+
 	for (;;) {
 		dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
 		k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Fast reconnection of the central sample
+ *
+ * Peripherals that were bonded or connected before are reconnected by the
+ * controller from its filter accept list: the first advertising packet of
+ * a known peripheral starts the connection, without waiting for scan
+ * responses nor matching names in the host.
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <logging/log.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+
+#include "reconnect.h"
+
+LOG_MODULE_REGISTER(reconnect, CONFIG_LOG_DEFAULT_LEVEL);
+
+#define PEER_COUNT	CONFIG_APP_RECONNECT_PEER_COUNT
+
+static bt_addr_le_t peers[PEER_COUNT];
+static uint8_t peer_count;
+
+/* Peer replaced when the list is full. */
+static uint8_t peer_next;
+
+/* The controller is connecting from the filter accept list. */
+static bool active;
+
+static bool peer_connected(const bt_addr_le_t *addr)
+{
+	struct bt_conn *conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+
+	if (conn) {
+		bt_conn_unref(conn);
+		return true;
+	}
+
+	return false;
+}
+
+void reconnect_peer_seen(const bt_addr_le_t *addr)
+{
+	for (uint8_t i = 0; i < peer_count; i++) {
+		if (!bt_addr_le_cmp(addr, &peers[i])) {
+			return;
+		}
+	}
+
+	if (peer_count < PEER_COUNT) {
+		bt_addr_le_copy(&peers[peer_count++], addr);
+		return;
+	}
+
+	bt_addr_le_copy(&peers[peer_next], addr);
+	peer_next = (peer_next + 1) % PEER_COUNT;
+}
+
+static void bond_found(const struct bt_bond_info *info, void *user_data)
+{
+	reconnect_peer_seen(&info->addr);
+}
+
+void reconnect_init(void)
+{
+	bt_foreach_bond(BT_ID_DEFAULT, bond_found, NULL);
+
+	LOG_INF("%u known peripherals", peer_count);
+}
+
+int reconnect_start(void)
+{
+	uint8_t count = 0;
+	int err;
+
+	/* The list cannot change while the controller uses it. */
+	err = reconnect_stop();
+	if (err) {
+		return err;
+	}
+
+	err = bt_le_whitelist_clear();
+	if (err) {
+		LOG_WRN("Filter accept list not cleared (err %d)", err);
+		return err;
+	}
+
+	for (uint8_t i = 0; i < peer_count; i++) {
+		if (peer_connected(&peers[i])) {
+			continue;
+		}
+
+		err = bt_le_whitelist_add(&peers[i]);
+		if (err) {
+			LOG_WRN("Peer not added to the filter accept list "
+				"(err %d)", err);
+			continue;
+		}
+		count++;
+	}
+
+	if (!count) {
+		return -ENOENT;
+	}
+
+	err = bt_conn_le_create_auto(BT_CONN_LE_CREATE_CONN_AUTO,
+				     BT_LE_CONN_PARAM_DEFAULT);
+	if (err) {
+		LOG_WRN("Automatic connection not started (err %d)", err);
+		return err;
+	}
+
+	active = true;
+
+	LOG_INF("Waiting for %u known peripherals", count);
+
+	return 0;
+}
+
+int reconnect_stop(void)
+{
+	int err;
+
+	if (!active) {
+		return 0;
+	}
+
+	/* The host reports no connection callback for a cancelled automatic
+	 * connection, the procedure is over once the call returns.
+	 */
+	err = bt_conn_create_auto_stop();
+	if (err) {
+		LOG_WRN("Automatic connection not stopped (err %d)", err);
+		return err;
+	}
+
+	active = false;
+
+	return 0;
+}
+
+void reconnect_ended(void)
+{
+	active = false;
+}
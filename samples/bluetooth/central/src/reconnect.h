@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef RECONNECT_H_
+#define RECONNECT_H_
+
+#include <zephyr/types.h>
+#include <bluetooth/addr.h>
+
+/** @brief Take the bonded peripherals as known peers.
+ *
+ * To be called once the settings are loaded.
+ */
+void reconnect_init(void);
+
+/** @brief Remember a peripheral that connected, bonded or not. */
+void reconnect_peer_seen(const bt_addr_le_t *addr);
+
+/** @brief Connect automatically to the known peripherals not connected.
+ *
+ * Fills the controller filter accept list with them and lets the
+ * controller connect to the first one advertising, without scanning from
+ * the host. An automatic connection already running is stopped first.
+ *
+ * @retval 0 If the controller is waiting for a known peripheral.
+ * @retval -ENOENT If every known peripheral is connected.
+ * @return Other negative error code from the host.
+ */
+int reconnect_start(void);
+
+/** @brief Stop connecting automatically, e.g. to scan for new devices.
+ *
+ * The procedure is over once this returns 0, no connection callback
+ * reports its end.
+ *
+ * @retval 0 If no automatic connection is running any longer.
+ * @return Negative error code from the host otherwise.
+ */
+int reconnect_stop(void);
+
+/** @brief A connection procedure ended, successfully or not.
+ *
+ * To be called first from the connected callback.
+ */
+void reconnect_ended(void);
+
+#endif /* RECONNECT_H_ */
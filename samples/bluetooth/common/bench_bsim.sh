@@ -0,0 +1,118 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2021 Croxel Inc.
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Headless CX Endpoint benchmark on BabbleSim. Builds the central and
+# peripheral samples for nrf52_bsim with their bench overlays, runs both
+# images against the 2.4 GHz phy and checks the BENCH lines of the central
+# with the patterns twister uses on hardware.
+#
+# Usage: bench_bsim.sh [l2cap]
+#
+# Needs west and BabbleSim, with BSIM_OUT_PATH and BSIM_COMPONENTS_PATH set
+# as for the Zephyr BabbleSim tests. Optional environment:
+#   BENCH_WORK_DIR        build and log directory, ./bench_bsim[_l2cap]
+#   BENCH_NO_BUILD        set to run the images of a previous build
+#   BENCH_SIM_LENGTH_US   simulated time, 120 s by default
+#   BENCH_TIMEOUT_S       wall clock limit of the run, 600 s by default
+
+set -u
+
+: "${BSIM_OUT_PATH:?BSIM_OUT_PATH must be defined}"
+: "${BSIM_COMPONENTS_PATH:?BSIM_COMPONENTS_PATH must be defined}"
+
+samples_dir=$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)
+variant="${1:-}"
+
+case "${variant}" in
+"")
+	overlays="overlay-bench.conf"
+	;;
+l2cap)
+	overlays="overlay-bench.conf;overlay-l2cap.conf"
+	;;
+*)
+	echo "Unknown variant '${variant}'" >&2
+	exit 2
+	;;
+esac
+
+work_dir="${BENCH_WORK_DIR:-${PWD}/bench_bsim${variant:+_${variant}}}"
+simulation_id="cx_bench${variant:+_${variant}}"
+sim_length_us="${BENCH_SIM_LENGTH_US:-120e6}"
+timeout_s="${BENCH_TIMEOUT_S:-600}"
+verbosity_level=2
+
+# Same patterns, in the same order, as the bench scenarios of
+# central/sample.yaml.
+expected=(
+	"BENCH start: mtu=[0-9]+"
+	"BENCH uplink: msgs=[0-9]+ .* lost=0 errors=0"
+	"BENCH downlink: msgs=[0-9]+ .* lost=0 errors=0"
+	"BENCH rtt_central: n=[0-9]+ .* errors=0"
+	"BENCH rtt_peripheral: n=[0-9]+ .* errors=0"
+	"BENCH done"
+)
+
+build() {
+	west build -p auto -b nrf52_bsim -d "${work_dir}/$1" \
+		"${samples_dir}/$1" -- -DOVERLAY_CONFIG="${overlays}"
+}
+
+if [ -z "${BENCH_NO_BUILD:-}" ]; then
+	build central || exit 1
+	build peripheral || exit 1
+fi
+
+for image in central peripheral; do
+	if [ ! -x "${work_dir}/${image}/zephyr/zephyr.exe" ]; then
+		echo "${work_dir}/${image}/zephyr/zephyr.exe not found" >&2
+		exit 1
+	fi
+done
+
+process_ids=""
+exit_code=0
+
+timeout "${timeout_s}" "${work_dir}/central/zephyr/zephyr.exe" \
+	-v=${verbosity_level} -s="${simulation_id}" -d=0 \
+	> "${work_dir}/central.log" 2>&1 &
+process_ids="${process_ids} $!"
+
+timeout "${timeout_s}" "${work_dir}/peripheral/zephyr/zephyr.exe" \
+	-v=${verbosity_level} -s="${simulation_id}" -d=1 \
+	> "${work_dir}/peripheral.log" 2>&1 &
+process_ids="${process_ids} $!"
+
+timeout "${timeout_s}" "${BSIM_OUT_PATH}/bin/bs_2G4_phy_v1" \
+	-v=${verbosity_level} -s="${simulation_id}" -D=2 \
+	-sim_length="${sim_length_us}" \
+	> "${work_dir}/phy.log" 2>&1 &
+process_ids="${process_ids} $!"
+
+for process_id in ${process_ids}; do
+	wait "${process_id}" || exit_code=$?
+done
+
+grep "BENCH" "${work_dir}/central.log"
+
+if [ "${exit_code}" -ne 0 ]; then
+	echo "FAIL: simulation exited with ${exit_code}, logs in ${work_dir}"
+	exit "${exit_code}"
+fi
+
+# Every pattern must match a line after the one matched by the previous.
+line=0
+for pattern in "${expected[@]}"; do
+	found=$(tail -n +$((line + 1)) "${work_dir}/central.log" |
+		grep -n -E -m 1 "${pattern}" | cut -d: -f1)
+	if [ -z "${found}" ]; then
+		echo "FAIL: no line matching '${pattern}', logs in ${work_dir}"
+		exit 1
+	fi
+	line=$((line + found))
+done
+
+echo "PASS"
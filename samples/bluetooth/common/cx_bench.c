@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr.h>
+#include <stdlib.h>
+#include <sys/printk.h>
+#include <bluetooth/conn.h>
+
+#include "cx_bench.h"
+
+uint16_t cx_bench_msg_fill(uint8_t *msg, uint16_t len, uint8_t op,
+			   uint16_t seq)
+{
+	struct cx_bench_hdr *hdr = (struct cx_bench_hdr *)msg;
+
+	for (uint16_t i = sizeof(*hdr); i < len; i++) {
+		msg[i] = (uint8_t)(seq + i);
+	}
+
+	hdr->op = op;
+	hdr->seq = seq;
+	hdr->stamp = k_cycle_get_32();
+
+	return len;
+}
+
+void cx_bench_rtt_add(struct cx_bench_rtt *rtt, const struct cx_bench_hdr *pong)
+{
+	if (rtt->count >= ARRAY_SIZE(rtt->samples)) {
+		return;
+	}
+
+	rtt->samples[rtt->count++] =
+		k_cyc_to_us_floor32(k_cycle_get_32() - pong->stamp);
+}
+
+static int sample_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const struct cx_bench_rtt *rtt, uint8_t pct)
+{
+	/* Nearest rank on the sorted samples. */
+	uint32_t rank = (pct * rtt->count + 99) / 100;
+
+	return rtt->samples[MAX(rank, 1) - 1];
+}
+
+void cx_bench_rtt_summarize(struct cx_bench_rtt *rtt,
+			    struct cx_bench_report *report)
+{
+	if (!rtt->count) {
+		return;
+	}
+
+	qsort(rtt->samples, rtt->count, sizeof(rtt->samples[0]), sample_cmp);
+
+	report->msgs = rtt->count;
+	report->rtt_p50_us = percentile(rtt, 50);
+	report->rtt_p90_us = percentile(rtt, 90);
+	report->rtt_p99_us = percentile(rtt, 99);
+	report->rtt_max_us = rtt->samples[rtt->count - 1];
+}
+
+uint16_t cx_bench_pdus(uint16_t len, uint16_t mtu)
+{
+	/* First segment carries a 3 byte header, the following ones 1. */
+	uint16_t first = mtu - 3 - 3;
+	uint16_t next = mtu - 3 - 1;
+
+	if (len <= first) {
+		return 1;
+	}
+
+	return 1 + ceiling_fraction(len - first, next);
+}
+
+void cx_bench_print_bulk(const char *name, struct bt_conn *conn,
+			 const struct cx_bench_report *report,
+			 uint16_t pdus_per_msg)
+{
+	struct bt_conn_info info;
+	uint32_t kbps = 0;
+	uint32_t per_evt = 0;
+
+	if (report->elapsed_us) {
+		kbps = (uint64_t)report->bytes * 8U * 1000U /
+		       report->elapsed_us;
+	}
+
+	if (!bt_conn_get_info(conn, &info) && report->elapsed_us) {
+		/* Connection interval is in units of 1.25 ms. */
+		uint32_t events = report->elapsed_us /
+				  (info.le.interval * 1250U);
+
+		per_evt = (uint32_t)report->msgs * pdus_per_msg * 100U /
+			  MAX(events, 1);
+	}
+
+	printk("BENCH %s: msgs=%u bytes=%u time_ms=%u kbps=%u "
+	       "pkts_per_evt=%u.%02u lost=%u errors=%u retries=%u\n",
+	       name, report->msgs, report->bytes, report->elapsed_us / 1000U,
+	       kbps, per_evt / 100U, per_evt % 100U, report->lost,
+	       report->errors, report->retries);
+}
+
+void cx_bench_print_rtt(const char *name, const struct cx_bench_report *report)
+{
+	printk("BENCH %s: n=%u rtt_us p50=%u p90=%u p99=%u max=%u "
+	       "errors=%u retries=%u\n",
+	       name, report->msgs, report->rtt_p50_us, report->rtt_p90_us,
+	       report->rtt_p99_us, report->rtt_max_us, report->errors,
+	       report->retries);
+}
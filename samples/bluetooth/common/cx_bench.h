@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CX_BENCH_H_
+#define CX_BENCH_H_
+
+/**
+ * @file
+ * @brief CX Endpoint benchmark protocol shared by the central and
+ *        peripheral samples.
+ *
+ * Every benchmark message starts with a @ref cx_bench_hdr. The central
+ * drives the tests; the peripheral answers requests and streams data on
+ * demand. Multi-byte fields are little endian, as on both ends.
+ */
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+enum cx_bench_op {
+	/** Echo request, answered with CX_BENCH_OP_PONG. */
+	CX_BENCH_OP_PING = 0x01,
+	/** Echo response, carries the stamp of the request. */
+	CX_BENCH_OP_PONG,
+	/** Bulk payload. */
+	CX_BENCH_OP_BULK,
+	/** End of a bulk transfer, answered with CX_BENCH_OP_REPORT. */
+	CX_BENCH_OP_BULK_END,
+	/** Results measured by the peer, followed by a cx_bench_report. */
+	CX_BENCH_OP_REPORT,
+	/** Ask the peer to stream bulk data, followed by a cx_bench_start. */
+	CX_BENCH_OP_START_BULK,
+	/** Ask the peer to run pings, followed by a cx_bench_start. */
+	CX_BENCH_OP_START_PING,
+};
+
+struct cx_bench_hdr {
+	uint8_t op;
+	uint16_t seq;
+	/** Sender cycle counter, echoed back in pongs. */
+	uint32_t stamp;
+} __packed;
+
+struct cx_bench_start {
+	uint16_t count;
+	uint16_t len;
+} __packed;
+
+struct cx_bench_report {
+	uint32_t bytes;
+	uint32_t elapsed_us;
+	uint16_t msgs;
+	uint16_t lost;
+	uint16_t errors;
+	uint16_t retries;
+	uint32_t rtt_p50_us;
+	uint32_t rtt_p90_us;
+	uint32_t rtt_p99_us;
+	uint32_t rtt_max_us;
+} __packed;
+
+/** Largest benchmark message. */
+#define CX_BENCH_MSG_MAX MAX(CONFIG_APP_BENCH_BULK_LEN, \
+			     MAX(CONFIG_APP_BENCH_PING_LEN, \
+				 sizeof(struct cx_bench_hdr) + \
+				 sizeof(struct cx_bench_report)))
+
+/** @brief Round trip time samples of one ping-pong test. */
+struct cx_bench_rtt {
+	uint32_t samples[CONFIG_APP_BENCH_PING_COUNT];
+	uint16_t count;
+};
+
+/** @brief Fill a message with its header and a test pattern.
+ *
+ * @return @p len.
+ */
+uint16_t cx_bench_msg_fill(uint8_t *msg, uint16_t len, uint8_t op,
+			   uint16_t seq);
+
+/** @brief Record the round trip of a pong received now. */
+void cx_bench_rtt_add(struct cx_bench_rtt *rtt, const struct cx_bench_hdr *pong);
+
+/** @brief Store the RTT percentiles of @p rtt in @p report. */
+void cx_bench_rtt_summarize(struct cx_bench_rtt *rtt,
+			    struct cx_bench_report *report);
+
+/** @brief Number of ATT packets a framed message of @p len bytes takes. */
+uint16_t cx_bench_pdus(uint16_t len, uint16_t mtu);
+
+/** @brief Print a throughput result.
+ *
+ * Packets per connection event are derived from the connection
+ * interval of @p conn and assume every message took @p pdus_per_msg
+ * packets.
+ */
+void cx_bench_print_bulk(const char *name, struct bt_conn *conn,
+			 const struct cx_bench_report *report,
+			 uint16_t pdus_per_msg);
+
+/** @brief Print a round trip result. */
+void cx_bench_print_rtt(const char *name, const struct cx_bench_report *report);
+
+#endif /* CX_BENCH_H_ */
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Benchmark responder of the peripheral sample
+ *
+ * Answers pings and bulk transfers started by the central and runs the
+ * peripheral-to-central tests it requests. Anything that sends more than
+ * a single reply runs on the benchmark thread, so the Bluetooth threads
+ * never block on a full TX queue.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <logging/log.h>
+
+#include <bluetooth/conn.h>
+#include <bluetooth/services/cx_endpoint.h>
+
+#include "cx_bench.h"
+#include "bench.h"
+
+LOG_MODULE_REGISTER(bench, CONFIG_LOG_DEFAULT_LEVEL);
+
+#define BENCH_TIMEOUT	K_MSEC(CONFIG_APP_BENCH_TIMEOUT_MS)
+#define BENCH_RETRY	K_MSEC(CONFIG_APP_BENCH_RETRY_MS)
+
+struct bench_req {
+	struct bt_conn *conn;
+	uint8_t op;
+	struct cx_bench_start start;
+};
+
+K_MSGQ_DEFINE(bench_req_q, sizeof(struct bench_req), 2, 4);
+static K_SEM_DEFINE(pong_sem, 0, 1);
+
+/* Receiver side of central-to-peripheral bulk transfers. */
+static struct {
+	struct cx_bench_report report;
+	uint32_t first;
+	uint32_t last;
+	uint16_t next_seq;
+} bulk_rx;
+
+/* Peripheral-initiated ping-pong, owned by the benchmark thread. */
+static struct cx_bench_rtt rtt;
+static uint16_t ping_seq;
+
+static int send_msg(struct bt_conn *conn, uint8_t op, uint16_t seq,
+		    uint16_t len, struct cx_bench_report *stats)
+{
+	struct net_buf *buf;
+	int err;
+
+	buf = bt_cx_endpoint_buf_alloc(K_NO_WAIT);
+	if (!buf) {
+		stats->retries++;
+		buf = bt_cx_endpoint_buf_alloc(BENCH_TIMEOUT);
+		if (!buf) {
+			stats->errors++;
+			return -ENOMEM;
+		}
+	}
+
+	cx_bench_msg_fill(net_buf_add(buf, len), len, op, seq);
+
+	for (;;) {
+		err = bt_cx_endpoint_send_buf(conn, buf);
+		if (err != -ENOMEM) {
+			break;
+		}
+
+		/* TX queue full, wait for the link to drain. */
+		stats->retries++;
+		k_sleep(BENCH_RETRY);
+	}
+
+	if (err) {
+		stats->errors++;
+		net_buf_unref(buf);
+	}
+
+	return err;
+}
+
+static int send_report(struct bt_conn *conn, const struct cx_bench_report *report)
+{
+	uint8_t msg[sizeof(struct cx_bench_hdr) + sizeof(*report)];
+
+	cx_bench_msg_fill(msg, sizeof(msg), CX_BENCH_OP_REPORT, 0);
+	memcpy(&msg[sizeof(struct cx_bench_hdr)], report, sizeof(*report));
+
+	return bt_cx_endpoint_send(conn, msg, sizeof(msg));
+}
+
+static void bulk_send(struct bt_conn *conn, const struct cx_bench_start *start)
+{
+	struct cx_bench_report report = {0};
+	uint32_t begin = k_cycle_get_32();
+	uint16_t len = MAX(start->len, sizeof(struct cx_bench_hdr));
+
+	for (uint16_t seq = 0; seq < start->count; seq++) {
+		if (send_msg(conn, CX_BENCH_OP_BULK, seq, len, &report) ==
+		    -ENOTCONN) {
+			return;
+		}
+
+		report.msgs++;
+		report.bytes += len;
+	}
+
+	send_msg(conn, CX_BENCH_OP_BULK_END, start->count,
+		 sizeof(struct cx_bench_hdr), &report);
+
+	report.elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - begin);
+	send_report(conn, &report);
+}
+
+static void ping_run(struct bt_conn *conn, const struct cx_bench_start *start)
+{
+	struct cx_bench_report report = {0};
+	uint16_t len = MAX(start->len, sizeof(struct cx_bench_hdr));
+
+	rtt.count = 0;
+	k_sem_reset(&pong_sem);
+
+	for (uint16_t i = 0; i < start->count; i++) {
+		ping_seq = i;
+
+		if (send_msg(conn, CX_BENCH_OP_PING, i, len, &report) ==
+		    -ENOTCONN) {
+			return;
+		}
+
+		if (k_sem_take(&pong_sem, BENCH_TIMEOUT)) {
+			LOG_WRN("Pong %u timed out", i);
+			report.errors++;
+		}
+	}
+
+	cx_bench_rtt_summarize(&rtt, &report);
+	send_report(conn, &report);
+}
+
+static void bench_thread(void)
+{
+	struct bench_req req;
+
+	for (;;) {
+		k_msgq_get(&bench_req_q, &req, K_FOREVER);
+
+		if (req.op == CX_BENCH_OP_START_BULK) {
+			bulk_send(req.conn, &req.start);
+		} else {
+			ping_run(req.conn, &req.start);
+		}
+
+		bt_conn_unref(req.conn);
+	}
+}
+
+K_THREAD_DEFINE(bench_tid, 1024, bench_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+static void bulk_recv(struct bt_conn *conn, const struct cx_bench_hdr *hdr,
+		      uint16_t len)
+{
+	uint32_t now = k_cycle_get_32();
+
+	if (!hdr->seq) {
+		memset(&bulk_rx, 0, sizeof(bulk_rx));
+		bulk_rx.first = now;
+	} else if (hdr->seq != bulk_rx.next_seq) {
+		bulk_rx.report.lost += (uint16_t)(hdr->seq - bulk_rx.next_seq);
+	}
+
+	bulk_rx.next_seq = hdr->seq + 1;
+	bulk_rx.last = now;
+	bulk_rx.report.msgs++;
+	bulk_rx.report.bytes += len;
+}
+
+static void bulk_end(struct bt_conn *conn, const struct cx_bench_hdr *hdr)
+{
+	struct cx_bench_report *report = &bulk_rx.report;
+	int err;
+
+	report->lost += (uint16_t)(hdr->seq - bulk_rx.next_seq);
+	report->elapsed_us = k_cyc_to_us_floor32(bulk_rx.last - bulk_rx.first);
+
+	err = send_report(conn, report);
+	if (err) {
+		LOG_WRN("Bulk report not sent (err %d)", err);
+	}
+}
+
+void bench_recv(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+	const struct cx_bench_hdr *hdr = (const struct cx_bench_hdr *)data;
+	struct bench_req req;
+	uint8_t pong[sizeof(*hdr)];
+	int err;
+
+	if (len < sizeof(*hdr)) {
+		LOG_WRN("Runt benchmark message (%u bytes)", len);
+		return;
+	}
+
+	switch (hdr->op) {
+	case CX_BENCH_OP_PING:
+		memcpy(pong, hdr, sizeof(pong));
+		pong[0] = CX_BENCH_OP_PONG;
+		err = bt_cx_endpoint_send(conn, pong, sizeof(pong));
+		if (err) {
+			LOG_WRN("Pong %u not sent (err %d)", hdr->seq, err);
+		}
+		break;
+	case CX_BENCH_OP_PONG:
+		if (hdr->seq == ping_seq) {
+			cx_bench_rtt_add(&rtt, hdr);
+			k_sem_give(&pong_sem);
+		}
+		break;
+	case CX_BENCH_OP_BULK:
+		bulk_recv(conn, hdr, len);
+		break;
+	case CX_BENCH_OP_BULK_END:
+		bulk_end(conn, hdr);
+		break;
+	case CX_BENCH_OP_START_BULK:
+	case CX_BENCH_OP_START_PING:
+		if (len < sizeof(*hdr) + sizeof(req.start)) {
+			break;
+		}
+
+		req.op = hdr->op;
+		memcpy(&req.start, &data[sizeof(*hdr)], sizeof(req.start));
+		req.conn = bt_conn_ref(conn);
+		if (k_msgq_put(&bench_req_q, &req, K_NO_WAIT)) {
+			LOG_WRN("Benchmark busy, request dropped");
+			bt_conn_unref(req.conn);
+		}
+		break;
+	default:
+		LOG_WRN("Unknown benchmark op 0x%02x", hdr->op);
+		break;
+	}
+}
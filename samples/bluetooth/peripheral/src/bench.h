@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+/** @brief Handle a benchmark message received from a central. */
+void bench_recv(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+#endif /* BENCH_H_ */
@@ -21,12 +21,15 @@
 #include <bluetooth/uuid.h>
 #include <bluetooth/gatt.h>
 
+#include <bluetooth/cx_link.h>
 #include <bluetooth/services/cx_endpoint.h>
 
 #include <settings/settings.h>
 
 #include <dk_buttons_and_leds.h>
 
+#include "bench.h"
+
 #define DEVICE_NAME             CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN         (sizeof(DEVICE_NAME) - 1)
 
@@ -40,6 +43,10 @@
 #define USER_BUTTON             DK_BTN1_MSK
 
 static bool app_button_state;
+static uint8_t conn_count;
+
+static void adv_restart_work_handler(struct k_work *work);
+static K_WORK_DEFINE(adv_restart_work, adv_restart_work_handler);
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -52,23 +59,59 @@ static const struct bt_data sd[] = {
 
 LOG_MODULE_REGISTER(app, CONFIG_LOG_DEFAULT_LEVEL);
 
+static int adv_start(void)
+{
+	return bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
+			       sd, ARRAY_SIZE(sd));
+}
+
+static void adv_restart_work_handler(struct k_work *work)
+{
+	int err;
+
+	if (conn_count >= CONFIG_BT_MAX_CONN) {
+		return;
+	}
+
+	err = adv_start();
+	if (err && (err != -EALREADY)) {
+		LOG_INF("Advertising failed to restart (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Advertising for more centrals (%u/%u connected)",
+		conn_count, CONFIG_BT_MAX_CONN);
+}
+
 static void connected(struct bt_conn *conn, uint8_t err)
 {
 	if (err) {
 		LOG_INF("Connection failed (err %u)", err);
+		k_work_submit(&adv_restart_work);
 		return;
 	}
 
-	LOG_INF("Connected");
+	conn_count++;
+	LOG_INF("Connected (%u active)", conn_count);
 
-	dk_set_led_on(CON_STATUS_LED);
+	if (IS_ENABLED(CONFIG_DK_LIBRARY)) {
+		dk_set_led_on(CON_STATUS_LED);
+	}
+
+	/* Advertising stops on connection, keep accepting further links. */
+	k_work_submit(&adv_restart_work);
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
-	LOG_INF("Disconnected (reason %u)", reason);
+	conn_count--;
+	LOG_INF("Disconnected (reason %u, %u active)", reason, conn_count);
 
-	dk_set_led_off(CON_STATUS_LED);
+	if (IS_ENABLED(CONFIG_DK_LIBRARY) && !conn_count) {
+		dk_set_led_off(CON_STATUS_LED);
+	}
+
+	k_work_submit(&adv_restart_work);
 }
 
 static struct bt_conn_cb conn_callbacks = {
@@ -78,13 +121,30 @@ static struct bt_conn_cb conn_callbacks = {
 
 static struct bt_conn_auth_cb conn_auth_callbacks;
 
-static void recv_data_cb(const uint8_t *data, uint16_t len)
+static void link_tuned(struct bt_conn *conn, const struct bt_cx_link_info *info,
+		       int err)
+{
+	LOG_INF("Link tuned: MTU %u, interval %u, data len %u (err %d)",
+		info->mtu, info->interval, info->tx_max_len, err);
+}
+
+static struct bt_cx_link_cb link_callbacks = {
+	.tuned = link_tuned,
+};
+
+static void recv_data_cb(struct bt_conn *conn, const uint8_t *data, uint16_t len)
 {
 	int err;
+
+	if (IS_ENABLED(CONFIG_APP_BENCH)) {
+		bench_recv(conn, data, len);
+		return;
+	}
+
 	LOG_INF("received data - Len: %d",len);
 	LOG_HEXDUMP_INF(data,len,"recvd_data");
 
-	err = bt_cx_endpoint_send_data(data,len);
+	err = bt_cx_endpoint_send(conn,data,len);
 	LOG_INF("Sending back the info - Result: %d",err);
 
 	dk_set_led(USER_LED, data[0]);
@@ -121,16 +181,21 @@ void main(void)
 
 	LOG_INF("Starting Bluetooth Peripheral CX_ENDPOINT example");
 
-	err = dk_leds_init();
-	if (err) {
-		LOG_INF("LEDs init failed (err %d)", err);
-		return;
-	}
-
-	err = init_button();
-	if (err) {
-		LOG_INF("Button init failed (err %d)", err);
-		return;
+	/* Benchmark builds for simulated boards run without LEDs and
+	 * buttons.
+	 */
+	if (IS_ENABLED(CONFIG_DK_LIBRARY)) {
+		err = dk_leds_init();
+		if (err) {
+			LOG_INF("LEDs init failed (err %d)", err);
+			return;
+		}
+
+		err = init_button();
+		if (err) {
+			LOG_INF("Button init failed (err %d)", err);
+			return;
+		}
 	}
 
 	bt_conn_cb_register(&conn_callbacks);
@@ -150,14 +215,19 @@ void main(void)
 		settings_load();
 	}
 
+	err = bt_cx_link_init(&link_callbacks);
+	if (err) {
+		LOG_INF("Failed to init link tuning (err %d)", err);
+		return;
+	}
+
 	err = bt_cx_endpoint_init(&cx_endpoint_callbacs);
 	if (err) {
 		LOG_INF("Failed to init CX_ENDPOINT (err:%d)", err);
 		return;
 	}
 
-	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
-			      sd, ARRAY_SIZE(sd));
+	err = adv_start();
 	if (err) {
 		LOG_INF("Advertising failed to start (err %d)", err);
 		return;
@@ -165,6 +235,10 @@ void main(void)
 
 	LOG_INF("Advertising successfully started");
 
+	if (!IS_ENABLED(CONFIG_DK_LIBRARY)) {
+		return;
+	}
+
 	for (;;) {
 		dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
 		k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
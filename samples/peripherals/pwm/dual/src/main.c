@@ -3,7 +3,7 @@
 #include <drivers/pwm_dual.h>
 #include <device.h>
 
-const char * pwm_name = "PWM_0";
+const char * pwm_name = "HBRIDGE";
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(app, CONFIG_LOG_DEFAULT_LEVEL);
@@ -35,25 +35,16 @@ void main(void)
         return;
 
 	while (1) {
-		struct pwm_dual_duty_cycle duty_cycle = {
-			.period = PERIOD_USEC,
-			.ch0 = {
-				.pin = 24,
-				.pulse = 0,
-			},
-			.ch1 = {
-				.pin = 44,
-				.pulse = 0,
-			},
-		};
+		uint32_t pulses[2] = { 0 };
+
 		if(direction_fwd){
-			duty_cycle.ch0.pulse = pulse_width;
+			pulses[0] = pulse_width;
 		}
 		else{
-			duty_cycle.ch1.pulse = pulse_width;
+			pulses[1] = pulse_width;
 		}
 		LOG_INF("Setting - dir: %s, pulse_width: %d",dir?"y":"n",pulse_width);
-		err = pwm_dual_set_usec(pwm,&duty_cycle);
+		err = pwm_dual_set_usec(pwm, PERIOD_USEC, pulses);
 		// err = pwm_pin_set_usec(pwm, PWM_CHANNEL, PERIOD_USEC,
 		// 		       pulse_width, PWM_FLAGS);
 		if (err) {
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX link tuning
+ *
+ * Runs a fixed sequence of link layer and ATT procedures on every new
+ * connection, one at a time: PHY update, data length update, ATT MTU
+ * exchange and connection parameter update. Each step waits for its
+ * completion event, or for a timeout when the peer does not answer,
+ * before the next one starts.
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+
+#include <bluetooth/cx_link.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(bt_cx_link, CONFIG_BT_CX_LINK_LOG_LEVEL);
+
+#define START_DELAY	K_MSEC(CONFIG_BT_CX_LINK_START_DELAY_MS)
+#define STEP_TIMEOUT	K_MSEC(CONFIG_BT_CX_LINK_STEP_TIMEOUT_MS)
+
+#if defined(CONFIG_BT_CX_LINK_PROFILE_THROUGHPUT)
+#define DEFAULT_PROFILE	BT_CX_LINK_PROFILE_THROUGHPUT
+#elif defined(CONFIG_BT_CX_LINK_PROFILE_LOW_POWER)
+#define DEFAULT_PROFILE	BT_CX_LINK_PROFILE_LOW_POWER
+#elif defined(CONFIG_BT_CX_LINK_PROFILE_NONE)
+#define DEFAULT_PROFILE	BT_CX_LINK_PROFILE_NONE
+#else
+#define DEFAULT_PROFILE	BT_CX_LINK_PROFILE_LOW_LATENCY
+#endif
+
+enum link_step {
+	STEP_PHY,
+	STEP_DATA_LEN,
+	STEP_MTU,
+	STEP_CONN_PARAM,
+	STEP_REPORT,
+	STEP_IDLE,
+};
+
+struct link_ctx {
+	struct bt_conn *conn;
+	struct k_delayed_work work;
+#if defined(CONFIG_BT_CX_LINK_MTU_EXCHANGE)
+	struct bt_gatt_exchange_params mtu_params;
+#endif
+	enum bt_cx_link_profile profile;
+	/* Next step to start. */
+	enum link_step step;
+	/* Waiting for the completion of the previous step. */
+	bool waiting;
+	/* Profile changed while a step was in flight. */
+	bool restart;
+	int err;
+	/* Incremented on disconnection, so that a sequence still running for
+	 * the link stops.
+	 */
+	uint32_t gen;
+};
+
+/* Interval in units of 1.25 ms, supervision timeout in units of 10 ms. */
+static const struct bt_le_conn_param profile_param[] = {
+	[BT_CX_LINK_PROFILE_LOW_LATENCY] = BT_LE_CONN_PARAM_INIT(6, 6, 0, 400),
+	[BT_CX_LINK_PROFILE_THROUGHPUT] = BT_LE_CONN_PARAM_INIT(40, 80, 0, 400),
+	[BT_CX_LINK_PROFILE_LOW_POWER] = BT_LE_CONN_PARAM_INIT(80, 160, 4, 600),
+};
+
+static struct link_ctx link_ctx[CONFIG_BT_MAX_CONN];
+static const struct bt_cx_link_cb *link_cb;
+
+/* Guards the sequence state, shared by the host callbacks and the work
+ * handler. Never held across host calls.
+ */
+static struct k_spinlock lock;
+
+/* Context of a connected link, lock held. */
+static struct link_ctx *ctx_get(struct bt_conn *conn)
+{
+	struct link_ctx *ctx = &link_ctx[bt_conn_index(conn)];
+
+	return (ctx->conn == conn) ? ctx : NULL;
+}
+
+/* Resume the sequence once the step started last has completed. */
+static void step_done(struct bt_conn *conn, enum link_step step, int err)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_ctx *ctx = ctx_get(conn);
+
+	if (!ctx || !ctx->waiting || (ctx->step != (step + 1))) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	if (err) {
+		ctx->err = err;
+	}
+
+	ctx->waiting = false;
+	k_delayed_work_submit(&ctx->work, K_NO_WAIT);
+	k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_BT_CX_LINK_MTU_EXCHANGE)
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	LOG_DBG("MTU exchange %s, MTU %u", err ? "failed" : "done",
+		bt_gatt_get_mtu(conn));
+
+	step_done(conn, STEP_MTU, err ? -EIO : 0);
+}
+#endif
+
+static bool conn_param_needed(struct bt_conn *conn,
+			      enum bt_cx_link_profile profile)
+{
+	const struct bt_le_conn_param *param;
+	struct bt_conn_info info;
+
+	if (profile == BT_CX_LINK_PROFILE_NONE) {
+		return false;
+	}
+
+	if (bt_conn_get_info(conn, &info)) {
+		return true;
+	}
+
+	param = &profile_param[profile];
+
+	return (info.le.interval < param->interval_min) ||
+	       (info.le.interval > param->interval_max) ||
+	       (info.le.latency != param->latency) ||
+	       (info.le.timeout != param->timeout);
+}
+
+#if defined(CONFIG_BT_CX_LINK_DATA_LEN)
+/* A data length the link already uses raises no update event. */
+static bool data_len_needed(struct bt_conn *conn)
+{
+	struct bt_conn_info info;
+
+	if (bt_conn_get_info(conn, &info) || !info.le.data_len) {
+		return true;
+	}
+
+	return (info.le.data_len->tx_max_len < BT_GAP_DATA_LEN_MAX) ||
+	       (info.le.data_len->tx_max_time < BT_GAP_DATA_TIME_MAX);
+}
+#endif
+
+/* Start a step. Returns 0 with *wait set if a completion is expected. */
+static int step_start(struct link_ctx *ctx, struct bt_conn *conn,
+		      enum bt_cx_link_profile profile, enum link_step step,
+		      bool *wait)
+{
+	*wait = false;
+
+	switch (step) {
+	case STEP_PHY:
+#if defined(CONFIG_BT_CX_LINK_PHY_2M)
+		*wait = true;
+		return bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+#else
+		return 0;
+#endif
+	case STEP_DATA_LEN:
+#if defined(CONFIG_BT_CX_LINK_DATA_LEN)
+		if (!data_len_needed(conn)) {
+			return 0;
+		}
+
+		*wait = true;
+		return bt_conn_le_data_len_update(conn,
+						  BT_LE_DATA_LEN_PARAM_MAX);
+#else
+		return 0;
+#endif
+	case STEP_MTU:
+#if defined(CONFIG_BT_CX_LINK_MTU_EXCHANGE)
+		ctx->mtu_params.func = mtu_exchanged;
+		*wait = true;
+		return bt_gatt_exchange_mtu(conn, &ctx->mtu_params);
+#else
+		return 0;
+#endif
+	case STEP_CONN_PARAM:
+		if (!conn_param_needed(conn, profile)) {
+			return 0;
+		}
+
+		*wait = true;
+		return bt_conn_le_param_update(conn, &profile_param[profile]);
+	default:
+		return 0;
+	}
+}
+
+/* Whether the link already has what a step asks for, for steps whose
+ * completion event is not raised when nothing changes.
+ */
+static bool step_met(struct bt_conn *conn, enum bt_cx_link_profile profile,
+		     enum link_step step)
+{
+	switch (step) {
+#if defined(CONFIG_BT_CX_LINK_DATA_LEN)
+	case STEP_DATA_LEN:
+		return !data_len_needed(conn);
+#endif
+	case STEP_CONN_PARAM:
+		return !conn_param_needed(conn, profile);
+	default:
+		return false;
+	}
+}
+
+static void report(struct bt_conn *conn, enum bt_cx_link_profile profile,
+		   int err)
+{
+	struct bt_cx_link_info info = {
+		.mtu = bt_gatt_get_mtu(conn),
+		.profile = profile,
+	};
+	struct bt_conn_info conn_info;
+
+	if (!bt_conn_get_info(conn, &conn_info)) {
+		info.interval = conn_info.le.interval;
+		info.latency = conn_info.le.latency;
+		info.timeout = conn_info.le.timeout;
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+		if (conn_info.le.phy) {
+			info.tx_phy = conn_info.le.phy->tx_phy;
+			info.rx_phy = conn_info.le.phy->rx_phy;
+		}
+#endif
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+		if (conn_info.le.data_len) {
+			info.tx_max_len = conn_info.le.data_len->tx_max_len;
+			info.rx_max_len = conn_info.le.data_len->rx_max_len;
+		}
+#endif
+	}
+
+	LOG_INF("Link %u tuned: phy %u/%u, data len %u/%u, MTU %u, "
+		"interval %u, latency %u (err %d)", bt_conn_index(conn),
+		info.tx_phy, info.rx_phy, info.tx_max_len, info.rx_max_len,
+		info.mtu, info.interval, info.latency, err);
+
+	if (link_cb && link_cb->tuned) {
+		link_cb->tuned(conn, &info, err);
+	}
+}
+
+/* Runs the steps with the lock released around host calls, stopping as
+ * soon as the link generation changes.
+ */
+static void tune_work_handler(struct k_work *work)
+{
+	struct link_ctx *ctx = CONTAINER_OF(work, struct link_ctx, work);
+	enum bt_cx_link_profile profile;
+	struct bt_conn *conn;
+	k_spinlock_key_t key;
+	enum link_step step;
+	bool timed_out;
+	bool done;
+	uint32_t gen;
+	bool wait;
+	int err;
+
+	key = k_spin_lock(&lock);
+	if (!ctx->conn) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	/* The link may go away while a step starts, the reference keeps
+	 * the connection object valid until the handler returns.
+	 */
+	conn = bt_conn_ref(ctx->conn);
+	gen = ctx->gen;
+	profile = ctx->profile;
+	step = ctx->step;
+	timed_out = ctx->waiting;
+	ctx->waiting = false;
+	k_spin_unlock(&lock, key);
+
+	if (timed_out) {
+		if (step_met(conn, profile, step - 1)) {
+			LOG_DBG("Link %u step %u already met",
+				bt_conn_index(conn), step - 1);
+		} else {
+			LOG_WRN("Link %u step %u timed out",
+				bt_conn_index(conn), step - 1);
+			key = k_spin_lock(&lock);
+			ctx->err = -ETIMEDOUT;
+			k_spin_unlock(&lock, key);
+		}
+	}
+
+	for (;;) {
+		key = k_spin_lock(&lock);
+		if (ctx->gen != gen) {
+			k_spin_unlock(&lock, key);
+			break;
+		}
+
+		/* Apply a profile changed while the previous step was in
+		 * flight.
+		 */
+		if (ctx->restart) {
+			ctx->restart = false;
+			ctx->step = STEP_CONN_PARAM;
+			ctx->err = 0;
+		}
+
+		if (ctx->step >= STEP_REPORT) {
+			done = (ctx->step == STEP_REPORT);
+			ctx->step = STEP_IDLE;
+			profile = ctx->profile;
+			err = ctx->err;
+			k_spin_unlock(&lock, key);
+
+			if (done) {
+				report(conn, profile, err);
+			}
+			break;
+		}
+
+		step = ctx->step++;
+		profile = ctx->profile;
+
+		/* Completions may arrive before the request call returns. */
+		ctx->waiting = true;
+		k_spin_unlock(&lock, key);
+
+		err = step_start(ctx, conn, profile, step, &wait);
+
+		key = k_spin_lock(&lock);
+		if (ctx->gen != gen) {
+			k_spin_unlock(&lock, key);
+			break;
+		}
+
+		if (!err && wait) {
+			if (ctx->waiting) {
+				k_delayed_work_submit(&ctx->work, STEP_TIMEOUT);
+				k_spin_unlock(&lock, key);
+				break;
+			}
+
+			k_spin_unlock(&lock, key);
+			continue;
+		}
+
+		ctx->waiting = false;
+		if (err) {
+			ctx->err = err;
+		}
+		k_spin_unlock(&lock, key);
+
+		if (err) {
+			LOG_WRN("Link %u step %u failed (err %d)",
+				bt_conn_index(conn), step, err);
+		}
+	}
+
+	bt_conn_unref(conn);
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	struct link_ctx *ctx;
+	k_spinlock_key_t key;
+
+	if (err) {
+		return;
+	}
+
+	ctx = &link_ctx[bt_conn_index(conn)];
+
+	key = k_spin_lock(&lock);
+	ctx->conn = bt_conn_ref(conn);
+	ctx->profile = DEFAULT_PROFILE;
+	ctx->step = STEP_PHY;
+	ctx->waiting = false;
+	ctx->restart = false;
+	ctx->err = 0;
+	k_spin_unlock(&lock, key);
+
+	k_delayed_work_submit(&ctx->work, START_DELAY);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_ctx *ctx = ctx_get(conn);
+
+	if (!ctx) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	/* A handler already running holds its own reference and stops at
+	 * its next check of the generation.
+	 */
+	ctx->conn = NULL;
+	ctx->gen++;
+	ctx->waiting = false;
+	k_spin_unlock(&lock, key);
+
+	k_delayed_work_cancel(&ctx->work);
+	bt_conn_unref(conn);
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+			     uint16_t latency, uint16_t timeout)
+{
+	LOG_DBG("Connection parameters: interval %u, latency %u, timeout %u",
+		interval, latency, timeout);
+
+	step_done(conn, STEP_CONN_PARAM, 0);
+}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+static void le_phy_updated(struct bt_conn *conn,
+			   struct bt_conn_le_phy_info *param)
+{
+	LOG_DBG("PHY updated: tx %u, rx %u", param->tx_phy, param->rx_phy);
+
+	step_done(conn, STEP_PHY, 0);
+}
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+static void le_data_len_updated(struct bt_conn *conn,
+				struct bt_conn_le_data_len_info *info)
+{
+	LOG_DBG("Data length updated: tx %u, rx %u", info->tx_max_len,
+		info->rx_max_len);
+
+	step_done(conn, STEP_DATA_LEN, 0);
+}
+#endif
+
+static struct bt_conn_cb conn_callbacks = {
+	.connected = connected,
+	.disconnected = disconnected,
+	.le_param_updated = le_param_updated,
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+	.le_phy_updated = le_phy_updated,
+#endif
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+	.le_data_len_updated = le_data_len_updated,
+#endif
+};
+
+int bt_cx_link_init(const struct bt_cx_link_cb *cb)
+{
+	static bool registered;
+
+	link_cb = cb;
+
+	if (registered) {
+		return 0;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(link_ctx); i++) {
+		k_delayed_work_init(&link_ctx[i].work, tune_work_handler);
+	}
+
+	bt_conn_cb_register(&conn_callbacks);
+	registered = true;
+
+	return 0;
+}
+
+int bt_cx_link_profile_set(struct bt_conn *conn,
+			   enum bt_cx_link_profile profile)
+{
+	k_spinlock_key_t key;
+	struct link_ctx *ctx;
+
+	if (profile > BT_CX_LINK_PROFILE_LOW_POWER) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&lock);
+	ctx = ctx_get(conn);
+	if (!ctx) {
+		k_spin_unlock(&lock, key);
+		return -EINVAL;
+	}
+
+	ctx->profile = profile;
+
+	/* A sequence still running picks the profile up by itself. A request
+	 * in flight is left to complete, the sequence restarts after it.
+	 */
+	if (ctx->step <= STEP_CONN_PARAM) {
+		k_spin_unlock(&lock, key);
+		return 0;
+	}
+
+	if (ctx->waiting) {
+		ctx->restart = true;
+		k_spin_unlock(&lock, key);
+		return 0;
+	}
+
+	ctx->step = STEP_CONN_PARAM;
+	ctx->err = 0;
+	k_delayed_work_submit(&ctx->work, K_NO_WAIT);
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
@@ -21,35 +21,686 @@
 #include <bluetooth/conn.h>
 #include <bluetooth/uuid.h>
 #include <bluetooth/gatt.h>
+#include <bluetooth/l2cap.h>
+#include <net/buf.h>
+#include <sys/ring_buffer.h>
 
 #include <bluetooth/services/cx_endpoint.h>
+#include <bluetooth/services/cx_endpoint_frame.h>
+#include <bluetooth/services/cx_endpoint_chan.h>
+#include <bluetooth/services/cx_endpoint_comp.h>
+
+#include "cx_endpoint_stats.h"
 
 #include <logging/log.h>
 
 LOG_MODULE_REGISTER(bt_cx_endpoint, CONFIG_BT_CX_ENDPOINT_LOG_LEVEL);
 
-static bool                   		notify_enabled;
+#define TX_QUEUE_LEN	CONFIG_BT_CX_ENDPOINT_TX_QUEUE_LEN
+#define TX_WINDOW	CONFIG_BT_CX_ENDPOINT_TX_WINDOW
+
+/* Every in-flight notification carries a segment or one or more coalesced
+ * messages, each tracked by its own entry. Up to 510 entries, so the ring is
+ * indexed with 16 bits.
+ */
+#define TX_INFLIGHT_LEN	(TX_QUEUE_LEN + TX_WINDOW)
+
+/* Time to wait before retrying when the host ran out of buffers and this
+ * link has no notification in flight whose completion would restart it.
+ */
+#define TX_RETRY_DELAY	K_MSEC(CONFIG_BT_CX_ENDPOINT_TX_RETRY_MS)
+
+/* Largest notification payload the host can be asked to send. */
+#define TX_PDU_MAX	(CONFIG_BT_L2CAP_TX_MTU - 3)
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COALESCE)
+#define COALESCE_LATENCY_MS	CONFIG_BT_CX_ENDPOINT_COALESCE_LATENCY_MS
+#else
+#define COALESCE_LATENCY_MS	0
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+#define CHAN_HDR_LEN	BT_CX_ENDPOINT_CHAN_HDR_LEN
+#else
+#define CHAN_HDR_LEN	0
+#endif
+
+/* Channel of a message from its channel header. */
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+#define CHAN_ID(hdr)	((hdr) & BT_CX_ENDPOINT_CHAN_ID_MASK)
+#else
+#define CHAN_ID(hdr)	(hdr)
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+#define RECV_PERM	(BT_GATT_PERM_WRITE | BT_GATT_PERM_PREPARE_WRITE)
+#else
+#define RECV_PERM	BT_GATT_PERM_WRITE
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+static void tx_buf_destroy(struct net_buf *buf);
+
+/* A compressed copy keeps the original message in its user data. */
+NET_BUF_POOL_DEFINE(cx_endpoint_tx_pool, CONFIG_BT_CX_ENDPOINT_TX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_TX_BUF_SIZE, sizeof(struct net_buf *),
+		    tx_buf_destroy);
+#else
+NET_BUF_POOL_DEFINE(cx_endpoint_tx_pool, CONFIG_BT_CX_ENDPOINT_TX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_TX_BUF_SIZE, 0, NULL);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+/* Link a received SDU belongs to, for deferred delivery. */
+struct l2cap_rx_meta {
+	uint8_t conn_index;
+	uint8_t gen;
+};
+
+/* Queued messages are shared between links and kept until completion, the
+ * host gets a copy it can consume.
+ */
+NET_BUF_POOL_DEFINE(cx_endpoint_l2cap_tx_pool,
+		    CONFIG_BT_CX_ENDPOINT_L2CAP_TX_BUF_COUNT,
+		    BT_L2CAP_BUF_SIZE(CONFIG_BT_CX_ENDPOINT_TX_BUF_SIZE), 0, NULL);
+NET_BUF_POOL_DEFINE(cx_endpoint_l2cap_rx_pool,
+		    CONFIG_BT_CX_ENDPOINT_L2CAP_RX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_L2CAP_MTU,
+		    sizeof(struct l2cap_rx_meta), NULL);
+#endif
+
+/* Per-connection endpoint state, indexed by bt_conn_index(). */
+struct cx_endpoint_conn_ctx {
+	struct bt_conn *conn;
+	uint16_t ccc_value;
+	uint16_t mtu;
+
+	/* Buffers waiting to be handed over to the host, with the time they
+	 * were queued at.
+	 */
+	struct net_buf *tx_queue[TX_QUEUE_LEN];
+	uint32_t tx_stamp[TX_QUEUE_LEN];
+	uint8_t tx_head;
+	uint8_t tx_count;
+
+	/* Bytes of the queue head already handed over to the host. */
+	uint16_t tx_offset;
+	struct bt_cx_endpoint_frame_tx frame_tx;
+	struct bt_cx_endpoint_chan_sched sched;
+
+	/* Messages and segments handed over to the host, completed in order.
+	 * pdu_end marks the last entry carried by a notification.
+	 */
+	struct {
+		struct net_buf *buf;
+		uint32_t stamp;
+		bool last;
+		bool pdu_end;
+	} tx_inflight[TX_INFLIGHT_LEN];
+	uint16_t inflight_head;
+	uint16_t inflight_count;
+	uint8_t inflight_pdus;
+
+	struct k_delayed_work tx_work;
+
+	/* Incremented on every new link, tags deferred writes. */
+	uint8_t gen;
+
+	/* Length of the attribute value written so far, for long writes. */
+	uint16_t rx_value_len;
+	struct bt_cx_endpoint_frame_rx frame_rx;
+
+	/* Link generation frame_rx belongs to, on the RX work queue. */
+	uint8_t frame_rx_gen;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+	/* Writes of the link put into the RX ring and taken out of it. */
+	uint16_t rx_queued;
+	atomic_t rx_consumed;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	/* Set by the client through the Framing Characteristic. */
+	bool framing;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	/* Codecs the peer decodes, as written to the Compression
+	 * Characteristic.
+	 */
+	uint8_t comp;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	/* Bulk channel, carrying every message once connected. */
+	struct bt_l2cap_le_chan l2cap;
+	bool l2cap_ready;
+
+	/* Transport of the messages in flight. */
+	bool tx_l2cap;
+#endif
+};
+
+static struct cx_endpoint_conn_ctx	conn_ctx[CONFIG_BT_MAX_CONN];
 static struct bt_cx_endpoint_cb 	cx_endpoint_cb;
+static struct k_spinlock		tx_lock;
+static uint8_t				tx_pdu[TX_PDU_MAX];
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+static struct bt_cx_endpoint_chan *chans[BT_CX_ENDPOINT_CHAN_COUNT];
+static struct bt_cx_endpoint_chan_param chan_param[BT_CX_ENDPOINT_CHAN_COUNT];
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+/* Messages are received from a single context, the BT RX thread or the
+ * RX work queue.
+ */
+static uint8_t comp_rx[CONFIG_BT_CX_ENDPOINT_COMP_MAX_LEN];
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+/* Field order is the value layout of the Stats Characteristic. */
+STATS_SECT_START(cx_endpoint)
+STATS_SECT_ENTRY32(rx_msgs)
+STATS_SECT_ENTRY32(rx_bytes)
+STATS_SECT_ENTRY32(rx_errors)
+STATS_SECT_ENTRY32(tx_msgs)
+STATS_SECT_ENTRY32(tx_bytes)
+STATS_SECT_ENTRY32(tx_pdus)
+STATS_SECT_ENTRY32(tx_errors)
+STATS_SECT_ENTRY32(err_nomem)
+STATS_SECT_ENTRY32(err_eacces)
+STATS_SECT_ENTRY32(queue_hwm)
+STATS_SECT_ENTRY32(inflight_hwm)
+CX_STATS_SECT_LAT(tx_lat)
+STATS_SECT_END;
+
+STATS_NAME_START(cx_endpoint)
+STATS_NAME(cx_endpoint, rx_msgs)
+STATS_NAME(cx_endpoint, rx_bytes)
+STATS_NAME(cx_endpoint, rx_errors)
+STATS_NAME(cx_endpoint, tx_msgs)
+STATS_NAME(cx_endpoint, tx_bytes)
+STATS_NAME(cx_endpoint, tx_pdus)
+STATS_NAME(cx_endpoint, tx_errors)
+STATS_NAME(cx_endpoint, err_nomem)
+STATS_NAME(cx_endpoint, err_eacces)
+STATS_NAME(cx_endpoint, queue_hwm)
+STATS_NAME(cx_endpoint, inflight_hwm)
+CX_STATS_NAME_LAT(cx_endpoint, tx_lat)
+STATS_NAME_END(cx_endpoint);
+
+static STATS_SECT_DECL(cx_endpoint) cx_endpoint_stats;
+
+BUILD_ASSERT((offsetof(STATS_SECT_DECL(cx_endpoint), tx_lat_lt1ms) ==
+	      (sizeof(struct stats_hdr) +
+	       BT_CX_ENDPOINT_STAT_TX_LAT * sizeof(uint32_t))) &&
+	     (offsetof(STATS_SECT_DECL(cx_endpoint), tx_lat_ge256ms) ==
+	      (sizeof(struct stats_hdr) +
+	       (BT_CX_ENDPOINT_STAT_COUNT - 1) * sizeof(uint32_t))),
+	     "Stats out of sync with enum bt_cx_endpoint_stat");
+#endif
+
+static struct cx_endpoint_conn_ctx *ctx_get(struct bt_conn *conn)
+{
+	struct cx_endpoint_conn_ctx *ctx = &conn_ctx[bt_conn_index(conn)];
+
+	return (ctx->conn == conn) ? ctx : NULL;
+}
 
 static void cx_endpointlc_ccc_cfg_changed(const struct bt_gatt_attr *attr,
 				  uint16_t value)
 {
-	notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	LOG_DBG("CCC aggregate value changed: %u", value);
+}
+
+static ssize_t cx_endpointlc_ccc_cfg_write(struct bt_conn *conn,
+				   const struct bt_gatt_attr *attr,
+				   uint16_t value)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+
+	if (ctx) {
+		ctx->ccc_value = value;
+		LOG_DBG("CCC written, conn: %p value: %u", conn, value);
+	}
+
+	return sizeof(value);
+}
+
+static struct _bt_gatt_ccc cx_endpoint_ccc = BT_GATT_CCC_INITIALIZER(
+	cx_endpointlc_ccc_cfg_changed, cx_endpointlc_ccc_cfg_write, NULL);
+
+static void frame_received(const uint8_t *data, uint16_t len, void *user_data)
+{
+	struct cx_endpoint_conn_ctx *ctx = user_data;
+	void (*recv_cb)(struct bt_conn *conn, const uint8_t *data,
+			uint16_t len) = cx_endpoint_cb.recv_cb;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+	uint8_t hdr = len ? data[0] : BT_CX_ENDPOINT_CHAN_COUNT;
+	uint8_t id = CHAN_ID(hdr);
+
+	if ((id >= BT_CX_ENDPOINT_CHAN_COUNT) ||
+	    (!chans[id] && (id != BT_CX_ENDPOINT_CHAN_DEFAULT))) {
+		CX_STATS_INC(cx_endpoint_stats, rx_errors);
+		LOG_WRN("Message on unknown channel %u dropped", id);
+		return;
+	}
+
+	if (chans[id]) {
+		recv_cb = chans[id]->recv_cb;
+	}
+
+	data += CHAN_HDR_LEN;
+	len -= CHAN_HDR_LEN;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	if (hdr & BT_CX_ENDPOINT_CHAN_COMPRESSED) {
+		int ret = bt_cx_endpoint_comp_decode(data, len, comp_rx,
+						     sizeof(comp_rx));
+
+		if (ret < 0) {
+			CX_STATS_INC(cx_endpoint_stats, rx_errors);
+			LOG_WRN("Compressed message dropped (err %d)", ret);
+			return;
+		}
+
+		data = comp_rx;
+		len = ret;
+	}
+#endif
+#endif
+
+	CX_STATS_INC(cx_endpoint_stats, rx_msgs);
+	CX_STATS_INCN(cx_endpoint_stats, rx_bytes, len);
+
+	if (recv_cb) {
+		recv_cb(ctx->conn, data, len);
+	}
+}
+
+/* Whether the client of the link turned framing on. */
+static bool ctx_framing(const struct cx_endpoint_conn_ctx *ctx)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	return ctx->framing;
+#else
+	return false;
+#endif
+}
+
+/* Hand one write to the application, through the reassembler if the link is
+ * framed. Chunks of a long write past the first one carry no header and
+ * continue the segment started at offset 0.
+ */
+static int rx_dispatch(struct cx_endpoint_conn_ctx *ctx, const uint8_t *data,
+		       uint16_t len, bool framed, bool append)
+{
+	if (!IS_ENABLED(CONFIG_BT_CX_ENDPOINT_FRAMING) || !framed) {
+		frame_received(data, len, ctx);
+		return 0;
+	}
+
+	if (append) {
+		return bt_cx_endpoint_frame_append(&ctx->frame_rx, data, len,
+						   frame_received, ctx);
+	}
+
+	return bt_cx_endpoint_frame_feed(&ctx->frame_rx, data, len,
+					 frame_received, ctx);
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+/* Ring buffer record header, followed by the written data. */
+struct rx_record_hdr {
+	uint8_t conn_index;
+	uint8_t gen;
+	uint8_t flags;
+	uint16_t len;
+} __packed;
+
+/* Record flags. */
+#define RX_RECORD_FRAMED	BIT(0)
+#define RX_RECORD_APPEND	BIT(1)
+
+#define RX_RECORD_MAX	(CONFIG_BT_L2CAP_RX_MTU - 3)
+
+static K_THREAD_STACK_DEFINE(rx_wq_stack, CONFIG_BT_CX_ENDPOINT_RX_WQ_STACK_SIZE);
+static struct k_work_q rx_wq;
+static uint8_t rx_pdu[RX_RECORD_MAX];
+
+/* Writes of a link the RX ring holds, each link owning an equal share. */
+#define RX_CREDITS \
+	((CONFIG_BT_CX_ENDPOINT_RX_RING_SIZE / CONFIG_BT_MAX_CONN) / \
+	 (sizeof(struct rx_record_hdr) + RX_RECORD_MAX))
+
+BUILD_ASSERT(RX_CREDITS >= 1, "RX ring cannot hold a full write per link");
+
+RING_BUF_DECLARE(rx_ring, CONFIG_BT_CX_ENDPOINT_RX_RING_SIZE);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+static K_FIFO_DEFINE(l2cap_rx_fifo);
+#endif
+
+static void rx_work_handler(struct k_work *work)
+{
+	struct cx_endpoint_conn_ctx *ctx;
+	struct rx_record_hdr hdr;
+	int err;
+
+	while (ring_buf_get(&rx_ring, (uint8_t *)&hdr, sizeof(hdr))) {
+		ring_buf_get(&rx_ring, rx_pdu, hdr.len);
+
+		ctx = &conn_ctx[hdr.conn_index];
+		if (!ctx->conn || (ctx->gen != hdr.gen)) {
+			LOG_DBG("Dropped write of a detached link");
+			continue;
+		}
+
+		/* Its room is free again, the credit goes back to the client
+		 * on its next read.
+		 */
+		atomic_inc(&ctx->rx_consumed);
+
+		if (ctx->frame_rx_gen != hdr.gen) {
+			bt_cx_endpoint_frame_rx_reset(&ctx->frame_rx);
+			ctx->frame_rx_gen = hdr.gen;
+		}
+
+		err = rx_dispatch(ctx, rx_pdu, hdr.len,
+				  hdr.flags & RX_RECORD_FRAMED,
+				  hdr.flags & RX_RECORD_APPEND);
+		if (err) {
+			CX_STATS_INC(cx_endpoint_stats, rx_errors);
+			LOG_WRN("Write dropped on link %u (err %d)",
+				hdr.conn_index, err);
+		}
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	/* After the writes, which a peer switching to the channel sent
+	 * first.
+	 */
+	struct l2cap_rx_meta *meta;
+	struct net_buf *sdu;
+
+	while ((sdu = net_buf_get(&l2cap_rx_fifo, K_NO_WAIT))) {
+		meta = net_buf_user_data(sdu);
+		ctx = &conn_ctx[meta->conn_index];
+		if (ctx->conn && (ctx->gen == meta->gen)) {
+			frame_received(sdu->data, sdu->len, ctx);
+		}
+
+		net_buf_unref(sdu);
+	}
+#endif
+
+	if (!IS_ENABLED(CONFIG_BT_CX_ENDPOINT_FRAMING)) {
+		return;
+	}
+
+	/* Release reassembly state left behind by detached links. */
+	for (int i = 0; i < ARRAY_SIZE(conn_ctx); i++) {
+		if (!conn_ctx[i].conn && conn_ctx[i].frame_rx.buf) {
+			bt_cx_endpoint_frame_rx_reset(&conn_ctx[i].frame_rx);
+		}
+	}
+}
+
+static K_WORK_DEFINE(rx_work, rx_work_handler);
+
+/* Writes of the link still in the RX ring. */
+static uint16_t rx_pending(struct cx_endpoint_conn_ctx *ctx)
+{
+	return ctx->rx_queued - (uint16_t)atomic_get(&ctx->rx_consumed);
+}
+
+static ssize_t credits_read(struct bt_conn *conn,
+			    const struct bt_gatt_attr *attr, void *buf,
+			    uint16_t len, uint16_t offset)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+	struct bt_cx_endpoint_credits value;
+
+	if (!ctx) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	/* Writes are handled in order with the read, the ones the client
+	 * sent before it are all counted.
+	 */
+	value.credits = sys_cpu_to_le16(RX_CREDITS);
+	value.pending = sys_cpu_to_le16(rx_pending(ctx));
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &value,
+				 sizeof(value));
+}
+
+static ssize_t rx_defer(struct cx_endpoint_conn_ctx *ctx, const void *buf,
+			uint16_t len, bool append, uint8_t flags)
+{
+	struct rx_record_hdr hdr = {
+		.conn_index = bt_conn_index(ctx->conn),
+		.gen = ctx->gen,
+		.flags = (ctx_framing(ctx) ? RX_RECORD_FRAMED : 0) |
+			 (append ? RX_RECORD_APPEND : 0),
+		.len = len,
+	};
+	const uint8_t *src[] = { (const uint8_t *)&hdr, buf };
+	const uint32_t src_len[] = { sizeof(hdr), len };
+	uint32_t claimed;
+	uint8_t *dst;
+
+	if (len > RX_RECORD_MAX) {
+		CX_STATS_INC(cx_endpoint_stats, rx_errors);
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	/* Clients keep their writes within the credits of the link, see
+	 * credits_read(). This runs on the host RX thread shared by every
+	 * link, so a write beyond them is dropped rather than waited for.
+	 */
+	if ((rx_pending(ctx) >= RX_CREDITS) ||
+	    (ring_buf_space_get(&rx_ring) < (sizeof(hdr) + len))) {
+		CX_STATS_INC(cx_endpoint_stats, rx_errors);
+		LOG_WRN("No RX room for the link, %s dropped",
+			(flags & BT_GATT_WRITE_FLAG_CMD) ? "command" : "write");
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+
+	/* Claim header and data before committing, so the consumer never
+	 * sees a partial record.
+	 */
+	for (int i = 0; i < ARRAY_SIZE(src); i++) {
+		uint32_t copied = 0;
+
+		while (copied < src_len[i]) {
+			claimed = ring_buf_put_claim(&rx_ring, &dst,
+						     src_len[i] - copied);
+			memcpy(dst, &src[i][copied], claimed);
+			copied += claimed;
+		}
+	}
+	ring_buf_put_finish(&rx_ring, sizeof(hdr) + len);
+	ctx->rx_queued++;
+
+	k_work_submit_to_queue(&rx_wq, &rx_work);
+
+	return len;
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_RX_DEFERRED */
+
+#if !defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+static ssize_t rx_inline(struct cx_endpoint_conn_ctx *ctx, const void *buf,
+			 uint16_t len, bool append)
+{
+	int err;
+
+	err = rx_dispatch(ctx, buf, len, ctx_framing(ctx), append);
+	if (err) {
+		CX_STATS_INC(cx_endpoint_stats, rx_errors);
+	}
+
+	switch (err) {
+	case 0:
+		return len;
+	case -ENOMEM:
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	case -EMSGSIZE:
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
 }
+#endif
 
 static ssize_t received_msg(struct bt_conn *conn,
 			 const struct bt_gatt_attr *attr,
 			 const void *buf,
 			 uint16_t len, uint16_t offset, uint8_t flags)
 {
+	struct cx_endpoint_conn_ctx *ctx;
+	ssize_t ret;
+
 	LOG_DBG("Attribute write, handle: %u, conn: %p", attr->handle, conn);
 
-	if (cx_endpoint_cb.recv_cb) {
-		cx_endpoint_cb.recv_cb((const uint8_t *)buf,len);
+	ctx = ctx_get(conn);
+	if (!ctx) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	/* Prepared chunks are delivered again with their offsets on
+	 * execution, nothing to validate before that. Only segments of a
+	 * framed link may span them.
+	 */
+	if (flags & BT_GATT_WRITE_FLAG_PREPARE) {
+		return ctx_framing(ctx) ?
+		       0 : BT_GATT_ERR(BT_ATT_ERR_WRITE_NOT_PERMITTED);
+	}
+
+	if (offset && (offset != ctx->rx_value_len)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+	ret = rx_defer(ctx, buf, len, offset != 0, flags);
+#else
+	ret = rx_inline(ctx, buf, len, offset != 0);
+#endif
+
+	/* A rejected chunk does not extend the value. */
+	if (ret >= 0) {
+		ctx->rx_value_len = offset + len;
+	}
+
+	return ret;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+static ssize_t psm_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			void *buf, uint16_t len, uint16_t offset)
+{
+	uint16_t psm = sys_cpu_to_le16(CONFIG_BT_CX_ENDPOINT_L2CAP_PSM);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &psm,
+				 sizeof(psm));
+}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+static ssize_t comp_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			 void *buf, uint16_t len, uint16_t offset)
+{
+	uint8_t codecs = BT_CX_ENDPOINT_COMP_SUPPORTED;
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &codecs,
+				 sizeof(codecs));
+}
+
+static ssize_t comp_write(struct bt_conn *conn,
+			  const struct bt_gatt_attr *attr, const void *buf,
+			  uint16_t len, uint16_t offset, uint8_t flags)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+
+	if (!ctx) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	if (offset) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(ctx->comp)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	ctx->comp = *(const uint8_t *)buf & BT_CX_ENDPOINT_COMP_SUPPORTED;
+
+	LOG_DBG("Link %u codecs 0x%02x", bt_conn_index(conn), ctx->comp);
+
+	return len;
+}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+static ssize_t frame_write(struct bt_conn *conn,
+			   const struct bt_gatt_attr *attr, const void *buf,
+			   uint16_t len, uint16_t offset, uint8_t flags)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+
+	if (!ctx) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	if (offset) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(uint8_t)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (*(const uint8_t *)buf != BT_CX_ENDPOINT_FRAMING_ON) {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
 	}
 
+	/* The response is queued by the cooperative host RX thread before
+	 * the next notification, which the client reads as framed once it
+	 * has the response. Writes after this one are framed already.
+	 */
+	ctx->framing = true;
+
+	LOG_DBG("Link %u framed", bt_conn_index(conn));
+
 	return len;
 }
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS_GATT)
+static ssize_t stats_read(struct bt_conn *conn,
+			  const struct bt_gatt_attr *attr,
+			  void *buf, uint16_t len, uint16_t offset)
+{
+	static uint32_t value[BT_CX_ENDPOINT_STAT_COUNT];
+	const uint32_t *counter = (const uint32_t *)
+		((const uint8_t *)&cx_endpoint_stats + sizeof(struct stats_hdr));
+
+	/* Snapshot the counters on the first chunk, so that the chunks of a
+	 * long read add up to a consistent value.
+	 */
+	if (!offset) {
+		for (int i = 0; i < ARRAY_SIZE(value); i++) {
+			value[i] = sys_cpu_to_le32(counter[i]);
+		}
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, value,
+				 sizeof(value));
+}
+#endif
 
 /* Service Declaration */
 BT_GATT_SERVICE_DEFINE(cx_endpoint_svc,
@@ -57,34 +708,1115 @@ BT_GATT_PRIMARY_SERVICE(BT_UUID_CX_ENDPOINT),
 	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_SEND,
 			       BT_GATT_CHRC_NOTIFY,
 			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
-	BT_GATT_CCC(cx_endpointlc_ccc_cfg_changed,
+	BT_GATT_CCC_MANAGED(&cx_endpoint_ccc,
 		    BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_RECV,
+			       BT_GATT_CHRC_WRITE |
+			       BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+			       RECV_PERM,
+			       NULL, received_msg, NULL),
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_PSM,
+			       BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ,
+			       psm_read, NULL, NULL),
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS_GATT)
+	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_STATS,
+			       BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ,
+			       stats_read, NULL, NULL),
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_COMP,
+			       BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+			       BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+			       comp_read, comp_write, NULL),
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_FRAME,
 			       BT_GATT_CHRC_WRITE,
 			       BT_GATT_PERM_WRITE,
-			       NULL, received_msg, NULL),
+			       NULL, frame_write, NULL),
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+	BT_GATT_CHARACTERISTIC(BT_UUID_CX_ENDPOINT_CREDITS,
+			       BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ,
+			       credits_read, NULL, NULL),
+#endif
 );
 
-int bt_cx_endpoint_init(struct bt_cx_endpoint_cb *callbacks)
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+static struct net_buf **tx_orig(struct net_buf *buf)
 {
-	if (callbacks) {
-		cx_endpoint_cb.recv_cb    = callbacks->recv_cb;
+	return net_buf_user_data(buf);
+}
+
+static void tx_buf_destroy(struct net_buf *buf)
+{
+	struct net_buf *orig = *tx_orig(buf);
+
+	if (orig) {
+		*tx_orig(buf) = NULL;
+		net_buf_unref(orig);
 	}
 
-	return 0;
+	net_buf_destroy(buf);
 }
+#endif
 
-int bt_cx_endpoint_send_data(const uint8_t *data, uint16_t len)
+static void tx_complete(struct cx_endpoint_conn_ctx *ctx, struct net_buf *buf,
+			int err)
+{
+	/* Callbacks are given the message as it was queued. */
+	struct net_buf *msg = buf;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	if (*tx_orig(buf)) {
+		msg = *tx_orig(buf);
+	}
+#endif
+
+	if (err) {
+		CX_STATS_INC(cx_endpoint_stats, tx_errors);
+	} else {
+		CX_STATS_INC(cx_endpoint_stats, tx_msgs);
+		CX_STATS_INCN(cx_endpoint_stats, tx_bytes, msg->len);
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+	const struct bt_cx_endpoint_chan *chan = chans[CHAN_ID(msg->data[0])];
+
+	if (chan) {
+		if (chan->sent_cb) {
+			chan->sent_cb(ctx->conn, msg->data + CHAN_HDR_LEN,
+				      msg->len - CHAN_HDR_LEN, err);
+		}
+
+		net_buf_unref(buf);
+		return;
+	}
+#endif
+
+	if (cx_endpoint_cb.sent_cb) {
+		cx_endpoint_cb.sent_cb(ctx->conn, msg, err);
+	}
+
+	net_buf_unref(buf);
+}
+
+static struct net_buf *inflight_pop(struct cx_endpoint_conn_ctx *ctx,
+				    bool *last, bool *pdu_end, uint32_t *stamp)
+{
+	uint16_t slot = ctx->inflight_head;
+
+	ctx->inflight_head = (ctx->inflight_head + 1) % TX_INFLIGHT_LEN;
+	ctx->inflight_count--;
+
+	*stamp = ctx->tx_inflight[slot].stamp;
+	*last = ctx->tx_inflight[slot].last;
+	*pdu_end = ctx->tx_inflight[slot].pdu_end;
+	if (*pdu_end) {
+		ctx->inflight_pdus--;
+	}
+
+	return ctx->tx_inflight[slot].buf;
+}
+
+static void inflight_push(struct cx_endpoint_conn_ctx *ctx,
+			  struct net_buf *buf, bool last, bool pdu_end,
+			  uint32_t stamp)
+{
+	uint16_t slot = (ctx->inflight_head + ctx->inflight_count) %
+			TX_INFLIGHT_LEN;
+
+	ctx->tx_inflight[slot].buf = buf;
+	ctx->tx_inflight[slot].stamp = stamp;
+	ctx->tx_inflight[slot].last = last;
+	ctx->tx_inflight[slot].pdu_end = pdu_end;
+	ctx->inflight_count++;
+	if (pdu_end) {
+		ctx->inflight_pdus++;
+		CX_STATS_INC(cx_endpoint_stats, tx_pdus);
+		CX_STATS_MAX(cx_endpoint_stats, inflight_hwm,
+			     ctx->inflight_pdus);
+	}
+}
+
+static struct net_buf *queue_pop(struct cx_endpoint_conn_ctx *ctx)
+{
+	struct net_buf *buf = ctx->tx_queue[ctx->tx_head];
+
+	ctx->tx_head = (ctx->tx_head + 1) % TX_QUEUE_LEN;
+	ctx->tx_count--;
+	ctx->tx_offset = 0;
+
+	return buf;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+static uint8_t queue_chan(struct cx_endpoint_conn_ctx *ctx, uint8_t pos)
+{
+	return CHAN_ID(ctx->tx_queue[(ctx->tx_head + pos) % TX_QUEUE_LEN]->data[0]);
+}
+
+/* Move the next message to serve to position pos of the queue, keeping the
+ * order of the messages of every channel. The channel is charged with
+ * queue_charge() once the message is actually handed over. Called with
+ * tx_lock held.
+ */
+static void queue_schedule(struct cx_endpoint_conn_ctx *ctx, uint8_t pos,
+			   struct bt_cx_endpoint_chan_sched *sched)
+{
+	struct net_buf *buf;
+	uint32_t backlog = 0;
+	uint32_t stamp;
+	uint8_t slot;
+	uint8_t prev;
+	uint8_t id;
+	uint8_t i;
+
+	for (i = pos; i < ctx->tx_count; i++) {
+		backlog |= BIT(queue_chan(ctx, i));
+	}
+
+	if (!backlog) {
+		return;
+	}
+
+	id = bt_cx_endpoint_chan_pick(sched, chan_param, backlog);
+
+	for (i = pos; queue_chan(ctx, i) != id; i++) {
+	}
+
+	/* Messages skipped over all belong to other channels. */
+	for (; i > pos; i--) {
+		slot = (ctx->tx_head + i) % TX_QUEUE_LEN;
+		prev = (ctx->tx_head + i - 1) % TX_QUEUE_LEN;
+
+		buf = ctx->tx_queue[slot];
+		ctx->tx_queue[slot] = ctx->tx_queue[prev];
+		ctx->tx_queue[prev] = buf;
+
+		stamp = ctx->tx_stamp[slot];
+		ctx->tx_stamp[slot] = ctx->tx_stamp[prev];
+		ctx->tx_stamp[prev] = stamp;
+	}
+}
+
+/* Charge the channel of the message at position pos of the queue. */
+static void queue_charge(struct cx_endpoint_conn_ctx *ctx, uint8_t pos,
+			 struct bt_cx_endpoint_chan_sched *sched)
+{
+	bt_cx_endpoint_chan_served(sched, chan_param, queue_chan(ctx, pos));
+}
+#else
+static void queue_schedule(struct cx_endpoint_conn_ctx *ctx, uint8_t pos,
+			   struct bt_cx_endpoint_chan_sched *sched)
+{
+}
+
+static void queue_charge(struct cx_endpoint_conn_ctx *ctx, uint8_t pos,
+			 struct bt_cx_endpoint_chan_sched *sched)
+{
+}
+#endif
+
+/* Drop the messages in flight, and the queued ones too if queued is set. */
+static void tx_flush(struct cx_endpoint_conn_ctx *ctx, int err, bool queued)
+{
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint32_t stamp;
+	bool pdu_end;
+
+	for (;;) {
+		bool last = true;
+
+		key = k_spin_lock(&tx_lock);
+		if (ctx->inflight_count) {
+			buf = inflight_pop(ctx, &last, &pdu_end, &stamp);
+		} else if (queued && ctx->tx_count) {
+			buf = queue_pop(ctx);
+		} else {
+			break;
+		}
+		k_spin_unlock(&tx_lock, key);
+
+		/* Leading segments of a message hold no reference, the
+		 * message is completed with its last segment or from the
+		 * queue head.
+		 */
+		if (last) {
+			tx_complete(ctx, buf, err);
+		}
+	}
+	k_spin_unlock(&tx_lock, key);
+}
+
+static void notify_complete(struct bt_conn *conn, void *user_data)
 {
-	if (!notify_enabled) {
-		return -EACCES;
+	struct cx_endpoint_conn_ctx *ctx = user_data;
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint32_t stamp;
+	bool pdu_end = false;
+	bool last;
+
+	while (!pdu_end) {
+		key = k_spin_lock(&tx_lock);
+		if ((ctx->conn != conn) || !ctx->inflight_count) {
+			k_spin_unlock(&tx_lock, key);
+			return;
+		}
+		buf = inflight_pop(ctx, &last, &pdu_end, &stamp);
+		k_spin_unlock(&tx_lock, key);
+
+		if (last) {
+			CX_STATS_LAT(cx_endpoint_stats, tx_lat,
+				     k_uptime_get_32() - stamp);
+			tx_complete(ctx, buf, 0);
+		}
 	}
 
-	if(!data){
+	/* A window slot is free again, keep the link busy. */
+	k_delayed_work_submit(&ctx->tx_work, K_NO_WAIT);
+}
+
+/* Pack as many whole queued messages as fit into tx_pdu. Returns the number
+ * of messages packed, or zero if the notification is to be held back until
+ * more messages arrive or the oldest one reaches its latency deadline.
+ */
+static uint8_t tx_coalesce(struct cx_endpoint_conn_ctx *ctx, uint8_t count,
+			   struct bt_cx_endpoint_frame_tx *frame_tx,
+			   struct bt_cx_endpoint_chan_sched *sched,
+			   uint16_t pdu_size, uint16_t *pdu_len)
+{
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint16_t offset;
+	int32_t remaining;
+	uint8_t packed;
+
+	for (packed = 0; packed < count; packed++) {
+		/* The head was scheduled by the caller. */
+		key = k_spin_lock(&tx_lock);
+		if (packed) {
+			queue_schedule(ctx, packed, sched);
+		}
+		buf = ctx->tx_queue[(ctx->tx_head + packed) % TX_QUEUE_LEN];
+		k_spin_unlock(&tx_lock, key);
+
+		if ((ctx->inflight_count + packed) >= TX_INFLIGHT_LEN) {
+			return packed;
+		}
+
+		if ((BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN + buf->len) >
+		    (pdu_size - *pdu_len)) {
+			/* Notification is full. */
+			return packed;
+		}
+
+		offset = 0;
+		*pdu_len += bt_cx_endpoint_frame_segment(
+			frame_tx, buf->data, buf->len, &offset,
+			&tx_pdu[*pdu_len], pdu_size - *pdu_len);
+
+		/* Charged once packed, so the next pick sees its cost. */
+		key = k_spin_lock(&tx_lock);
+		queue_charge(ctx, packed, sched);
+		k_spin_unlock(&tx_lock, key);
+	}
+
+	if (!packed ||
+	    ((pdu_size - *pdu_len) <= BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN)) {
+		return packed;
+	}
+
+	remaining = (int32_t)(ctx->tx_stamp[ctx->tx_head] +
+			      COALESCE_LATENCY_MS - k_uptime_get_32());
+	if (remaining > 0) {
+		k_delayed_work_submit(&ctx->tx_work, K_MSEC(remaining));
+		return 0;
+	}
+
+	return packed;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+/* Select the transport of the next message. Messages in flight complete
+ * in order only on a single transport, so switching waits until none is
+ * left. Returns false if the message has to wait.
+ */
+static bool tx_transport(struct cx_endpoint_conn_ctx *ctx, uint16_t offset,
+			 bool *l2cap)
+{
+	if (!offset && (ctx->tx_l2cap != ctx->l2cap_ready)) {
+		if (ctx->inflight_count) {
+			return false;
+		}
+
+		ctx->tx_l2cap = ctx->l2cap_ready;
+		LOG_DBG("Link %u switched to %s", bt_conn_index(ctx->conn),
+			ctx->tx_l2cap ? "L2CAP" : "GATT");
+	}
+
+	*l2cap = ctx->tx_l2cap;
+
+	return true;
+}
+
+static int l2cap_send(struct cx_endpoint_conn_ctx *ctx, struct net_buf *buf)
+{
+	struct net_buf *sdu;
+	int err;
+
+	if (buf->len > ctx->l2cap.tx.mtu) {
+		return -EMSGSIZE;
+	}
+
+	sdu = net_buf_alloc(&cx_endpoint_l2cap_tx_pool, K_NO_WAIT);
+	if (!sdu) {
+		return -ENOMEM;
+	}
+
+	net_buf_reserve(sdu, BT_L2CAP_CHAN_SEND_RESERVE);
+	net_buf_add_mem(sdu, buf->data, buf->len);
+
+	err = bt_l2cap_chan_send(&ctx->l2cap.chan, sdu);
+	if (err < 0) {
+		net_buf_unref(sdu);
+		return err;
+	}
+
+	return 0;
+}
+#else
+static bool tx_transport(struct cx_endpoint_conn_ctx *ctx, uint16_t offset,
+			 bool *l2cap)
+{
+	*l2cap = false;
+
+	return true;
+}
+
+static int l2cap_send(struct cx_endpoint_conn_ctx *ctx, struct net_buf *buf)
+{
+	return -ENOTSUP;
+}
+#endif
+
+static void tx_work_handler(struct k_work *work)
+{
+	struct cx_endpoint_conn_ctx *ctx =
+		CONTAINER_OF(work, struct cx_endpoint_conn_ctx, tx_work);
+	struct bt_gatt_notify_params params = {
+		.attr = &cx_endpoint_svc.attrs[2],
+		.func = notify_complete,
+		.user_data = ctx,
+	};
+	struct bt_cx_endpoint_frame_tx frame_tx;
+	struct bt_cx_endpoint_chan_sched sched;
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint16_t pdu_size;
+	uint16_t pdu_len;
+	uint16_t offset;
+	uint32_t stamp;
+	uint8_t packed;
+	uint8_t count;
+	bool started;
+	bool l2cap;
+	bool last;
+	int err;
+
+	for (;;) {
+		key = k_spin_lock(&tx_lock);
+		count = ctx->tx_count;
+		if (!ctx->conn || !count ||
+		    (ctx->inflight_pdus >= TX_WINDOW) ||
+		    (ctx->inflight_count >= TX_INFLIGHT_LEN)) {
+			k_spin_unlock(&tx_lock, key);
+			return;
+		}
+
+		/* Messages are scheduled as they are started, a message
+		 * partially handed over to the host is completed first.
+		 */
+		sched = ctx->sched;
+		started = !ctx->tx_offset;
+		if (started) {
+			queue_schedule(ctx, 0, &sched);
+		}
+		buf = ctx->tx_queue[ctx->tx_head];
+
+		if (!tx_transport(ctx, ctx->tx_offset, &l2cap)) {
+			/* Resumed by the last completion. */
+			k_spin_unlock(&tx_lock, key);
+			return;
+		}
+		k_spin_unlock(&tx_lock, key);
+
+		ctx->mtu = bt_gatt_get_mtu(ctx->conn);
+		pdu_size = MIN(ctx->mtu - 3, TX_PDU_MAX);
+		offset = ctx->tx_offset;
+		frame_tx = ctx->frame_tx;
+		packed = 0;
+		pdu_len = 0;
+		err = 0;
+
+		if (IS_ENABLED(CONFIG_BT_CX_ENDPOINT_COALESCE) && !offset &&
+		    !l2cap && ctx_framing(ctx)) {
+			packed = tx_coalesce(ctx, count, &frame_tx, &sched,
+					     pdu_size, &pdu_len);
+			if (!packed && pdu_len) {
+				/* Held back until the latency deadline. */
+				return;
+			}
+		}
+
+		if (l2cap) {
+			/* One SDU per message, whatever its size. */
+			last = true;
+		} else if (packed) {
+			params.data = tx_pdu;
+			params.len = pdu_len;
+			last = true;
+		} else if (IS_ENABLED(CONFIG_BT_CX_ENDPOINT_FRAMING) &&
+			   ctx_framing(ctx)) {
+			params.data = tx_pdu;
+			params.len = bt_cx_endpoint_frame_segment(
+				&frame_tx, buf->data, buf->len, &offset,
+				tx_pdu, pdu_size);
+			last = (offset == buf->len);
+		} else if (buf->len > pdu_size) {
+			err = -EMSGSIZE;
+			last = true;
+		} else {
+			params.data = buf->data;
+			params.len = buf->len;
+			last = true;
+		}
+
+		if (!err) {
+			err = l2cap ? l2cap_send(ctx, buf) :
+				      bt_gatt_notify_cb(ctx->conn, &params);
+		}
+
+		if (err == -ENOMEM) {
+			/* Host buffers exhausted, resume on the next completion
+			 * or after a short delay if nothing is in flight.
+			 */
+			if (!ctx->inflight_pdus) {
+				k_delayed_work_submit(&ctx->tx_work,
+						      TX_RETRY_DELAY);
+			}
+			return;
+		}
+
+		if (err) {
+			LOG_WRN("%s failed on link %u (err %d)",
+				l2cap ? "SDU" : "Notify",
+				bt_conn_index(ctx->conn), err);
+		}
+
+		key = k_spin_lock(&tx_lock);
+		if (!err) {
+			ctx->frame_tx = frame_tx;
+		}
+
+		/* Coalesced messages were charged as they were packed. */
+		if (!packed && started) {
+			queue_charge(ctx, 0, &sched);
+		}
+		ctx->sched = sched;
+
+		if (packed) {
+			for (uint8_t i = 0; i < packed; i++) {
+				stamp = ctx->tx_stamp[ctx->tx_head];
+				buf = queue_pop(ctx);
+				if (!err) {
+					inflight_push(ctx, buf, true,
+						      i == (packed - 1), stamp);
+				} else {
+					k_spin_unlock(&tx_lock, key);
+					tx_complete(ctx, buf, err);
+					key = k_spin_lock(&tx_lock);
+				}
+			}
+		} else if (err) {
+			buf = queue_pop(ctx);
+			k_spin_unlock(&tx_lock, key);
+			tx_complete(ctx, buf, err);
+			key = k_spin_lock(&tx_lock);
+		} else {
+			stamp = ctx->tx_stamp[ctx->tx_head];
+			if (last) {
+				queue_pop(ctx);
+			} else {
+				ctx->tx_offset = offset;
+			}
+			inflight_push(ctx, buf, last, true, stamp);
+		}
+		k_spin_unlock(&tx_lock, key);
+	}
+}
+
+static int ctx_enqueue(struct cx_endpoint_conn_ctx *ctx, struct net_buf *buf)
+{
+	k_spinlock_key_t key;
+	uint8_t slot;
+
+	key = k_spin_lock(&tx_lock);
+	if (ctx->tx_count >= TX_QUEUE_LEN) {
+		k_spin_unlock(&tx_lock, key);
+		CX_STATS_INC(cx_endpoint_stats, err_nomem);
+		return -ENOMEM;
+	}
+	slot = (ctx->tx_head + ctx->tx_count) % TX_QUEUE_LEN;
+	ctx->tx_queue[slot] = net_buf_ref(buf);
+	ctx->tx_stamp[slot] = k_uptime_get_32();
+	ctx->tx_count++;
+	CX_STATS_MAX(cx_endpoint_stats, queue_hwm, ctx->tx_count);
+	k_spin_unlock(&tx_lock, key);
+
+	k_delayed_work_submit(&ctx->tx_work, K_NO_WAIT);
+
+	return 0;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+static struct cx_endpoint_conn_ctx *l2cap_ctx(struct bt_l2cap_chan *chan)
+{
+	return CONTAINER_OF(chan, struct cx_endpoint_conn_ctx, l2cap.chan);
+}
+
+static void l2cap_connected(struct bt_l2cap_chan *chan)
+{
+	struct cx_endpoint_conn_ctx *ctx = l2cap_ctx(chan);
+
+	LOG_INF("L2CAP channel connected on link %u, MTU %u/%u",
+		bt_conn_index(chan->conn), ctx->l2cap.tx.mtu,
+		ctx->l2cap.rx.mtu);
+
+	ctx->l2cap_ready = true;
+	k_delayed_work_submit(&ctx->tx_work, K_NO_WAIT);
+}
+
+static void l2cap_disconnected(struct bt_l2cap_chan *chan)
+{
+	struct cx_endpoint_conn_ctx *ctx = l2cap_ctx(chan);
+
+	LOG_DBG("L2CAP channel disconnected");
+
+	ctx->l2cap_ready = false;
+	if (!ctx->conn || !ctx->tx_l2cap) {
+		return;
+	}
+
+	/* SDUs still in flight are never reported as sent. */
+	tx_flush(ctx, -ECONNRESET, false);
+	k_delayed_work_submit(&ctx->tx_work, K_NO_WAIT);
+}
+
+static struct net_buf *l2cap_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	/* Called from the host RX thread, which must not wait for the
+	 * application to release a buffer.
+	 */
+	return net_buf_alloc(&cx_endpoint_l2cap_rx_pool, K_NO_WAIT);
+}
+
+static int l2cap_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	struct cx_endpoint_conn_ctx *ctx = l2cap_ctx(chan);
+
+	if (!ctx->conn) {
+		return 0;
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+	struct l2cap_rx_meta *meta = net_buf_user_data(buf);
+
+	meta->conn_index = bt_conn_index(ctx->conn);
+	meta->gen = ctx->gen;
+
+	net_buf_put(&l2cap_rx_fifo, net_buf_ref(buf));
+	k_work_submit_to_queue(&rx_wq, &rx_work);
+#else
+	frame_received(buf->data, buf->len, ctx);
+#endif
+
+	return 0;
+}
+
+static void l2cap_sent(struct bt_l2cap_chan *chan)
+{
+	struct cx_endpoint_conn_ctx *ctx = l2cap_ctx(chan);
+
+	/* Every SDU is tracked as one PDU in flight. */
+	notify_complete(chan->conn, ctx);
+}
+
+static struct bt_l2cap_chan_ops l2cap_ops = {
+	.connected = l2cap_connected,
+	.disconnected = l2cap_disconnected,
+	.alloc_buf = l2cap_alloc_buf,
+	.recv = l2cap_recv,
+	.sent = l2cap_sent,
+};
+
+static int l2cap_accept(struct bt_conn *conn, struct bt_l2cap_chan **chan)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+
+	if (!ctx || ctx->l2cap.chan.conn) {
+		return -ENOMEM;
+	}
+
+	memset(&ctx->l2cap, 0, sizeof(ctx->l2cap));
+	ctx->l2cap.chan.ops = &l2cap_ops;
+	ctx->l2cap.rx.mtu = CONFIG_BT_CX_ENDPOINT_L2CAP_MTU;
+
+	*chan = &ctx->l2cap.chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server l2cap_server = {
+	.psm = CONFIG_BT_CX_ENDPOINT_L2CAP_PSM,
+	.sec_level = BT_SECURITY_L1,
+	.accept = l2cap_accept,
+};
+#endif /* CONFIG_BT_CX_ENDPOINT_L2CAP */
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	struct cx_endpoint_conn_ctx *ctx = &conn_ctx[bt_conn_index(conn)];
+
+	if (err) {
+		return;
+	}
+
+	ctx->conn = bt_conn_ref(conn);
+	ctx->gen++;
+	ctx->ccc_value = 0;
+	ctx->mtu = bt_gatt_get_mtu(conn);
+	ctx->tx_head = 0;
+	ctx->tx_count = 0;
+	ctx->inflight_head = 0;
+	ctx->inflight_count = 0;
+	ctx->inflight_pdus = 0;
+	ctx->tx_offset = 0;
+	ctx->rx_value_len = 0;
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+	ctx->rx_queued = 0;
+	atomic_set(&ctx->rx_consumed, 0);
+#endif
+	memset(&ctx->sched, 0, sizeof(ctx->sched));
+	/* A segment left over from the previous link must not be completed by
+	 * the new one. With deferred reception the RX work queue owns the
+	 * reassembly state and drops it on the first write of a new link.
+	 */
+	if (IS_ENABLED(CONFIG_BT_CX_ENDPOINT_FRAMING) &&
+	    !IS_ENABLED(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)) {
+		bt_cx_endpoint_frame_rx_reset(&ctx->frame_rx);
+	}
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	ctx->framing = false;
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	ctx->comp = 0;
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	ctx->l2cap_ready = false;
+	ctx->tx_l2cap = false;
+#endif
+
+	LOG_DBG("Link %u attached, conn: %p", bt_conn_index(conn), conn);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+
+	if (!ctx) {
+		return;
+	}
+
+	LOG_DBG("Link %u detached, conn: %p", bt_conn_index(conn), conn);
+
+	k_delayed_work_cancel(&ctx->tx_work);
+	tx_flush(ctx, -ENOTCONN, true);
+
+	/* With deferred reception the reassembly state belongs to the RX
+	 * work queue, which releases it once the link is gone.
+	 */
+	if (IS_ENABLED(CONFIG_BT_CX_ENDPOINT_FRAMING) &&
+	    !IS_ENABLED(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)) {
+		bt_cx_endpoint_frame_rx_reset(&ctx->frame_rx);
+	}
+
+	bt_conn_unref(ctx->conn);
+	ctx->conn = NULL;
+	ctx->ccc_value = 0;
+}
+
+static void security_changed(struct bt_conn *conn, bt_security_t level,
+			     enum bt_security_err err)
+{
+	struct cx_endpoint_conn_ctx *ctx = ctx_get(conn);
+
+	/* CCC values of bonded peers are restored once the link is encrypted,
+	 * without going through the CCC write callback.
+	 */
+	if (ctx && !err &&
+	    bt_gatt_is_subscribed(conn, &cx_endpoint_svc.attrs[2],
+				  BT_GATT_CCC_NOTIFY)) {
+		ctx->ccc_value = BT_GATT_CCC_NOTIFY;
+	}
+}
+
+static struct bt_conn_cb conn_callbacks = {
+	.connected        = connected,
+	.disconnected     = disconnected,
+	.security_changed = security_changed,
+};
+
+static bool ctx_subscribed(const struct cx_endpoint_conn_ctx *ctx)
+{
+	return ctx->conn && (ctx->ccc_value & BT_GATT_CCC_NOTIFY);
+}
+
+int bt_cx_endpoint_init(struct bt_cx_endpoint_cb *callbacks)
+{
+	static bool conn_cb_registered;
+
+	if (callbacks) {
+		cx_endpoint_cb.recv_cb    = callbacks->recv_cb;
+		cx_endpoint_cb.sent_cb    = callbacks->sent_cb;
+	}
+
+	if (!conn_cb_registered) {
+		for (int i = 0; i < ARRAY_SIZE(conn_ctx); i++) {
+			k_delayed_work_init(&conn_ctx[i].tx_work,
+					    tx_work_handler);
+		}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RX_DEFERRED)
+		k_work_q_start(&rx_wq, rx_wq_stack,
+			       K_THREAD_STACK_SIZEOF(rx_wq_stack),
+			       CONFIG_BT_CX_ENDPOINT_RX_WQ_PRIORITY);
+		k_thread_name_set(&rx_wq.thread, "cx_endpoint_rx");
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+		bt_cx_endpoint_chan_param_init(chan_param);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+		/* Without the server, messages keep using GATT. */
+		if (bt_l2cap_server_register(&l2cap_server)) {
+			LOG_ERR("L2CAP server registration failed");
+		}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+		stats_init_and_reg(STATS_HDR(cx_endpoint_stats),
+				   STATS_SIZE_INIT_PARMS(cx_endpoint_stats,
+							 STATS_SIZE_32),
+				   STATS_NAME_INIT_PARMS(cx_endpoint),
+				   "cx_endpoint");
+#endif
+
+		bt_conn_cb_register(&conn_callbacks);
+		conn_cb_registered = true;
+	}
+
+	return 0;
+}
+
+struct net_buf *bt_cx_endpoint_buf_alloc(k_timeout_t timeout)
+{
+	struct net_buf *buf = net_buf_alloc(&cx_endpoint_tx_pool, timeout);
+
+	if (buf && CHAN_HDR_LEN) {
+		net_buf_reserve(buf, CHAN_HDR_LEN);
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	if (buf) {
+		*tx_orig(buf) = NULL;
+	}
+#endif
+
+	return buf;
+}
+
+static int send_buf(struct bt_conn *conn, struct net_buf *buf)
+{
+	struct cx_endpoint_conn_ctx *ctx;
+	int queued = 0;
+	int ret = -EACCES;
+	int err;
+
+	if (conn) {
+		ctx = ctx_get(conn);
+		if (!ctx) {
+			return -ENOTCONN;
+		}
+
+		if (!ctx_subscribed(ctx)) {
+			CX_STATS_INC(cx_endpoint_stats, err_eacces);
+			return -EACCES;
+		}
+
+		err = ctx_enqueue(ctx, buf);
+		if (!err) {
+			net_buf_unref(buf);
+		}
+
+		return err;
+	}
+
+	/* Fan out only to the links that have notifications enabled, every
+	 * link queue holds its own reference to the same buffer.
+	 */
+	for (int i = 0; i < ARRAY_SIZE(conn_ctx); i++) {
+		ctx = &conn_ctx[i];
+
+		if (!ctx_subscribed(ctx)) {
+			continue;
+		}
+
+		err = ctx_enqueue(ctx, buf);
+		if (err) {
+			LOG_WRN("TX queue full on link %d", i);
+			ret = err;
+		} else {
+			queued++;
+		}
+	}
+
+	if (!queued) {
+		if (ret == -EACCES) {
+			CX_STATS_INC(cx_endpoint_stats, err_eacces);
+		}
+
+		return ret;
+	}
+
+	net_buf_unref(buf);
+
+	return 0;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+/* Whether every target of a message decodes compressed messages. */
+static bool comp_targets(struct bt_conn *conn)
+{
+	struct cx_endpoint_conn_ctx *ctx;
+	bool any = false;
+
+	if (conn) {
+		ctx = ctx_get(conn);
+		return ctx && ctx->comp;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(conn_ctx); i++) {
+		ctx = &conn_ctx[i];
+
+		if (!ctx_subscribed(ctx)) {
+			continue;
+		}
+
+		if (!ctx->comp) {
+			return false;
+		}
+		any = true;
+	}
+
+	return any;
+}
+
+/* Compressed copy of a message holding its reference to the message, or
+ * NULL to send the message as is.
+ */
+static struct net_buf *tx_compress(struct bt_conn *conn, struct net_buf *buf)
+{
+	uint16_t len = buf->len - CHAN_HDR_LEN;
+	struct net_buf *comp;
+	int ret;
+
+	if ((len < CONFIG_BT_CX_ENDPOINT_COMP_MIN_LEN) ||
+	    !comp_targets(conn)) {
+		return NULL;
+	}
+
+	comp = bt_cx_endpoint_buf_alloc(K_NO_WAIT);
+	if (!comp) {
+		return NULL;
+	}
+
+	ret = bt_cx_endpoint_comp_encode(buf->data + CHAN_HDR_LEN, len,
+					 net_buf_tail(comp),
+					 MIN(net_buf_tailroom(comp), len - 1));
+	if (ret < 0) {
+		net_buf_unref(comp);
+		return NULL;
+	}
+
+	net_buf_add(comp, ret);
+	net_buf_push_u8(comp, buf->data[0] | BT_CX_ENDPOINT_CHAN_COMPRESSED);
+	*tx_orig(comp) = buf;
+
+	return comp;
+}
+#endif
+
+static int chan_send_buf(uint8_t id, struct bt_conn *conn,
+			 struct net_buf *buf)
+{
+	int err;
+
+	if (!buf) {
+		return -EINVAL;
+	}
+
+	if (!CHAN_HDR_LEN) {
+		return send_buf(conn, buf);
+	}
+
+	if (net_buf_headroom(buf) < CHAN_HDR_LEN) {
+		return -EINVAL;
+	}
+
+	net_buf_push_u8(buf, id);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	struct net_buf *comp = tx_compress(conn, buf);
+
+	if (comp) {
+		err = send_buf(conn, comp);
+		if (!err) {
+			return 0;
+		}
+
+		/* The caller keeps its reference. */
+		*tx_orig(comp) = NULL;
+		net_buf_unref(comp);
+		net_buf_pull(buf, CHAN_HDR_LEN);
+
+		return err;
+	}
+#endif
+
+	err = send_buf(conn, buf);
+	if (err) {
+		/* Hand the buffer back as it was given. */
+		net_buf_pull(buf, CHAN_HDR_LEN);
+	}
+
+	return err;
+}
+
+static int chan_send(uint8_t id, struct bt_conn *conn, const uint8_t *data,
+		     uint16_t len)
+{
+	struct net_buf *buf;
+	int err;
+
+	if (!data) {
+		return -EINVAL;
+	}
+
+	if (len > (CONFIG_BT_CX_ENDPOINT_TX_BUF_SIZE - CHAN_HDR_LEN)) {
+		return -EMSGSIZE;
+	}
+
+	buf = bt_cx_endpoint_buf_alloc(K_NO_WAIT);
+	if (!buf) {
+		CX_STATS_INC(cx_endpoint_stats, err_nomem);
+		return -ENOMEM;
+	}
+
+	net_buf_add_mem(buf, data, len);
+
+	err = chan_send_buf(id, conn, buf);
+	if (err) {
+		net_buf_unref(buf);
+	}
+
+	return err;
+}
+
+int bt_cx_endpoint_send_buf(struct bt_conn *conn, struct net_buf *buf)
+{
+	return chan_send_buf(BT_CX_ENDPOINT_CHAN_DEFAULT, conn, buf);
+}
+
+int bt_cx_endpoint_send(struct bt_conn *conn, const uint8_t *data,
+			uint16_t len)
+{
+	return chan_send(BT_CX_ENDPOINT_CHAN_DEFAULT, conn, data, len);
+}
+
+int bt_cx_endpoint_send_data(const uint8_t *data, uint16_t len)
+{
+	return bt_cx_endpoint_send(NULL, data, len);
+}
+
+uint8_t bt_cx_endpoint_subscribed_count(void)
+{
+	uint8_t count = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(conn_ctx); i++) {
+		if (ctx_subscribed(&conn_ctx[i])) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+int bt_cx_endpoint_chan_register(struct bt_cx_endpoint_chan *chan)
+{
+	if (!chan || (chan->id >= BT_CX_ENDPOINT_CHAN_COUNT) ||
+	    !chan->weight) {
+		return -EINVAL;
+	}
+
+	if (chans[chan->id]) {
+		return -EALREADY;
+	}
+
+	chan_param[chan->id].prio = chan->prio;
+	chan_param[chan->id].weight = chan->weight;
+	chans[chan->id] = chan;
+
+	return 0;
+}
+
+int bt_cx_endpoint_chan_send_buf(const struct bt_cx_endpoint_chan *chan,
+				 struct bt_conn *conn, struct net_buf *buf)
+{
+	if (!chan) {
+		return -EINVAL;
+	}
+
+	return chan_send_buf(chan->id, conn, buf);
+}
+
+int bt_cx_endpoint_chan_send(const struct bt_cx_endpoint_chan *chan,
+			     struct bt_conn *conn, const uint8_t *data,
+			     uint16_t len)
+{
+	if (!chan) {
 		return -EINVAL;
 	}
 
-	return bt_gatt_notify(NULL, &cx_endpoint_svc.attrs[2],
-			      data,
-			      len);
+	return chan_send(chan->id, conn, data, len);
 }
+#endif /* CONFIG_BT_CX_ENDPOINT_CHANNELS */
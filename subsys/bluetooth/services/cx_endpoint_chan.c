@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX Endpoint channel scheduling
+ */
+
+#include <zephyr/types.h>
+#include <zephyr.h>
+
+#include <bluetooth/services/cx_endpoint_chan.h>
+
+BUILD_ASSERT(BT_CX_ENDPOINT_CHAN_COUNT <= 32,
+	     "Channel backlog does not fit in a 32-bit mask");
+
+uint8_t bt_cx_endpoint_chan_pick(const struct bt_cx_endpoint_chan_sched *sched,
+				 const struct bt_cx_endpoint_chan_param *param,
+				 uint32_t backlog)
+{
+	uint8_t best = 0;
+	bool found = false;
+
+	/* Lowest priority value first, then the channel with the most credit
+	 * left in its round, which interleaves channels of equal weight.
+	 */
+	for (uint8_t id = 0; id < BT_CX_ENDPOINT_CHAN_COUNT; id++) {
+		if (!(backlog & BIT(id))) {
+			continue;
+		}
+
+		if (!found || (param[id].prio < param[best].prio) ||
+		    ((param[id].prio == param[best].prio) &&
+		     (sched->credit[id] > sched->credit[best]))) {
+			best = id;
+			found = true;
+		}
+	}
+
+	return best;
+}
+
+void bt_cx_endpoint_chan_served(struct bt_cx_endpoint_chan_sched *sched,
+				const struct bt_cx_endpoint_chan_param *param,
+				uint8_t id)
+{
+	/* A channel picked without credit means every channel of its
+	 * priority with messages waiting has used its share, start a new
+	 * round for all of them.
+	 */
+	if (!sched->credit[id]) {
+		for (uint8_t i = 0; i < BT_CX_ENDPOINT_CHAN_COUNT; i++) {
+			if (param[i].prio == param[id].prio) {
+				sched->credit[i] = param[i].weight;
+			}
+		}
+	}
+
+	sched->credit[id]--;
+}
+
+void bt_cx_endpoint_chan_param_init(struct bt_cx_endpoint_chan_param *param)
+{
+	for (uint8_t id = 0; id < BT_CX_ENDPOINT_CHAN_COUNT; id++) {
+		param[id].prio = BT_CX_ENDPOINT_CHAN_PRIO_LOWEST;
+		param[id].weight = 1;
+	}
+}
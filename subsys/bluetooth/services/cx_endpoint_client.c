@@ -7,45 +7,1261 @@
 #include <bluetooth/conn.h>
 #include <bluetooth/uuid.h>
 #include <bluetooth/gatt.h>
+#include <bluetooth/l2cap.h>
+#include <settings/settings.h>
+#include <sys/byteorder.h>
 
 #include <bluetooth/services/cx_endpoint.h>
 #include <bluetooth/services/cx_endpoint_client.h>
+#include <bluetooth/services/cx_endpoint_frame.h>
+#include <bluetooth/services/cx_endpoint_chan.h>
+#include <bluetooth/services/cx_endpoint_comp.h>
+
+#include "cx_endpoint_client_rpc.h"
+#include "cx_endpoint_stats.h"
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(cx_endpoint_c, CONFIG_BT_CX_ENDPOINT_CLIENT_LOG_LEVEL);
 
-enum {
-	CX_ENDPOINT_C_INITIALIZED,
-	CX_ENDPOINT_C_TX_NOTIF_ENABLED,
-	CX_ENDPOINT_C_RX_WRITE_PENDING
-};
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+#define CHAN_HDR_LEN	BT_CX_ENDPOINT_CHAN_HDR_LEN
+#else
+#define CHAN_HDR_LEN	0
+#endif
+
+/* Channel of a message from its channel header. */
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+#define CHAN_ID(hdr)	((hdr) & BT_CX_ENDPOINT_CHAN_ID_MASK)
+#else
+#define CHAN_ID(hdr)	(hdr)
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+#define TX_QUEUE_LEN	CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE_LEN
+#define TX_WINDOW	CONFIG_BT_CX_ENDPOINT_CLIENT_TX_WINDOW
+
+/* Time to wait before retrying when the host ran out of buffers and this
+ * instance has no write in flight whose completion would restart it.
+ */
+#define TX_RETRY_DELAY	K_MSEC(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_RETRY_MS)
+
+/* Flags of a queued message. */
+#define TX_FLAG_RELIABLE	BIT(0)
+
+/* User data of a queued message. */
+struct tx_meta {
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	/* Original message of a compressed copy, NULL otherwise. */
+	struct net_buf *orig;
+#endif
+	uint8_t flags;
+};
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+static void tx_buf_destroy(struct net_buf *buf);
+
+NET_BUF_POOL_DEFINE(cx_endpoint_c_tx_pool,
+		    CONFIG_BT_CX_ENDPOINT_CLIENT_TX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_CLIENT_TX_BUF_SIZE,
+		    sizeof(struct tx_meta), tx_buf_destroy);
+#else
+NET_BUF_POOL_DEFINE(cx_endpoint_c_tx_pool,
+		    CONFIG_BT_CX_ENDPOINT_CLIENT_TX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_CLIENT_TX_BUF_SIZE,
+		    sizeof(struct tx_meta), NULL);
+#endif
+
+/* Protects the TX queues of all instances. */
+static struct k_spinlock tx_lock;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+/* Channel ID of a received message, kept in its user data. */
+NET_BUF_POOL_DEFINE(cx_endpoint_c_rx_pool,
+		    CONFIG_BT_CX_ENDPOINT_CLIENT_RX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_CLIENT_RX_BUF_SIZE, sizeof(uint8_t),
+		    NULL);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+/* Notifications and SDUs are received from the BT RX thread only. */
+static uint8_t comp_rx[CONFIG_BT_CX_ENDPOINT_COMP_MAX_LEN];
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+#define RX_PAUSE_HIGH	CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE_HIGH
+#define RX_PAUSE_LOW	CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE_LOW
+
+BUILD_ASSERT(RX_PAUSE_LOW < RX_PAUSE_HIGH,
+	     "Notifications must resume below the pause level");
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+NET_BUF_POOL_DEFINE(cx_endpoint_c_l2cap_tx_pool,
+		    CONFIG_BT_CX_ENDPOINT_L2CAP_TX_BUF_COUNT,
+		    BT_L2CAP_BUF_SIZE(CONFIG_BT_CX_ENDPOINT_L2CAP_MTU), 0, NULL);
+NET_BUF_POOL_DEFINE(cx_endpoint_c_l2cap_rx_pool,
+		    CONFIG_BT_CX_ENDPOINT_L2CAP_RX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_L2CAP_MTU, 0, NULL);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+/* Shared by all client instances. */
+STATS_SECT_START(cx_endpoint_c)
+STATS_SECT_ENTRY32(rx_msgs)
+STATS_SECT_ENTRY32(rx_bytes)
+STATS_SECT_ENTRY32(rx_errors)
+STATS_SECT_ENTRY32(rx_drops)
+STATS_SECT_ENTRY32(rx_pauses)
+STATS_SECT_ENTRY32(tx_msgs)
+STATS_SECT_ENTRY32(tx_bytes)
+STATS_SECT_ENTRY32(tx_writes)
+STATS_SECT_ENTRY32(tx_errors)
+STATS_SECT_ENTRY32(err_nomem)
+STATS_SECT_ENTRY32(err_ealready)
+STATS_SECT_ENTRY32(err_enotconn)
+STATS_SECT_ENTRY32(inflight_hwm)
+CX_STATS_SECT_LAT(wr_lat)
+STATS_SECT_END;
+
+STATS_NAME_START(cx_endpoint_c)
+STATS_NAME(cx_endpoint_c, rx_msgs)
+STATS_NAME(cx_endpoint_c, rx_bytes)
+STATS_NAME(cx_endpoint_c, rx_errors)
+STATS_NAME(cx_endpoint_c, rx_drops)
+STATS_NAME(cx_endpoint_c, rx_pauses)
+STATS_NAME(cx_endpoint_c, tx_msgs)
+STATS_NAME(cx_endpoint_c, tx_bytes)
+STATS_NAME(cx_endpoint_c, tx_writes)
+STATS_NAME(cx_endpoint_c, tx_errors)
+STATS_NAME(cx_endpoint_c, err_nomem)
+STATS_NAME(cx_endpoint_c, err_ealready)
+STATS_NAME(cx_endpoint_c, err_enotconn)
+STATS_NAME(cx_endpoint_c, inflight_hwm)
+CX_STATS_NAME_LAT(cx_endpoint_c, wr_lat)
+STATS_NAME_END(cx_endpoint_c);
+
+static STATS_SECT_DECL(cx_endpoint_c) cx_endpoint_c_stats;
+#endif
+
+enum {
+	CX_ENDPOINT_C_INITIALIZED,
+	CX_ENDPOINT_C_TX_NOTIF_ENABLED,
+	CX_ENDPOINT_C_RX_WRITE_PENDING,
+	CX_ENDPOINT_C_L2CAP_READY,
+	CX_ENDPOINT_C_L2CAP_TX,
+	CX_ENDPOINT_C_HASH_VALID,
+	CX_ENDPOINT_C_UNVERIFIED,
+	CX_ENDPOINT_C_RX_PAUSED,
+	CX_ENDPOINT_C_RX_FLOW_PENDING,
+	CX_ENDPOINT_C_COMP_TX,
+	CX_ENDPOINT_C_FRAME_PENDING,
+	CX_ENDPOINT_C_FRAMED,
+	CX_ENDPOINT_C_CREDITS_READ
+};
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+static int hash_read_start(struct bt_cx_endpoint_client *cx_endpoint_c);
+static struct bt_gatt_subscribe_params *
+cache_sub_params(struct bt_cx_endpoint_client *cx_endpoint_c);
+static void cache_detach(struct bt_cx_endpoint_client *cx_endpoint_c);
+#endif
+
+struct frame_recv_ctx {
+	struct bt_cx_endpoint_client *cx_endpoint;
+	uint8_t ret;
+};
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+static uint8_t rx_enqueue(struct bt_cx_endpoint_client *cx_endpoint_c,
+			  uint8_t id, const uint8_t *data, uint16_t len)
+{
+	struct net_buf *buf = NULL;
+
+	if (len <= CONFIG_BT_CX_ENDPOINT_CLIENT_RX_BUF_SIZE) {
+		buf = net_buf_alloc(&cx_endpoint_c_rx_pool, K_NO_WAIT);
+	}
+
+	if (!buf) {
+		cx_endpoint_c->rx_drops++;
+		CX_STATS_INC(cx_endpoint_c_stats, rx_drops);
+		LOG_WRN("Message of %u bytes dropped, no RX buffer", len);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	*(uint8_t *)net_buf_user_data(buf) = id;
+	net_buf_add_mem(buf, data, len);
+
+	/* Counted first, the application may release it right away. */
+	atomic_inc(&cx_endpoint_c->rx_count);
+	net_buf_put(&cx_endpoint_c->rx_fifo, buf);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+	if ((atomic_get(&cx_endpoint_c->rx_count) >= RX_PAUSE_HIGH) &&
+	    !atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_PAUSED)) {
+		k_work_submit(&cx_endpoint_c->rx_flow_work);
+	}
+#endif
+
+	return BT_GATT_ITER_CONTINUE;
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE */
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+static void rx_flow_written(struct bt_conn *conn, uint8_t err,
+			    struct bt_gatt_write_params *params)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(params, struct bt_cx_endpoint_client,
+			     rx_flow_params);
+
+	if (cx_endpoint_c->conn != conn) {
+		return;
+	}
+
+	if (err) {
+		/* Back to the state of the peer, retried by the next check. */
+		LOG_WRN("CCC write failed (err %u)", err);
+		if (cx_endpoint_c->rx_flow_ccc) {
+			atomic_set_bit(&cx_endpoint_c->state,
+				       CX_ENDPOINT_C_RX_PAUSED);
+		} else {
+			atomic_clear_bit(&cx_endpoint_c->state,
+					 CX_ENDPOINT_C_RX_PAUSED);
+		}
+	}
+
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_FLOW_PENDING);
+
+	/* The application may have caught up meanwhile. */
+	k_work_submit(&cx_endpoint_c->rx_flow_work);
+}
+
+/* Pause or resume notifications, one CCC write at a time. The
+ * subscription itself is kept, so that notifications sent by the peer
+ * before processing the write are still received.
+ */
+static void rx_flow_work_handler(struct k_work *work)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(work, struct bt_cx_endpoint_client, rx_flow_work);
+	atomic_val_t count = atomic_get(&cx_endpoint_c->rx_count);
+	bool pause;
+	int err;
+
+	if (!cx_endpoint_c->conn ||
+	    !atomic_test_bit(&cx_endpoint_c->state,
+			     CX_ENDPOINT_C_TX_NOTIF_ENABLED) ||
+	    atomic_test_bit(&cx_endpoint_c->state,
+			    CX_ENDPOINT_C_RX_FLOW_PENDING)) {
+		return;
+	}
+
+	pause = !atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_PAUSED);
+	if ((pause && (count < RX_PAUSE_HIGH)) ||
+	    (!pause && (count > RX_PAUSE_LOW))) {
+		return;
+	}
+
+	cx_endpoint_c->rx_flow_ccc = sys_cpu_to_le16(pause ? 0 :
+						     BT_GATT_CCC_NOTIFY);
+	cx_endpoint_c->rx_flow_params.func = rx_flow_written;
+	cx_endpoint_c->rx_flow_params.handle = cx_endpoint_c->handles.tx_ccc;
+	cx_endpoint_c->rx_flow_params.offset = 0;
+	cx_endpoint_c->rx_flow_params.data = &cx_endpoint_c->rx_flow_ccc;
+	cx_endpoint_c->rx_flow_params.length = sizeof(cx_endpoint_c->rx_flow_ccc);
+
+	atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_FLOW_PENDING);
+
+	err = bt_gatt_write(cx_endpoint_c->conn, &cx_endpoint_c->rx_flow_params);
+	if (err) {
+		LOG_WRN("CCC write not started (err %d)", err);
+		atomic_clear_bit(&cx_endpoint_c->state,
+				 CX_ENDPOINT_C_RX_FLOW_PENDING);
+		return;
+	}
+
+	if (pause) {
+		LOG_DBG("Notifications paused, %ld messages held", (long)count);
+		atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_PAUSED);
+		CX_STATS_INC(cx_endpoint_c_stats, rx_pauses);
+	} else {
+		LOG_DBG("Notifications resumed");
+		atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_PAUSED);
+	}
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE */
+
+/* Hand a whole message to the callback of its channel. */
+static uint8_t msg_received(struct bt_cx_endpoint_client *cx_endpoint_c,
+			    const uint8_t *data, uint16_t len)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+	const struct bt_cx_endpoint_client_chan *chan;
+	uint8_t hdr = len ? data[0] : BT_CX_ENDPOINT_CHAN_COUNT;
+	uint8_t id = CHAN_ID(hdr);
+
+	if ((id >= BT_CX_ENDPOINT_CHAN_COUNT) ||
+	    (!cx_endpoint_c->chan[id] && (id != BT_CX_ENDPOINT_CHAN_DEFAULT))) {
+		CX_STATS_INC(cx_endpoint_c_stats, rx_errors);
+		LOG_WRN("Message on unknown channel %u dropped", id);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	chan = cx_endpoint_c->chan[id];
+	data += BT_CX_ENDPOINT_CHAN_HDR_LEN;
+	len -= BT_CX_ENDPOINT_CHAN_HDR_LEN;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	if (hdr & BT_CX_ENDPOINT_CHAN_COMPRESSED) {
+		int ret = bt_cx_endpoint_comp_decode(data, len, comp_rx,
+						     sizeof(comp_rx));
+
+		if (ret < 0) {
+			CX_STATS_INC(cx_endpoint_c_stats, rx_errors);
+			LOG_WRN("Compressed message dropped (err %d)", ret);
+			return BT_GATT_ITER_CONTINUE;
+		}
+
+		data = comp_rx;
+		len = ret;
+	}
+#endif
+
+	CX_STATS_INC(cx_endpoint_c_stats, rx_msgs);
+	CX_STATS_INCN(cx_endpoint_c_stats, rx_bytes, len);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+	if (!chan || !chan->received) {
+		return rx_enqueue(cx_endpoint_c, id, data, len);
+	}
+#endif
+
+	if (chan) {
+		return chan->received ?
+		       chan->received(cx_endpoint_c, data, len) :
+		       BT_GATT_ITER_CONTINUE;
+	}
+#else
+	CX_STATS_INC(cx_endpoint_c_stats, rx_msgs);
+	CX_STATS_INCN(cx_endpoint_c_stats, rx_bytes, len);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+	return rx_enqueue(cx_endpoint_c, BT_CX_ENDPOINT_CHAN_DEFAULT, data, len);
+#endif
+#endif
+
+	if (cx_endpoint_c->cb.received) {
+		return cx_endpoint_c->cb.received(cx_endpoint_c, data, len);
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void frame_received(const uint8_t *data, uint16_t len, void *user_data)
+{
+	struct frame_recv_ctx *ctx = user_data;
+
+	if (msg_received(ctx->cx_endpoint, data, len) == BT_GATT_ITER_STOP) {
+		ctx->ret = BT_GATT_ITER_STOP;
+	}
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+static uint8_t frame_feed(struct bt_cx_endpoint_client *cx_endpoint,
+			  const void *data, uint16_t length)
+{
+	struct frame_recv_ctx ctx = {
+		.cx_endpoint = cx_endpoint,
+		.ret = BT_GATT_ITER_CONTINUE,
+	};
+	int err;
+
+	err = bt_cx_endpoint_frame_feed(&cx_endpoint->frame_rx, data, length,
+					frame_received, &ctx);
+	if (err) {
+		CX_STATS_INC(cx_endpoint_c_stats, rx_errors);
+		LOG_WRN("Notification dropped (err %d)", err);
+	}
+
+	return ctx.ret;
+}
+#endif
+
+static void notif_unsubscribed(struct bt_cx_endpoint_client *cx_endpoint)
+{
+	atomic_clear_bit(&cx_endpoint->state, CX_ENDPOINT_C_TX_NOTIF_ENABLED);
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	bt_cx_endpoint_frame_rx_reset(&cx_endpoint->frame_rx);
+#endif
+	if (cx_endpoint->cb.unsubscribed) {
+		cx_endpoint->cb.unsubscribed(cx_endpoint);
+	}
+}
+
+static uint8_t notif_received(struct bt_cx_endpoint_client *cx_endpoint,
+			      const void *data, uint16_t length)
+{
+	LOG_DBG("[NOTIFICATION] data %p length %u", data, length);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	/* From the response to the framing write on, see frame_written(). */
+	if (atomic_test_bit(&cx_endpoint->state, CX_ENDPOINT_C_FRAMED)) {
+		return frame_feed(cx_endpoint, data, length);
+	}
+#endif
+
+	return msg_received(cx_endpoint, data, length);
+}
+
+static uint8_t on_received(struct bt_conn *conn,
+			struct bt_gatt_subscribe_params *params,
+			const void *data, uint16_t length)
+{
+	struct bt_cx_endpoint_client *cx_endpoint;
+
+	/* Retrieve CX_ENDPOINT Client module context. */
+	cx_endpoint = CONTAINER_OF(params, struct bt_cx_endpoint_client, tx_notif_params);
+
+	if (!data) {
+		LOG_DBG("[UNSUBSCRIBED]");
+		params->value_handle = 0;
+		notif_unsubscribed(cx_endpoint);
+		return BT_GATT_ITER_STOP;
+	}
+
+	return notif_received(cx_endpoint, data, length);
+}
+
+static int write_pdu(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	int err;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+	cx_endpoint_c->write_stamp = k_uptime_get_32();
+#endif
+
+	err = bt_gatt_write(cx_endpoint_c->conn, &cx_endpoint_c->rx_write_params);
+	if (err == -ENOMEM) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_nomem);
+	}
+
+	return err;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+static int write_next_segment(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	uint16_t pdu_size = MIN(bt_gatt_get_mtu(cx_endpoint_c->conn) - 3,
+				sizeof(cx_endpoint_c->tx_pdu));
+
+	cx_endpoint_c->rx_write_params.data = cx_endpoint_c->tx_pdu;
+	cx_endpoint_c->rx_write_params.length = bt_cx_endpoint_frame_segment(
+		&cx_endpoint_c->frame_tx, cx_endpoint_c->tx_data,
+		cx_endpoint_c->tx_len, &cx_endpoint_c->tx_offset,
+		cx_endpoint_c->tx_pdu, pdu_size);
+
+	return write_pdu(cx_endpoint_c);
+}
+#endif
+
+static void on_sent(struct bt_conn *conn, uint8_t err,
+		    struct bt_gatt_write_params *params);
+static void write_done(struct bt_cx_endpoint_client *cx_endpoint_c,
+		       uint8_t err, const void *data, uint16_t length);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+static struct bt_cx_endpoint_client *l2cap_client(struct bt_l2cap_chan *chan)
+{
+	return CONTAINER_OF(chan, struct bt_cx_endpoint_client, l2cap.chan);
+}
+
+static void l2cap_connected(struct bt_l2cap_chan *chan)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c = l2cap_client(chan);
+
+	LOG_INF("L2CAP channel connected, MTU %u/%u",
+		cx_endpoint_c->l2cap.tx.mtu, cx_endpoint_c->l2cap.rx.mtu);
+
+	atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY);
+}
+
+static void l2cap_disconnected(struct bt_l2cap_chan *chan)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c = l2cap_client(chan);
+
+	LOG_DBG("L2CAP channel disconnected");
+
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY);
+
+	/* An SDU still in flight is never reported as sent. */
+	if (atomic_test_and_clear_bit(&cx_endpoint_c->state,
+				      CX_ENDPOINT_C_L2CAP_TX)) {
+		write_done(cx_endpoint_c, BT_ATT_ERR_UNLIKELY,
+			   cx_endpoint_c->tx_data, cx_endpoint_c->tx_len);
+	}
+}
+
+static struct net_buf *l2cap_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	return net_buf_alloc(&cx_endpoint_c_l2cap_rx_pool, K_NO_WAIT);
+}
+
+static int l2cap_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	/* There are no notifications to stop on this transport. */
+	(void)msg_received(l2cap_client(chan), buf->data, buf->len);
+
+	return 0;
+}
+
+static void l2cap_sent(struct bt_l2cap_chan *chan)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c = l2cap_client(chan);
+
+	if (!atomic_test_and_clear_bit(&cx_endpoint_c->state,
+				       CX_ENDPOINT_C_L2CAP_TX)) {
+		return;
+	}
+
+	CX_STATS_INC(cx_endpoint_c_stats, tx_writes);
+	CX_STATS_LAT(cx_endpoint_c_stats, wr_lat,
+		     k_uptime_get_32() - cx_endpoint_c->write_stamp);
+
+	write_done(cx_endpoint_c, 0, cx_endpoint_c->tx_data,
+		   cx_endpoint_c->tx_len);
+}
+
+static struct bt_l2cap_chan_ops l2cap_ops = {
+	.connected = l2cap_connected,
+	.disconnected = l2cap_disconnected,
+	.alloc_buf = l2cap_alloc_buf,
+	.recv = l2cap_recv,
+	.sent = l2cap_sent,
+};
+
+static uint8_t psm_read(struct bt_conn *conn, uint8_t err,
+			struct bt_gatt_read_params *params,
+			const void *data, uint16_t length)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(params, struct bt_cx_endpoint_client,
+			     psm_read_params);
+	uint16_t psm;
+	int ret;
+
+	if (err || !data || (length != sizeof(psm))) {
+		LOG_WRN("PSM read failed (err %u), staying on GATT", err);
+		return BT_GATT_ITER_STOP;
+	}
+
+	psm = sys_get_le16(data);
+
+	memset(&cx_endpoint_c->l2cap, 0, sizeof(cx_endpoint_c->l2cap));
+	cx_endpoint_c->l2cap.chan.ops = &l2cap_ops;
+	cx_endpoint_c->l2cap.rx.mtu = CONFIG_BT_CX_ENDPOINT_L2CAP_MTU;
+
+	ret = bt_l2cap_chan_connect(conn, &cx_endpoint_c->l2cap.chan, psm);
+	if (ret) {
+		LOG_WRN("L2CAP connect to PSM 0x%02x failed (err %d)", psm,
+			ret);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+/* Connect the bulk channel if the peer offers one. */
+static void l2cap_start(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	int err;
+
+	if (!cx_endpoint_c->handles.psm || cx_endpoint_c->l2cap.chan.conn) {
+		return;
+	}
+
+	cx_endpoint_c->psm_read_params.func = psm_read;
+	cx_endpoint_c->psm_read_params.handle_count = 1;
+	cx_endpoint_c->psm_read_params.single.handle = cx_endpoint_c->handles.psm;
+	cx_endpoint_c->psm_read_params.single.offset = 0;
+
+	err = bt_gatt_read(cx_endpoint_c->conn, &cx_endpoint_c->psm_read_params);
+	if (err) {
+		LOG_WRN("PSM read failed (err %d), staying on GATT", err);
+	}
+}
+
+static int l2cap_write(struct bt_cx_endpoint_client *cx_endpoint_c,
+		       const uint8_t *data, uint16_t len)
+{
+	struct net_buf *sdu;
+	int err;
+
+	if (len > MIN(cx_endpoint_c->l2cap.tx.mtu,
+		      CONFIG_BT_CX_ENDPOINT_L2CAP_MTU)) {
+		return -EMSGSIZE;
+	}
+
+	sdu = net_buf_alloc(&cx_endpoint_c_l2cap_tx_pool, K_NO_WAIT);
+	if (!sdu) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_nomem);
+		return -ENOMEM;
+	}
+
+	net_buf_reserve(sdu, BT_L2CAP_CHAN_SEND_RESERVE);
+	net_buf_add_mem(sdu, data, len);
+
+	cx_endpoint_c->tx_data = data;
+	cx_endpoint_c->tx_len = len;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+	cx_endpoint_c->write_stamp = k_uptime_get_32();
+#endif
+
+	/* The SDU may be reported sent before the call returns. */
+	atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_TX);
+
+	err = bt_l2cap_chan_send(&cx_endpoint_c->l2cap.chan, sdu);
+	if (err < 0) {
+		atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_TX);
+		net_buf_unref(sdu);
+		return err;
+	}
+
+	return 0;
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_L2CAP */
+
+/* Whether the peer frames the messages of the link. */
+static bool tx_framed(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	return IS_ENABLED(CONFIG_BT_CX_ENDPOINT_FRAMING) &&
+	       atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAMED);
+}
+
+/* Start writing a message, segment by segment on a framed link. */
+static int write_start(struct bt_cx_endpoint_client *cx_endpoint_c,
+		       const uint8_t *data, uint16_t len)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	/* Once connected, the channel carries every message. */
+	if (atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY)) {
+		return l2cap_write(cx_endpoint_c, data, len);
+	}
+#endif
+
+	cx_endpoint_c->rx_write_params.func = on_sent;
+	cx_endpoint_c->rx_write_params.handle = cx_endpoint_c->handles.rx;
+	cx_endpoint_c->rx_write_params.offset = 0;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	/* An unframed message is written whole, in a single PDU. */
+	cx_endpoint_c->tx_data = data;
+	cx_endpoint_c->tx_len = len;
+	cx_endpoint_c->tx_offset = tx_framed(cx_endpoint_c) ? 0 : len;
+
+	if (!cx_endpoint_c->tx_offset) {
+		return write_next_segment(cx_endpoint_c);
+	}
+#endif
+
+	cx_endpoint_c->rx_write_params.data = data;
+	cx_endpoint_c->rx_write_params.length = len;
+
+	return write_pdu(cx_endpoint_c);
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+static uint8_t queue_chan(struct bt_cx_endpoint_client *cx_endpoint_c,
+			  uint8_t pos)
+{
+	uint8_t slot = (cx_endpoint_c->tx_head + pos) % TX_QUEUE_LEN;
+
+	return CHAN_ID(cx_endpoint_c->tx_queue[slot]->data[0]);
+}
+
+/* Move the next message to serve to the head of the queue, keeping the
+ * order of the messages of every channel. Called with tx_lock held.
+ */
+static void queue_schedule(struct bt_cx_endpoint_client *cx_endpoint_c,
+			   struct bt_cx_endpoint_chan_sched *sched)
+{
+	struct net_buf *buf;
+	uint32_t backlog = 0;
+	uint8_t slot;
+	uint8_t prev;
+	uint8_t id;
+	uint8_t i;
+
+	for (i = 0; i < cx_endpoint_c->tx_count; i++) {
+		backlog |= BIT(queue_chan(cx_endpoint_c, i));
+	}
+
+	id = bt_cx_endpoint_chan_pick(sched, cx_endpoint_c->chan_param,
+				      backlog);
+
+	for (i = 0; queue_chan(cx_endpoint_c, i) != id; i++) {
+	}
+
+	/* Messages skipped over all belong to other channels. */
+	for (; i > 0; i--) {
+		slot = (cx_endpoint_c->tx_head + i) % TX_QUEUE_LEN;
+		prev = (cx_endpoint_c->tx_head + i - 1) % TX_QUEUE_LEN;
+
+		buf = cx_endpoint_c->tx_queue[slot];
+		cx_endpoint_c->tx_queue[slot] = cx_endpoint_c->tx_queue[prev];
+		cx_endpoint_c->tx_queue[prev] = buf;
+	}
+
+	bt_cx_endpoint_chan_served(sched, cx_endpoint_c->chan_param, id);
+}
+#else
+static void queue_schedule(struct bt_cx_endpoint_client *cx_endpoint_c,
+			   struct bt_cx_endpoint_chan_sched *sched)
+{
+}
+#endif
+
+static struct net_buf *queue_pop(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	struct net_buf *buf = cx_endpoint_c->tx_queue[cx_endpoint_c->tx_head];
+
+	cx_endpoint_c->tx_head = (cx_endpoint_c->tx_head + 1) % TX_QUEUE_LEN;
+	cx_endpoint_c->tx_count--;
+	cx_endpoint_c->tx_queue_offset = 0;
+
+	return buf;
+}
+
+static struct net_buf *inflight_pop(struct bt_cx_endpoint_client *cx_endpoint_c,
+				    bool *last, uint32_t *stamp)
+{
+	uint8_t slot = cx_endpoint_c->inflight_head;
+
+	cx_endpoint_c->inflight_head = (cx_endpoint_c->inflight_head + 1) %
+				       TX_WINDOW;
+	cx_endpoint_c->inflight_count--;
+
+	*last = cx_endpoint_c->tx_inflight[slot].last;
+	*stamp = cx_endpoint_c->tx_inflight[slot].stamp;
+
+	return cx_endpoint_c->tx_inflight[slot].buf;
+}
+
+static void inflight_push(struct bt_cx_endpoint_client *cx_endpoint_c,
+			  struct net_buf *buf, bool last, uint32_t stamp)
+{
+	uint8_t slot = (cx_endpoint_c->inflight_head +
+			cx_endpoint_c->inflight_count) % TX_WINDOW;
+
+	cx_endpoint_c->tx_inflight[slot].buf = buf;
+	cx_endpoint_c->tx_inflight[slot].last = last;
+	cx_endpoint_c->tx_inflight[slot].stamp = stamp;
+	cx_endpoint_c->inflight_count++;
+
+	CX_STATS_MAX(cx_endpoint_c_stats, inflight_hwm,
+		     cx_endpoint_c->inflight_count);
+}
+
+static struct tx_meta *tx_meta(struct net_buf *buf)
+{
+	return net_buf_user_data(buf);
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+static void tx_buf_destroy(struct net_buf *buf)
+{
+	struct net_buf *orig = tx_meta(buf)->orig;
+
+	if (orig) {
+		tx_meta(buf)->orig = NULL;
+		net_buf_unref(orig);
+	}
+
+	net_buf_destroy(buf);
+}
+
+/* Compressed copy of a queued message, holding the reference to the
+ * message, or the message itself if it is to be written as is.
+ */
+static struct net_buf *tx_compress(struct bt_cx_endpoint_client *cx_endpoint_c,
+				   struct net_buf *buf)
+{
+	uint16_t len = buf->len - CHAN_HDR_LEN;
+	struct net_buf *comp;
+	int ret;
+
+	if ((len < CONFIG_BT_CX_ENDPOINT_COMP_MIN_LEN) ||
+	    !atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_COMP_TX)) {
+		return buf;
+	}
+
+	comp = net_buf_alloc(&cx_endpoint_c_tx_pool, K_NO_WAIT);
+	if (!comp) {
+		return buf;
+	}
+
+	tx_meta(comp)->orig = NULL;
+	net_buf_add_u8(comp, buf->data[0] | BT_CX_ENDPOINT_CHAN_COMPRESSED);
+
+	ret = bt_cx_endpoint_comp_encode(buf->data + CHAN_HDR_LEN, len,
+					 net_buf_tail(comp),
+					 MIN(net_buf_tailroom(comp), len - 1));
+	if (ret < 0) {
+		net_buf_unref(comp);
+		return buf;
+	}
+
+	net_buf_add(comp, ret);
+	tx_meta(comp)->flags = tx_meta(buf)->flags;
+	tx_meta(comp)->orig = buf;
+
+	return comp;
+}
+#endif
+
+/* Report a message of the queue to its channel or to the instance, and
+ * release it.
+ */
+static void tx_complete(struct bt_cx_endpoint_client *cx_endpoint_c,
+			struct net_buf *buf, uint8_t err)
+{
+	/* Callbacks are given the message as it was queued. */
+	struct net_buf *msg = buf;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	if (tx_meta(buf)->orig) {
+		msg = tx_meta(buf)->orig;
+	}
+#endif
+
+	const uint8_t *data = msg->data + CHAN_HDR_LEN;
+	uint16_t len = msg->len - CHAN_HDR_LEN;
+
+	if (err) {
+		CX_STATS_INC(cx_endpoint_c_stats, tx_errors);
+	} else {
+		CX_STATS_INC(cx_endpoint_c_stats, tx_msgs);
+		CX_STATS_INCN(cx_endpoint_c_stats, tx_bytes, len);
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+	const struct bt_cx_endpoint_client_chan *chan =
+		cx_endpoint_c->chan[CHAN_ID(msg->data[0])];
 
-static uint8_t on_received(struct bt_conn *conn,
-			struct bt_gatt_subscribe_params *params,
-			const void *data, uint16_t length)
+	if (chan) {
+		if (chan->sent) {
+			chan->sent(cx_endpoint_c, err, data, len);
+		}
+
+		net_buf_unref(buf);
+		return;
+	}
+#endif
+
+	if (cx_endpoint_c->cb.sent) {
+		cx_endpoint_c->cb.sent(cx_endpoint_c, err, data, len);
+	}
+
+	net_buf_unref(buf);
+}
+
+static void write_complete(struct bt_conn *conn, void *user_data)
 {
-	struct bt_cx_endpoint_client *cx_endpoint;
+	struct bt_cx_endpoint_client *cx_endpoint_c = user_data;
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint32_t stamp;
+	bool last;
 
-	/* Retrieve CX_ENDPOINT Client module context. */
-	cx_endpoint = CONTAINER_OF(params, struct bt_cx_endpoint_client, tx_notif_params);
+	key = k_spin_lock(&tx_lock);
+	if ((cx_endpoint_c->conn != conn) || !cx_endpoint_c->inflight_count) {
+		k_spin_unlock(&tx_lock, key);
+		return;
+	}
+	buf = inflight_pop(cx_endpoint_c, &last, &stamp);
+	k_spin_unlock(&tx_lock, key);
 
-	if (!data) {
-		LOG_DBG("[UNSUBSCRIBED]");
-		params->value_handle = 0;
-		atomic_clear_bit(&cx_endpoint->state, CX_ENDPOINT_C_TX_NOTIF_ENABLED);
-		if (cx_endpoint->cb.unsubscribed) {
-			cx_endpoint->cb.unsubscribed();
-		}
+	CX_STATS_INC(cx_endpoint_c_stats, tx_writes);
+	CX_STATS_LAT(cx_endpoint_c_stats, wr_lat, k_uptime_get_32() - stamp);
+
+	/* Leading segments of a message hold no reference, the message is
+	 * reported with its last segment.
+	 */
+	if (last) {
+		tx_complete(cx_endpoint_c, buf, 0);
+	}
+
+	/* A window slot is free again, keep the link busy. */
+	k_delayed_work_submit(&cx_endpoint_c->tx_work, K_NO_WAIT);
+}
+
+/* Whether the next message goes as a whole, acknowledged or over L2CAP,
+ * rather than written without response.
+ */
+static bool tx_single(struct bt_cx_endpoint_client *cx_endpoint_c,
+		      struct net_buf *buf)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	if (atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY)) {
+		return true;
+	}
+#endif
+
+	return (tx_meta(buf)->flags & TX_FLAG_RELIABLE) != 0;
+}
+
+/* Whether the peer buffers one more write of the link, tx_lock held. The
+ * L2CAP channel has credits of its own.
+ */
+static bool credit_available(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	if (atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY)) {
+		return true;
+	}
+#endif
+
+	if (!cx_endpoint_c->handles.credits) {
+		return true;
+	}
+
+	return (uint16_t)(cx_endpoint_c->credits_writes -
+			  cx_endpoint_c->credits_base) <
+	       cx_endpoint_c->credits;
+}
+
+static uint8_t credits_read(struct bt_conn *conn, uint8_t err,
+			    struct bt_gatt_read_params *params,
+			    const void *data, uint16_t length)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(params, struct bt_cx_endpoint_client,
+			     credits_read_params);
+	const struct bt_cx_endpoint_credits *value = data;
+	k_spinlock_key_t key;
+	bool available;
+
+	/* Released while the read was pending. */
+	if (cx_endpoint_c->conn != conn) {
 		return BT_GATT_ITER_STOP;
 	}
 
-	LOG_DBG("[NOTIFICATION] data %p length %u", data, length);
-	if (cx_endpoint->cb.received) {
-		return cx_endpoint->cb.received(data, length);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_CREDITS_READ);
+
+	if (err || !data || (length != sizeof(*value))) {
+		LOG_WRN("Credits read failed (err %u)", err);
+		k_delayed_work_submit(&cx_endpoint_c->tx_work, TX_RETRY_DELAY);
+		return BT_GATT_ITER_STOP;
 	}
 
-	return BT_GATT_ITER_CONTINUE;
+	/* Writes issued after the read are still held, on top of the ones
+	 * the peer reported.
+	 */
+	key = k_spin_lock(&tx_lock);
+	cx_endpoint_c->credits = sys_le16_to_cpu(value->credits);
+	cx_endpoint_c->credits_base = cx_endpoint_c->credits_mark -
+				      sys_le16_to_cpu(value->pending);
+	available = credit_available(cx_endpoint_c);
+	k_spin_unlock(&tx_lock, key);
+
+	/* Read again later while the peer consumes nothing. */
+	k_delayed_work_submit(&cx_endpoint_c->tx_work,
+			      available ? K_NO_WAIT : TX_RETRY_DELAY);
+
+	return BT_GATT_ITER_STOP;
+}
+
+/* Ask the peer how many writes of the link it still holds, called from
+ * the TX work only.
+ */
+static void credits_refresh(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	int err;
+
+	if (atomic_test_and_set_bit(&cx_endpoint_c->state,
+				    CX_ENDPOINT_C_CREDITS_READ)) {
+		return;
+	}
+
+	cx_endpoint_c->credits_mark = cx_endpoint_c->credits_writes;
+	cx_endpoint_c->credits_read_params.func = credits_read;
+	cx_endpoint_c->credits_read_params.handle_count = 1;
+	cx_endpoint_c->credits_read_params.single.handle =
+		cx_endpoint_c->handles.credits;
+	cx_endpoint_c->credits_read_params.single.offset = 0;
+
+	err = bt_gatt_read(cx_endpoint_c->conn,
+			   &cx_endpoint_c->credits_read_params);
+	if (err) {
+		LOG_WRN("Credits read failed (err %d)", err);
+		atomic_clear_bit(&cx_endpoint_c->state,
+				 CX_ENDPOINT_C_CREDITS_READ);
+		k_delayed_work_submit(&cx_endpoint_c->tx_work, TX_RETRY_DELAY);
+	}
+}
+
+/* Account for a write issued on the link, asking for the credits back
+ * before they run out.
+ */
+static void credit_take(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	k_spinlock_key_t key;
+	uint16_t used;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	if (atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY)) {
+		return;
+	}
+#endif
+
+	if (!cx_endpoint_c->handles.credits) {
+		return;
+	}
+
+	key = k_spin_lock(&tx_lock);
+	cx_endpoint_c->credits_writes++;
+	used = cx_endpoint_c->credits_writes - cx_endpoint_c->credits_base;
+	k_spin_unlock(&tx_lock, key);
+
+	if (used >= DIV_ROUND_UP(cx_endpoint_c->credits, 2)) {
+		credits_refresh(cx_endpoint_c);
+	}
+}
+
+static void tx_work_handler(struct k_work *work)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(work, struct bt_cx_endpoint_client, tx_work);
+	struct bt_cx_endpoint_chan_sched sched;
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	const uint8_t *pdu;
+	uint16_t pdu_size;
+	uint16_t pdu_len;
+	uint16_t offset;
+	uint32_t stamp;
+	bool last;
+	int err;
+
+	for (;;) {
+		key = k_spin_lock(&tx_lock);
+		if (!cx_endpoint_c->conn || !cx_endpoint_c->tx_count ||
+		    cx_endpoint_c->tx_buf ||
+		    atomic_test_bit(&cx_endpoint_c->state,
+				    CX_ENDPOINT_C_UNVERIFIED) ||
+		    atomic_test_bit(&cx_endpoint_c->state,
+				    CX_ENDPOINT_C_FRAME_PENDING) ||
+		    (cx_endpoint_c->inflight_count >= TX_WINDOW)) {
+			k_spin_unlock(&tx_lock, key);
+			return;
+		}
+
+		if (!credit_available(cx_endpoint_c)) {
+			k_spin_unlock(&tx_lock, key);
+
+			/* Resumed once the peer consumed some of the writes. */
+			credits_refresh(cx_endpoint_c);
+			return;
+		}
+
+		/* Messages are scheduled as they are started, a message
+		 * partially written is completed first.
+		 */
+		sched = cx_endpoint_c->sched;
+		if (!cx_endpoint_c->tx_queue_offset) {
+			queue_schedule(cx_endpoint_c, &sched);
+		}
+		buf = cx_endpoint_c->tx_queue[cx_endpoint_c->tx_head];
+		offset = cx_endpoint_c->tx_queue_offset;
+		k_spin_unlock(&tx_lock, key);
+
+		if (!offset && tx_single(cx_endpoint_c, buf)) {
+			/* Write responses and SDU completions are not ordered
+			 * with writes without response, so the window drains
+			 * first. Resumed by the last completion.
+			 */
+			if (cx_endpoint_c->inflight_count) {
+				return;
+			}
+
+			/* Left at the queue head until write_done(). */
+			cx_endpoint_c->tx_buf = buf;
+
+			err = write_start(cx_endpoint_c, buf->data, buf->len);
+			if (!err) {
+				cx_endpoint_c->sched = sched;
+				credit_take(cx_endpoint_c);
+				return;
+			}
+
+			cx_endpoint_c->tx_buf = NULL;
+		} else {
+			pdu_size = bt_gatt_get_mtu(cx_endpoint_c->conn) - 3;
+			err = 0;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+			struct bt_cx_endpoint_frame_tx frame_tx =
+				cx_endpoint_c->frame_tx;
+
+			if (tx_framed(cx_endpoint_c)) {
+				pdu = cx_endpoint_c->tx_pdu;
+				pdu_len = bt_cx_endpoint_frame_segment(
+					&frame_tx, buf->data, buf->len, &offset,
+					cx_endpoint_c->tx_pdu,
+					MIN(pdu_size,
+					    sizeof(cx_endpoint_c->tx_pdu)));
+				last = (offset == buf->len);
+			} else
+#endif
+			{
+				pdu = buf->data;
+				pdu_len = buf->len;
+				last = true;
+				if (pdu_len > pdu_size) {
+					err = -EMSGSIZE;
+				}
+			}
+
+			stamp = k_uptime_get_32();
+
+			/* The data is copied by the host, tx_pdu is free again
+			 * once the call returns.
+			 */
+			if (!err) {
+				err = bt_gatt_write_without_response_cb(
+					cx_endpoint_c->conn,
+					cx_endpoint_c->handles.rx, pdu, pdu_len,
+					false, write_complete, cx_endpoint_c);
+			}
+
+			if (!err) {
+				key = k_spin_lock(&tx_lock);
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+				cx_endpoint_c->frame_tx = frame_tx;
+#endif
+				cx_endpoint_c->sched = sched;
+				if (last) {
+					queue_pop(cx_endpoint_c);
+				} else {
+					cx_endpoint_c->tx_queue_offset = offset;
+				}
+				inflight_push(cx_endpoint_c, buf, last, stamp);
+				k_spin_unlock(&tx_lock, key);
+				credit_take(cx_endpoint_c);
+				continue;
+			}
+		}
+
+		if (err == -ENOMEM) {
+			/* Host buffers exhausted, resume on the next completion
+			 * or after a short delay if nothing is in flight.
+			 */
+			CX_STATS_INC(cx_endpoint_c_stats, err_nomem);
+			if (!cx_endpoint_c->inflight_count) {
+				k_delayed_work_submit(&cx_endpoint_c->tx_work,
+						      TX_RETRY_DELAY);
+			}
+			return;
+		}
+
+		LOG_WRN("Write failed (err %d)", err);
+
+		key = k_spin_lock(&tx_lock);
+		cx_endpoint_c->sched = sched;
+		buf = queue_pop(cx_endpoint_c);
+		k_spin_unlock(&tx_lock, key);
+
+		tx_complete(cx_endpoint_c, buf, BT_ATT_ERR_UNLIKELY);
+	}
+}
+
+static int queue_send(struct bt_cx_endpoint_client *cx_endpoint_c, uint8_t id,
+		      uint8_t flags, const uint8_t *data, uint16_t len)
+{
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint8_t slot;
+
+	if (len > (CONFIG_BT_CX_ENDPOINT_CLIENT_TX_BUF_SIZE - CHAN_HDR_LEN)) {
+		return -EMSGSIZE;
+	}
+
+	buf = net_buf_alloc(&cx_endpoint_c_tx_pool, K_NO_WAIT);
+	if (!buf) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_nomem);
+		return -ENOMEM;
+	}
+
+	tx_meta(buf)->flags = flags;
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	tx_meta(buf)->orig = NULL;
+#endif
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+	net_buf_add_u8(buf, id);
+#else
+	ARG_UNUSED(id);
+#endif
+	net_buf_add_mem(buf, data, len);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	buf = tx_compress(cx_endpoint_c, buf);
+#endif
+
+	key = k_spin_lock(&tx_lock);
+	if (cx_endpoint_c->tx_count >= TX_QUEUE_LEN) {
+		k_spin_unlock(&tx_lock, key);
+		net_buf_unref(buf);
+		CX_STATS_INC(cx_endpoint_c_stats, err_nomem);
+		return -ENOMEM;
+	}
+
+	slot = (cx_endpoint_c->tx_head + cx_endpoint_c->tx_count) %
+	       TX_QUEUE_LEN;
+	cx_endpoint_c->tx_queue[slot] = buf;
+	cx_endpoint_c->tx_count++;
+	k_spin_unlock(&tx_lock, key);
+
+	k_delayed_work_submit(&cx_endpoint_c->tx_work, K_NO_WAIT);
+
+	return 0;
+}
+
+/* Report every queued and in-flight message as failed. */
+static void tx_flush(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+	uint32_t stamp;
+	bool last;
+
+	k_delayed_work_cancel(&cx_endpoint_c->tx_work);
+
+	for (;;) {
+		last = true;
+
+		key = k_spin_lock(&tx_lock);
+		if (cx_endpoint_c->inflight_count) {
+			buf = inflight_pop(cx_endpoint_c, &last, &stamp);
+		} else if (cx_endpoint_c->tx_count) {
+			buf = queue_pop(cx_endpoint_c);
+		} else {
+			break;
+		}
+		k_spin_unlock(&tx_lock, key);
+
+		/* A partially written message is still at the queue head. */
+		if (last) {
+			tx_complete(cx_endpoint_c, buf, BT_ATT_ERR_UNLIKELY);
+		}
+	}
+	cx_endpoint_c->tx_buf = NULL;
+	cx_endpoint_c->credits = 0;
+	cx_endpoint_c->credits_writes = 0;
+	cx_endpoint_c->credits_base = 0;
+	k_spin_unlock(&tx_lock, key);
 }
+#endif /* CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE */
 
 static void on_sent(struct bt_conn *conn, uint8_t err,
 		    struct bt_gatt_write_params *params)
@@ -61,10 +1277,64 @@ static void on_sent(struct bt_conn *conn, uint8_t err,
 	data = params->data;
 	length = params->length;
 
+	CX_STATS_INC(cx_endpoint_c_stats, tx_writes);
+	CX_STATS_LAT(cx_endpoint_c_stats, wr_lat,
+		     k_uptime_get_32() - cx_endpoint_c->write_stamp);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	/* Report the whole message once its last segment is written. */
+	if (!err && (cx_endpoint_c->tx_offset < cx_endpoint_c->tx_len)) {
+		if (!write_next_segment(cx_endpoint_c)) {
+			return;
+		}
+
+		err = BT_ATT_ERR_UNLIKELY;
+	}
+
+	data = cx_endpoint_c->tx_data;
+	length = cx_endpoint_c->tx_len;
+#endif
+
+	write_done(cx_endpoint_c, err, data, length);
+}
+
+/* Report the message being written and start the next queued one. */
+static void write_done(struct bt_cx_endpoint_client *cx_endpoint_c,
+		       uint8_t err, const void *data, uint16_t length)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+
+	/* Reported from the queued buffer, without the channel ID. */
+	ARG_UNUSED(data);
+	ARG_UNUSED(length);
+
+	if (!cx_endpoint_c->tx_buf) {
+		return;
+	}
+
+	key = k_spin_lock(&tx_lock);
+	cx_endpoint_c->tx_buf = NULL;
+	buf = queue_pop(cx_endpoint_c);
+	k_spin_unlock(&tx_lock, key);
+
+	tx_complete(cx_endpoint_c, buf, err);
+
+	k_delayed_work_submit(&cx_endpoint_c->tx_work, K_NO_WAIT);
+#else
+	if (err) {
+		CX_STATS_INC(cx_endpoint_c_stats, tx_errors);
+	} else {
+		CX_STATS_INC(cx_endpoint_c_stats, tx_msgs);
+		CX_STATS_INCN(cx_endpoint_c_stats, tx_bytes, length);
+	}
+
 	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_WRITE_PENDING);
 	if (cx_endpoint_c->cb.sent) {
-		cx_endpoint_c->cb.sent(err, data, length);
+		cx_endpoint_c->cb.sent(cx_endpoint_c, err, data, length);
 	}
+#endif
 }
 
 int bt_cx_endpoint_client_init(struct bt_cx_endpoint_client *cx_endpoint_c,
@@ -80,6 +1350,44 @@ int bt_cx_endpoint_client_init(struct bt_cx_endpoint_client *cx_endpoint_c,
 
 	memcpy(&cx_endpoint_c->cb, &cx_endpoint_c_init->cb, sizeof(cx_endpoint_c->cb));
 
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+	bt_cx_endpoint_chan_param_init(cx_endpoint_c->chan_param);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	k_delayed_work_init(&cx_endpoint_c->tx_work, tx_work_handler);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+	k_fifo_init(&cx_endpoint_c->rx_fifo);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+	k_work_init(&cx_endpoint_c->rx_flow_work, rx_flow_work_handler);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+	int err = cx_endpoint_client_rpc_init(cx_endpoint_c);
+
+	if (err) {
+		LOG_ERR("RPC channel not registered (err %d)", err);
+		return err;
+	}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+	static bool stats_registered;
+
+	if (!stats_registered) {
+		stats_init_and_reg(STATS_HDR(cx_endpoint_c_stats),
+				   STATS_SIZE_INIT_PARMS(cx_endpoint_c_stats,
+							 STATS_SIZE_32),
+				   STATS_NAME_INIT_PARMS(cx_endpoint_c),
+				   "cx_endpoint_c");
+		stats_registered = true;
+	}
+#endif
+
 	return 0;
 }
 
@@ -89,26 +1397,244 @@ int bt_cx_endpoint_client_send(struct bt_cx_endpoint_client *cx_endpoint_c, cons
 	int err;
 
 	if (!cx_endpoint_c->conn) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_enotconn);
 		return -ENOTCONN;
 	}
 
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	ARG_UNUSED(err);
+
+	return queue_send(cx_endpoint_c, BT_CX_ENDPOINT_CHAN_DEFAULT, 0, data,
+			  len);
+#else
+	if (atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_UNVERIFIED) ||
+	    atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAME_PENDING)) {
+		return -EAGAIN;
+	}
+
 	if (atomic_test_and_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_WRITE_PENDING)) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_ealready);
 		return -EALREADY;
 	}
 
-	cx_endpoint_c->rx_write_params.func = on_sent;
-	cx_endpoint_c->rx_write_params.handle = cx_endpoint_c->handles.rx;
-	cx_endpoint_c->rx_write_params.offset = 0;
-	cx_endpoint_c->rx_write_params.data = data;
-	cx_endpoint_c->rx_write_params.length = len;
+	err = write_start(cx_endpoint_c, data, len);
+	if (err) {
+		atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_WRITE_PENDING);
+	}
 
-	err = bt_gatt_write(cx_endpoint_c->conn, &cx_endpoint_c->rx_write_params);
+	return err;
+#endif /* CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE */
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+int bt_cx_endpoint_client_send_reliable(struct bt_cx_endpoint_client *cx_endpoint_c,
+					const uint8_t *data, uint16_t len)
+{
+	if (!cx_endpoint_c->conn) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_enotconn);
+		return -ENOTCONN;
+	}
+
+	return queue_send(cx_endpoint_c, BT_CX_ENDPOINT_CHAN_DEFAULT,
+			  TX_FLAG_RELIABLE, data, len);
+}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+struct net_buf *bt_cx_endpoint_client_recv(struct bt_cx_endpoint_client *cx_endpoint_c,
+					   k_timeout_t timeout)
+{
+	return net_buf_get(&cx_endpoint_c->rx_fifo, timeout);
+}
+
+void bt_cx_endpoint_client_recv_done(struct bt_cx_endpoint_client *cx_endpoint_c,
+				     struct net_buf *buf)
+{
+	net_buf_unref(buf);
+	atomic_dec(&cx_endpoint_c->rx_count);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+	if (atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_PAUSED) &&
+	    (atomic_get(&cx_endpoint_c->rx_count) <= RX_PAUSE_LOW)) {
+		k_work_submit(&cx_endpoint_c->rx_flow_work);
+	}
+#endif
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE */
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CHANNELS)
+int bt_cx_endpoint_client_chan_register(struct bt_cx_endpoint_client *cx_endpoint_c,
+					struct bt_cx_endpoint_client_chan *chan)
+{
+	if (!cx_endpoint_c || !chan ||
+	    (chan->id >= BT_CX_ENDPOINT_CHAN_COUNT) || !chan->weight) {
+		return -EINVAL;
+	}
+
+	if (cx_endpoint_c->chan[chan->id]) {
+		return -EALREADY;
+	}
+
+	cx_endpoint_c->chan_param[chan->id].prio = chan->prio;
+	cx_endpoint_c->chan_param[chan->id].weight = chan->weight;
+	cx_endpoint_c->chan[chan->id] = chan;
+
+	return 0;
+}
+
+int bt_cx_endpoint_client_chan_send(struct bt_cx_endpoint_client *cx_endpoint_c,
+				    const struct bt_cx_endpoint_client_chan *chan,
+				    const uint8_t *data, uint16_t len)
+{
+	if (!chan) {
+		return -EINVAL;
+	}
+
+	if (!cx_endpoint_c->conn) {
+		CX_STATS_INC(cx_endpoint_c_stats, err_enotconn);
+		return -ENOTCONN;
+	}
+
+	return queue_send(cx_endpoint_c, chan->id,
+			  chan->reliable ? TX_FLAG_RELIABLE : 0, data, len);
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_CHANNELS */
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+static void comp_written(struct bt_conn *conn, uint8_t err,
+			 struct bt_gatt_write_params *params)
+{
+	if (err) {
+		LOG_WRN("Codecs not written (err %u), notifications not "
+			"compressed", err);
+	}
+}
+
+static uint8_t comp_read(struct bt_conn *conn, uint8_t err,
+			 struct bt_gatt_read_params *params,
+			 const void *data, uint16_t length)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(params, struct bt_cx_endpoint_client,
+			     comp_read_params);
+	int ret;
+
+	if (err || !data || (length != sizeof(uint8_t))) {
+		LOG_WRN("Codecs read failed (err %u), not compressing", err);
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (*(const uint8_t *)data & BT_CX_ENDPOINT_COMP_SUPPORTED) {
+		LOG_DBG("Writes compressed");
+		atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_COMP_TX);
+	}
+
+	/* The peer compresses its notifications once it knows our codecs. */
+	cx_endpoint_c->comp_codecs = BT_CX_ENDPOINT_COMP_SUPPORTED;
+	cx_endpoint_c->comp_write_params.func = comp_written;
+	cx_endpoint_c->comp_write_params.handle = cx_endpoint_c->handles.comp;
+	cx_endpoint_c->comp_write_params.offset = 0;
+	cx_endpoint_c->comp_write_params.data = &cx_endpoint_c->comp_codecs;
+	cx_endpoint_c->comp_write_params.length =
+		sizeof(cx_endpoint_c->comp_codecs);
+
+	ret = bt_gatt_write(conn, &cx_endpoint_c->comp_write_params);
+	if (ret) {
+		LOG_WRN("Codecs not written (err %d)", ret);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+/* Negotiate compression if the peer offers it. */
+static void comp_start(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	int err;
+
+	if (!cx_endpoint_c->handles.comp) {
+		return;
+	}
+
+	cx_endpoint_c->comp_read_params.func = comp_read;
+	cx_endpoint_c->comp_read_params.handle_count = 1;
+	cx_endpoint_c->comp_read_params.single.handle =
+		cx_endpoint_c->handles.comp;
+	cx_endpoint_c->comp_read_params.single.offset = 0;
+
+	err = bt_gatt_read(cx_endpoint_c->conn,
+			   &cx_endpoint_c->comp_read_params);
+	if (err) {
+		LOG_WRN("Codecs read failed (err %d), not compressing", err);
+	}
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_COMPRESSION */
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+static void frame_written(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_write_params *params)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(params, struct bt_cx_endpoint_client,
+			     frame_write_params);
+
+	/* Released while the write was pending. */
+	if (cx_endpoint_c->conn != conn) {
+		return;
+	}
+
+	/* The peer frames its notifications from the write on, the ones
+	 * received before this response were not.
+	 */
+	if (err) {
+		LOG_WRN("Framing not turned on (err %u), messages limited to "
+			"one PDU", err);
+	} else {
+		LOG_DBG("Messages framed");
+		atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAMED);
+	}
+
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAME_PENDING);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	/* Messages queued while the write was pending. */
+	k_delayed_work_submit(&cx_endpoint_c->tx_work, K_NO_WAIT);
+#endif
+}
+
+/* Frame the messages of the link if the peer supports it. Writes are held
+ * until the response, which unlike them is ordered with the write.
+ */
+static void frame_start(struct bt_cx_endpoint_client *cx_endpoint_c,
+			struct bt_conn *conn)
+{
+	static const uint8_t frame_on = BT_CX_ENDPOINT_FRAMING_ON;
+	int err;
+
+	if (!cx_endpoint_c->handles.frame ||
+	    atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAMED)) {
+		return;
+	}
+
+	if (atomic_test_and_set_bit(&cx_endpoint_c->state,
+				    CX_ENDPOINT_C_FRAME_PENDING)) {
+		return;
+	}
+
+	cx_endpoint_c->frame_write_params.func = frame_written;
+	cx_endpoint_c->frame_write_params.handle = cx_endpoint_c->handles.frame;
+	cx_endpoint_c->frame_write_params.offset = 0;
+	cx_endpoint_c->frame_write_params.data = &frame_on;
+	cx_endpoint_c->frame_write_params.length = sizeof(frame_on);
+
+	err = bt_gatt_write(conn, &cx_endpoint_c->frame_write_params);
 	if (err) {
-		atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_WRITE_PENDING);
+		LOG_WRN("Framing write failed (err %d), messages limited to "
+			"one PDU", err);
+		atomic_clear_bit(&cx_endpoint_c->state,
+				 CX_ENDPOINT_C_FRAME_PENDING);
 	}
-
-	return err;
 }
+#endif /* CONFIG_BT_CX_ENDPOINT_FRAMING */
 
 int bt_cx_endpoint_handles_assign(struct bt_gatt_dm *dm,
 			  struct bt_cx_endpoint_client *cx_endpoint_c)
@@ -164,33 +1690,707 @@ int bt_cx_endpoint_handles_assign(struct bt_gatt_dm *dm,
 	LOG_DBG("Found handle for CX_ENDPOINT RX characteristic.");
 	cx_endpoint_c->handles.rx = gatt_desc->handle;
 
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	/* CX_ENDPOINT PSM Characteristic, optional */
+	cx_endpoint_c->handles.psm = 0;
+	gatt_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_CX_ENDPOINT_PSM);
+	gatt_desc = gatt_chrc ?
+		    bt_gatt_dm_desc_by_uuid(dm, gatt_chrc, BT_UUID_CX_ENDPOINT_PSM) :
+		    NULL;
+	if (gatt_desc) {
+		LOG_DBG("Found handle for CX_ENDPOINT PSM characteristic.");
+		cx_endpoint_c->handles.psm = gatt_desc->handle;
+	}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	/* CX_ENDPOINT Compression Characteristic, optional */
+	cx_endpoint_c->handles.comp = 0;
+	gatt_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_CX_ENDPOINT_COMP);
+	gatt_desc = gatt_chrc ?
+		    bt_gatt_dm_desc_by_uuid(dm, gatt_chrc, BT_UUID_CX_ENDPOINT_COMP) :
+		    NULL;
+	if (gatt_desc) {
+		LOG_DBG("Found handle for CX_ENDPOINT Compression characteristic.");
+		cx_endpoint_c->handles.comp = gatt_desc->handle;
+	}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	/* CX_ENDPOINT Framing Characteristic, optional */
+	cx_endpoint_c->handles.frame = 0;
+	gatt_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_CX_ENDPOINT_FRAME);
+	gatt_desc = gatt_chrc ?
+		    bt_gatt_dm_desc_by_uuid(dm, gatt_chrc, BT_UUID_CX_ENDPOINT_FRAME) :
+		    NULL;
+	if (gatt_desc) {
+		LOG_DBG("Found handle for CX_ENDPOINT Framing characteristic.");
+		cx_endpoint_c->handles.frame = gatt_desc->handle;
+	}
+
+	/* Before the link is usable, so that no message goes out unframed. */
+	frame_start(cx_endpoint_c, bt_gatt_dm_conn_get(dm));
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	/* CX_ENDPOINT RX Credits Characteristic, optional */
+	cx_endpoint_c->handles.credits = 0;
+	gatt_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_CX_ENDPOINT_CREDITS);
+	gatt_desc = gatt_chrc ?
+		    bt_gatt_dm_desc_by_uuid(dm, gatt_chrc, BT_UUID_CX_ENDPOINT_CREDITS) :
+		    NULL;
+	if (gatt_desc) {
+		LOG_DBG("Found handle for CX_ENDPOINT RX Credits characteristic.");
+		cx_endpoint_c->handles.credits = gatt_desc->handle;
+	}
+#endif
+
 	/* Assign connection instance. */
 	cx_endpoint_c->conn = bt_gatt_dm_conn_get(dm);
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+	/* Handles just discovered are cached along with the database hash. */
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_UNVERIFIED);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_HASH_VALID);
+	if (hash_read_start(cx_endpoint_c)) {
+		LOG_WRN("Database hash not read, handles not cached");
+	}
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	l2cap_start(cx_endpoint_c);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	comp_start(cx_endpoint_c);
+#endif
 	return 0;
 }
 
 int bt_cx_endpoint_subscribe_receive(struct bt_cx_endpoint_client *cx_endpoint_c)
 {
+	struct bt_gatt_subscribe_params *params = NULL;
 	int err;
 
 	if (atomic_test_and_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_TX_NOTIF_ENABLED)) {
 		return -EALREADY;
 	}
 
-	cx_endpoint_c->tx_notif_params.notify = on_received;
-	cx_endpoint_c->tx_notif_params.value = BT_GATT_CCC_NOTIFY;
-	cx_endpoint_c->tx_notif_params.value_handle = cx_endpoint_c->handles.tx;
-	cx_endpoint_c->tx_notif_params.ccc_handle = cx_endpoint_c->handles.tx_ccc;
-	atomic_set_bit(cx_endpoint_c->tx_notif_params.flags,
-		       BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+	params = cache_sub_params(cx_endpoint_c);
+#endif
+	if (!params) {
+		params = &cx_endpoint_c->tx_notif_params;
+		params->notify = on_received;
+		atomic_set_bit(params->flags, BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+	}
+
+	params->value = BT_GATT_CCC_NOTIFY;
+	params->value_handle = cx_endpoint_c->handles.tx;
+	params->ccc_handle = cx_endpoint_c->handles.tx_ccc;
+
+	err = bt_gatt_subscribe(cx_endpoint_c->conn, params);
+	if ((err == -EALREADY) && (params != &cx_endpoint_c->tx_notif_params)) {
+		/* Kept by the host since a previous connection. */
+		err = 0;
+	}
 
-	err = bt_gatt_subscribe(cx_endpoint_c->conn, &cx_endpoint_c->tx_notif_params);
 	if (err) {
 		LOG_ERR("Subscribe failed (err %d)", err);
+		params->value_handle = 0;
 		atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_TX_NOTIF_ENABLED);
 	} else {
 		LOG_DBG("[SUBSCRIBED]");
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+		(void)bt_cx_endpoint_client_cache_save(cx_endpoint_c);
+#endif
 	}
 
 	return err;
 }
+
+void bt_cx_endpoint_client_release(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+	cache_detach(cx_endpoint_c);
+#endif
+
+	cx_endpoint_c->conn = NULL;
+
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_TX_NOTIF_ENABLED);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_WRITE_PENDING);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_HASH_VALID);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_UNVERIFIED);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_COMP_TX);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAME_PENDING);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_FRAMED);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_CREDITS_READ);
+	cx_endpoint_c->tx_notif_params.value_handle = 0;
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	bt_cx_endpoint_frame_rx_reset(&cx_endpoint_c->frame_rx);
+	memset(&cx_endpoint_c->frame_tx, 0, sizeof(cx_endpoint_c->frame_tx));
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_READY);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_L2CAP_TX);
+	cx_endpoint_c->l2cap.chan.conn = NULL;
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+	/* Before the TX queue, so that calls fail for the release rather
+	 * than for their request.
+	 */
+	cx_endpoint_client_rpc_flush(cx_endpoint_c);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	tx_flush(cx_endpoint_c);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_PAUSE)
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_PAUSED);
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_RX_FLOW_PENDING);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+	struct net_buf *buf;
+
+	while ((buf = net_buf_get(&cx_endpoint_c->rx_fifo, K_NO_WAIT))) {
+		bt_cx_endpoint_client_recv_done(cx_endpoint_c, buf);
+	}
+#endif
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE)
+#define CACHE_SIZE	CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE_SIZE
+
+/* Entries are stored under "cx_ep_c/<address><type>", the address being
+ * written most significant byte first as in bt_settings_encode_key().
+ */
+#define CACHE_KEY_ROOT	"cx_ep_c"
+#define CACHE_KEY_LEN	(sizeof(CACHE_KEY_ROOT "/") + 13)
+
+struct cache_val {
+	uint8_t db_hash[16];
+	struct bt_cx_endpoint_client_handles handles;
+	bool subscribed;
+};
+
+static struct cache_entry {
+	bt_addr_le_t addr;
+	bool used;
+	struct cache_val val;
+
+	/* Subscription of the peer once bonded. Held here rather than by
+	 * the instance, the host keeps it registered across connections
+	 * while the instance may serve another peer.
+	 */
+	struct bt_gatt_subscribe_params sub;
+
+	/* Instance attached to the peer, if any. */
+	struct bt_cx_endpoint_client *client;
+} cache[CACHE_SIZE];
+
+/* Entry replaced when the cache is full. */
+static uint8_t cache_next;
+
+/* Settings update, stored from the system work queue rather than from the
+ * Bluetooth RX thread the callbacks run on.
+ */
+struct cache_store {
+	bt_addr_le_t addr;
+	bool delete;
+	struct cache_val val;
+} __aligned(4);
+
+/* A drop and a save for every entry. */
+K_MSGQ_DEFINE(cache_store_q, sizeof(struct cache_store), 2 * CACHE_SIZE, 4);
+
+static void cache_key(char *key, const bt_addr_le_t *addr)
+{
+	snprintk(key, CACHE_KEY_LEN, CACHE_KEY_ROOT "/%02x%02x%02x%02x%02x%02x%u",
+		 addr->a.val[5], addr->a.val[4], addr->a.val[3],
+		 addr->a.val[2], addr->a.val[1], addr->a.val[0], addr->type);
+}
+
+static int cache_key_parse(const char *name, bt_addr_le_t *addr)
+{
+	uint8_t val[sizeof(addr->a.val)];
+
+	if (!name || (strlen(name) != (2 * sizeof(val) + 1)) ||
+	    (hex2bin(name, 2 * sizeof(val), val, sizeof(val)) != sizeof(val))) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < sizeof(val); i++) {
+		addr->a.val[i] = val[sizeof(val) - 1 - i];
+	}
+	addr->type = name[2 * sizeof(val)] - '0';
+
+	return 0;
+}
+
+static void cache_store_handler(struct k_work *work)
+{
+	struct cache_store store;
+	char key[CACHE_KEY_LEN];
+	int err;
+
+	while (!k_msgq_get(&cache_store_q, &store, K_NO_WAIT)) {
+		cache_key(key, &store.addr);
+		if (store.delete) {
+			err = settings_delete(key);
+		} else {
+			err = settings_save_one(key, &store.val,
+						sizeof(store.val));
+		}
+
+		if (err) {
+			LOG_WRN("Cache entry %s not stored (err %d)",
+				log_strdup(key), err);
+		}
+	}
+}
+
+static K_WORK_DEFINE(cache_store_work, cache_store_handler);
+
+/* Queue a settings update of the entry of addr, deleted if val is NULL. */
+static int cache_store(const bt_addr_le_t *addr, const struct cache_val *val)
+{
+	struct cache_store store = { 0 };
+
+	bt_addr_le_copy(&store.addr, addr);
+	store.delete = !val;
+	if (val) {
+		store.val = *val;
+	}
+
+	if (k_msgq_put(&cache_store_q, &store, K_NO_WAIT)) {
+		LOG_WRN("Cache store queue full");
+		return -ENOMEM;
+	}
+
+	k_work_submit(&cache_store_work);
+
+	return 0;
+}
+
+static bool cache_subscribed(const struct cache_entry *entry)
+{
+	return entry->sub.value_handle != 0;
+}
+
+static int cache_find(const bt_addr_le_t *addr)
+{
+	for (int i = 0; i < CACHE_SIZE; i++) {
+		if (cache[i].used && !bt_addr_le_cmp(addr, &cache[i].addr)) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/* The subscription of a dropped entry stays with it until the host
+ * removes it.
+ */
+static void cache_drop(int i)
+{
+	(void)cache_store(&cache[i].addr, NULL);
+	cache[i].used = false;
+}
+
+static int cache_slot(const bt_addr_le_t *addr)
+{
+	int i = cache_find(addr);
+
+	if (i >= 0) {
+		return i;
+	}
+
+	/* A dropped entry of the peer whose subscription is still held. */
+	for (i = 0; i < CACHE_SIZE; i++) {
+		if (cache_subscribed(&cache[i]) &&
+		    !bt_addr_le_cmp(addr, &cache[i].addr)) {
+			break;
+		}
+	}
+
+	if (i == CACHE_SIZE) {
+		for (i = 0; i < CACHE_SIZE; i++) {
+			if (!cache[i].used && !cache_subscribed(&cache[i])) {
+				break;
+			}
+		}
+	}
+
+	/* Entries with a subscription registered in the host are never
+	 * replaced.
+	 */
+	for (int n = 0; (i == CACHE_SIZE) && (n < CACHE_SIZE); n++) {
+		if (!cache_subscribed(&cache[cache_next])) {
+			i = cache_next;
+			cache_drop(i);
+		}
+		cache_next = (cache_next + 1) % CACHE_SIZE;
+	}
+
+	if (i == CACHE_SIZE) {
+		return -ENOMEM;
+	}
+
+	if (!cache_subscribed(&cache[i])) {
+		memset(&cache[i].sub, 0, sizeof(cache[i].sub));
+		cache[i].client = NULL;
+	}
+
+	bt_addr_le_copy(&cache[i].addr, addr);
+	memset(&cache[i].val, 0, sizeof(cache[i].val));
+	cache[i].used = true;
+
+	return i;
+}
+
+static int cache_set(const char *name, size_t len, settings_read_cb read_cb,
+		     void *cb_arg)
+{
+	bt_addr_le_t addr;
+	ssize_t ret;
+	int i;
+
+	if (cache_key_parse(name, &addr)) {
+		LOG_WRN("Invalid cache key %s", log_strdup(name));
+		return -EINVAL;
+	}
+
+	if (!len) {
+		i = cache_find(&addr);
+		if (i >= 0) {
+			cache[i].used = false;
+		}
+		return 0;
+	}
+
+	if (len != sizeof(struct cache_val)) {
+		/* Stored by a build with another layout, rediscovered. */
+		LOG_WRN("Cache entry %s ignored", log_strdup(name));
+		return 0;
+	}
+
+	i = cache_slot(&addr);
+	if (i < 0) {
+		return i;
+	}
+
+	ret = read_cb(cb_arg, &cache[i].val, sizeof(cache[i].val));
+	if (ret < 0) {
+		cache[i].used = false;
+		return ret;
+	}
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(cx_endpoint_c, CACHE_KEY_ROOT, NULL, cache_set,
+			       NULL, NULL);
+
+static uint8_t cache_on_received(struct bt_conn *conn,
+				 struct bt_gatt_subscribe_params *params,
+				 const void *data, uint16_t length)
+{
+	struct cache_entry *entry = CONTAINER_OF(params, struct cache_entry,
+						 sub);
+	struct bt_cx_endpoint_client *cx_endpoint_c = entry->client;
+
+	if (!data) {
+		LOG_DBG("[UNSUBSCRIBED]");
+		params->value_handle = 0;
+		entry->client = NULL;
+		if (cx_endpoint_c) {
+			notif_unsubscribed(cx_endpoint_c);
+		}
+		return BT_GATT_ITER_STOP;
+	}
+
+	/* Kept registered while no instance serves the peer. */
+	if (!cx_endpoint_c || (cx_endpoint_c->conn != conn)) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	return notif_received(cx_endpoint_c, data, length);
+}
+
+/* Subscription parameters of a cached peer, attached to the instance. NULL
+ * if the peer is not cached yet, the instance subscribing with its own
+ * volatile parameters then.
+ */
+static struct bt_gatt_subscribe_params *
+cache_sub_params(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	const bt_addr_le_t *addr = bt_conn_get_dst(cx_endpoint_c->conn);
+	struct cache_entry *entry;
+	int i;
+
+	if (!bt_addr_le_is_bonded(BT_ID_DEFAULT, addr)) {
+		return NULL;
+	}
+
+	i = cache_find(addr);
+	if (i < 0) {
+		return NULL;
+	}
+
+	entry = &cache[i];
+	entry->client = cx_endpoint_c;
+	entry->sub.notify = cache_on_received;
+	atomic_clear_bit(entry->sub.flags, BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+
+	return &entry->sub;
+}
+
+static void cache_detach(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	for (int i = 0; i < CACHE_SIZE; i++) {
+		if (cache[i].client == cx_endpoint_c) {
+			cache[i].client = NULL;
+		}
+	}
+}
+
+/* Resume the subscription of the previous connection. The server keeps
+ * the CCC of a bonded peer, so it is not written again.
+ */
+static void cache_resubscribe(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	struct bt_gatt_subscribe_params *params;
+	int err;
+
+	if (atomic_test_and_set_bit(&cx_endpoint_c->state,
+				    CX_ENDPOINT_C_TX_NOTIF_ENABLED)) {
+		return;
+	}
+
+	params = cache_sub_params(cx_endpoint_c);
+	if (!params) {
+		atomic_clear_bit(&cx_endpoint_c->state,
+				 CX_ENDPOINT_C_TX_NOTIF_ENABLED);
+		return;
+	}
+
+	params->value = BT_GATT_CCC_NOTIFY;
+	params->value_handle = cx_endpoint_c->handles.tx;
+	params->ccc_handle = cx_endpoint_c->handles.tx_ccc;
+
+	err = bt_gatt_resubscribe(BT_ID_DEFAULT,
+				  bt_conn_get_dst(cx_endpoint_c->conn), params);
+	if (err && (err != -EALREADY)) {
+		LOG_ERR("Resubscribe failed (err %d)", err);
+		params->value_handle = 0;
+		atomic_clear_bit(&cx_endpoint_c->state,
+				 CX_ENDPOINT_C_TX_NOTIF_ENABLED);
+		return;
+	}
+
+	LOG_DBG("[RESUBSCRIBED]");
+}
+
+/* Cached handles that do not match the server any longer. */
+static void cache_stale(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	int i = cache_find(bt_conn_get_dst(cx_endpoint_c->conn));
+
+	LOG_WRN("Cached handles are stale");
+
+	if (i >= 0) {
+		if (cache_subscribed(&cache[i]) &&
+		    bt_gatt_unsubscribe(cx_endpoint_c->conn, &cache[i].sub)) {
+			LOG_WRN("Stale subscription kept");
+		}
+		cache_drop(i);
+	}
+
+	bt_cx_endpoint_client_release(cx_endpoint_c);
+
+	if (cx_endpoint_c->cb.stale) {
+		cx_endpoint_c->cb.stale(cx_endpoint_c);
+	}
+}
+
+static void cache_verified(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	int i = cache_find(bt_conn_get_dst(cx_endpoint_c->conn));
+
+	LOG_DBG("Cached handles verified");
+
+#if defined(CONFIG_BT_CX_ENDPOINT_FRAMING)
+	frame_start(cx_endpoint_c, cx_endpoint_c->conn);
+#endif
+
+	atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_UNVERIFIED);
+	atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_HASH_VALID);
+
+	if ((i >= 0) && cache[i].val.subscribed) {
+		cache_resubscribe(cx_endpoint_c);
+	}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_L2CAP)
+	l2cap_start(cx_endpoint_c);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_COMPRESSION)
+	comp_start(cx_endpoint_c);
+#endif
+
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_QUEUE)
+	/* Messages queued since the link came up. */
+	k_delayed_work_submit(&cx_endpoint_c->tx_work, K_NO_WAIT);
+#endif
+}
+
+static uint8_t hash_read(struct bt_conn *conn, uint8_t err,
+			 struct bt_gatt_read_params *params, const void *data,
+			 uint16_t length)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(params, struct bt_cx_endpoint_client,
+			     hash_read_params);
+	bool verify;
+
+	/* Released while the read was pending. */
+	if (cx_endpoint_c->conn != conn) {
+		return BT_GATT_ITER_STOP;
+	}
+
+	verify = atomic_test_bit(&cx_endpoint_c->state,
+				 CX_ENDPOINT_C_UNVERIFIED);
+
+	if (err || !data || (length != sizeof(cx_endpoint_c->db_hash))) {
+		LOG_WRN("Database hash read failed (err %u)", err);
+		if (verify) {
+			cache_stale(cx_endpoint_c);
+		}
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (verify) {
+		if (memcmp(cx_endpoint_c->db_hash, data, length)) {
+			cache_stale(cx_endpoint_c);
+		} else {
+			cache_verified(cx_endpoint_c);
+		}
+		return BT_GATT_ITER_STOP;
+	}
+
+	memcpy(cx_endpoint_c->db_hash, data, length);
+	atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_HASH_VALID);
+	(void)bt_cx_endpoint_client_cache_save(cx_endpoint_c);
+
+	return BT_GATT_ITER_STOP;
+}
+
+static int hash_read_start(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	struct bt_gatt_read_params *params = &cx_endpoint_c->hash_read_params;
+
+	params->func = hash_read;
+	params->handle_count = 0;
+	params->by_uuid.start_handle = 0x0001;
+	params->by_uuid.end_handle = 0xffff;
+	params->by_uuid.uuid = BT_UUID_GATT_DB_HASH;
+
+	return bt_gatt_read(cx_endpoint_c->conn, params);
+}
+
+int bt_cx_endpoint_client_cache_assign(struct bt_cx_endpoint_client *cx_endpoint_c,
+				       struct bt_conn *conn)
+{
+	const bt_addr_le_t *addr = bt_conn_get_dst(conn);
+	int err;
+	int i;
+
+	if (!bt_addr_le_is_bonded(BT_ID_DEFAULT, addr)) {
+		return -ENOENT;
+	}
+
+	i = cache_find(addr);
+	if (i < 0) {
+		return -ENOENT;
+	}
+
+	cx_endpoint_c->handles = cache[i].val.handles;
+	memcpy(cx_endpoint_c->db_hash, cache[i].val.db_hash,
+	       sizeof(cx_endpoint_c->db_hash));
+
+	/* Messages are accepted right away and held until the server
+	 * confirms its database did not change.
+	 */
+	cx_endpoint_c->conn = conn;
+	atomic_set_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_UNVERIFIED);
+
+	err = hash_read_start(cx_endpoint_c);
+	if (err) {
+		LOG_WRN("Database hash read not started (err %d)", err);
+		atomic_clear_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_UNVERIFIED);
+		cx_endpoint_c->conn = NULL;
+		return err;
+	}
+
+	LOG_DBG("Handles assigned from the cache");
+
+	return 0;
+}
+
+int bt_cx_endpoint_client_cache_save(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	const bt_addr_le_t *addr;
+	struct cache_val val = { 0 };
+	int err;
+	int i;
+
+	if (!cx_endpoint_c->conn ||
+	    !atomic_test_bit(&cx_endpoint_c->state, CX_ENDPOINT_C_HASH_VALID)) {
+		return -EAGAIN;
+	}
+
+	addr = bt_conn_get_dst(cx_endpoint_c->conn);
+	if (!bt_addr_le_is_bonded(BT_ID_DEFAULT, addr)) {
+		return -EACCES;
+	}
+
+	memcpy(val.db_hash, cx_endpoint_c->db_hash, sizeof(val.db_hash));
+	val.handles = cx_endpoint_c->handles;
+	val.subscribed = atomic_test_bit(&cx_endpoint_c->state,
+					 CX_ENDPOINT_C_TX_NOTIF_ENABLED);
+
+	i = cache_slot(addr);
+	if (i < 0) {
+		return i;
+	}
+
+	if (!memcmp(&cache[i].val, &val, sizeof(val))) {
+		/* Spare the flash. */
+		return 0;
+	}
+
+	err = cache_store(addr, &val);
+	if (err) {
+		return err;
+	}
+
+	cache[i].val = val;
+
+	return 0;
+}
+
+void bt_cx_endpoint_client_cache_forget(const bt_addr_le_t *addr)
+{
+	for (int i = 0; i < CACHE_SIZE; i++) {
+		if (cache[i].used &&
+		    (!addr || !bt_addr_le_cmp(addr, &cache[i].addr))) {
+			cache_drop(i);
+		}
+	}
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_CLIENT_CACHE */
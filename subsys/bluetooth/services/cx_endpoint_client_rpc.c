@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX Endpoint remote procedure calls, client side
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include <bluetooth/services/cx_endpoint_client.h>
+#include <bluetooth/services/cx_endpoint_rpc.h>
+
+#include "cx_endpoint_client_rpc.h"
+#include "cx_endpoint_stats.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(cx_endpoint_c_rpc, CONFIG_BT_CX_ENDPOINT_CLIENT_LOG_LEVEL);
+
+#define METHOD_COUNT	CONFIG_BT_CX_ENDPOINT_RPC_METHOD_COUNT
+#define MAX_PENDING	CONFIG_BT_CX_ENDPOINT_CLIENT_RPC_MAX_PENDING
+
+/* Timeout of the calls made with K_FOREVER. */
+#define NO_TIMEOUT	UINT32_MAX
+
+BUILD_ASSERT(CONFIG_BT_CX_ENDPOINT_RPC_CHAN < BT_CX_ENDPOINT_CHAN_COUNT,
+	     "RPC channel out of range");
+BUILD_ASSERT(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_BUF_SIZE >=
+	     (BT_CX_ENDPOINT_CHAN_HDR_LEN +
+	      sizeof(struct bt_cx_endpoint_rpc_hdr) +
+	      CONFIG_BT_CX_ENDPOINT_RPC_MAX_LEN),
+	     "TX buffers too small for RPC requests");
+
+/* Protects the calls of all instances and the latency records. */
+static struct k_spinlock rpc_lock;
+
+/* Shared by all client instances. */
+static struct bt_cx_endpoint_rpc_lat lat[METHOD_COUNT];
+
+/* Remove the call with the given request ID from the outstanding ones. */
+static bool call_take(struct bt_cx_endpoint_client *cx_endpoint_c, uint16_t id,
+		      struct bt_cx_endpoint_client_rpc_call *call)
+{
+	struct bt_cx_endpoint_client_rpc_call *pending;
+	k_spinlock_key_t key;
+	bool found = false;
+
+	key = k_spin_lock(&rpc_lock);
+	for (uint8_t i = 0; i < MAX_PENDING; i++) {
+		pending = &cx_endpoint_c->rpc_calls[i];
+		if (pending->cb && (pending->id == id)) {
+			*call = *pending;
+			pending->cb = NULL;
+			found = true;
+			break;
+		}
+	}
+	k_spin_unlock(&rpc_lock, key);
+
+	return found;
+}
+
+static void call_done(struct bt_cx_endpoint_client *cx_endpoint_c,
+		      const struct bt_cx_endpoint_client_rpc_call *call, int err,
+		      const uint8_t *data, uint16_t len)
+{
+	uint32_t ms = k_uptime_get_32() - call->stamp;
+	struct bt_cx_endpoint_rpc_lat *l;
+	k_spinlock_key_t key;
+
+	if (call->method < METHOD_COUNT) {
+		l = &lat[call->method];
+
+		key = k_spin_lock(&rpc_lock);
+		l->count++;
+		if (err) {
+			l->errors++;
+		}
+		if (err == -ETIMEDOUT) {
+			l->timeouts++;
+		} else {
+			l->total_ms += ms;
+			l->max_ms = MAX(l->max_ms, ms);
+			cx_stats_lat_add(l->hist, ms);
+		}
+		k_spin_unlock(&rpc_lock, key);
+	}
+
+	call->cb(cx_endpoint_c, err, data, len, call->user_data);
+}
+
+static uint8_t rpc_received(struct bt_cx_endpoint_client *cx_endpoint_c,
+			    const uint8_t *data, uint16_t len)
+{
+	const struct bt_cx_endpoint_rpc_hdr *hdr = (const void *)data;
+	struct bt_cx_endpoint_client_rpc_call call;
+
+	if (len < sizeof(*hdr)) {
+		LOG_WRN("RPC response of %u bytes dropped", len);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	if (!call_take(cx_endpoint_c, sys_le16_to_cpu(hdr->id), &call)) {
+		/* Timed out already. */
+		LOG_DBG("Late RPC response %u dropped",
+			sys_le16_to_cpu(hdr->id));
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	if (hdr->status) {
+		call_done(cx_endpoint_c, &call, -hdr->status, NULL, 0);
+	} else {
+		call_done(cx_endpoint_c, &call, 0, data + sizeof(*hdr),
+			  len - sizeof(*hdr));
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void rpc_sent(struct bt_cx_endpoint_client *cx_endpoint_c, uint8_t err,
+		     const uint8_t *data, uint16_t len)
+{
+	const struct bt_cx_endpoint_rpc_hdr *hdr = (const void *)data;
+	struct bt_cx_endpoint_client_rpc_call call;
+
+	if (!err || (len < sizeof(*hdr))) {
+		return;
+	}
+
+	if (call_take(cx_endpoint_c, sys_le16_to_cpu(hdr->id), &call)) {
+		LOG_WRN("RPC request %u not written (err %u)",
+			sys_le16_to_cpu(hdr->id), err);
+		call_done(cx_endpoint_c, &call, -EIO, NULL, 0);
+	}
+}
+
+static void rpc_work_handler(struct k_work *work)
+{
+	struct bt_cx_endpoint_client *cx_endpoint_c =
+		CONTAINER_OF(work, struct bt_cx_endpoint_client, rpc_work);
+	struct bt_cx_endpoint_client_rpc_call *pending;
+	struct bt_cx_endpoint_client_rpc_call call;
+	k_spinlock_key_t key;
+	uint32_t elapsed;
+	uint32_t next;
+	bool expired;
+
+	/* Fail the expired calls one at a time, the callback may make new
+	 * calls.
+	 */
+	do {
+		expired = false;
+		next = NO_TIMEOUT;
+
+		key = k_spin_lock(&rpc_lock);
+		for (uint8_t i = 0; i < MAX_PENDING; i++) {
+			pending = &cx_endpoint_c->rpc_calls[i];
+			if (!pending->cb || (pending->timeout_ms == NO_TIMEOUT)) {
+				continue;
+			}
+
+			elapsed = k_uptime_get_32() - pending->stamp;
+			if (elapsed >= pending->timeout_ms) {
+				call = *pending;
+				pending->cb = NULL;
+				expired = true;
+				break;
+			}
+
+			next = MIN(next, pending->timeout_ms - elapsed);
+		}
+		k_spin_unlock(&rpc_lock, key);
+
+		if (expired) {
+			LOG_WRN("RPC request %u timed out", call.id);
+			call_done(cx_endpoint_c, &call, -ETIMEDOUT, NULL, 0);
+		}
+	} while (expired);
+
+	if (next != NO_TIMEOUT) {
+		k_delayed_work_submit(&cx_endpoint_c->rpc_work, K_MSEC(next));
+	}
+}
+
+int cx_endpoint_client_rpc_init(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	cx_endpoint_c->rpc_chan.id = CONFIG_BT_CX_ENDPOINT_RPC_CHAN;
+	cx_endpoint_c->rpc_chan.prio = CONFIG_BT_CX_ENDPOINT_RPC_PRIO;
+	cx_endpoint_c->rpc_chan.weight = 1;
+	cx_endpoint_c->rpc_chan.received = rpc_received;
+	cx_endpoint_c->rpc_chan.sent = rpc_sent;
+
+	k_delayed_work_init(&cx_endpoint_c->rpc_work, rpc_work_handler);
+
+	return bt_cx_endpoint_client_chan_register(cx_endpoint_c,
+						   &cx_endpoint_c->rpc_chan);
+}
+
+void cx_endpoint_client_rpc_flush(struct bt_cx_endpoint_client *cx_endpoint_c)
+{
+	struct bt_cx_endpoint_client_rpc_call call;
+	k_spinlock_key_t key;
+
+	k_delayed_work_cancel(&cx_endpoint_c->rpc_work);
+
+	for (uint8_t i = 0; i < MAX_PENDING; i++) {
+		key = k_spin_lock(&rpc_lock);
+		call = cx_endpoint_c->rpc_calls[i];
+		cx_endpoint_c->rpc_calls[i].cb = NULL;
+		k_spin_unlock(&rpc_lock, key);
+
+		if (call.cb) {
+			call_done(cx_endpoint_c, &call, -ECONNRESET, NULL, 0);
+		}
+	}
+}
+
+int bt_cx_endpoint_client_rpc_call(struct bt_cx_endpoint_client *cx_endpoint_c,
+				   uint8_t method, const uint8_t *args,
+				   uint16_t len, k_timeout_t timeout,
+				   bt_cx_endpoint_client_rpc_cb_t cb,
+				   void *user_data)
+{
+	uint8_t msg[sizeof(struct bt_cx_endpoint_rpc_hdr) +
+		    CONFIG_BT_CX_ENDPOINT_RPC_MAX_LEN];
+	struct bt_cx_endpoint_rpc_hdr *hdr = (void *)msg;
+	struct bt_cx_endpoint_client_rpc_call *call = NULL;
+	uint32_t timeout_ms;
+	k_spinlock_key_t key;
+	uint16_t id;
+	int err;
+
+	if (!cb) {
+		return -EINVAL;
+	}
+
+	if (len > CONFIG_BT_CX_ENDPOINT_RPC_MAX_LEN) {
+		return -EMSGSIZE;
+	}
+
+	if (!cx_endpoint_c->conn) {
+		return -ENOTCONN;
+	}
+
+	timeout_ms = K_TIMEOUT_EQ(timeout, K_FOREVER) ?
+		     NO_TIMEOUT : k_ticks_to_ms_ceil32(timeout.ticks);
+
+	key = k_spin_lock(&rpc_lock);
+	for (uint8_t i = 0; i < MAX_PENDING; i++) {
+		if (!cx_endpoint_c->rpc_calls[i].cb) {
+			call = &cx_endpoint_c->rpc_calls[i];
+			break;
+		}
+	}
+
+	if (!call) {
+		k_spin_unlock(&rpc_lock, key);
+		return -ENOMEM;
+	}
+
+	id = cx_endpoint_c->rpc_next_id++;
+	call->cb = cb;
+	call->user_data = user_data;
+	call->stamp = k_uptime_get_32();
+	call->timeout_ms = timeout_ms;
+	call->id = id;
+	call->method = method;
+	k_spin_unlock(&rpc_lock, key);
+
+	hdr->id = sys_cpu_to_le16(id);
+	hdr->method = method;
+	hdr->status = 0;
+	memcpy(msg + sizeof(*hdr), args, len);
+
+	err = bt_cx_endpoint_client_chan_send(cx_endpoint_c,
+					      &cx_endpoint_c->rpc_chan, msg,
+					      sizeof(*hdr) + len);
+	if (err) {
+		key = k_spin_lock(&rpc_lock);
+		call->cb = NULL;
+		k_spin_unlock(&rpc_lock, key);
+		return err;
+	}
+
+	/* The timeout work runs for the call expiring first. */
+	if ((timeout_ms != NO_TIMEOUT) &&
+	    (!k_delayed_work_pending(&cx_endpoint_c->rpc_work) ||
+	     (k_delayed_work_remaining_get(&cx_endpoint_c->rpc_work) >
+	      timeout_ms))) {
+		k_delayed_work_submit(&cx_endpoint_c->rpc_work,
+				      K_MSEC(timeout_ms));
+	}
+
+	return 0;
+}
+
+int bt_cx_endpoint_client_rpc_lat_get(uint8_t method,
+				      struct bt_cx_endpoint_rpc_lat *out)
+{
+	k_spinlock_key_t key;
+
+	if (method >= METHOD_COUNT) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&rpc_lock);
+	*out = lat[method];
+	k_spin_unlock(&rpc_lock, key);
+
+	return 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CX_ENDPOINT_CLIENT_RPC_H_
+#define CX_ENDPOINT_CLIENT_RPC_H_
+
+/* RPC state of a client instance, managed along with the instance. */
+
+#include <bluetooth/services/cx_endpoint_client.h>
+
+/* Register the RPC channel of an instance being initialized. */
+int cx_endpoint_client_rpc_init(struct bt_cx_endpoint_client *cx_endpoint_c);
+
+/* Fail every outstanding call of an instance being released. */
+void cx_endpoint_client_rpc_flush(struct bt_cx_endpoint_client *cx_endpoint_c);
+
+#endif /* CX_ENDPOINT_CLIENT_RPC_H_ */
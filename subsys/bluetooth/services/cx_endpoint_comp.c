@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX Endpoint message compression
+ */
+
+#include <zephyr/types.h>
+#include <string.h>
+#include <errno.h>
+#include <zephyr.h>
+
+#include <bluetooth/services/cx_endpoint_comp.h>
+
+#define HASH_BITS	CONFIG_BT_CX_ENDPOINT_COMP_HASH_BITS
+#define HASH_SIZE	BIT(HASH_BITS)
+
+/* Longest literal run and match of a token, and farthest match. */
+#define LIT_MAX		32
+#define MATCH_MIN	3
+#define MATCH_MAX	(7 + 255 + 2)
+#define DIST_MAX	8192
+
+/* Offset in the message of the last position seen with each hash. Entries
+ * left by a previous message are caught by comparing the data.
+ */
+static uint16_t hash_table[HASH_SIZE];
+static K_MUTEX_DEFINE(hash_lock);
+
+static uint32_t hash(const uint8_t *p)
+{
+	uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+	return ((v >> (24 - HASH_BITS)) - (v * 5)) & (HASH_SIZE - 1);
+}
+
+static int encode(const uint8_t *data, uint16_t len, uint8_t *out,
+		  uint16_t size)
+{
+	const uint8_t *ip = data;
+	const uint8_t *end = data + len;
+	const uint8_t *ref;
+	uint8_t *op = out;
+	uint8_t *out_end = out + size;
+	uint8_t *lit_hdr;
+	uint16_t match;
+	uint16_t max;
+	uint16_t dist;
+	uint8_t lit = 0;
+	uint32_t h;
+
+	if (!size) {
+		return -ENOSPC;
+	}
+
+	/* Every literal run starts with room for its control byte. */
+	lit_hdr = op++;
+
+	while (ip < end) {
+		match = 0;
+
+		if ((end - ip) >= MATCH_MIN) {
+			h = hash(ip);
+			ref = data + hash_table[h];
+			hash_table[h] = ip - data;
+
+			if ((ref < ip) && ((ip - ref) <= DIST_MAX) &&
+			    !memcmp(ref, ip, MATCH_MIN)) {
+				max = MIN(end - ip, MATCH_MAX);
+				for (match = MATCH_MIN; (match < max) &&
+				     (ref[match] == ip[match]); match++) {
+				}
+			}
+		}
+
+		if (!match) {
+			if (op >= out_end) {
+				return -ENOSPC;
+			}
+
+			*op++ = *ip++;
+			if (++lit == LIT_MAX) {
+				*lit_hdr = lit - 1;
+				lit = 0;
+				lit_hdr = op++;
+			}
+			continue;
+		}
+
+		/* Close the literal run, dropping it if empty. */
+		if (lit) {
+			*lit_hdr = lit - 1;
+			lit = 0;
+		} else {
+			op--;
+		}
+
+		if ((op + ((match - 2) >= 7 ? 3 : 2) + 1) > out_end) {
+			return -ENOSPC;
+		}
+
+		dist = ip - ref - 1;
+		if ((match - 2) < 7) {
+			*op++ = ((match - 2) << 5) | (dist >> 8);
+		} else {
+			*op++ = (7 << 5) | (dist >> 8);
+			*op++ = match - 2 - 7;
+		}
+		*op++ = dist & 0xFF;
+
+		/* Positions inside the match are hashed for the next ones. */
+		for (ip++, match--; match; ip++, match--) {
+			if ((end - ip) >= MATCH_MIN) {
+				hash_table[hash(ip)] = ip - data;
+			}
+		}
+
+		lit_hdr = op++;
+	}
+
+	if (lit) {
+		*lit_hdr = lit - 1;
+	} else {
+		op--;
+	}
+
+	return op - out;
+}
+
+int bt_cx_endpoint_comp_encode(const uint8_t *data, uint16_t len,
+			       uint8_t *out, uint16_t size)
+{
+	int ret;
+
+	if (k_is_in_isr() || k_mutex_lock(&hash_lock, K_NO_WAIT)) {
+		return -EBUSY;
+	}
+
+	ret = encode(data, len, out, size);
+
+	k_mutex_unlock(&hash_lock);
+
+	return ret;
+}
+
+int bt_cx_endpoint_comp_decode(const uint8_t *data, uint16_t len,
+			       uint8_t *out, uint16_t size)
+{
+	const uint8_t *ip = data;
+	const uint8_t *end = data + len;
+	const uint8_t *ref;
+	uint8_t *op = out;
+	uint8_t *out_end = out + size;
+	uint16_t count;
+	uint8_t ctrl;
+
+	while (ip < end) {
+		ctrl = *ip++;
+
+		if (ctrl < LIT_MAX) {
+			count = ctrl + 1;
+			if (count > (end - ip)) {
+				return -EBADMSG;
+			}
+
+			if (count > (out_end - op)) {
+				return -EMSGSIZE;
+			}
+
+			memcpy(op, ip, count);
+			ip += count;
+			op += count;
+			continue;
+		}
+
+		count = ctrl >> 5;
+		if (count == 7) {
+			if (ip >= end) {
+				return -EBADMSG;
+			}
+			count += *ip++;
+		}
+		count += 2;
+
+		if (ip >= end) {
+			return -EBADMSG;
+		}
+
+		ref = op - ((((ctrl & 0x1F) << 8) | *ip++) + 1);
+		if (ref < out) {
+			return -EBADMSG;
+		}
+
+		if (count > (out_end - op)) {
+			return -EMSGSIZE;
+		}
+
+		/* Byte by byte, a match may overlap its own output. */
+		while (count--) {
+			*op++ = *ref++;
+		}
+	}
+
+	return op - out;
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX Endpoint message segmentation and reassembly
+ */
+
+#include <zephyr/types.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/byteorder.h>
+#include <zephyr.h>
+#include <net/buf.h>
+
+#include <bluetooth/services/cx_endpoint_frame.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(bt_cx_endpoint_frame, CONFIG_BT_CX_ENDPOINT_FRAME_LOG_LEVEL);
+
+NET_BUF_POOL_DEFINE(cx_endpoint_frame_rx_pool,
+		    CONFIG_BT_CX_ENDPOINT_FRAME_RX_BUF_COUNT,
+		    CONFIG_BT_CX_ENDPOINT_MAX_MSG_LEN, 0, NULL);
+
+static uint8_t seq_get(uint8_t hdr)
+{
+	return (hdr >> BT_CX_ENDPOINT_FRAME_SEQ_POS) &
+	       BT_CX_ENDPOINT_FRAME_SEQ_MASK;
+}
+
+uint16_t bt_cx_endpoint_frame_segment(struct bt_cx_endpoint_frame_tx *tx,
+				      const uint8_t *msg, uint16_t msg_len,
+				      uint16_t *offset, uint8_t *pdu,
+				      uint16_t pdu_size)
+{
+	uint8_t flags = 0;
+	uint16_t hdr_len = BT_CX_ENDPOINT_FRAME_HDR_LEN;
+	uint16_t chunk;
+
+	if (*offset == 0) {
+		flags |= BT_CX_ENDPOINT_FRAME_FIRST;
+		hdr_len = BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN;
+		sys_put_le16(msg_len, &pdu[1]);
+	}
+
+	chunk = MIN(msg_len - *offset, pdu_size - hdr_len);
+	if ((*offset + chunk) == msg_len) {
+		flags |= BT_CX_ENDPOINT_FRAME_LAST;
+	}
+
+	pdu[0] = flags | ((tx->seq & BT_CX_ENDPOINT_FRAME_SEQ_MASK) <<
+			  BT_CX_ENDPOINT_FRAME_SEQ_POS);
+	tx->seq++;
+
+	memcpy(&pdu[hdr_len], &msg[*offset], chunk);
+	*offset += chunk;
+
+	return hdr_len + chunk;
+}
+
+void bt_cx_endpoint_frame_rx_reset(struct bt_cx_endpoint_frame_rx *rx)
+{
+	if (rx->buf) {
+		net_buf_unref(rx->buf);
+		rx->buf = NULL;
+	}
+
+	rx->total = 0;
+}
+
+int bt_cx_endpoint_frame_append(struct bt_cx_endpoint_frame_rx *rx,
+				const uint8_t *data, uint16_t len,
+				bt_cx_endpoint_frame_recv_t cb,
+				void *user_data)
+{
+	if (!rx->buf) {
+		return -EBADMSG;
+	}
+
+	if (len > (rx->total - rx->buf->len)) {
+		LOG_WRN("Segment overruns message (%u > %u)",
+			rx->buf->len + len, rx->total);
+		bt_cx_endpoint_frame_rx_reset(rx);
+		return -EBADMSG;
+	}
+
+	net_buf_add_mem(rx->buf, data, len);
+
+	if (rx->buf->len == rx->total) {
+		cb(rx->buf->data, rx->buf->len, user_data);
+		bt_cx_endpoint_frame_rx_reset(rx);
+	}
+
+	return 0;
+}
+
+int bt_cx_endpoint_frame_feed(struct bt_cx_endpoint_frame_rx *rx,
+			      const uint8_t *pdu, uint16_t len,
+			      bt_cx_endpoint_frame_recv_t cb, void *user_data)
+{
+	uint8_t hdr;
+	uint16_t total;
+
+	if (len < BT_CX_ENDPOINT_FRAME_HDR_LEN) {
+		return -EBADMSG;
+	}
+
+	hdr = pdu[0];
+
+	if (!(hdr & BT_CX_ENDPOINT_FRAME_FIRST)) {
+		if (!rx->buf) {
+			LOG_WRN("Continuation without a started message");
+			return -EBADMSG;
+		}
+
+		if (seq_get(hdr) != (rx->seq & BT_CX_ENDPOINT_FRAME_SEQ_MASK)) {
+			LOG_WRN("Segment out of sequence (%u != %u)",
+				seq_get(hdr),
+				rx->seq & BT_CX_ENDPOINT_FRAME_SEQ_MASK);
+			bt_cx_endpoint_frame_rx_reset(rx);
+			return -EBADMSG;
+		}
+
+		rx->seq++;
+
+		return bt_cx_endpoint_frame_append(
+			rx, &pdu[BT_CX_ENDPOINT_FRAME_HDR_LEN],
+			len - BT_CX_ENDPOINT_FRAME_HDR_LEN, cb, user_data);
+	}
+
+	/* A packet may carry several whole messages back to back, the last
+	 * one possibly starting a message continued in later packets.
+	 */
+	while (len) {
+		hdr = pdu[0];
+
+		if (!(hdr & BT_CX_ENDPOINT_FRAME_FIRST) ||
+		    (len < BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN)) {
+			return -EBADMSG;
+		}
+
+		if (rx->buf) {
+			LOG_WRN("Message dropped, %u of %u bytes received",
+				rx->buf->len, rx->total);
+			bt_cx_endpoint_frame_rx_reset(rx);
+		}
+
+		total = sys_get_le16(&pdu[1]);
+		pdu += BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN;
+		len -= BT_CX_ENDPOINT_FRAME_FIRST_HDR_LEN;
+
+		/* Whole messages skip the reassembly buffer. */
+		if (len >= total) {
+			cb(pdu, total, user_data);
+			pdu += total;
+			len -= total;
+			continue;
+		}
+
+		if (total > CONFIG_BT_CX_ENDPOINT_MAX_MSG_LEN) {
+			LOG_WRN("Message too large (%u bytes)", total);
+			return -EMSGSIZE;
+		}
+
+		rx->buf = net_buf_alloc(&cx_endpoint_frame_rx_pool, K_NO_WAIT);
+		if (!rx->buf) {
+			LOG_WRN("No reassembly buffer available");
+			return -ENOMEM;
+		}
+
+		rx->total = total;
+		rx->seq = seq_get(hdr) + 1;
+		net_buf_add_mem(rx->buf, pdu, len);
+		break;
+	}
+
+	return 0;
+}
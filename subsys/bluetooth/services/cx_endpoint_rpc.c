@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX Endpoint remote procedure calls, service side
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include <bluetooth/services/cx_endpoint.h>
+#include <bluetooth/services/cx_endpoint_rpc.h>
+
+#include "cx_endpoint_stats.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(cx_endpoint_rpc, CONFIG_BT_CX_ENDPOINT_LOG_LEVEL);
+
+#define METHOD_COUNT	CONFIG_BT_CX_ENDPOINT_RPC_METHOD_COUNT
+
+BUILD_ASSERT(CONFIG_BT_CX_ENDPOINT_RPC_CHAN < BT_CX_ENDPOINT_CHAN_COUNT,
+	     "RPC channel out of range");
+BUILD_ASSERT(CONFIG_BT_CX_ENDPOINT_TX_BUF_SIZE >=
+	     (BT_CX_ENDPOINT_CHAN_HDR_LEN +
+	      sizeof(struct bt_cx_endpoint_rpc_hdr) +
+	      CONFIG_BT_CX_ENDPOINT_RPC_MAX_LEN),
+	     "TX buffers too small for RPC responses");
+
+static const struct bt_cx_endpoint_rpc_method *methods;
+static size_t method_count;
+
+static struct bt_cx_endpoint_rpc_lat lat[METHOD_COUNT];
+
+static void rpc_received(struct bt_conn *conn, const uint8_t *data,
+			 uint16_t len);
+
+static struct bt_cx_endpoint_chan rpc_chan = {
+	.id = CONFIG_BT_CX_ENDPOINT_RPC_CHAN,
+	.prio = CONFIG_BT_CX_ENDPOINT_RPC_PRIO,
+	.weight = 1,
+	.recv_cb = rpc_received,
+};
+
+static bt_cx_endpoint_rpc_handler_t handler_get(uint8_t method)
+{
+	for (size_t i = 0; i < method_count; i++) {
+		if (methods[i].method == method) {
+			return methods[i].handler;
+		}
+	}
+
+	return NULL;
+}
+
+static void lat_record(uint8_t method, uint32_t ms, int err)
+{
+	struct bt_cx_endpoint_rpc_lat *l;
+
+	if (method >= METHOD_COUNT) {
+		return;
+	}
+
+	l = &lat[method];
+	l->count++;
+	if (err) {
+		l->errors++;
+	}
+	l->total_ms += ms;
+	l->max_ms = MAX(l->max_ms, ms);
+	cx_stats_lat_add(l->hist, ms);
+}
+
+static void rpc_received(struct bt_conn *conn, const uint8_t *data,
+			 uint16_t len)
+{
+	const struct bt_cx_endpoint_rpc_hdr *req = (const void *)data;
+	struct bt_cx_endpoint_rpc_hdr *rsp_hdr;
+	bt_cx_endpoint_rpc_handler_t handler;
+	struct net_buf *rsp;
+	uint32_t stamp;
+	int ret;
+	int err;
+
+	if (len < sizeof(*req)) {
+		LOG_WRN("RPC request of %u bytes dropped", len);
+		return;
+	}
+
+	/* No response without a buffer, the call times out on the client. */
+	rsp = bt_cx_endpoint_buf_alloc(K_NO_WAIT);
+	if (!rsp) {
+		LOG_WRN("No buffer to answer RPC request %u",
+			sys_le16_to_cpu(req->id));
+		lat_record(req->method, 0, -ENOMEM);
+		return;
+	}
+
+	rsp_hdr = net_buf_add(rsp, sizeof(*rsp_hdr));
+	rsp_hdr->id = req->id;
+	rsp_hdr->method = req->method;
+
+	handler = handler_get(req->method);
+	if (handler) {
+		stamp = k_uptime_get_32();
+		ret = handler(conn, data + sizeof(*req), len - sizeof(*req),
+			      rsp);
+		lat_record(req->method, k_uptime_get_32() - stamp, ret < 0);
+	} else {
+		LOG_WRN("RPC method %u not supported", req->method);
+		ret = -ENOTSUP;
+	}
+
+	/* Results are not sent along with an error, positive values are not
+	 * errors.
+	 */
+	if (ret < 0) {
+		rsp->len = sizeof(*rsp_hdr);
+		rsp_hdr->status = MIN(-ret, UINT8_MAX);
+	} else {
+		rsp_hdr->status = 0;
+	}
+
+	err = bt_cx_endpoint_chan_send_buf(&rpc_chan, conn, rsp);
+	if (err) {
+		LOG_WRN("RPC response %u not sent (err %d)",
+			sys_le16_to_cpu(req->id), err);
+		net_buf_unref(rsp);
+	}
+}
+
+int bt_cx_endpoint_rpc_init(const struct bt_cx_endpoint_rpc_method *table,
+			    size_t count)
+{
+	int err;
+
+	if (!table || !count) {
+		return -EINVAL;
+	}
+
+	err = bt_cx_endpoint_chan_register(&rpc_chan);
+	if (err) {
+		return err;
+	}
+
+	methods = table;
+	method_count = count;
+
+	return 0;
+}
+
+int bt_cx_endpoint_rpc_lat_get(uint8_t method,
+			       struct bt_cx_endpoint_rpc_lat *out)
+{
+	if (method >= METHOD_COUNT) {
+		return -EINVAL;
+	}
+
+	*out = lat[method];
+
+	return 0;
+}
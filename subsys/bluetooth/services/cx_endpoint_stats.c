@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief CX Endpoint statistics shell commands
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+#include <stats/stats.h>
+
+/* Groups registered by the service and the client, when enabled. */
+static const char *const groups[] = {
+	"cx_endpoint",
+	"cx_endpoint_c",
+};
+
+static int entry_print(struct stats_hdr *hdr, void *arg, const char *name,
+		       uint16_t off)
+{
+	const struct shell *shell = arg;
+
+	shell_print(shell, "  %s: %u", name,
+		    *(const uint32_t *)((const uint8_t *)hdr + off));
+
+	return 0;
+}
+
+static int cmd_show(const struct shell *shell, size_t argc, char **argv)
+{
+	struct stats_hdr *hdr;
+
+	for (int i = 0; i < ARRAY_SIZE(groups); i++) {
+		hdr = stats_group_find(groups[i]);
+		if (!hdr) {
+			continue;
+		}
+
+		shell_print(shell, "%s:", groups[i]);
+		stats_walk(hdr, entry_print, (void *)shell);
+	}
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	struct stats_hdr *hdr;
+
+	for (int i = 0; i < ARRAY_SIZE(groups); i++) {
+		hdr = stats_group_find(groups[i]);
+		if (hdr) {
+			/* Counters follow the header, all of the same size. */
+			memset((uint8_t *)hdr + sizeof(*hdr), 0,
+			       hdr->s_size * hdr->s_cnt);
+		}
+	}
+
+	shell_print(shell, "Statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_cx_stats,
+	SHELL_CMD(show, NULL, "Print CX Endpoint counters", cmd_show),
+	SHELL_CMD(reset, NULL, "Clear CX Endpoint counters", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(cx_stats, &sub_cx_stats, "CX Endpoint statistics", NULL);
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CX_ENDPOINT_STATS_H_
+#define CX_ENDPOINT_STATS_H_
+
+/* Counters shared by the CX Endpoint service and client, compiled out
+ * unless CONFIG_BT_CX_ENDPOINT_STATS is enabled.
+ */
+
+#include <zephyr/types.h>
+#include <sys/util.h>
+#include <stats/stats.h>
+
+#include <bluetooth/services/cx_endpoint.h>
+
+#define CX_STATS_LAT_BUCKETS	BT_CX_ENDPOINT_STAT_LAT_BUCKETS
+
+#define CX_STATS_SECT_LAT(prefix__)		\
+	STATS_SECT_ENTRY32(prefix__##_lt1ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt2ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt4ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt8ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt16ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt32ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt64ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt128ms)	\
+	STATS_SECT_ENTRY32(prefix__##_lt256ms)	\
+	STATS_SECT_ENTRY32(prefix__##_ge256ms)
+
+#define CX_STATS_NAME_LAT(group__, prefix__)		\
+	STATS_NAME(group__, prefix__##_lt1ms)		\
+	STATS_NAME(group__, prefix__##_lt2ms)		\
+	STATS_NAME(group__, prefix__##_lt4ms)		\
+	STATS_NAME(group__, prefix__##_lt8ms)		\
+	STATS_NAME(group__, prefix__##_lt16ms)		\
+	STATS_NAME(group__, prefix__##_lt32ms)		\
+	STATS_NAME(group__, prefix__##_lt64ms)		\
+	STATS_NAME(group__, prefix__##_lt128ms)		\
+	STATS_NAME(group__, prefix__##_lt256ms)		\
+	STATS_NAME(group__, prefix__##_ge256ms)
+
+/* Count a latency in the histogram starting at bucket. */
+static inline void cx_stats_lat_add(uint32_t *bucket, uint32_t ms)
+{
+	uint8_t i = 0;
+
+	while ((i < (CX_STATS_LAT_BUCKETS - 1)) && (ms >= BIT(i))) {
+		i++;
+	}
+
+	bucket[i]++;
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_STATS)
+#define CX_STATS_INC(group__, var__)	STATS_INC(group__, var__)
+#define CX_STATS_INCN(group__, var__, n__) STATS_INCN(group__, var__, n__)
+#define CX_STATS_MAX(group__, var__, val__)		\
+	do {						\
+		if ((val__) > (group__).var__) {	\
+			(group__).var__ = (val__);	\
+		}					\
+	} while (false)
+#define CX_STATS_LAT(group__, prefix__, ms__)			\
+	cx_stats_lat_add(&(group__).prefix__##_lt1ms, (ms__))
+#else
+#define CX_STATS_INC(group__, var__)
+#define CX_STATS_INCN(group__, var__, n__)
+#define CX_STATS_MAX(group__, var__, val__)
+#define CX_STATS_LAT(group__, prefix__, ms__)
+#endif
+
+#endif /* CX_ENDPOINT_STATS_H_ */
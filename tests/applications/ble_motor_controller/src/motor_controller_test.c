@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <unity.h>
+#include <zephyr.h>
+#include <motor_controller.h>
+
+#include "motor_emul.h"
+
+#define RATE_HZ		CONFIG_APP_MOTOR_CONTROL_RATE_HZ
+#define TICKS_PER_PERIOD(rate)	(CONFIG_SYS_CLOCK_TICKS_PER_SEC / (rate))
+
+/* The closed-loop motor of native_posix.overlay, on the emulated
+ * H-bridge. The open-loop one follows.
+ */
+#define MOTOR		0
+#define MOTOR_2		1
+
+/* Q16.16 */
+#define GAIN(value)	((int32_t)((value) * 65536))
+
+#define RPM(percent)	((percent) * CONFIG_APP_MOTOR_PID_MAX_RPM / 100.0)
+
+static const struct motor_controller_pid gains = {
+	.kp = GAIN(1),
+	.ki = GAIN(10),
+	.kd = 0,
+};
+
+static void assert_rpm_within(double expected, double tolerance)
+{
+	double rpm = motor_emul_rpm();
+
+	TEST_ASSERT_TRUE(rpm >= expected - tolerance);
+	TEST_ASSERT_TRUE(rpm <= expected + tolerance);
+}
+
+static void assert_speed_within(int8_t expected, int8_t tolerance)
+{
+	int8_t speed;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_speed_get(MOTOR, &speed));
+	TEST_ASSERT_INT_WITHIN(tolerance, expected, speed);
+}
+
+static void assert_periods(uint32_t rate, size_t expected)
+{
+	const int64_t *log;
+	size_t count = motor_emul_samples(&log);
+	int64_t interval;
+
+	TEST_ASSERT_INT_WITHIN(1, expected, count);
+
+	for (size_t i = 1; i < MIN(count, MOTOR_EMUL_LOG_LEN); i++) {
+		interval = log[i] - log[i - 1];
+		TEST_ASSERT_INT_WITHIN(1, TICKS_PER_PERIOD(rate), interval);
+	}
+}
+
+void setUp(void)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		TEST_ASSERT_EQUAL(0, motor_controller_init());
+		initialized = true;
+	}
+
+	TEST_ASSERT_EQUAL(0, motor_controller_pid_set(&gains));
+	TEST_ASSERT_EQUAL(0, motor_controller_rate_set(RATE_HZ));
+	TEST_ASSERT_EQUAL(0, motor_controller_stop());
+
+	/* Let the integral term of the previous test settle. */
+	motor_emul_reset();
+	k_sleep(K_SECONDS(1));
+	motor_emul_reset();
+}
+
+void tearDown(void)
+{
+}
+
+/* Suite teardown shall finalize with mandatory call to generic_suiteTearDown. */
+extern int generic_suiteTearDown(int num_failures);
+
+int test_suiteTearDown(int num_failures)
+{
+	return generic_suiteTearDown(num_failures);
+}
+
+void test_sampled_at_control_rate(void)
+{
+	k_sleep(K_SECONDS(1));
+
+	assert_periods(RATE_HZ, RATE_HZ);
+}
+
+void test_rate_tunable(void)
+{
+	TEST_ASSERT_EQUAL(0, motor_controller_rate_set(2 * RATE_HZ));
+	TEST_ASSERT_EQUAL(2 * RATE_HZ, motor_controller_rate_get());
+	motor_emul_reset();
+
+	k_sleep(K_SECONDS(1));
+
+	assert_periods(2 * RATE_HZ, 2 * RATE_HZ);
+}
+
+void test_rate_out_of_range_rejected(void)
+{
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_rate_set(0));
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_rate_set(
+				CONFIG_SYS_CLOCK_TICKS_PER_SEC + 1));
+	TEST_ASSERT_EQUAL(RATE_HZ, motor_controller_rate_get());
+}
+
+void test_gains_tunable(void)
+{
+	struct motor_controller_pid pid = { GAIN(2), GAIN(3), GAIN(0.5) };
+	struct motor_controller_pid read;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_pid_set(&pid));
+	TEST_ASSERT_EQUAL(0, motor_controller_pid_get(&read));
+
+	TEST_ASSERT_EQUAL(pid.kp, read.kp);
+	TEST_ASSERT_EQUAL(pid.ki, read.ki);
+	TEST_ASSERT_EQUAL(pid.kd, read.kd);
+}
+
+void test_negative_gain_rejected(void)
+{
+	struct motor_controller_pid pid = { GAIN(1), -GAIN(1), 0 };
+	struct motor_controller_pid read;
+
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_pid_set(&pid));
+	TEST_ASSERT_EQUAL(0, motor_controller_pid_get(&read));
+	TEST_ASSERT_EQUAL(gains.ki, read.ki);
+}
+
+void test_converges_forward(void)
+{
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 50));
+
+	k_sleep(K_SECONDS(2));
+
+	assert_rpm_within(RPM(50), RPM(1));
+	assert_speed_within(50, 1);
+}
+
+void test_converges_backward(void)
+{
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, -30));
+
+	k_sleep(K_SECONDS(2));
+
+	assert_rpm_within(RPM(-30), RPM(1));
+	assert_speed_within(-30, 1);
+}
+
+void test_out_of_range_rejected(void)
+{
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_set(MOTOR, 101));
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_set(MOTOR, -101));
+}
+
+void test_group_applied(void)
+{
+	const struct motor_controller_setpoint setpoints[] = {
+		{ .motor = MOTOR, .speed = 20 },
+		{ .motor = MOTOR, .speed = 40 },
+	};
+
+	TEST_ASSERT_EQUAL(2, motor_controller_count());
+	TEST_ASSERT_EQUAL(0, motor_controller_set_group(setpoints,
+							ARRAY_SIZE(setpoints)));
+
+	k_sleep(K_SECONDS(2));
+
+	/* The last setpoint of a motor wins. */
+	assert_rpm_within(RPM(40), RPM(1));
+	assert_speed_within(40, 1);
+}
+
+void test_group_unknown_motor_rejected(void)
+{
+	const struct motor_controller_setpoint setpoints[] = {
+		{ .motor = MOTOR, .speed = 50 },
+		{ .motor = motor_controller_count(), .speed = 50 },
+	};
+	int8_t speed;
+
+	TEST_ASSERT_EQUAL(-EINVAL,
+			  motor_controller_set_group(setpoints,
+						     ARRAY_SIZE(setpoints)));
+	TEST_ASSERT_EQUAL(-EINVAL,
+			  motor_controller_speed_get(motor_controller_count(),
+						     &speed));
+
+	/* Nothing applied. */
+	k_sleep(K_MSEC(500));
+	assert_rpm_within(0, RPM(1));
+}
+
+void test_open_loop_motor_in_same_update(void)
+{
+	const struct motor_controller_setpoint setpoints[] = {
+		{ .motor = MOTOR, .speed = 50 },
+		{ .motor = MOTOR_2, .speed = 30 },
+	};
+	const struct motor_emul_update *log;
+	size_t count;
+	int8_t speed;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_set_group(setpoints,
+							ARRAY_SIZE(setpoints)));
+	k_sleep(K_MSEC(2 * 1000 / RATE_HZ));
+
+	/* Set along with the first output of the closed loop, then kept
+	 * in every update.
+	 */
+	count = motor_emul_updates(&log);
+	TEST_ASSERT_GREATER_THAN(0, count);
+	for (size_t i = 0; i < MIN(count, MOTOR_EMUL_LOG_LEN); i++) {
+		TEST_ASSERT_GREATER_THAN(0, log[i].pulses[0]);
+		TEST_ASSERT_EQUAL(0, log[i].pulses[1]);
+		TEST_ASSERT_GREATER_THAN(0, log[i].pulses[2]);
+		TEST_ASSERT_EQUAL(log[0].pulses[2], log[i].pulses[2]);
+		TEST_ASSERT_EQUAL(0, log[i].pulses[3]);
+	}
+
+	TEST_ASSERT_EQUAL(0, motor_controller_speed_get(MOTOR_2, &speed));
+	TEST_ASSERT_EQUAL(30, speed);
+}
+
+void test_no_windup_while_stalled(void)
+{
+	double peak = 0;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 50));
+	k_sleep(K_SECONDS(2));
+
+	/* Saturated for a long time, far from the setpoint. */
+	motor_emul_stall(true);
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 80));
+	k_sleep(K_SECONDS(2));
+	TEST_ASSERT_TRUE(motor_emul_duty() == 1.0);
+
+	motor_emul_stall(false);
+	for (int i = 0; i < 200; i++) {
+		k_sleep(K_MSEC(10));
+		peak = MAX(peak, motor_emul_rpm());
+	}
+
+	TEST_ASSERT_TRUE(peak < RPM(80) * 1.03);
+	assert_rpm_within(RPM(80), RPM(1));
+}
+
+void test_encoder_failure_coasts(void)
+{
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 50));
+	k_sleep(K_SECONDS(1));
+
+	motor_emul_fail(true);
+	k_sleep(K_MSEC(2 * 1000 / RATE_HZ));
+
+	TEST_ASSERT_TRUE(motor_emul_duty() == 0.0);
+}
+
+/* It is required to be added to each test. That is because unity is using
+ * different main signature (returns int) and zephyr expects main which does
+ * not return value.
+ */
+extern int unity_main(void);
+
+void main(void)
+{
+	(void)unity_main();
+}
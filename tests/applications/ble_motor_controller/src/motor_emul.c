@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr.h>
+#include <devicetree.h>
+#include <drivers/pwm_dual.h>
+#include <drivers/sensor.h>
+
+#include "motor_emul.h"
+
+/* Integration step of the plant. */
+#define STEP_SEC	0.0001
+
+#define HBRIDGE_CYCLES_PER_SEC	1000000
+
+#define HBRIDGE_LABEL	DT_LABEL(DT_INST(0, croxel_hbridge_emul))
+#define QDEC_LABEL	DT_LABEL(DT_INST(0, croxel_qdec_emul))
+
+static struct {
+	int64_t updated;
+	double duty;
+	double rpm;
+	/* Revolutions not reported yet. */
+	double revs;
+	/* Counts of the last sample. */
+	int32_t counts;
+	bool stalled;
+	bool fail;
+	int64_t samples[MOTOR_EMUL_LOG_LEN];
+	size_t sample_count;
+	struct motor_emul_update updates[MOTOR_EMUL_LOG_LEN];
+	size_t update_count;
+} motor;
+
+/* Integrate the plant up to now with the current duty cycle. */
+static void advance(void)
+{
+	int64_t now = k_uptime_ticks();
+	double dt = (double)(now - motor.updated) /
+		    CONFIG_SYS_CLOCK_TICKS_PER_SEC;
+	double step;
+
+	motor.updated = now;
+
+	for (; dt > 0; dt -= step) {
+		step = MIN(dt, STEP_SEC);
+		if (motor.stalled) {
+			motor.rpm = 0;
+			continue;
+		}
+
+		motor.rpm += ((motor.duty * MOTOR_EMUL_FREE_RPM) - motor.rpm) *
+			     step * 1000 / MOTOR_EMUL_TAU_MS;
+		motor.revs += motor.rpm * step / 60;
+	}
+}
+
+static int hbridge_set_cycles(const struct device *dev, uint32_t period,
+			      const uint32_t *pulses)
+{
+	struct motor_emul_update *update;
+
+	for (int i = 0; i < MOTOR_EMUL_CHANNELS; i++) {
+		if (pulses[i] > period) {
+			return -EINVAL;
+		}
+	}
+
+	advance();
+	motor.duty = ((double)pulses[0] - (double)pulses[1]) / period;
+
+	if (motor.update_count < ARRAY_SIZE(motor.updates)) {
+		update = &motor.updates[motor.update_count];
+		update->time = motor.updated;
+		memcpy(update->pulses, pulses, sizeof(update->pulses));
+	}
+
+	motor.update_count++;
+
+	return 0;
+}
+
+static int hbridge_set_channel_cycles(const struct device *dev,
+				      uint32_t channel, uint32_t period,
+				      uint32_t pulse)
+{
+	return -ENOTSUP;
+}
+
+static int hbridge_get_cycles_per_sec(const struct device *dev,
+				      uint64_t *cycles)
+{
+	*cycles = HBRIDGE_CYCLES_PER_SEC;
+
+	return 0;
+}
+
+static uint8_t hbridge_channel_count(const struct device *dev)
+{
+	return MOTOR_EMUL_CHANNELS;
+}
+
+static int qdec_sample_fetch(const struct device *dev,
+			     enum sensor_channel chan)
+{
+	if (motor.fail) {
+		return -EIO;
+	}
+
+	advance();
+
+	/* Whole counts, the remainder is reported with the next sample. */
+	motor.counts = motor.revs * MOTOR_EMUL_COUNTS_PER_REV;
+	motor.revs -= (double)motor.counts / MOTOR_EMUL_COUNTS_PER_REV;
+
+	if (motor.sample_count < ARRAY_SIZE(motor.samples)) {
+		motor.samples[motor.sample_count] = motor.updated;
+	}
+
+	motor.sample_count++;
+
+	return 0;
+}
+
+static int qdec_channel_get(const struct device *dev,
+			    enum sensor_channel chan,
+			    struct sensor_value *val)
+{
+	int64_t udeg;
+
+	if (chan != SENSOR_CHAN_ROTATION) {
+		return -ENOTSUP;
+	}
+
+	udeg = ((int64_t)motor.counts * 360 * 1000000) /
+	       MOTOR_EMUL_COUNTS_PER_REV;
+	val->val1 = udeg / 1000000;
+	val->val2 = udeg % 1000000;
+
+	return 0;
+}
+
+void motor_emul_reset(void)
+{
+	memset(&motor, 0, sizeof(motor));
+	motor.updated = k_uptime_ticks();
+}
+
+void motor_emul_stall(bool stalled)
+{
+	advance();
+	motor.stalled = stalled;
+}
+
+void motor_emul_fail(bool fail)
+{
+	motor.fail = fail;
+}
+
+double motor_emul_rpm(void)
+{
+	advance();
+
+	return motor.rpm;
+}
+
+double motor_emul_duty(void)
+{
+	return motor.duty;
+}
+
+size_t motor_emul_samples(const int64_t **log)
+{
+	*log = motor.samples;
+
+	return motor.sample_count;
+}
+
+size_t motor_emul_updates(const struct motor_emul_update **log)
+{
+	*log = motor.updates;
+
+	return motor.update_count;
+}
+
+static int motor_emul_init(const struct device *dev)
+{
+	motor_emul_reset();
+
+	return 0;
+}
+
+static const struct pwm_dual_driver_api hbridge_api = {
+	.set_cycles = hbridge_set_cycles,
+	.set_channel_cycles = hbridge_set_channel_cycles,
+	.get_cycles_per_sec = hbridge_get_cycles_per_sec,
+	.channel_count = hbridge_channel_count,
+};
+
+static const struct sensor_driver_api qdec_api = {
+	.sample_fetch = qdec_sample_fetch,
+	.channel_get = qdec_channel_get,
+};
+
+DEVICE_AND_API_INIT(motor_emul_hbridge, HBRIDGE_LABEL,
+		    motor_emul_init, NULL, NULL, POST_KERNEL,
+		    CONFIG_KERNEL_INIT_PRIORITY_DEVICE, &hbridge_api);
+
+DEVICE_AND_API_INIT(motor_emul_qdec, QDEC_LABEL, motor_emul_init,
+		    NULL, NULL, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE,
+		    &qdec_api);
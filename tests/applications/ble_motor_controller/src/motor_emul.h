@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef MOTOR_EMUL_H_
+#define MOTOR_EMUL_H_
+
+/* Emulated motor, driven by channels 0 and 1 of a four-channel PWM Dual
+ * device and read by a quadrature decoder sensor device. Channels 2 and
+ * 3 drive a second motor, recorded only.
+ *
+ * The motor is a first order plant: its speed moves towards the duty
+ * cycle times MOTOR_EMUL_FREE_RPM with a time constant. The plant is
+ * integrated in simulated time whenever the duty cycle changes or the
+ * encoder is sampled, and the encoder reports whole counts.
+ */
+
+#include <zephyr/types.h>
+#include <device.h>
+
+/* Speed at 100 percent duty cycle, unloaded. */
+#define MOTOR_EMUL_FREE_RPM	6000
+#define MOTOR_EMUL_TAU_MS	50
+#define MOTOR_EMUL_COUNTS_PER_REV	1024
+
+#define MOTOR_EMUL_LOG_LEN	256
+
+#define MOTOR_EMUL_CHANNELS	4
+
+/* Update of the PWM Dual device. */
+struct motor_emul_update {
+	/* Uptime in ticks. */
+	int64_t time;
+	uint32_t pulses[MOTOR_EMUL_CHANNELS];
+};
+
+/* Stop the motor and clear the samples, the failure and the stall. */
+void motor_emul_reset(void);
+
+/* Hold the shaft, or release it. */
+void motor_emul_stall(bool stalled);
+
+/* Make the encoder samples fail with -EIO, or succeed again. */
+void motor_emul_fail(bool fail);
+
+/* Current speed, in RPM. */
+double motor_emul_rpm(void);
+
+/* Duty cycle last applied, from -1 backward to 1 forward. */
+double motor_emul_duty(void);
+
+/* Uptime in ticks of each encoder sample since the last reset, the first
+ * ones if more than the log holds. Returns the number of samples.
+ */
+size_t motor_emul_samples(const int64_t **log);
+
+/* Each update of the PWM Dual device since the last reset, the first ones
+ * if more than the log holds. Returns the number of updates.
+ */
+size_t motor_emul_updates(const struct motor_emul_update **log);
+
+#endif /* MOTOR_EMUL_H_ */
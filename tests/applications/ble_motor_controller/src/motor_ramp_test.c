@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <unity.h>
+#include <zephyr.h>
+#include <motor_controller.h>
+
+#include "motor_emul.h"
+
+#define RATE_HZ		CONFIG_APP_MOTOR_CONTROL_RATE_HZ
+#define TICKS_PER_PERIOD(rate)	(CONFIG_SYS_CLOCK_TICKS_PER_SEC / (rate))
+
+/* Percent of full speed per second. */
+#define ACCEL		CONFIG_APP_MOTOR_RAMP_ACCEL
+
+/* The motors of native_posix.overlay, on channels 0-1 and 2-3 of the
+ * emulated group.
+ */
+#define MOTOR		0
+#define MOTOR_2		1
+
+static const struct motor_controller_ramp linear = {
+	.profile = MOTOR_CONTROLLER_PROFILE_LINEAR,
+	.accel = ACCEL,
+};
+
+static void assert_speed_within(int8_t expected, int8_t tolerance)
+{
+	int8_t speed;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_speed_get(MOTOR, &speed));
+	TEST_ASSERT_INT_WITHIN(tolerance, expected, speed);
+}
+
+static void assert_duty_within(double expected, double tolerance)
+{
+	double duty = motor_emul_duty();
+
+	TEST_ASSERT_TRUE(duty >= expected - tolerance);
+	TEST_ASSERT_TRUE(duty <= expected + tolerance);
+}
+
+/* Every update of the H-bridge at least min_count, one control period
+ * apart.
+ */
+static void assert_updates_periodic(uint32_t rate, size_t min_count)
+{
+	const struct motor_emul_update *log;
+	size_t count = motor_emul_updates(&log);
+	int64_t interval;
+
+	TEST_ASSERT_GREATER_OR_EQUAL(min_count, count);
+
+	for (size_t i = 1; i < MIN(count, MOTOR_EMUL_LOG_LEN); i++) {
+		interval = log[i].time - log[i - 1].time;
+		TEST_ASSERT_INT_WITHIN(1, TICKS_PER_PERIOD(rate), interval);
+	}
+}
+
+void setUp(void)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		TEST_ASSERT_EQUAL(0, motor_controller_init());
+		initialized = true;
+	}
+
+	TEST_ASSERT_EQUAL(0, motor_controller_ramp_set(&linear));
+	TEST_ASSERT_EQUAL(0, motor_controller_rate_set(RATE_HZ));
+	TEST_ASSERT_EQUAL(0, motor_controller_stop());
+
+	/* Longest ramp down from full speed. */
+	k_sleep(K_MSEC(100 * MSEC_PER_SEC / ACCEL + 100));
+	motor_emul_reset();
+}
+
+void tearDown(void)
+{
+}
+
+/* Suite teardown shall finalize with mandatory call to generic_suiteTearDown. */
+extern int generic_suiteTearDown(int num_failures);
+
+int test_suiteTearDown(int num_failures)
+{
+	return generic_suiteTearDown(num_failures);
+}
+
+void test_ramp_follows_acceleration(void)
+{
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 50));
+
+	k_sleep(K_MSEC(100));
+	assert_speed_within(ACCEL / 10, 2);
+
+	k_sleep(K_MSEC(50 * MSEC_PER_SEC / ACCEL));
+	assert_speed_within(50, 0);
+	assert_duty_within(0.5, 0.001);
+}
+
+void test_ramp_ends_at_setpoint(void)
+{
+	const struct motor_emul_update *log;
+	size_t count;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, -20));
+	k_sleep(K_MSEC(20 * MSEC_PER_SEC / ACCEL + 100));
+
+	assert_speed_within(-20, 0);
+	assert_duty_within(-0.2, 0.001);
+
+	/* No update once the setpoint is reached. */
+	count = motor_emul_updates(&log);
+	k_sleep(K_MSEC(200));
+	TEST_ASSERT_EQUAL(count, motor_emul_updates(&log));
+}
+
+void test_s_curve_takes_longer(void)
+{
+	const struct motor_controller_ramp s_curve = {
+		.profile = MOTOR_CONTROLLER_PROFILE_S_CURVE,
+		.accel = ACCEL,
+	};
+	int8_t speed;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_ramp_set(&s_curve));
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 50));
+
+	/* Where the linear ramp ends, 1.5 times shorter. */
+	k_sleep(K_MSEC(50 * MSEC_PER_SEC / ACCEL));
+	TEST_ASSERT_EQUAL(0, motor_controller_speed_get(MOTOR, &speed));
+	TEST_ASSERT_LESS_THAN(48, speed);
+
+	k_sleep(K_MSEC(25 * MSEC_PER_SEC / ACCEL + 20));
+	assert_speed_within(50, 0);
+}
+
+void test_repeated_setpoint_keeps_ramping(void)
+{
+	/* Setpoints streamed faster than the control rate. */
+	for (int i = 0; i < 30; i++) {
+		TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 100));
+		k_sleep(K_MSEC(7));
+	}
+
+	assert_speed_within((ACCEL * 210) / MSEC_PER_SEC, 3);
+	assert_updates_periodic(RATE_HZ, 20);
+}
+
+void test_new_setpoints_keep_phase(void)
+{
+	for (int i = 0; i < 30; i++) {
+		TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR,
+							  (i % 2) ? 80 : 90));
+		k_sleep(K_MSEC(7));
+	}
+
+	assert_updates_periodic(RATE_HZ, 20);
+}
+
+void test_rate_change_replans(void)
+{
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 100));
+	k_sleep(K_MSEC(100));
+
+	TEST_ASSERT_EQUAL(0, motor_controller_rate_set(RATE_HZ / 2));
+	motor_emul_reset();
+	k_sleep(K_MSEC(200));
+
+	assert_updates_periodic(RATE_HZ / 2, 9);
+	assert_speed_within((ACCEL * 300) / MSEC_PER_SEC, 3);
+}
+
+void test_direct_setpoint_skips_ramp(void)
+{
+	const struct motor_emul_update *log;
+	size_t count;
+
+	TEST_ASSERT_EQUAL(0, motor_controller_set(MOTOR, 100));
+	k_sleep(K_MSEC(50));
+
+	/* Applied at once, ending the ramp in progress. */
+	TEST_ASSERT_EQUAL(0, motor_controller_set_direct(MOTOR, 30));
+	assert_speed_within(30, 0);
+	assert_duty_within(0.3, 0.001);
+
+	count = motor_emul_updates(&log);
+	k_sleep(K_MSEC(100));
+	TEST_ASSERT_EQUAL(count, motor_emul_updates(&log));
+	assert_duty_within(0.3, 0.001);
+}
+
+void test_group_single_update_per_tick(void)
+{
+	const struct motor_controller_setpoint setpoints[] = {
+		{ .motor = MOTOR, .speed = 40 },
+		{ .motor = MOTOR_2, .speed = -60 },
+	};
+	const struct motor_emul_update *log;
+	size_t count;
+
+	TEST_ASSERT_EQUAL(2, motor_controller_count());
+	TEST_ASSERT_EQUAL(0, motor_controller_set_group(setpoints,
+							ARRAY_SIZE(setpoints)));
+
+	/* Both motors still ramping. */
+	k_sleep(K_MSEC(100));
+	assert_updates_periodic(RATE_HZ, 9);
+
+	/* Each tick moves both motors with a single call to the group. */
+	count = motor_emul_updates(&log);
+	for (size_t i = 0; i < count; i++) {
+		TEST_ASSERT_EQUAL(0, log[i].pulses[1]);
+		TEST_ASSERT_EQUAL(0, log[i].pulses[2]);
+		TEST_ASSERT_GREATER_THAN(i ? log[i - 1].pulses[0] : 0,
+					 log[i].pulses[0]);
+		TEST_ASSERT_GREATER_THAN(i ? log[i - 1].pulses[3] : 0,
+					 log[i].pulses[3]);
+	}
+}
+
+void test_invalid_ramp_rejected(void)
+{
+	const struct motor_controller_ramp no_accel = {
+		.profile = MOTOR_CONTROLLER_PROFILE_LINEAR,
+		.accel = 0,
+	};
+	const struct motor_controller_ramp unknown = {
+		.profile = MOTOR_CONTROLLER_PROFILE_S_CURVE + 1,
+		.accel = ACCEL,
+	};
+
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_ramp_set(&no_accel));
+	TEST_ASSERT_EQUAL(-EINVAL, motor_controller_ramp_set(&unknown));
+}
+
+/* It is required to be added to each test. That is because unity is using
+ * different main signature (returns int) and zephyr expects main which does
+ * not return value.
+ */
+extern int unity_main(void);
+
+void main(void)
+{
+	(void)unity_main();
+}
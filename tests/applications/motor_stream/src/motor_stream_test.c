@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <unity.h>
+#include <zephyr.h>
+#include <sys/byteorder.h>
+#include <motor_controller.h>
+#include <motor_stream.h>
+
+#define DELAY_MS	CONFIG_APP_MOTOR_STREAM_DELAY_MS
+#define PERIOD_MS	(MSEC_PER_SEC / CONFIG_APP_MOTOR_STREAM_RATE_HZ)
+#define DEPTH		CONFIG_APP_MOTOR_STREAM_DEPTH
+
+#define LOG_LEN		16
+
+/* Setpoints applied by the stream, in place of the motor controller. */
+static struct {
+	int64_t time;
+	uint8_t motor;
+	int8_t speed;
+} applied[LOG_LEN];
+static size_t applied_count;
+
+static struct motor_stream_stats before;
+
+int motor_controller_set_direct(uint8_t motor, int8_t speed)
+{
+	if (applied_count < ARRAY_SIZE(applied)) {
+		applied[applied_count].time = k_uptime_get();
+		applied[applied_count].motor = motor;
+		applied[applied_count].speed = speed;
+	}
+
+	applied_count++;
+
+	return 0;
+}
+
+/* Send a stream packet of count setpoints, at the sender times given. */
+static int send(const uint16_t *times, const int8_t *speeds, uint8_t count)
+{
+	uint8_t buf[MOTOR_STREAM_HDR_LEN + (LOG_LEN * MOTOR_STREAM_SETPOINT_LEN)];
+	uint8_t *setpoint = &buf[MOTOR_STREAM_HDR_LEN];
+
+	buf[0] = MOTOR_STREAM_ID;
+	buf[1] = count;
+
+	for (uint8_t i = 0; i < count; i++) {
+		sys_put_le16(times[i], setpoint);
+		setpoint[2] = speeds[i];
+		setpoint += MOTOR_STREAM_SETPOINT_LEN;
+	}
+
+	return motor_stream_recv(buf, setpoint - buf);
+}
+
+/* Statistics since the start of the test. */
+static void stats_get(struct motor_stream_stats *stats)
+{
+	motor_stream_stats_get(stats);
+	stats->underruns -= before.underruns;
+	stats->overruns -= before.overruns;
+	stats->played -= before.played;
+}
+
+static void assert_applied(const int8_t *speeds, size_t count)
+{
+	TEST_ASSERT_EQUAL(count, applied_count);
+
+	/* The stream drives the first motor. */
+	for (size_t i = 0; i < count; i++) {
+		TEST_ASSERT_EQUAL(0, applied[i].motor);
+		TEST_ASSERT_EQUAL(speeds[i], applied[i].speed);
+	}
+}
+
+void setUp(void)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		TEST_ASSERT_EQUAL(0, motor_stream_init());
+		initialized = true;
+	}
+
+	motor_stream_stop();
+	applied_count = 0;
+	motor_stream_stats_get(&before);
+}
+
+void tearDown(void)
+{
+}
+
+/* Suite teardown shall finalize with mandatory call to generic_suiteTearDown. */
+extern int generic_suiteTearDown(int num_failures);
+
+int test_suiteTearDown(int num_failures)
+{
+	return generic_suiteTearDown(num_failures);
+}
+
+void test_played_after_delay(void)
+{
+	const uint16_t times[] = { 1000, 1010, 1020 };
+	const int8_t speeds[] = { 10, 20, 30 };
+	struct motor_stream_stats stats;
+	int64_t start = k_uptime_get();
+
+	TEST_ASSERT_EQUAL(0, send(times, speeds, ARRAY_SIZE(times)));
+	k_sleep(K_MSEC(DELAY_MS + 100));
+
+	assert_applied(speeds, ARRAY_SIZE(speeds));
+
+	/* The first one after the delay, on the next playout period, the
+	 * others keep their spacing.
+	 */
+	TEST_ASSERT_INT_WITHIN(PERIOD_MS / 2, start + DELAY_MS + PERIOD_MS / 2,
+			       applied[0].time);
+	TEST_ASSERT_INT_WITHIN(1, 10, applied[1].time - applied[0].time);
+	TEST_ASSERT_INT_WITHIN(1, 10, applied[2].time - applied[1].time);
+
+	/* Ran dry after the last one. */
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(3, stats.played);
+	TEST_ASSERT_EQUAL(1, stats.underruns);
+	TEST_ASSERT_EQUAL(0, stats.overruns);
+	TEST_ASSERT_EQUAL(0, stats.buffered);
+}
+
+void test_sender_time_unwrapped(void)
+{
+	const uint16_t first[] = { 65520, 65530 };
+	const uint16_t second[] = { 4, 14 };
+	const int8_t speeds[] = { 10, 20 };
+	const int8_t more_speeds[] = { 30, 40 };
+	const int8_t expected[] = { 10, 20, 30, 40 };
+
+	/* Wrapping within a packet, then between packets. */
+	TEST_ASSERT_EQUAL(0, send(first, speeds, ARRAY_SIZE(first)));
+	k_sleep(K_MSEC(5));
+	TEST_ASSERT_EQUAL(0, send(second, more_speeds, ARRAY_SIZE(second)));
+	k_sleep(K_MSEC(DELAY_MS + 100));
+
+	assert_applied(expected, ARRAY_SIZE(expected));
+	for (size_t i = 1; i < ARRAY_SIZE(expected); i++) {
+		TEST_ASSERT_INT_WITHIN(1, 10,
+				       applied[i].time - applied[i - 1].time);
+	}
+}
+
+void test_closer_than_period_merged(void)
+{
+	const uint16_t times[] = { 1000, 1002, 1004 };
+	const int8_t speeds[] = { 10, 20, 30 };
+	const int8_t expected[] = { 30 };
+	struct motor_stream_stats stats;
+
+	TEST_ASSERT_EQUAL(0, send(times, speeds, ARRAY_SIZE(times)));
+	k_sleep(K_MSEC(DELAY_MS + 100));
+
+	assert_applied(expected, ARRAY_SIZE(expected));
+
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(3, stats.played);
+}
+
+void test_overrun_drops_oldest(void)
+{
+	const uint16_t times[] = { 1000, 1010, 1020, 1030, 1040, 1050 };
+	const int8_t speeds[] = { 1, 2, 3, 4, 5, 6 };
+	struct motor_stream_stats stats;
+
+	BUILD_ASSERT(ARRAY_SIZE(times) == DEPTH + 2,
+		     "Two setpoints more than the buffer holds");
+
+	TEST_ASSERT_EQUAL(0, send(times, speeds, ARRAY_SIZE(times)));
+
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(2, stats.overruns);
+	TEST_ASSERT_EQUAL(DEPTH, stats.buffered);
+
+	k_sleep(K_MSEC(DELAY_MS + 100));
+
+	/* The latest ones are kept. */
+	assert_applied(&speeds[2], DEPTH);
+
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(DEPTH, stats.played);
+	TEST_ASSERT_EQUAL(1, stats.underruns);
+}
+
+void test_underrun_resyncs(void)
+{
+	const uint16_t first[] = { 1000 };
+	const uint16_t later[] = { 5000 };
+	const int8_t speeds[] = { 10 };
+	const int8_t more_speeds[] = { 20 };
+	struct motor_stream_stats stats;
+	int64_t start;
+
+	TEST_ASSERT_EQUAL(0, send(first, speeds, ARRAY_SIZE(first)));
+	k_sleep(K_MSEC(DELAY_MS + 50));
+
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(1, stats.underruns);
+
+	/* Played after the delay again, whatever the sender time. */
+	start = k_uptime_get();
+	TEST_ASSERT_EQUAL(0, send(later, more_speeds, ARRAY_SIZE(later)));
+	k_sleep(K_MSEC(DELAY_MS + 50));
+
+	TEST_ASSERT_EQUAL(2, applied_count);
+	TEST_ASSERT_EQUAL(20, applied[1].speed);
+	TEST_ASSERT_INT_WITHIN(PERIOD_MS / 2, start + DELAY_MS + PERIOD_MS / 2,
+			       applied[1].time);
+
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(2, stats.underruns);
+}
+
+void test_stop_drops_buffered(void)
+{
+	const uint16_t times[] = { 1000, 1010 };
+	const int8_t speeds[] = { 10, 20 };
+	struct motor_stream_stats stats;
+
+	TEST_ASSERT_EQUAL(0, send(times, speeds, ARRAY_SIZE(times)));
+	motor_stream_stop();
+	k_sleep(K_MSEC(DELAY_MS + 100));
+
+	TEST_ASSERT_EQUAL(0, applied_count);
+
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(0, stats.played);
+	TEST_ASSERT_EQUAL(0, stats.buffered);
+}
+
+void test_malformed_rejected(void)
+{
+	const uint8_t wrong_id[] = { 0x7f, 1, 0xe8, 0x03, 10 };
+	const uint8_t wrong_count[] = { MOTOR_STREAM_ID, 2, 0xe8, 0x03, 10 };
+	const uint8_t wrong_speed[] = { MOTOR_STREAM_ID, 2, 0xe8, 0x03, 10,
+					0xf2, 0x03, 101 };
+	const uint8_t truncated[] = { MOTOR_STREAM_ID };
+	struct motor_stream_stats stats;
+
+	TEST_ASSERT_EQUAL(-EINVAL, motor_stream_recv(wrong_id,
+						     sizeof(wrong_id)));
+	TEST_ASSERT_EQUAL(-EINVAL, motor_stream_recv(wrong_count,
+						     sizeof(wrong_count)));
+	TEST_ASSERT_EQUAL(-EINVAL, motor_stream_recv(wrong_speed,
+						     sizeof(wrong_speed)));
+	TEST_ASSERT_EQUAL(-EINVAL, motor_stream_recv(truncated,
+						     sizeof(truncated)));
+
+	/* Nothing buffered, not even the valid setpoint of a packet. */
+	stats_get(&stats);
+	TEST_ASSERT_EQUAL(0, stats.buffered);
+	k_sleep(K_MSEC(DELAY_MS + 50));
+	TEST_ASSERT_EQUAL(0, applied_count);
+}
+
+/* It is required to be added to each test. That is because unity is using
+ * different main signature (returns int) and zephyr expects main which does
+ * not return value.
+ */
+extern int unity_main(void);
+
+void main(void)
+{
+	(void)unity_main();
+}
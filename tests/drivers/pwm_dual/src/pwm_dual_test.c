@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <unity.h>
+#include <zephyr.h>
+#include <drivers/pwm_dual.h>
+
+#include "pwm_emul.h"
+
+#define PERIOD_USEC	1000U
+#define STEP_USEC	250U
+#define CYCLES(usec)	((usec) * (PWM_EMUL_CYCLES_PER_SEC / USEC_PER_SEC))
+
+#define BRIDGE_SYNC_NAME	"BRIDGE_SYNC"
+#define BRIDGE_NAME		"BRIDGE"
+#define MOTORS_NAME		"MOTORS"
+
+static const struct device *sync_dev;
+static const struct device *seq_dev;
+static const struct device *bridge_sync;
+static const struct device *bridge;
+static const struct device *motors;
+
+static int set(const struct device *dev, uint32_t ch0_usec, uint32_t ch1_usec)
+{
+	uint32_t pulses[] = { ch0_usec, ch1_usec };
+
+	return pwm_dual_set_usec(dev, PERIOD_USEC, pulses);
+}
+
+/* Drive one leg up and down, then the other one, with abrupt reversals
+ * from full speed, as a motor controller would. Returns the number of
+ * settings applied.
+ */
+static size_t sweep(const struct device *dev)
+{
+	size_t count = 0;
+
+	for (int leg = 0; leg < 2; leg++) {
+		for (uint32_t pulse = 0; pulse <= PERIOD_USEC;
+		     pulse += STEP_USEC) {
+			TEST_ASSERT_EQUAL(0, leg ? set(dev, 0, pulse) :
+						   set(dev, pulse, 0));
+			count++;
+		}
+
+		TEST_ASSERT_EQUAL(0, leg ? set(dev, PERIOD_USEC, 0) :
+					   set(dev, 0, PERIOD_USEC));
+		count++;
+	}
+
+	return count;
+}
+
+static void assert_one_leg_driven(const struct device *dev)
+{
+	const struct pwm_emul_output *log;
+	size_t reloads = pwm_emul_reloads(dev, &log);
+
+	for (size_t i = 0; i < reloads; i++) {
+		TEST_ASSERT_FALSE(log[i].pulse[0] && log[i].pulse[1]);
+	}
+}
+
+void setUp(void)
+{
+	sync_dev = device_get_binding(PWM_EMUL_SYNC_NAME);
+	seq_dev = device_get_binding(PWM_EMUL_NAME);
+	bridge_sync = device_get_binding(BRIDGE_SYNC_NAME);
+	bridge = device_get_binding(BRIDGE_NAME);
+	motors = device_get_binding(MOTORS_NAME);
+	TEST_ASSERT_NOT_NULL(sync_dev);
+	TEST_ASSERT_NOT_NULL(seq_dev);
+	TEST_ASSERT_NOT_NULL(bridge_sync);
+	TEST_ASSERT_NOT_NULL(bridge);
+	TEST_ASSERT_NOT_NULL(motors);
+
+	/* Groups sharing a controller start from released channels. */
+	TEST_ASSERT_EQUAL(0, set(bridge_sync, 0, 0));
+	TEST_ASSERT_EQUAL(0, set(bridge, 0, 0));
+	TEST_ASSERT_EQUAL(0, pwm_dual_set_usec(motors, PERIOD_USEC,
+					       (uint32_t[4]) { 0 }));
+
+	pwm_emul_reset(sync_dev);
+	pwm_emul_reset(seq_dev);
+}
+
+void tearDown(void)
+{
+}
+
+/* Suite teardown shall finalize with mandatory call to generic_suiteTearDown. */
+extern int generic_suiteTearDown(int num_failures);
+
+int test_suiteTearDown(int num_failures)
+{
+	return generic_suiteTearDown(num_failures);
+}
+
+void test_channel_count_from_devicetree(void)
+{
+	TEST_ASSERT_EQUAL(2, pwm_dual_channel_count(bridge_sync));
+	TEST_ASSERT_EQUAL(2, pwm_dual_channel_count(bridge));
+	TEST_ASSERT_EQUAL(4, pwm_dual_channel_count(motors));
+}
+
+void test_sync_update_is_single_reload(void)
+{
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(0, set(bridge_sync, 300, 700));
+
+	TEST_ASSERT_EQUAL(1, pwm_emul_reloads(sync_dev, &log));
+	TEST_ASSERT_EQUAL(CYCLES(PERIOD_USEC), log[0].period);
+	TEST_ASSERT_EQUAL(CYCLES(300), log[0].pulse[0]);
+	TEST_ASSERT_EQUAL(CYCLES(700), log[0].pulse[1]);
+}
+
+void test_sync_reversal_on_same_boundary(void)
+{
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(0, set(bridge_sync, PERIOD_USEC, 0));
+	TEST_ASSERT_EQUAL(0, set(bridge_sync, 0, PERIOD_USEC));
+
+	TEST_ASSERT_EQUAL(2, pwm_emul_reloads(sync_dev, &log));
+	TEST_ASSERT_EQUAL(0, log[1].pulse[0]);
+	TEST_ASSERT_EQUAL(CYCLES(PERIOD_USEC), log[1].pulse[1]);
+}
+
+void test_sync_sweep_reloads_once_per_setting(void)
+{
+	const struct pwm_emul_output *log;
+	size_t count = sweep(bridge_sync);
+
+	TEST_ASSERT_EQUAL(count, pwm_emul_reloads(sync_dev, &log));
+	assert_one_leg_driven(sync_dev);
+}
+
+void test_sync_all_channels_single_reload(void)
+{
+	uint32_t pulses[] = { 100, 200, 300, 400 };
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(0, pwm_dual_set_usec(motors, PERIOD_USEC, pulses));
+
+	TEST_ASSERT_EQUAL(1, pwm_emul_reloads(sync_dev, &log));
+	for (int i = 0; i < ARRAY_SIZE(pulses); i++) {
+		TEST_ASSERT_EQUAL(CYCLES(pulses[i]), log[0].pulse[i]);
+	}
+}
+
+void test_set_channel_keeps_other_channels(void)
+{
+	uint32_t pulses[] = { 100, 200, 300, 400 };
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(0, pwm_dual_set_usec(motors, PERIOD_USEC, pulses));
+	TEST_ASSERT_EQUAL(0, pwm_dual_set_channel_usec(motors, 2, PERIOD_USEC,
+						       900));
+
+	TEST_ASSERT_EQUAL(2, pwm_emul_reloads(sync_dev, &log));
+	TEST_ASSERT_EQUAL(CYCLES(100), log[1].pulse[0]);
+	TEST_ASSERT_EQUAL(CYCLES(200), log[1].pulse[1]);
+	TEST_ASSERT_EQUAL(CYCLES(900), log[1].pulse[2]);
+	TEST_ASSERT_EQUAL(CYCLES(400), log[1].pulse[3]);
+}
+
+void test_channel_out_of_range_rejected(void)
+{
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(-EINVAL, pwm_dual_set_channel_usec(bridge_sync, 2,
+							     PERIOD_USEC, 0));
+	TEST_ASSERT_EQUAL(0, pwm_emul_reloads(sync_dev, &log));
+}
+
+void test_sequential_releases_leg_first(void)
+{
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(0, set(bridge, PERIOD_USEC, 0));
+	pwm_emul_reset(seq_dev);
+	TEST_ASSERT_EQUAL(0, set(bridge, 0, PERIOD_USEC));
+
+	/* Both legs released for a period, never both driven. */
+	TEST_ASSERT_EQUAL(2, pwm_emul_reloads(seq_dev, &log));
+	TEST_ASSERT_EQUAL(0, log[0].pulse[0]);
+	TEST_ASSERT_EQUAL(0, log[0].pulse[1]);
+	TEST_ASSERT_EQUAL(CYCLES(PERIOD_USEC), log[1].pulse[1]);
+}
+
+void test_sequential_sweep_never_drives_both_legs(void)
+{
+	const struct pwm_emul_output *log;
+	size_t count = sweep(bridge);
+
+	TEST_ASSERT_EQUAL(2 * count, pwm_emul_reloads(seq_dev, &log));
+	assert_one_leg_driven(seq_dev);
+}
+
+void test_backend_register_incomplete_rejected(void)
+{
+	struct pwm_dual_backend backend = {
+		.dev = seq_dev,
+	};
+
+	TEST_ASSERT_EQUAL(-EINVAL, pwm_dual_backend_register(NULL));
+	TEST_ASSERT_EQUAL(-EINVAL, pwm_dual_backend_register(&backend));
+}
+
+void test_pulse_longer_than_period_rejected(void)
+{
+	const struct pwm_emul_output *log;
+
+	TEST_ASSERT_EQUAL(-EINVAL, set(bridge_sync, PERIOD_USEC + 1, 0));
+	TEST_ASSERT_EQUAL(0, pwm_emul_reloads(sync_dev, &log));
+}
+
+void test_period_overflowing_cycles_rejected(void)
+{
+	uint32_t pulses[] = { 0, 0 };
+
+	TEST_ASSERT_EQUAL(-ENOTSUP, pwm_dual_set_usec(bridge_sync, UINT32_MAX,
+						      pulses));
+}
+
+/* It is required to be added to each test. That is because unity is using
+ * different main signature (returns int) and zephyr expects main which does
+ * not return value.
+ */
+extern int unity_main(void);
+
+void main(void)
+{
+	(void)unity_main();
+}
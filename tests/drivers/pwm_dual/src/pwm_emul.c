@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#define DT_DRV_COMPAT croxel_pwm_emul
+
+#include <string.h>
+#include <errno.h>
+#include <sys/util.h>
+#include <drivers/pwm.h>
+#include <drivers/pwm_dual.h>
+
+#include "pwm_emul.h"
+
+#define LOG_LEN	64
+
+struct pwm_emul_config {
+	bool sync;
+};
+
+struct pwm_emul_data {
+	struct pwm_emul_output out;
+	struct pwm_emul_output log[LOG_LEN];
+	size_t reloads;
+	struct pwm_dual_backend backend;
+};
+
+static void reload(struct pwm_emul_data *data)
+{
+	if (data->reloads < ARRAY_SIZE(data->log)) {
+		data->log[data->reloads] = data->out;
+	}
+
+	data->reloads++;
+}
+
+static int pwm_emul_pin_set(const struct device *dev, uint32_t pwm,
+			    uint32_t period_cycles, uint32_t pulse_cycles,
+			    pwm_flags_t flags)
+{
+	struct pwm_emul_data *data = dev->data;
+
+	if ((pwm >= PWM_EMUL_CHANNELS) || (pulse_cycles > period_cycles)) {
+		return -EINVAL;
+	}
+
+	data->out.period = period_cycles;
+	data->out.pulse[pwm] = pulse_cycles;
+	reload(data);
+
+	return 0;
+}
+
+static int pwm_emul_pin_set_multi(const struct device *dev,
+				  uint32_t period_cycles, const uint32_t *pins,
+				  const uint32_t *pulses, size_t count)
+{
+	struct pwm_emul_data *data = dev->data;
+
+	for (size_t i = 0; i < count; i++) {
+		if ((pins[i] >= PWM_EMUL_CHANNELS) ||
+		    (pulses[i] > period_cycles)) {
+			return -EINVAL;
+		}
+	}
+
+	data->out.period = period_cycles;
+	for (size_t i = 0; i < count; i++) {
+		data->out.pulse[pins[i]] = pulses[i];
+	}
+	reload(data);
+
+	return 0;
+}
+
+static int pwm_emul_get_cycles_per_sec(const struct device *dev,
+				       uint32_t pwm, uint64_t *cycles)
+{
+	*cycles = PWM_EMUL_CYCLES_PER_SEC;
+
+	return 0;
+}
+
+size_t pwm_emul_reloads(const struct device *dev,
+			const struct pwm_emul_output **log)
+{
+	struct pwm_emul_data *data = dev->data;
+
+	*log = data->log;
+
+	return data->reloads;
+}
+
+void pwm_emul_reset(const struct device *dev)
+{
+	struct pwm_emul_data *data = dev->data;
+
+	memset(&data->out, 0, sizeof(data->out));
+	data->reloads = 0;
+}
+
+static int pwm_emul_init(const struct device *dev)
+{
+	const struct pwm_emul_config *config = dev->config;
+	struct pwm_emul_data *data = dev->data;
+
+	pwm_emul_reset(dev);
+
+	if (!config->sync) {
+		return 0;
+	}
+
+	data->backend.dev = dev;
+	data->backend.pin_set_multi = pwm_emul_pin_set_multi;
+
+	return pwm_dual_backend_register(&data->backend);
+}
+
+/* Both kinds of device implement the standard API only. */
+static const struct pwm_driver_api pwm_emul_api = {
+	.pin_set = pwm_emul_pin_set,
+	.get_cycles_per_sec = pwm_emul_get_cycles_per_sec,
+};
+
+#define PWM_EMUL_DEVICE(inst)						\
+	static struct pwm_emul_data pwm_emul_data_##inst;		\
+	static const struct pwm_emul_config pwm_emul_config_##inst = {	\
+		.sync = DT_INST_PROP(inst, sync),			\
+	};								\
+	DEVICE_AND_API_INIT(pwm_emul_##inst, DT_INST_LABEL(inst),	\
+			    pwm_emul_init, &pwm_emul_data_##inst,	\
+			    &pwm_emul_config_##inst, POST_KERNEL,	\
+			    CONFIG_KERNEL_INIT_PRIORITY_DEVICE,		\
+			    &pwm_emul_api);
+
+DT_INST_FOREACH_STATUS_OKAY(PWM_EMUL_DEVICE)
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef PWM_EMUL_H_
+#define PWM_EMUL_H_
+
+/* Emulated PWM devices of the devicetree overlay, with the channel number
+ * used as pin.
+ *
+ * Every reload of the emulated hardware restarts the period with the
+ * output as set, as the nRF PWM does, and is recorded. A setting applied
+ * in a single reload changes all its channels on the same period
+ * boundary.
+ */
+
+#include <zephyr/types.h>
+#include <device.h>
+
+/* Registered as a PWM Dual backend, implementing pin_set_multi. */
+#define PWM_EMUL_SYNC_NAME	"PWM_EMUL_SYNC"
+
+/* Standard PWM API only, not registered. */
+#define PWM_EMUL_NAME		"PWM_EMUL"
+
+#define PWM_EMUL_CHANNELS	4
+#define PWM_EMUL_CYCLES_PER_SEC	16000000
+
+/* Output of the emulated hardware, in cycles. */
+struct pwm_emul_output {
+	uint32_t period;
+	uint32_t pulse[PWM_EMUL_CHANNELS];
+};
+
+/* Output after each reload since the last reset, the first ones if more
+ * than the log holds. Returns the number of reloads.
+ */
+size_t pwm_emul_reloads(const struct device *dev,
+			const struct pwm_emul_output **log);
+
+/* Clear the output and the reloads. */
+void pwm_emul_reset(const struct device *dev);
+
+#endif /* PWM_EMUL_H_ */
@@ -0,0 +1,1085 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Loopback Bluetooth host for native_posix tests
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/byteorder.h>
+#include <sys/slist.h>
+#include <sys/util.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/uuid.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/gatt_dm.h>
+
+#include "bt_loopback.h"
+
+#define LINK_COUNT	CONFIG_BT_MAX_CONN
+
+/* PDUs in flight over all links, host buffers of both directions and the
+ * responses to requests.
+ */
+#define PDU_COUNT	(LINK_COUNT * BT_LOOPBACK_DIR_COUNT * 16)
+
+/* Attributes of the peripheral database. */
+#define ATTR_MAX	16
+
+/* Largest attribute value, written with a long write if needed. */
+#define VALUE_MAX	512
+
+BUILD_ASSERT(BT_GATT_CCC_MAX >= LINK_COUNT, "CCC cannot track every link");
+
+/* Opaque to the users of the host, conn[] of a link is indexed by the
+ * direction the connection receives.
+ */
+struct bt_conn {
+	uint8_t index;
+	atomic_t ref;
+};
+
+enum pdu_type {
+	PDU_NOTIFY,
+	PDU_WRITE_CMD,
+	PDU_WRITE_REQ,
+	PDU_READ_REQ,
+	PDU_WRITE_RSP,
+	PDU_READ_RSP,
+};
+
+struct pdu {
+	sys_snode_t node;
+	int64_t due;
+	uint8_t type;
+	uint8_t err;
+	bool lost;
+
+	/* Holds a host buffer of the sender until delivered. */
+	bool buffered;
+
+	uint16_t handle;
+	uint16_t offset;
+	uint16_t len;
+
+	union {
+		struct {
+			bt_gatt_complete_func_t func;
+			void *user_data;
+		} sent;
+		struct bt_gatt_write_params *write;
+		struct bt_gatt_read_params *read;
+	} cb;
+
+	uint8_t data[VALUE_MAX];
+};
+
+struct dir {
+	struct k_delayed_work work;
+	struct link *link;
+	sys_slist_t pdus;
+
+	/* Buffered PDUs in flight. */
+	uint8_t inflight;
+
+	/* Next connection event and the PDUs already delivered in it. */
+	int64_t event;
+	uint8_t event_pdus;
+};
+
+struct bt_gatt_dm {
+	struct bt_conn *conn;
+	struct bt_gatt_service_val svc_val;
+	struct bt_gatt_dm_attr attrs[ATTR_MAX];
+	size_t attr_count;
+};
+
+struct link {
+	bool used;
+	struct bt_conn conn[BT_LOOPBACK_DIR_COUNT];
+	struct dir dir[BT_LOOPBACK_DIR_COUNT];
+
+	/* Subscription of the central, a single one per link. */
+	struct bt_gatt_subscribe_params *sub;
+
+	struct bt_gatt_dm dm;
+};
+
+static struct link links[LINK_COUNT];
+static struct pdu pdu_pool[PDU_COUNT];
+static sys_slist_t pdu_free;
+static uint16_t pdus_used;
+static const struct bt_gatt_service_static *db;
+static const struct bt_uuid *dm_hidden;
+static struct bt_conn_cb *conn_cbs;
+static struct bt_loopback_stats stats[BT_LOOPBACK_DIR_COUNT];
+static struct k_spinlock lock;
+static uint32_t loss_state;
+
+static struct bt_loopback_param param = {
+	.mtu = 23,
+	.pdus_per_event = 1,
+};
+
+static struct link *link_get(struct bt_conn *conn)
+{
+	return &links[conn->index];
+}
+
+static struct bt_conn *central_get(struct link *link)
+{
+	return &link->conn[BT_LOOPBACK_TO_CENTRAL];
+}
+
+static struct bt_conn *peripheral_get(struct link *link)
+{
+	return &link->conn[BT_LOOPBACK_TO_PERIPHERAL];
+}
+
+/* Direction of the PDUs sent by conn. */
+static enum bt_loopback_dir tx_dir(struct bt_conn *conn)
+{
+	return (conn == central_get(link_get(conn))) ?
+	       BT_LOOPBACK_TO_PERIPHERAL : BT_LOOPBACK_TO_CENTRAL;
+}
+
+static const struct bt_gatt_attr *attr_get(uint16_t handle)
+{
+	if (!handle || (handle > db->attr_count)) {
+		return NULL;
+	}
+
+	return &db->attrs[handle - 1];
+}
+
+static uint16_t attr_handle(const struct bt_gatt_attr *attr)
+{
+	if ((attr < db->attrs) || (attr >= &db->attrs[db->attr_count])) {
+		return 0;
+	}
+
+	return (attr - db->attrs) + 1;
+}
+
+/* Called with lock held. */
+static bool pdu_lost(void)
+{
+	if (!param.loss_permille) {
+		return false;
+	}
+
+	loss_state ^= loss_state << 13;
+	loss_state ^= loss_state >> 17;
+	loss_state ^= loss_state << 5;
+
+	return (loss_state % 1000) < param.loss_permille;
+}
+
+/* Delivery time of a PDU sent now. Called with lock held. */
+static int64_t pdu_due(struct dir *d)
+{
+	int64_t due = k_uptime_get() + param.latency_ms;
+	uint16_t interval = param.interval_ms;
+
+	if (!interval) {
+		return due;
+	}
+
+	if (d->event_pdus >= MAX(param.pdus_per_event, 1)) {
+		d->event += interval;
+		d->event_pdus = 0;
+	}
+
+	if (d->event < due) {
+		d->event += ceiling_fraction(due - d->event, interval) * interval;
+		d->event_pdus = 0;
+	}
+
+	d->event_pdus++;
+
+	return d->event;
+}
+
+static struct pdu *pdu_alloc(struct bt_conn *conn, uint8_t type, int *err)
+{
+	struct link *link = link_get(conn);
+	enum bt_loopback_dir dir = tx_dir(conn);
+	struct dir *d = &link->dir[dir];
+	struct pdu *pdu = NULL;
+	sys_snode_t *node;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	if (!link->used) {
+		*err = -ENOTCONN;
+		goto out;
+	}
+
+	if ((param.tx_bufs && (d->inflight >= param.tx_bufs)) ||
+	    !(node = sys_slist_get(&pdu_free))) {
+		stats[dir].nomem++;
+		*err = -ENOMEM;
+		goto out;
+	}
+
+	pdu = CONTAINER_OF(node, struct pdu, node);
+	memset(pdu, 0, offsetof(struct pdu, data));
+	pdu->type = type;
+	pdu->buffered = true;
+	pdus_used++;
+
+	d->inflight++;
+	stats[dir].inflight_hwm = MAX(stats[dir].inflight_hwm, d->inflight);
+
+out:
+	k_spin_unlock(&lock, key);
+
+	return pdu;
+}
+
+static void pdu_free_put(struct pdu *pdu)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	sys_slist_append(&pdu_free, &pdu->node);
+	pdus_used--;
+
+	k_spin_unlock(&lock, key);
+}
+
+static void pdu_queue(struct link *link, enum bt_loopback_dir dir,
+		      struct pdu *pdu)
+{
+	struct dir *d = &link->dir[dir];
+	k_spinlock_key_t key;
+	struct pdu *head;
+	int64_t delay;
+
+	key = k_spin_lock(&lock);
+	if ((pdu->type == PDU_NOTIFY) || (pdu->type == PDU_WRITE_CMD)) {
+		pdu->lost = pdu_lost();
+		if (pdu->lost) {
+			stats[dir].lost++;
+		}
+	}
+	stats[dir].pdus++;
+	stats[dir].bytes += pdu->len;
+
+	pdu->due = pdu_due(d);
+	sys_slist_append(&d->pdus, &pdu->node);
+
+	head = CONTAINER_OF(sys_slist_peek_head(&d->pdus), struct pdu, node);
+	delay = MAX(head->due - k_uptime_get(), 0);
+	k_spin_unlock(&lock, key);
+
+	k_delayed_work_submit(&d->work, K_MSEC(delay));
+}
+
+static uint8_t att_err(ssize_t ret, uint16_t len)
+{
+	if (ret < 0) {
+		return -ret;
+	}
+
+	return (ret == len) ? 0 : BT_ATT_ERR_UNLIKELY;
+}
+
+static uint8_t write_req(struct bt_conn *conn, struct pdu *pdu)
+{
+	const struct bt_gatt_attr *attr = attr_get(pdu->handle);
+	uint16_t chunk = param.mtu - 3;
+	uint16_t off;
+	uint16_t len;
+	ssize_t ret;
+
+	if (!attr) {
+		return BT_ATT_ERR_INVALID_HANDLE;
+	}
+
+	if (!attr->write || !(attr->perm & BT_GATT_PERM_WRITE)) {
+		return BT_ATT_ERR_WRITE_NOT_PERMITTED;
+	}
+
+	if (!pdu->offset && (pdu->len <= chunk)) {
+		return att_err(attr->write(conn, attr, pdu->data, pdu->len, 0,
+					   0), pdu->len);
+	}
+
+	/* Long write, chunks are prepared then executed in order. */
+	if (!(attr->perm & BT_GATT_PERM_PREPARE_WRITE)) {
+		return BT_ATT_ERR_WRITE_NOT_PERMITTED;
+	}
+
+	chunk = param.mtu - 5;
+
+	for (off = 0; off < pdu->len; off += len) {
+		len = MIN(chunk, pdu->len - off);
+		ret = attr->write(conn, attr, &pdu->data[off], len,
+				  pdu->offset + off, BT_GATT_WRITE_FLAG_PREPARE);
+		if (ret < 0) {
+			return -ret;
+		}
+	}
+
+	for (off = 0; off < pdu->len; off += len) {
+		len = MIN(chunk, pdu->len - off);
+		ret = attr->write(conn, attr, &pdu->data[off], len,
+				  pdu->offset + off, 0);
+		if (att_err(ret, len)) {
+			return att_err(ret, len);
+		}
+	}
+
+	return 0;
+}
+
+static uint8_t read_req(struct bt_conn *conn, struct pdu *pdu)
+{
+	const struct bt_gatt_attr *attr = attr_get(pdu->handle);
+	ssize_t ret;
+
+	/* Reads by UUID are sent with no handle, nothing matches them. */
+	if (!pdu->handle) {
+		return BT_ATT_ERR_ATTRIBUTE_NOT_FOUND;
+	}
+
+	if (!attr) {
+		return BT_ATT_ERR_INVALID_HANDLE;
+	}
+
+	if (!attr->read || !(attr->perm & BT_GATT_PERM_READ)) {
+		return BT_ATT_ERR_READ_NOT_PERMITTED;
+	}
+
+	ret = attr->read(conn, attr, pdu->data, MIN(param.mtu - 1, VALUE_MAX),
+			 pdu->offset);
+	if (ret < 0) {
+		return -ret;
+	}
+
+	pdu->len = ret;
+
+	return 0;
+}
+
+/* Remove the subscription of the central, with the CCC written back if the
+ * central stopped it, as after BT_GATT_ITER_STOP.
+ */
+static void unsubscribe(struct link *link, bool write_ccc)
+{
+	struct bt_gatt_subscribe_params *sub = link->sub;
+	const struct bt_gatt_attr *attr;
+	uint16_t value = 0;
+
+	if (!sub) {
+		return;
+	}
+
+	link->sub = NULL;
+
+	attr = attr_get(sub->ccc_handle);
+	if (write_ccc && attr && attr->write) {
+		(void)attr->write(peripheral_get(link), attr, &value,
+				  sizeof(value), 0, 0);
+	}
+
+	sub->notify(central_get(link), sub, NULL, 0);
+}
+
+static void pdu_deliver(struct link *link, enum bt_loopback_dir dir,
+			struct pdu *pdu)
+{
+	struct bt_conn *rx = &link->conn[dir];
+	struct bt_conn *tx = &link->conn[!dir];
+	const struct bt_gatt_attr *attr;
+	struct bt_gatt_subscribe_params *sub;
+	struct bt_gatt_write_params *write;
+	struct bt_gatt_read_params *read;
+	bt_gatt_complete_func_t func;
+	void *user_data;
+	uint8_t err;
+
+	switch (pdu->type) {
+	case PDU_NOTIFY:
+		sub = link->sub;
+		if (!pdu->lost && sub && (sub->value_handle == pdu->handle) &&
+		    (sub->notify(rx, sub, pdu->data, pdu->len) ==
+		     BT_GATT_ITER_STOP)) {
+			unsubscribe(link, true);
+		}
+		break;
+	case PDU_WRITE_CMD:
+		attr = attr_get(pdu->handle);
+		if (!pdu->lost && attr && attr->write &&
+		    (attr->perm & BT_GATT_PERM_WRITE)) {
+			(void)attr->write(rx, attr, pdu->data, pdu->len, 0,
+					  BT_GATT_WRITE_FLAG_CMD);
+		}
+		break;
+	case PDU_WRITE_REQ:
+		pdu->err = write_req(rx, pdu);
+		pdu->type = PDU_WRITE_RSP;
+		pdu->len = 0;
+		pdu_queue(link, !dir, pdu);
+		return;
+	case PDU_READ_REQ:
+		pdu->err = read_req(rx, pdu);
+		pdu->type = PDU_READ_RSP;
+		pdu_queue(link, !dir, pdu);
+		return;
+	case PDU_WRITE_RSP:
+		write = pdu->cb.write;
+		err = pdu->err;
+		pdu_free_put(pdu);
+
+		if (write && write->func) {
+			write->func(rx, err, write);
+		}
+		return;
+	case PDU_READ_RSP:
+		read = pdu->cb.read;
+		if (pdu->err) {
+			read->func(rx, pdu->err, read, NULL, 0);
+		} else if (read->func(rx, 0, read, pdu->data, pdu->len) ==
+			   BT_GATT_ITER_CONTINUE) {
+			read->func(rx, 0, read, NULL, 0);
+		}
+		pdu_free_put(pdu);
+		return;
+	}
+
+	/* Notifications and writes without response complete on delivery,
+	 * once their host buffer is free again.
+	 */
+	func = pdu->cb.sent.func;
+	user_data = pdu->cb.sent.user_data;
+	pdu_free_put(pdu);
+
+	if (func) {
+		func(tx, user_data);
+	}
+}
+
+static void dir_work_handler(struct k_work *work)
+{
+	struct dir *d = CONTAINER_OF(work, struct dir, work);
+	struct link *link = d->link;
+	sys_snode_t *node;
+	k_spinlock_key_t key;
+	struct pdu *pdu;
+	int64_t delay;
+
+	for (;;) {
+		key = k_spin_lock(&lock);
+		node = sys_slist_peek_head(&d->pdus);
+		if (!node) {
+			k_spin_unlock(&lock, key);
+			return;
+		}
+
+		pdu = CONTAINER_OF(node, struct pdu, node);
+		delay = pdu->due - k_uptime_get();
+		if (delay > 0) {
+			k_spin_unlock(&lock, key);
+			k_delayed_work_submit(&d->work, K_MSEC(delay));
+			return;
+		}
+
+		(void)sys_slist_get(&d->pdus);
+		if (pdu->buffered) {
+			pdu->buffered = false;
+			d->inflight--;
+		}
+		k_spin_unlock(&lock, key);
+
+		pdu_deliver(link, d - link->dir, pdu);
+	}
+}
+
+static void ccc_update(const struct bt_gatt_attr *attr,
+		       struct _bt_gatt_ccc *ccc)
+{
+	uint16_t value = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(ccc->cfg); i++) {
+		value |= ccc->cfg[i].value;
+	}
+
+	if (value != ccc->value) {
+		ccc->value = value;
+		if (ccc->cfg_changed) {
+			ccc->cfg_changed(attr, value);
+		}
+	}
+}
+
+/* Subscriptions are not persistent, as for peers without a bond. */
+static void ccc_reset(struct bt_conn *conn)
+{
+	const struct bt_gatt_attr *attr;
+	struct _bt_gatt_ccc *ccc;
+
+	for (size_t i = 0; i < db->attr_count; i++) {
+		attr = &db->attrs[i];
+		if (bt_uuid_cmp(attr->uuid, BT_UUID_GATT_CCC)) {
+			continue;
+		}
+
+		ccc = attr->user_data;
+		ccc->cfg[bt_conn_index(conn)].value = 0;
+		ccc_update(attr, ccc);
+	}
+}
+
+int bt_loopback_init(const struct bt_gatt_service_static *svc)
+{
+	if (svc->attr_count > ATTR_MAX) {
+		return -ENOMEM;
+	}
+
+	db = svc;
+
+	sys_slist_init(&pdu_free);
+	for (size_t i = 0; i < ARRAY_SIZE(pdu_pool); i++) {
+		sys_slist_append(&pdu_free, &pdu_pool[i].node);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+		for (size_t j = 0; j < BT_LOOPBACK_DIR_COUNT; j++) {
+			links[i].dir[j].link = &links[i];
+			k_delayed_work_init(&links[i].dir[j].work,
+					    dir_work_handler);
+		}
+	}
+
+	return 0;
+}
+
+void bt_loopback_param_set(const struct bt_loopback_param *p)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	param = *p;
+	loss_state = p->seed ? p->seed : 1;
+
+	k_spin_unlock(&lock, key);
+}
+
+struct bt_conn *bt_loopback_connect(struct bt_conn **central)
+{
+	struct bt_conn *peripheral;
+	struct bt_conn_cb *cb;
+	struct link *link;
+	size_t i;
+
+	for (i = 0; (i < ARRAY_SIZE(links)) && links[i].used; i++) {
+	}
+
+	if (i == ARRAY_SIZE(links)) {
+		return NULL;
+	}
+
+	link = &links[i];
+	link->sub = NULL;
+
+	for (size_t j = 0; j < BT_LOOPBACK_DIR_COUNT; j++) {
+		link->conn[j].index = i;
+		atomic_set(&link->conn[j].ref, 1);
+
+		sys_slist_init(&link->dir[j].pdus);
+		link->dir[j].inflight = 0;
+		link->dir[j].event = 0;
+		link->dir[j].event_pdus = 0;
+	}
+
+	link->used = true;
+
+	peripheral = peripheral_get(link);
+	for (cb = conn_cbs; cb; cb = cb->_next) {
+		if (cb->connected) {
+			cb->connected(peripheral, 0);
+		}
+	}
+
+	*central = central_get(link);
+
+	return peripheral;
+}
+
+void bt_loopback_disconnect(struct bt_conn *conn)
+{
+	struct link *link = link_get(conn);
+	struct bt_conn *central = central_get(link);
+	struct bt_conn_cb *cb;
+	sys_slist_t dropped;
+	sys_snode_t *node;
+	k_spinlock_key_t key;
+	struct pdu *pdu;
+
+	if (!link->used) {
+		return;
+	}
+
+	sys_slist_init(&dropped);
+
+	key = k_spin_lock(&lock);
+	link->used = false;
+	for (size_t i = 0; i < BT_LOOPBACK_DIR_COUNT; i++) {
+		k_delayed_work_cancel(&link->dir[i].work);
+		while ((node = sys_slist_get(&link->dir[i].pdus))) {
+			sys_slist_append(&dropped, node);
+		}
+		link->dir[i].inflight = 0;
+	}
+	k_spin_unlock(&lock, key);
+
+	/* Requests never answered fail, as on an ATT reset. */
+	while ((node = sys_slist_get(&dropped))) {
+		pdu = CONTAINER_OF(node, struct pdu, node);
+
+		if (((pdu->type == PDU_WRITE_REQ) ||
+		     (pdu->type == PDU_WRITE_RSP)) &&
+		    pdu->cb.write && pdu->cb.write->func) {
+			pdu->cb.write->func(central, BT_ATT_ERR_UNLIKELY,
+					    pdu->cb.write);
+		} else if ((pdu->type == PDU_READ_REQ) ||
+			   (pdu->type == PDU_READ_RSP)) {
+			pdu->cb.read->func(central, BT_ATT_ERR_UNLIKELY,
+					   pdu->cb.read, NULL, 0);
+		}
+
+		pdu_free_put(pdu);
+	}
+
+	unsubscribe(link, false);
+	ccc_reset(peripheral_get(link));
+
+	for (cb = conn_cbs; cb; cb = cb->_next) {
+		if (cb->disconnected) {
+			cb->disconnected(peripheral_get(link),
+					 BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		}
+	}
+}
+
+struct bt_gatt_dm *bt_loopback_dm_get(struct bt_conn *central)
+{
+	struct bt_gatt_dm *dm = &link_get(central)->dm;
+
+	dm->conn = central;
+	dm->svc_val.uuid = db->attrs[0].user_data;
+	dm->svc_val.end_handle = db->attr_count;
+	dm->attr_count = db->attr_count;
+
+	for (size_t i = 0; i < db->attr_count; i++) {
+		dm->attrs[i].uuid = (struct bt_uuid *)db->attrs[i].uuid;
+		dm->attrs[i].handle = i + 1;
+		dm->attrs[i].perm = db->attrs[i].perm;
+	}
+
+	return dm;
+}
+
+void bt_loopback_dm_hide(const struct bt_uuid *uuid)
+{
+	dm_hidden = uuid;
+}
+
+bool bt_loopback_idle(void)
+{
+	return !pdus_used;
+}
+
+void bt_loopback_stats_get(enum bt_loopback_dir dir,
+			   struct bt_loopback_stats *s)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	*s = stats[dir];
+
+	k_spin_unlock(&lock, key);
+}
+
+void bt_loopback_stats_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(stats, 0, sizeof(stats));
+
+	k_spin_unlock(&lock, key);
+}
+
+/* Host API used by the modules under test. */
+
+void bt_conn_cb_register(struct bt_conn_cb *cb)
+{
+	cb->_next = conn_cbs;
+	conn_cbs = cb;
+}
+
+struct bt_conn *bt_conn_ref(struct bt_conn *conn)
+{
+	atomic_inc(&conn->ref);
+
+	return conn;
+}
+
+void bt_conn_unref(struct bt_conn *conn)
+{
+	atomic_dec(&conn->ref);
+}
+
+uint8_t bt_conn_index(struct bt_conn *conn)
+{
+	return conn->index;
+}
+
+int bt_uuid_cmp(const struct bt_uuid *u1, const struct bt_uuid *u2)
+{
+	/* UUIDs of the database and of the modules use the same types. */
+	if (u1->type != u2->type) {
+		return u1->type - u2->type;
+	}
+
+	switch (u1->type) {
+	case BT_UUID_TYPE_16:
+		return (int)BT_UUID_16(u1)->val - (int)BT_UUID_16(u2)->val;
+	case BT_UUID_TYPE_32:
+		return (BT_UUID_32(u1)->val == BT_UUID_32(u2)->val) ? 0 : 1;
+	case BT_UUID_TYPE_128:
+		return memcmp(BT_UUID_128(u1)->val, BT_UUID_128(u2)->val, 16);
+	}
+
+	return -EINVAL;
+}
+
+uint16_t bt_gatt_get_mtu(struct bt_conn *conn)
+{
+	return param.mtu;
+}
+
+ssize_t bt_gatt_attr_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			  void *buf, uint16_t buf_len, uint16_t offset,
+			  const void *value, uint16_t value_len)
+{
+	uint16_t len;
+
+	if (offset > value_len) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	len = MIN(buf_len, value_len - offset);
+	memcpy(buf, (const uint8_t *)value + offset, len);
+
+	return len;
+}
+
+ssize_t bt_gatt_attr_read_service(struct bt_conn *conn,
+				  const struct bt_gatt_attr *attr,
+				  void *buf, uint16_t len, uint16_t offset)
+{
+	const struct bt_uuid *uuid = attr->user_data;
+	uint16_t uuid16;
+
+	if (uuid->type == BT_UUID_TYPE_16) {
+		uuid16 = sys_cpu_to_le16(BT_UUID_16(uuid)->val);
+		return bt_gatt_attr_read(conn, attr, buf, len, offset, &uuid16,
+					 sizeof(uuid16));
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset,
+				 BT_UUID_128(uuid)->val, 16);
+}
+
+ssize_t bt_gatt_attr_read_chrc(struct bt_conn *conn,
+			       const struct bt_gatt_attr *attr, void *buf,
+			       uint16_t len, uint16_t offset)
+{
+	const struct bt_gatt_chrc *chrc = attr->user_data;
+	uint8_t value[3 + 16];
+	uint16_t value_len = 3;
+
+	value[0] = chrc->properties;
+	sys_put_le16(attr_handle(attr) + 1, &value[1]);
+
+	if (chrc->uuid->type == BT_UUID_TYPE_16) {
+		sys_put_le16(BT_UUID_16(chrc->uuid)->val, &value[3]);
+		value_len += 2;
+	} else {
+		memcpy(&value[3], BT_UUID_128(chrc->uuid)->val, 16);
+		value_len += 16;
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, value,
+				 value_len);
+}
+
+ssize_t bt_gatt_attr_read_ccc(struct bt_conn *conn,
+			      const struct bt_gatt_attr *attr, void *buf,
+			      uint16_t len, uint16_t offset)
+{
+	const struct _bt_gatt_ccc *ccc = attr->user_data;
+	uint16_t value = sys_cpu_to_le16(ccc->cfg[bt_conn_index(conn)].value);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &value,
+				 sizeof(value));
+}
+
+ssize_t bt_gatt_attr_write_ccc(struct bt_conn *conn,
+			       const struct bt_gatt_attr *attr, const void *buf,
+			       uint16_t len, uint16_t offset, uint8_t flags)
+{
+	struct _bt_gatt_ccc *ccc = attr->user_data;
+	uint16_t value;
+	ssize_t ret;
+
+	if (offset) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (!len || (len > sizeof(uint16_t))) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	value = (len == 1) ? *(const uint8_t *)buf : sys_get_le16(buf);
+
+	if (ccc->cfg_write) {
+		ret = ccc->cfg_write(conn, attr, value);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	ccc->cfg[bt_conn_index(conn)].value = value;
+	ccc_update(attr, ccc);
+
+	return len;
+}
+
+bool bt_gatt_is_subscribed(struct bt_conn *conn,
+			   const struct bt_gatt_attr *attr, uint16_t ccc_value)
+{
+	const struct bt_gatt_attr *ccc = attr_get(attr_handle(attr) + 1);
+
+	if (!attr_handle(attr) || !ccc ||
+	    bt_uuid_cmp(ccc->uuid, BT_UUID_GATT_CCC)) {
+		return false;
+	}
+
+	return ((struct _bt_gatt_ccc *)ccc->user_data)->
+		cfg[bt_conn_index(conn)].value & ccc_value;
+}
+
+int bt_gatt_notify_cb(struct bt_conn *conn,
+		      struct bt_gatt_notify_params *params)
+{
+	uint16_t handle;
+	struct pdu *pdu;
+	int err;
+
+	/* Notifications to every peer are not used by the modules. */
+	if (!conn) {
+		return -ENOTSUP;
+	}
+
+	handle = attr_handle(params->attr);
+	if (!handle) {
+		return -ENOENT;
+	}
+
+	if (params->len > (param.mtu - 3)) {
+		return -EMSGSIZE;
+	}
+
+	pdu = pdu_alloc(conn, PDU_NOTIFY, &err);
+	if (!pdu) {
+		return err;
+	}
+
+	pdu->handle = handle;
+	pdu->len = params->len;
+	memcpy(pdu->data, params->data, params->len);
+	pdu->cb.sent.func = params->func;
+	pdu->cb.sent.user_data = params->user_data;
+
+	pdu_queue(link_get(conn), tx_dir(conn), pdu);
+
+	return 0;
+}
+
+int bt_gatt_write_without_response_cb(struct bt_conn *conn, uint16_t handle,
+				      const void *data, uint16_t length,
+				      bool sign, bt_gatt_complete_func_t func,
+				      void *user_data)
+{
+	struct pdu *pdu;
+	int err;
+
+	if (length > (param.mtu - 3)) {
+		return -EMSGSIZE;
+	}
+
+	pdu = pdu_alloc(conn, PDU_WRITE_CMD, &err);
+	if (!pdu) {
+		return err;
+	}
+
+	pdu->handle = handle;
+	pdu->len = length;
+	memcpy(pdu->data, data, length);
+	pdu->cb.sent.func = func;
+	pdu->cb.sent.user_data = user_data;
+
+	pdu_queue(link_get(conn), tx_dir(conn), pdu);
+
+	return 0;
+}
+
+int bt_gatt_write(struct bt_conn *conn, struct bt_gatt_write_params *params)
+{
+	struct pdu *pdu;
+	int err;
+
+	if (params->length > VALUE_MAX) {
+		return -EINVAL;
+	}
+
+	pdu = pdu_alloc(conn, PDU_WRITE_REQ, &err);
+	if (!pdu) {
+		return err;
+	}
+
+	pdu->handle = params->handle;
+	pdu->offset = params->offset;
+	pdu->len = params->length;
+	memcpy(pdu->data, params->data, params->length);
+	pdu->cb.write = params;
+
+	pdu_queue(link_get(conn), tx_dir(conn), pdu);
+
+	return 0;
+}
+
+int bt_gatt_read(struct bt_conn *conn, struct bt_gatt_read_params *params)
+{
+	struct pdu *pdu;
+	int err;
+
+	if (params->handle_count > 1) {
+		return -ENOTSUP;
+	}
+
+	pdu = pdu_alloc(conn, PDU_READ_REQ, &err);
+	if (!pdu) {
+		return err;
+	}
+
+	if (params->handle_count) {
+		pdu->handle = params->single.handle;
+		pdu->offset = params->single.offset;
+	}
+	pdu->cb.read = params;
+
+	pdu_queue(link_get(conn), tx_dir(conn), pdu);
+
+	return 0;
+}
+
+int bt_gatt_subscribe(struct bt_conn *conn,
+		      struct bt_gatt_subscribe_params *params)
+{
+	struct link *link = link_get(conn);
+	struct pdu *pdu;
+	int err;
+
+	if (!params->notify || !params->value_handle || !params->ccc_handle) {
+		return -EINVAL;
+	}
+
+	if (link->sub) {
+		return (link->sub == params) ? -EALREADY : -ENOMEM;
+	}
+
+	/* The CCC write is not reported, as for a subscription without a
+	 * write callback.
+	 */
+	pdu = pdu_alloc(conn, PDU_WRITE_REQ, &err);
+	if (!pdu) {
+		return err;
+	}
+
+	pdu->handle = params->ccc_handle;
+	pdu->len = sizeof(uint16_t);
+	sys_put_le16(params->value, pdu->data);
+
+	link->sub = params;
+	pdu_queue(link, tx_dir(conn), pdu);
+
+	return 0;
+}
+
+const struct bt_gatt_dm_attr *bt_gatt_dm_service_get(const struct bt_gatt_dm *dm)
+{
+	return &dm->attrs[0];
+}
+
+struct bt_gatt_service_val *bt_gatt_dm_attr_service_val(
+	const struct bt_gatt_dm_attr *attr)
+{
+	/* Only asked for the service attribute, the first of a discovery. */
+	struct bt_gatt_dm *dm = CONTAINER_OF(attr, struct bt_gatt_dm, attrs);
+
+	return &dm->svc_val;
+}
+
+const struct bt_gatt_dm_attr *bt_gatt_dm_char_by_uuid(const struct bt_gatt_dm *dm,
+						      const struct bt_uuid *uuid)
+{
+	const struct bt_gatt_chrc *chrc;
+
+	if (dm_hidden && !bt_uuid_cmp(uuid, dm_hidden)) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < dm->attr_count; i++) {
+		if (bt_uuid_cmp(db->attrs[i].uuid, BT_UUID_GATT_CHRC)) {
+			continue;
+		}
+
+		chrc = db->attrs[i].user_data;
+		if (!bt_uuid_cmp(chrc->uuid, uuid)) {
+			return &dm->attrs[i];
+		}
+	}
+
+	return NULL;
+}
+
+const struct bt_gatt_dm_attr *bt_gatt_dm_desc_by_uuid(const struct bt_gatt_dm *dm,
+						      const struct bt_gatt_dm_attr *attr_chrc,
+						      const struct bt_uuid *uuid)
+{
+	/* Descriptors, the value first, run until the next characteristic. */
+	for (size_t i = (attr_chrc - dm->attrs) + 1;
+	     (i < dm->attr_count) &&
+	     bt_uuid_cmp(dm->attrs[i].uuid, BT_UUID_GATT_CHRC); i++) {
+		if (!bt_uuid_cmp(dm->attrs[i].uuid, uuid)) {
+			return &dm->attrs[i];
+		}
+	}
+
+	return NULL;
+}
+
+struct bt_conn *bt_gatt_dm_conn_get(struct bt_gatt_dm *dm)
+{
+	return dm->conn;
+}
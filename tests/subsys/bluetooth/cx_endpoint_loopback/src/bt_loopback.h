@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BT_LOOPBACK_H_
+#define BT_LOOPBACK_H_
+
+/* Loopback Bluetooth host connecting a GATT server and client of the same
+ * process, for native_posix.
+ *
+ * It implements the host API used by the CX Endpoint service and client:
+ * connections, the static attribute database, notifications, writes,
+ * reads, subscriptions and a minimal discovery manager. Every PDU is
+ * delivered from the system work queue after the configured latency,
+ * with the sender completion called on delivery, so that queueing,
+ * segmentation and flow control run as against a real link.
+ */
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/gatt_dm.h>
+
+/* Direction of the PDUs of a link. */
+enum bt_loopback_dir {
+	/* Notifications, and responses to the client. */
+	BT_LOOPBACK_TO_CENTRAL,
+	/* Writes and reads of the client. */
+	BT_LOOPBACK_TO_PERIPHERAL,
+
+	BT_LOOPBACK_DIR_COUNT
+};
+
+/* Link model, the same for both directions of every link. */
+struct bt_loopback_param {
+	/* ATT MTU. */
+	uint16_t mtu;
+
+	/* Time from sending a PDU to its delivery. */
+	uint16_t latency_ms;
+
+	/* Connection interval and PDUs delivered per connection event. No
+	 * pacing if interval_ms is 0.
+	 */
+	uint16_t interval_ms;
+	uint8_t pdus_per_event;
+
+	/* Host buffers of a sender, a PDU holding one until delivered.
+	 * Sends fail with -ENOMEM while all are in use. 0 for no limit
+	 * other than the PDU pool.
+	 */
+	uint8_t tx_bufs;
+
+	/* Notifications and writes without response dropped by the
+	 * receiving host, per thousand. Their senders still see them
+	 * completed. Requests and responses are never lost.
+	 */
+	uint16_t loss_permille;
+
+	/* Seed of the loss pattern. */
+	uint32_t seed;
+};
+
+/* Counters of a direction, over all links. */
+struct bt_loopback_stats {
+	/* PDUs sent, lost ones included. */
+	uint32_t pdus;
+	uint32_t bytes;
+	uint32_t lost;
+
+	/* Sends rejected for lack of host buffers. */
+	uint32_t nomem;
+
+	/* Highest number of PDUs in flight on a link. */
+	uint8_t inflight_hwm;
+};
+
+/* Use the attributes of svc as the database of every peripheral. */
+int bt_loopback_init(const struct bt_gatt_service_static *svc);
+
+/* Set the link model, applied to the PDUs sent from now on. Resets the
+ * loss pattern.
+ */
+void bt_loopback_param_set(const struct bt_loopback_param *param);
+
+/* Create a link and report it connected to the peripheral. Returns the
+ * peripheral connection and the central one in central, or NULL if all
+ * links are in use.
+ */
+struct bt_conn *bt_loopback_connect(struct bt_conn **central);
+
+/* Tear down the link of conn, from either side. PDUs in flight are
+ * dropped, pending requests fail with BT_ATT_ERR_UNLIKELY, the
+ * subscription of the central is removed and the disconnection is
+ * reported to the peripheral.
+ */
+void bt_loopback_disconnect(struct bt_conn *conn);
+
+/* Discovery of the peripheral database, as completed by the discovery
+ * manager, valid until the link is torn down.
+ */
+struct bt_gatt_dm *bt_loopback_dm_get(struct bt_conn *central);
+
+/* Leave the characteristic of uuid out of discoveries, as against a peer
+ * built without it. NULL to discover every characteristic again.
+ */
+void bt_loopback_dm_hide(const struct bt_uuid *uuid);
+
+/* Whether no PDU is in flight on any link. */
+bool bt_loopback_idle(void);
+
+void bt_loopback_stats_get(enum bt_loopback_dir dir,
+			   struct bt_loopback_stats *stats);
+void bt_loopback_stats_reset(void);
+
+#endif /* BT_LOOPBACK_H_ */
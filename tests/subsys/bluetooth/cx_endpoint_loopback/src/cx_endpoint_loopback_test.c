@@ -0,0 +1,687 @@
+/*
+ * Copyright (c) 2021 Croxel Inc.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <unity.h>
+#include <zephyr.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/printk.h>
+
+#include <bluetooth/services/cx_endpoint.h>
+#include <bluetooth/services/cx_endpoint_client.h>
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+#include <bluetooth/services/cx_endpoint_rpc.h>
+#endif
+
+#include "bt_loopback.h"
+
+/* Longest time a test waits for the link, in simulated time. */
+#define WAIT_MS		10000
+
+/* Every message starts with its sequence number. */
+#define MSG_HDR_LEN	sizeof(uint16_t)
+
+BUILD_ASSERT((CONFIG_BT_CX_ENDPOINT_TX_QUEUE_LEN +
+	      CONFIG_BT_CX_ENDPOINT_TX_WINDOW) >=
+	     CONFIG_BT_CX_ENDPOINT_TX_BUF_COUNT,
+	     "TX pool must run out before the queue");
+
+/* Messages expected by one side. */
+struct rx_rec {
+	uint16_t len;
+	bool compressible;
+	uint16_t next_seq;
+	uint32_t msgs;
+	uint32_t bytes;
+	uint32_t bad;
+};
+
+/* Completions seen by one side. */
+struct tx_rec {
+	uint32_t ok;
+	uint32_t err;
+};
+
+extern const struct bt_gatt_service_static cx_endpoint_svc;
+
+static struct bt_cx_endpoint_client client;
+static struct bt_conn *peripheral;
+static struct bt_conn *central;
+
+static struct rx_rec server_rx;
+static struct rx_rec client_rx;
+static struct tx_rec server_tx;
+static struct tx_rec client_tx;
+
+/* Time the server application takes per message. */
+static uint16_t server_rx_delay_ms;
+
+static uint8_t msg[CONFIG_BT_CX_ENDPOINT_MAX_MSG_LEN];
+
+/* Incompressible filler unless asked otherwise, regenerated from the
+ * sequence number to check what was received.
+ */
+static void msg_fill(uint8_t *buf, uint16_t len, uint16_t seq,
+		     bool compressible)
+{
+	uint32_t x = (seq * 2654435761u) | 1;
+
+	sys_put_le16(seq, buf);
+
+	for (uint16_t i = MSG_HDR_LEN; i < len; i++) {
+		if (compressible) {
+			buf[i] = i % 16;
+			continue;
+		}
+
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		buf[i] = x;
+	}
+}
+
+static void rx_check(struct rx_rec *rec, const uint8_t *data, uint16_t len)
+{
+	static uint8_t expected[CONFIG_BT_CX_ENDPOINT_MAX_MSG_LEN];
+	uint16_t seq;
+
+	if ((len != rec->len) || (len < MSG_HDR_LEN)) {
+		rec->bad++;
+		return;
+	}
+
+	/* Lost messages leave gaps, but never reorder. */
+	seq = sys_get_le16(data);
+	msg_fill(expected, len, seq, rec->compressible);
+	if ((seq < rec->next_seq) || memcmp(data, expected, len)) {
+		rec->bad++;
+		return;
+	}
+
+	rec->next_seq = seq + 1;
+	rec->msgs++;
+	rec->bytes += len;
+}
+
+static void server_recv(struct bt_conn *conn, const uint8_t *data,
+			uint16_t len)
+{
+	rx_check(&server_rx, data, len);
+
+	if (server_rx_delay_ms) {
+		k_sleep(K_MSEC(server_rx_delay_ms));
+	}
+}
+
+static void server_sent(struct bt_conn *conn, struct net_buf *buf, int err)
+{
+	if (err) {
+		server_tx.err++;
+	} else {
+		server_tx.ok++;
+	}
+}
+
+static uint8_t client_received(struct bt_cx_endpoint_client *cx_endpoint,
+			       const uint8_t *data, uint16_t len)
+{
+	rx_check(&client_rx, data, len);
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void client_sent(struct bt_cx_endpoint_client *cx_endpoint,
+			uint8_t err, const uint8_t *data, uint16_t len)
+{
+	if (err) {
+		client_tx.err++;
+	} else {
+		client_tx.ok++;
+	}
+}
+
+static struct bt_cx_endpoint_cb server_cb = {
+	.recv_cb = server_recv,
+	.sent_cb = server_sent,
+};
+
+/* Hand the messages queued on the client to the same checks as the
+ * received callback.
+ */
+static void client_drain(void)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_CLIENT_RX_QUEUE)
+	struct net_buf *buf;
+
+	while ((buf = bt_cx_endpoint_client_recv(&client, K_NO_WAIT))) {
+		rx_check(&client_rx, buf->data, buf->len);
+		bt_cx_endpoint_client_recv_done(&client, buf);
+	}
+#endif
+}
+
+static bool wait_idle(void)
+{
+	for (int i = 0; i < WAIT_MS; i++) {
+		client_drain();
+		if (bt_loopback_idle()) {
+			return true;
+		}
+		k_sleep(K_MSEC(1));
+	}
+
+	return false;
+}
+
+static bool wait_count(const uint32_t *count, uint32_t expected)
+{
+	for (int i = 0; (i < WAIT_MS) && (*count < expected); i++) {
+		k_sleep(K_MSEC(1));
+		client_drain();
+	}
+
+	return *count >= expected;
+}
+
+/* Connect, discover and subscribe, as a central application would. */
+static void link_up(const struct bt_loopback_param *param)
+{
+	const struct bt_cx_endpoint_client_init_param init = {
+		.cb = {
+			.received = client_received,
+			.sent = client_sent,
+		},
+	};
+
+	bt_loopback_param_set(param);
+
+	memset(&client, 0, sizeof(client));
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_client_init(&client, &init));
+
+	peripheral = bt_loopback_connect(&central);
+	TEST_ASSERT_NOT_NULL(peripheral);
+
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_handles_assign(
+				bt_loopback_dm_get(central), &client));
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_subscribe_receive(&client));
+	TEST_ASSERT_TRUE(wait_idle());
+	TEST_ASSERT_EQUAL(1, bt_cx_endpoint_subscribed_count());
+
+	bt_loopback_stats_reset();
+}
+
+/* Queue messages from the server, waiting for room when the TX pool or
+ * queue is full.
+ */
+static void server_send(uint16_t first, uint16_t count, uint16_t len)
+{
+	int err;
+
+	server_rx.len = len;
+	client_rx.len = len;
+
+	for (uint16_t seq = first; seq < (first + count); seq++) {
+		msg_fill(msg, len, seq, client_rx.compressible);
+
+		for (int i = 0; i < WAIT_MS; i++) {
+			err = bt_cx_endpoint_send(peripheral, msg, len);
+			if (err != -ENOMEM) {
+				break;
+			}
+			k_sleep(K_MSEC(1));
+			client_drain();
+		}
+
+		TEST_ASSERT_EQUAL(0, err);
+	}
+}
+
+static void client_send(uint16_t first, uint16_t count, uint16_t len)
+{
+	int err;
+
+	server_rx.len = len;
+	client_rx.len = len;
+
+	for (uint16_t seq = first; seq < (first + count); seq++) {
+		msg_fill(msg, len, seq, server_rx.compressible);
+
+		for (int i = 0; i < WAIT_MS; i++) {
+			err = bt_cx_endpoint_client_send(&client, msg, len);
+			if (err != -ENOMEM) {
+				break;
+			}
+			k_sleep(K_MSEC(1));
+		}
+
+		TEST_ASSERT_EQUAL(0, err);
+	}
+}
+
+void setUp(void)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		TEST_ASSERT_EQUAL(0, bt_loopback_init(&cx_endpoint_svc));
+		initialized = true;
+	}
+
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_init(&server_cb));
+	bt_loopback_dm_hide(NULL);
+
+	memset(&server_rx, 0, sizeof(server_rx));
+	memset(&client_rx, 0, sizeof(client_rx));
+	memset(&server_tx, 0, sizeof(server_tx));
+	memset(&client_tx, 0, sizeof(client_tx));
+	server_rx_delay_ms = 0;
+}
+
+void tearDown(void)
+{
+	if (peripheral) {
+		bt_loopback_disconnect(peripheral);
+		bt_cx_endpoint_client_release(&client);
+		peripheral = NULL;
+		central = NULL;
+	}
+
+	/* Let retries pending on either side find the link gone. */
+	k_sleep(K_MSEC(50));
+}
+
+/* Suite teardown shall finalize with mandatory call to generic_suiteTearDown. */
+extern int generic_suiteTearDown(int num_failures);
+
+int test_suiteTearDown(int num_failures)
+{
+	return generic_suiteTearDown(num_failures);
+}
+
+void test_segmented_round_trip(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 23,
+		.latency_ms = 2,
+	};
+	struct bt_loopback_stats stats;
+
+	link_up(&param);
+
+	server_send(0, 4, 600);
+	client_send(0, 4, 600);
+
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, 4));
+	TEST_ASSERT_TRUE(wait_count(&server_rx.msgs, 4));
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+	TEST_ASSERT_EQUAL(0, server_rx.bad);
+	TEST_ASSERT_TRUE(wait_count(&client_tx.ok, 4));
+	TEST_ASSERT_TRUE(wait_count(&server_tx.ok, 4));
+
+	/* 600 bytes take at least 30 notifications of 20 bytes. */
+	bt_loopback_stats_get(BT_LOOPBACK_TO_CENTRAL, &stats);
+	TEST_ASSERT_GREATER_OR_EQUAL(4 * 30, stats.pdus);
+	bt_loopback_stats_get(BT_LOOPBACK_TO_PERIPHERAL, &stats);
+	TEST_ASSERT_GREATER_OR_EQUAL(4 * 30, stats.pdus);
+}
+
+void test_tx_queue_full_then_drains(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 247,
+		.latency_ms = 50,
+	};
+	uint16_t accepted = 0;
+	int err;
+
+	link_up(&param);
+
+	server_rx.len = 100;
+	client_rx.len = 100;
+
+	/* Nothing completes before the latency, the pool runs out first. */
+	for (;;) {
+		msg_fill(msg, 100, accepted, false);
+		err = bt_cx_endpoint_send(peripheral, msg, 100);
+		if (err) {
+			break;
+		}
+		accepted++;
+	}
+
+	TEST_ASSERT_EQUAL(-ENOMEM, err);
+	TEST_ASSERT_EQUAL(CONFIG_BT_CX_ENDPOINT_TX_BUF_COUNT, accepted);
+
+	server_send(accepted, 4, 100);
+
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, accepted + 4));
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+	TEST_ASSERT_TRUE(wait_count(&server_tx.ok, accepted + 4));
+	TEST_ASSERT_EQUAL(0, server_tx.err);
+}
+
+void test_window_bounds_inflight(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 247,
+		.latency_ms = 20,
+	};
+	struct bt_loopback_stats stats;
+
+	link_up(&param);
+
+	server_send(0, 8, 600);
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, 8));
+
+	client_send(0, 8, 600);
+	TEST_ASSERT_TRUE(wait_count(&server_rx.msgs, 8));
+
+	bt_loopback_stats_get(BT_LOOPBACK_TO_CENTRAL, &stats);
+	TEST_ASSERT_LESS_OR_EQUAL(CONFIG_BT_CX_ENDPOINT_TX_WINDOW,
+				  stats.inflight_hwm);
+	TEST_ASSERT_GREATER_OR_EQUAL(2, stats.inflight_hwm);
+
+	bt_loopback_stats_get(BT_LOOPBACK_TO_PERIPHERAL, &stats);
+	TEST_ASSERT_LESS_OR_EQUAL(CONFIG_BT_CX_ENDPOINT_CLIENT_TX_WINDOW,
+				  stats.inflight_hwm);
+	TEST_ASSERT_GREATER_OR_EQUAL(2, stats.inflight_hwm);
+}
+
+void test_host_buffer_exhaustion(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 23,
+		.latency_ms = 10,
+		.tx_bufs = 1,
+	};
+	struct bt_loopback_stats stats;
+
+	link_up(&param);
+
+	server_send(0, 6, 100);
+	client_send(0, 6, 100);
+
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, 6));
+	TEST_ASSERT_TRUE(wait_count(&server_rx.msgs, 6));
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+	TEST_ASSERT_EQUAL(0, server_rx.bad);
+
+	/* Both sides retried after the host ran out of buffers. */
+	bt_loopback_stats_get(BT_LOOPBACK_TO_CENTRAL, &stats);
+	TEST_ASSERT_GREATER_THAN(0, stats.nomem);
+	TEST_ASSERT_EQUAL(1, stats.inflight_hwm);
+	bt_loopback_stats_get(BT_LOOPBACK_TO_PERIPHERAL, &stats);
+	TEST_ASSERT_GREATER_THAN(0, stats.nomem);
+	TEST_ASSERT_EQUAL(1, stats.inflight_hwm);
+}
+
+void test_loss_keeps_messages_whole(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 23,
+		.latency_ms = 2,
+		.loss_permille = 200,
+		.seed = 0x1234,
+	};
+	struct bt_loopback_stats stats;
+
+	link_up(&param);
+
+	server_send(0, 40, 60);
+	client_send(0, 40, 60);
+
+	/* Senders see every notification and write complete. */
+	TEST_ASSERT_TRUE(wait_count(&server_tx.ok, 40));
+	TEST_ASSERT_TRUE(wait_count(&client_tx.ok, 40));
+	TEST_ASSERT_TRUE(wait_idle());
+
+	/* Messages with a lost segment are dropped, the others arrive
+	 * intact.
+	 */
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+	TEST_ASSERT_EQUAL(0, server_rx.bad);
+	TEST_ASSERT_GREATER_THAN(0, client_rx.msgs);
+	TEST_ASSERT_LESS_THAN(40, client_rx.msgs);
+	TEST_ASSERT_GREATER_THAN(0, server_rx.msgs);
+	TEST_ASSERT_LESS_THAN(40, server_rx.msgs);
+
+	bt_loopback_stats_get(BT_LOOPBACK_TO_CENTRAL, &stats);
+	TEST_ASSERT_GREATER_THAN(0, stats.lost);
+}
+
+void test_slow_consumer_loses_nothing(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 247,
+		.latency_ms = 2,
+	};
+
+	link_up(&param);
+
+	/* Far more than the RX ring holds, written faster than consumed. */
+	server_rx_delay_ms = 20;
+	client_send(0, 40, 200);
+
+	TEST_ASSERT_TRUE(wait_count(&client_tx.ok, 40));
+	TEST_ASSERT_TRUE(wait_count(&server_rx.msgs, 40));
+	TEST_ASSERT_EQUAL(0, client_tx.err);
+	TEST_ASSERT_EQUAL(0, server_rx.bad);
+	TEST_ASSERT_TRUE(wait_idle());
+	TEST_ASSERT_EQUAL(40, server_rx.msgs);
+}
+
+void test_compressible_payload(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 247,
+		.latency_ms = 2,
+	};
+	struct bt_loopback_stats stats;
+
+	link_up(&param);
+
+	client_rx.compressible = true;
+	server_send(0, 8, 200);
+
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, 8));
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+
+	bt_loopback_stats_get(BT_LOOPBACK_TO_CENTRAL, &stats);
+	if (IS_ENABLED(CONFIG_BT_CX_ENDPOINT_COMPRESSION)) {
+		TEST_ASSERT_LESS_THAN(client_rx.bytes / 2, stats.bytes);
+	} else {
+		TEST_ASSERT_GREATER_OR_EQUAL(client_rx.bytes, stats.bytes);
+	}
+}
+
+void test_peer_without_framing(void)
+{
+	const struct bt_loopback_param param = {
+		.mtu = 247,
+		.latency_ms = 2,
+	};
+	struct bt_loopback_stats stats;
+
+	/* As against a service built without framing. */
+	bt_loopback_dm_hide(BT_UUID_CX_ENDPOINT_FRAME);
+	link_up(&param);
+
+	server_send(0, 4, 200);
+	client_send(0, 4, 200);
+
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, 4));
+	TEST_ASSERT_TRUE(wait_count(&server_rx.msgs, 4));
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+	TEST_ASSERT_EQUAL(0, server_rx.bad);
+	TEST_ASSERT_TRUE(wait_idle());
+
+	/* Unframed and never coalesced, one PDU per message. */
+	bt_loopback_stats_get(BT_LOOPBACK_TO_CENTRAL, &stats);
+	TEST_ASSERT_EQUAL(4, stats.pdus);
+	bt_loopback_stats_get(BT_LOOPBACK_TO_PERIPHERAL, &stats);
+	TEST_ASSERT_EQUAL(4, stats.pdus);
+
+	/* Messages beyond one ATT payload cannot be carried. */
+	msg_fill(msg, 600, 4, false);
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_send(peripheral, msg, 600));
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_client_send(&client, msg, 600));
+	TEST_ASSERT_TRUE(wait_count(&server_tx.err, 1));
+	TEST_ASSERT_TRUE(wait_count(&client_tx.err, 1));
+	TEST_ASSERT_EQUAL(4, client_rx.msgs);
+	TEST_ASSERT_EQUAL(4, server_rx.msgs);
+}
+
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+#define RPC_ECHO	0
+#define RPC_FAIL	1
+
+/* Echoes its arguments, returning their length as a positive value. */
+static int rpc_echo(struct bt_conn *conn, const uint8_t *args, uint16_t len,
+		    struct net_buf *rsp)
+{
+	net_buf_add_mem(rsp, args, len);
+
+	return len;
+}
+
+static int rpc_fail(struct bt_conn *conn, const uint8_t *args, uint16_t len,
+		    struct net_buf *rsp)
+{
+	net_buf_add_mem(rsp, args, len);
+
+	return -EINVAL;
+}
+
+static const struct bt_cx_endpoint_rpc_method rpc_methods[] = {
+	{ .method = RPC_ECHO, .handler = rpc_echo },
+	{ .method = RPC_FAIL, .handler = rpc_fail },
+};
+
+struct rpc_rsp {
+	uint32_t count;
+	int err;
+	uint8_t data[8];
+	uint16_t len;
+};
+
+static void rpc_done(struct bt_cx_endpoint_client *cx_endpoint, int err,
+		     const uint8_t *data, uint16_t len, void *user_data)
+{
+	struct rpc_rsp *rsp = user_data;
+
+	rsp->err = err;
+	rsp->len = MIN(len, sizeof(rsp->data));
+	if (rsp->len) {
+		memcpy(rsp->data, data, rsp->len);
+	}
+	rsp->count++;
+}
+#endif /* CONFIG_BT_CX_ENDPOINT_RPC */
+
+void test_rpc_round_trip(void)
+{
+#if defined(CONFIG_BT_CX_ENDPOINT_RPC)
+	const struct bt_loopback_param param = {
+		.mtu = 23,
+		.latency_ms = 2,
+	};
+	const uint8_t args[] = { 1, 2, 3, 4 };
+	struct rpc_rsp echo = { 0 };
+	struct rpc_rsp fail = { 0 };
+	struct rpc_rsp missing = { 0 };
+	int err;
+
+	err = bt_cx_endpoint_rpc_init(rpc_methods, ARRAY_SIZE(rpc_methods));
+	TEST_ASSERT_TRUE((err == 0) || (err == -EALREADY));
+
+	link_up(&param);
+
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_client_rpc_call(&client, RPC_ECHO,
+				args, sizeof(args), K_MSEC(1000), rpc_done,
+				&echo));
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_client_rpc_call(&client, RPC_FAIL,
+				args, sizeof(args), K_MSEC(1000), rpc_done,
+				&fail));
+	TEST_ASSERT_EQUAL(0, bt_cx_endpoint_client_rpc_call(&client, 0x7f,
+				args, sizeof(args), K_MSEC(1000), rpc_done,
+				&missing));
+
+	TEST_ASSERT_TRUE(wait_count(&echo.count, 1));
+	TEST_ASSERT_TRUE(wait_count(&fail.count, 1));
+	TEST_ASSERT_TRUE(wait_count(&missing.count, 1));
+
+	/* A positive return is a success with results, an error comes
+	 * without them.
+	 */
+	TEST_ASSERT_EQUAL(0, echo.err);
+	TEST_ASSERT_EQUAL(sizeof(args), echo.len);
+	TEST_ASSERT_EQUAL_MEMORY(args, echo.data, sizeof(args));
+	TEST_ASSERT_EQUAL(-EINVAL, fail.err);
+	TEST_ASSERT_EQUAL(0, fail.len);
+	TEST_ASSERT_EQUAL(-ENOTSUP, missing.err);
+#else
+	TEST_IGNORE_MESSAGE("CONFIG_BT_CX_ENDPOINT_RPC disabled");
+#endif
+}
+
+static void benchmark(uint16_t mtu)
+{
+	/* Connection interval of 7.5 ms rounded up, with a few PDUs per
+	 * connection event.
+	 */
+	const struct bt_loopback_param param = {
+		.mtu = mtu,
+		.interval_ms = 8,
+		.pdus_per_event = 4,
+	};
+	const uint16_t count = 32;
+	const uint16_t len = 512;
+	int64_t start;
+	int64_t elapsed;
+
+	link_up(&param);
+
+	start = k_uptime_get();
+	server_send(0, count, len);
+	TEST_ASSERT_TRUE(wait_count(&client_rx.msgs, count));
+	elapsed = MAX(k_uptime_get() - start, 1);
+	printk("MTU %u, server to client: %u bytes in %lld ms, %lld B/s\n",
+	       mtu, client_rx.bytes, elapsed,
+	       (client_rx.bytes * 1000LL) / elapsed);
+
+	start = k_uptime_get();
+	client_send(0, count, len);
+	TEST_ASSERT_TRUE(wait_count(&server_rx.msgs, count));
+	elapsed = MAX(k_uptime_get() - start, 1);
+	printk("MTU %u, client to server: %u bytes in %lld ms, %lld B/s\n",
+	       mtu, server_rx.bytes, elapsed,
+	       (server_rx.bytes * 1000LL) / elapsed);
+
+	TEST_ASSERT_EQUAL(0, client_rx.bad);
+	TEST_ASSERT_EQUAL(0, server_rx.bad);
+}
+
+void test_benchmark_throughput_mtu_23(void)
+{
+	benchmark(23);
+}
+
+void test_benchmark_throughput_mtu_247(void)
+{
+	benchmark(247);
+}
+
+/* It is required to be added to each test. That is because unity is using
+ * different main signature (returns int) and zephyr expects main which does
+ * not return value.
+ */
+extern int unity_main(void);
+
+void main(void)
+{
+	(void)unity_main();
+}